@@ -29,6 +29,7 @@
 #include <linux/resume_user_mode.h>
 #include <linux/psi.h>
 #include <linux/part_stat.h>
+#include <linux/cgroup_bulk_stat.h>
 #include "blk.h"
 #include "blk-cgroup.h"
 #include "blk-ioprio.h"
@@ -981,6 +982,43 @@ static int blkcg_print_stat(struct seq_file *sf, void *v)
 	return 0;
 }
 
+/* sum of io.stat over all the devices, for cgroup.bulk_stat */
+static void blkcg_bulk_stat_fill(struct cgroup_subsys_state *css,
+				 struct cgroup_bulk_stat *bs)
+{
+	struct blkcg *blkcg = css_to_blkcg(css);
+	struct blkcg_gq *blkg;
+
+	/* the non-root stats are flushed by the reader of cgroup.bulk_stat */
+	if (!css->parent)
+		blkcg_fill_root_iostats();
+
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(blkg, &blkcg->blkg_list, blkcg_node) {
+		struct blkg_iostat_set *bis = &blkg->iostat;
+		struct blkg_iostat cur;
+		unsigned seq;
+
+		if (!blkg->online)
+			continue;
+
+		do {
+			seq = u64_stats_fetch_begin(&bis->sync);
+			cur = bis->cur;
+		} while (u64_stats_fetch_retry(&bis->sync, seq));
+
+		bs->io_rbytes += cur.bytes[BLKG_IOSTAT_READ];
+		bs->io_wbytes += cur.bytes[BLKG_IOSTAT_WRITE];
+		bs->io_dbytes += cur.bytes[BLKG_IOSTAT_DISCARD];
+		bs->io_rios += cur.ios[BLKG_IOSTAT_READ];
+		bs->io_wios += cur.ios[BLKG_IOSTAT_WRITE];
+		bs->io_dios += cur.ios[BLKG_IOSTAT_DISCARD];
+	}
+	rcu_read_unlock();
+
+	bs->flags |= CGROUP_BULK_STAT_IO;
+}
+
 static struct cftype blkcg_files[] = {
 	{
 		.name = "stat",
@@ -1311,6 +1349,7 @@ struct cgroup_subsys io_cgrp_subsys = {
 	.css_offline = blkcg_css_offline,
 	.css_free = blkcg_css_free,
 	.css_rstat_flush = blkcg_rstat_flush,
+	.css_bulk_stat_fill = blkcg_bulk_stat_fill,
 	.bind = blkcg_bind,
 	.dfl_cftypes = blkcg_files,
 	.legacy_cftypes = blkcg_legacy_files,
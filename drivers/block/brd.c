@@ -24,15 +24,18 @@
 #include <linux/slab.h>
 #include <linux/backing-dev.h>
 #include <linux/debugfs.h>
+#include <linux/nodemask.h>
+#include <linux/percpu.h>
 
 #include <linux/uaccess.h>
 
 /*
  * Each block ramdisk device has a radix_tree brd_pages of pages that stores
- * the pages containing the block device's contents. A brd page's ->index is
- * its offset in PAGE_SIZE units. This is similar to, but in no way connected
- * with, the kernel's pagecache or buffer cache (which sit above our block
- * device).
+ * the pages containing the block device's contents. The pages are allocated
+ * with order brd_order, so one entry covers (PAGE_SIZE << brd_order) bytes of
+ * the device, and a brd page's ->index is its offset in those units. This is
+ * similar to, but in no way connected with, the kernel's pagecache or buffer
+ * cache (which sit above our block device).
  */
 struct brd_device {
 	int			brd_number;
@@ -46,8 +49,46 @@ struct brd_device {
 	spinlock_t		brd_lock;
 	struct radix_tree_root	brd_pages;
 	u64			brd_nr_pages;
+	unsigned int		brd_order;
+
+	/* last backing page each CPU looked up, see brd_lookup_page() */
+	struct page * __percpu	*brd_last_page;
 };
 
+static int rd_node = NUMA_NO_NODE;
+static bool rd_interleave;
+
+static inline unsigned int brd_sectors_shift(struct brd_device *brd)
+{
+	return PAGE_SECTORS_SHIFT + brd->brd_order;
+}
+
+/* the PAGE_SIZE part of backing page @page that holds @sector */
+static inline struct page *brd_sub_page(struct brd_device *brd,
+					struct page *page, sector_t sector)
+{
+	return nth_page(page, (sector >> PAGE_SECTORS_SHIFT) &
+			      ((1UL << brd->brd_order) - 1));
+}
+
+/*
+ * Pick the node to allocate the backing page for index @idx from: spread
+ * round robin over the nodes with memory, a fixed node, or the local one.
+ */
+static int brd_page_node(pgoff_t idx)
+{
+	int nid, n;
+
+	if (!rd_interleave)
+		return rd_node;
+
+	n = idx % num_node_state(N_MEMORY);
+	for_each_node_state(nid, N_MEMORY)
+		if (!n--)
+			return nid;
+	return NUMA_NO_NODE;
+}
+
 /*
  * Look up and return a brd's page for a given sector.
  */
@@ -56,6 +97,18 @@ static struct page *brd_lookup_page(struct brd_device *brd, sector_t sector)
 	pgoff_t idx;
 	struct page *page;
 
+	idx = sector >> brd_sectors_shift(brd);
+
+	/*
+	 * Large I/O walks the same backing page over and over, so try the page
+	 * this CPU found last before going to the tree.  Pages are only freed
+	 * together with the device, and ->index identifies the page, so a
+	 * single racy read of the pointer is all that is needed.
+	 */
+	page = this_cpu_read(*brd->brd_last_page);
+	if (page && page->index == idx)
+		return brd_sub_page(brd, page, sector);
+
 	/*
 	 * The page lifetime is protected by the fact that we have opened the
 	 * device node -- brd pages will never be deleted under us, so we
@@ -68,13 +121,15 @@ static struct page *brd_lookup_page(struct brd_device *brd, sector_t sector)
 	 * here, only deletes).
 	 */
 	rcu_read_lock();
-	idx = sector >> PAGE_SECTORS_SHIFT; /* sector to page index */
 	page = radix_tree_lookup(&brd->brd_pages, idx);
 	rcu_read_unlock();
 
-	BUG_ON(page && page->index != idx);
+	if (!page)
+		return NULL;
+	BUG_ON(page->index != idx);
+	this_cpu_write(*brd->brd_last_page, page);
 
-	return page;
+	return brd_sub_page(brd, page, sector);
 }
 
 /*
@@ -97,31 +152,49 @@ static struct page *brd_insert_page(struct brd_device *brd, sector_t sector)
 	 * block or filesystem layers from page reclaim.
 	 */
 	gfp_flags = GFP_NOIO | __GFP_ZERO | __GFP_HIGHMEM;
-	page = alloc_page(gfp_flags);
+	if (brd->brd_order)
+		gfp_flags |= __GFP_COMP | __GFP_NOWARN;
+	idx = sector >> brd_sectors_shift(brd);
+	page = alloc_pages_node(brd_page_node(idx), gfp_flags, brd->brd_order);
 	if (!page)
 		return NULL;
 
 	if (radix_tree_preload(GFP_NOIO)) {
-		__free_page(page);
+		__free_pages(page, brd->brd_order);
 		return NULL;
 	}
 
 	spin_lock(&brd->brd_lock);
-	idx = sector >> PAGE_SECTORS_SHIFT;
 	page->index = idx;
 	if (radix_tree_insert(&brd->brd_pages, idx, page)) {
-		__free_page(page);
+		__free_pages(page, brd->brd_order);
 		page = radix_tree_lookup(&brd->brd_pages, idx);
 		BUG_ON(!page);
 		BUG_ON(page->index != idx);
 	} else {
-		brd->brd_nr_pages++;
+		brd->brd_nr_pages += 1UL << brd->brd_order;
 	}
 	spin_unlock(&brd->brd_lock);
 
 	radix_tree_preload_end();
 
-	return page;
+	return brd_sub_page(brd, page, sector);
+}
+
+/*
+ * Allocate the whole backing store up front, so that I/O never has to.
+ */
+static int brd_populate(struct brd_device *brd, sector_t nr_sectors)
+{
+	sector_t sector;
+
+	for (sector = 0; sector < nr_sectors;
+	     sector += 1ULL << brd_sectors_shift(brd)) {
+		if (!brd_insert_page(brd, sector))
+			return -ENOMEM;
+		cond_resched();
+	}
+	return 0;
 }
 
 /*
@@ -148,7 +221,7 @@ static void brd_free_pages(struct brd_device *brd)
 			pos = pages[i]->index;
 			ret = radix_tree_delete(&brd->brd_pages, pos);
 			BUG_ON(!ret || ret != pages[i]);
-			__free_page(pages[i]);
+			__free_pages(pages[i], brd->brd_order);
 		}
 
 		pos++;
@@ -343,6 +416,20 @@ static int max_part = 1;
 module_param(max_part, int, 0444);
 MODULE_PARM_DESC(max_part, "Num Minors to reserve between devices");
 
+static unsigned int rd_order;
+module_param(rd_order, uint, 0444);
+MODULE_PARM_DESC(rd_order, "Allocation order of the backing pages, e.g. 9 for 2M pages on x86-64 (default: 0)");
+
+module_param(rd_node, int, 0444);
+MODULE_PARM_DESC(rd_node, "NUMA node to allocate the backing pages from (default: local node)");
+
+module_param(rd_interleave, bool, 0444);
+MODULE_PARM_DESC(rd_interleave, "Interleave the backing pages over all nodes with memory (default: false)");
+
+static bool rd_prealloc;
+module_param(rd_prealloc, bool, 0444);
+MODULE_PARM_DESC(rd_prealloc, "Allocate all backing pages when the device is created (default: false)");
+
 MODULE_LICENSE("GPL");
 MODULE_ALIAS_BLOCKDEV_MAJOR(RAMDISK_MAJOR);
 MODULE_ALIAS("rd");
@@ -378,6 +465,12 @@ static int brd_alloc(int i)
 	if (!brd)
 		return -ENOMEM;
 	brd->brd_number		= i;
+	brd->brd_order		= rd_order;
+	brd->brd_last_page = alloc_percpu(struct page *);
+	if (!brd->brd_last_page) {
+		kfree(brd);
+		return -ENOMEM;
+	}
 	list_add_tail(&brd->brd_list, &brd_devices);
 
 	spin_lock_init(&brd->brd_lock);
@@ -388,7 +481,8 @@ static int brd_alloc(int i)
 		debugfs_create_u64(buf, 0444, brd_debugfs_dir,
 				&brd->brd_nr_pages);
 
-	disk = brd->brd_disk = blk_alloc_disk(NUMA_NO_NODE);
+	disk = brd->brd_disk = blk_alloc_disk(rd_interleave ? NUMA_NO_NODE :
+					       rd_node);
 	if (!disk)
 		goto out_free_dev;
 
@@ -412,16 +506,25 @@ static int brd_alloc(int i)
 	/* Tell the block layer that this is not a rotational device */
 	blk_queue_flag_set(QUEUE_FLAG_NONROT, disk->queue);
 	blk_queue_flag_clear(QUEUE_FLAG_ADD_RANDOM, disk->queue);
+
+	if (rd_prealloc) {
+		err = brd_populate(brd, get_capacity(disk));
+		if (err)
+			goto out_free_pages;
+	}
+
 	err = add_disk(disk);
 	if (err)
-		goto out_cleanup_disk;
+		goto out_free_pages;
 
 	return 0;
 
-out_cleanup_disk:
+out_free_pages:
+	brd_free_pages(brd);
 	put_disk(disk);
 out_free_dev:
 	list_del(&brd->brd_list);
+	free_percpu(brd->brd_last_page);
 	kfree(brd);
 	return err;
 }
@@ -442,6 +545,7 @@ static void brd_cleanup(void)
 		put_disk(brd->brd_disk);
 		brd_free_pages(brd);
 		list_del(&brd->brd_list);
+		free_percpu(brd->brd_last_page);
 		kfree(brd);
 	}
 }
@@ -463,6 +567,20 @@ static inline void brd_check_and_reset_par(void)
 			DISK_MAX_PARTS, DISK_MAX_PARTS);
 		max_part = DISK_MAX_PARTS;
 	}
+
+	if (rd_order >= MAX_ORDER) {
+		pr_info("brd: rd_order can't be larger than %d, reset rd_order = %d.\n",
+			MAX_ORDER - 1, MAX_ORDER - 1);
+		rd_order = MAX_ORDER - 1;
+	}
+
+	if (rd_node != NUMA_NO_NODE &&
+	    (rd_node < 0 || rd_node >= MAX_NUMNODES ||
+	     !node_state(rd_node, N_MEMORY))) {
+		pr_info("brd: rd_node %d has no memory, using the local node.\n",
+			rd_node);
+		rd_node = NUMA_NO_NODE;
+	}
 }
 
 static int __init brd_init(void)
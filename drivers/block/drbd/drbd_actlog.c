@@ -320,6 +320,7 @@ static int __al_write_transaction(struct drbd_device *device, struct al_transact
 	int i, mx;
 	unsigned extent_nr;
 	unsigned crc = 0;
+	int n_updates;
 	int err = 0;
 
 	memset(buffer, 0, sizeof(*buffer));
@@ -350,6 +351,7 @@ static int __al_write_transaction(struct drbd_device *device, struct al_transact
 	spin_unlock_irq(&device->al_lock);
 	BUG_ON(i > AL_UPDATES_PER_TRANSACTION);
 
+	n_updates = i;
 	buffer->n_updates = cpu_to_be16(i);
 	for ( ; i < AL_UPDATES_PER_TRANSACTION; i++) {
 		buffer->update_slot_nr[i] = cpu_to_be16(-1);
@@ -392,6 +394,7 @@ static int __al_write_transaction(struct drbd_device *device, struct al_transact
 			} else {
 				device->al_tr_number++;
 				device->al_writ_cnt++;
+				device->al_upd_cnt += n_updates;
 			}
 		}
 	}
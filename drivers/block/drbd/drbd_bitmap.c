@@ -18,6 +18,7 @@
 #include <linux/drbd.h>
 #include <linux/slab.h>
 #include <linux/highmem.h>
+#include <linux/sort.h>
 
 #include "drbd_int.h"
 
@@ -1059,6 +1060,14 @@ static void bm_page_io_async(struct drbd_bm_aio_ctx *ctx, int page_nr) __must_ho
 	}
 }
 
+static int cmp_bm_hint(const void *a, const void *b)
+{
+	unsigned int l = *(const unsigned int *)a;
+	unsigned int r = *(const unsigned int *)b;
+
+	return (l > r) - (l < r);
+}
+
 /*
  * bm_rw: read/write the whole bitmap from/to its on disk location.
  */
@@ -1067,6 +1076,7 @@ static int bm_rw(struct drbd_device *device, const unsigned int flags, unsigned
 	struct drbd_bm_aio_ctx *ctx;
 	struct drbd_bitmap *b = device->bitmap;
 	unsigned int num_pages, i, count = 0;
+	struct blk_plug plug;
 	unsigned long now;
 	char ppb[10];
 	int err = 0;
@@ -1114,6 +1124,7 @@ static int bm_rw(struct drbd_device *device, const unsigned int flags, unsigned
 	now = jiffies;
 
 	/* let the layers below us try to merge these bios... */
+	blk_start_plug(&plug);
 
 	if (flags & BM_AIO_READ) {
 		for (i = 0; i < num_pages; i++) {
@@ -1125,6 +1136,11 @@ static int bm_rw(struct drbd_device *device, const unsigned int flags, unsigned
 	} else if (flags & BM_AIO_WRITE_HINTED) {
 		/* ASSERT: BM_AIO_WRITE_ALL_PAGES is not set. */
 		unsigned int hint;
+
+		/* The hints come in activity log order, submit them in on disk
+		 * order so that neighbouring pages can go out as one write. */
+		sort(b->al_bitmap_hints, b->n_bitmap_hints,
+		     sizeof(b->al_bitmap_hints[0]), cmp_bm_hint, NULL);
 		for (hint = 0; hint < b->n_bitmap_hints; hint++) {
 			i = b->al_bitmap_hints[hint];
 			if (i >= num_pages) /* == -1U: no hint here. */
@@ -1164,6 +1180,10 @@ static int bm_rw(struct drbd_device *device, const unsigned int flags, unsigned
 		}
 	}
 
+	blk_finish_plug(&plug);
+	if (!(flags & BM_AIO_READ))
+		device->bm_writ_cnt += count;
+
 	/*
 	 * We initialize ctx->in_flight to one to make sure drbd_bm_endio
 	 * will not set ctx->done early, and decrement / test it here.  If there
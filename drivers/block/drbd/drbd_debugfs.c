@@ -687,6 +687,28 @@ static int device_act_log_extents_show(struct seq_file *m, void *ignored)
 	return 0;
 }
 
+static int device_act_log_stats_show(struct seq_file *m, void *ignored)
+{
+	struct drbd_device *device = m->private;
+
+	/* BUMP me if you change the file format/content/presentation */
+	seq_printf(m, "v: %u\n\n", 0);
+
+	/* al_updates / al_writes is the average number of extents changed per
+	 * transaction, al_waiting_writes counts application writes that had
+	 * to wait for one. */
+	seq_printf(m, "al_writes: %u\n", device->al_writ_cnt);
+	seq_printf(m, "al_updates: %u\n", device->al_upd_cnt);
+	seq_printf(m, "al_waiting_writes: %u\n", device->al_wait_cnt);
+	seq_printf(m, "bm_writes: %u\n", device->bm_writ_cnt);
+
+	if (get_ldev_if_state(device, D_FAILED)) {
+		lc_seq_printf_stats(m, device->act_log);
+		put_ldev(device);
+	}
+	return 0;
+}
+
 static int device_oldest_requests_show(struct seq_file *m, void *ignored)
 {
 	struct drbd_device *device = m->private;
@@ -764,6 +786,7 @@ static const struct file_operations device_ ## name ## _fops = {		\
 
 drbd_debugfs_device_attr(oldest_requests)
 drbd_debugfs_device_attr(act_log_extents)
+drbd_debugfs_device_attr(act_log_stats)
 drbd_debugfs_device_attr(resync_extents)
 drbd_debugfs_device_attr(data_gen_id)
 drbd_debugfs_device_attr(ed_gen_id)
@@ -802,6 +825,7 @@ void drbd_debugfs_device_add(struct drbd_device *device)
 
 	DCF(oldest_requests);
 	DCF(act_log_extents);
+	DCF(act_log_stats);
 	DCF(resync_extents);
 	DCF(data_gen_id);
 	DCF(ed_gen_id);
@@ -818,6 +842,7 @@ void drbd_debugfs_device_cleanup(struct drbd_device *device)
 	drbd_debugfs_remove(&device->debugfs_minor);
 	drbd_debugfs_remove(&device->debugfs_vol_oldest_requests);
 	drbd_debugfs_remove(&device->debugfs_vol_act_log_extents);
+	drbd_debugfs_remove(&device->debugfs_vol_act_log_stats);
 	drbd_debugfs_remove(&device->debugfs_vol_resync_extents);
 	drbd_debugfs_remove(&device->debugfs_vol_data_gen_id);
 	drbd_debugfs_remove(&device->debugfs_vol_ed_gen_id);
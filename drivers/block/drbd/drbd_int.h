@@ -460,6 +460,9 @@ enum {
 
 	/* If it contains only 0 bytes, send back P_RS_DEALLOCATED */
 	__EE_RS_THIN_REQ,
+
+	/* The P_WRITE_ACK went out as part of a P_WRITE_ACK_BATCH */
+	__EE_ACK_SENT,
 };
 #define EE_CALL_AL_COMPLETE_IO (1<<__EE_CALL_AL_COMPLETE_IO)
 #define EE_MAY_SET_IN_SYNC     (1<<__EE_MAY_SET_IN_SYNC)
@@ -476,6 +479,7 @@ enum {
 #define EE_WRITE_SAME		(1<<__EE_WRITE_SAME)
 #define EE_APPLICATION		(1<<__EE_APPLICATION)
 #define EE_RS_THIN_REQ		(1<<__EE_RS_THIN_REQ)
+#define EE_ACK_SENT		(1<<__EE_ACK_SENT)
 
 /* flag bits per device */
 enum {
@@ -822,6 +826,7 @@ struct drbd_device {
 	struct dentry *debugfs_vol_resync_extents;
 	struct dentry *debugfs_vol_data_gen_id;
 	struct dentry *debugfs_vol_ed_gen_id;
+	struct dentry *debugfs_vol_act_log_stats;
 #endif
 
 	unsigned int vnr;	/* volume number within the connection */
@@ -858,6 +863,8 @@ struct drbd_device {
 	unsigned int read_cnt;
 	unsigned int writ_cnt;
 	unsigned int al_writ_cnt;
+	unsigned int al_upd_cnt;  /* extent updates written by those AL transactions */
+	unsigned int al_wait_cnt; /* application writes that waited for one */
 	unsigned int bm_writ_cnt;
 	atomic_t ap_bio_cnt;	 /* Requests we need to complete */
 	atomic_t ap_actlog_cnt;  /* Requests waiting for activity log */
@@ -2012,6 +2012,8 @@ void drbd_device_cleanup(struct drbd_device *device)
 				first_peer_device(device)->connection->receiver.t_state);
 
 	device->al_writ_cnt  =
+	device->al_upd_cnt   =
+	device->al_wait_cnt  =
 	device->bm_writ_cnt  =
 	device->read_cnt     =
 	device->recv_cnt     =
@@ -3630,6 +3632,7 @@ const char *cmdname(enum drbd_packet cmd)
 		[P_RS_DEALLOCATED]      = "rs_deallocated",
 		[P_WSAME]	        = "WriteSame",
 		[P_ZEROES]		= "Zeroes",
+		[P_WRITE_ACK_BATCH]	= "WriteAckBatch",
 
 		/* enum drbd_packet, but not commands - obsoleted flags:
 		 *	P_MAY_IGNORE
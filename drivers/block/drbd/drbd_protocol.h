@@ -75,6 +75,9 @@ enum drbd_packet {
 
 	/* 0x40 .. 0x48 already claimed in DRBD 9 */
 
+	/* Only use this if both support FF_ACK_BATCH */
+	P_WRITE_ACK_BATCH     = 0x49, /* meta sock: several P_WRITE_ACKs in one packet */
+
 	P_MAY_IGNORE	      = 0x100, /* Flag to test if (cmd > P_MAY_IGNORE) ... */
 	P_MAX_OPT_CMD	      = 0x101,
 
@@ -174,6 +177,15 @@ struct p_block_ack {
 	u32	    seq_num;
 } __packed;
 
+/* as many p_block_ack as fit into DRBD_SOCKET_BUFFER_SIZE, rounded down */
+#define DRBD_MAX_ACK_BATCH 128
+
+struct p_block_ack_batch {
+	u32	    count;	/* number of entries in acks[] */
+	u32	    pad;	/* to multiple of 8 Byte */
+	struct p_block_ack acks[];
+} __packed;
+
 struct p_block_req {
 	u64 sector;
 	u64 block_id;
@@ -243,6 +255,11 @@ struct p_block_req {
  */
 #define DRBD_FF_WZEROES 8
 
+/* supports P_WRITE_ACK_BATCH: the ack sender collects the P_WRITE_ACKs of
+ * all peer requests it finishes in one go into few packets, instead of
+ * sending one packet per request. */
+#define DRBD_FF_ACK_BATCH 16
+
 
 struct p_connection_features {
 	u32 protocol_min;
@@ -39,7 +39,8 @@
 #include "drbd_req.h"
 #include "drbd_vli.h"
 
-#define PRO_FEATURES (DRBD_FF_TRIM|DRBD_FF_THIN_RESYNC|DRBD_FF_WSAME|DRBD_FF_WZEROES)
+#define PRO_FEATURES (DRBD_FF_TRIM|DRBD_FF_THIN_RESYNC|DRBD_FF_WSAME|DRBD_FF_WZEROES|\
+		      DRBD_FF_ACK_BATCH)
 
 struct packet_info {
 	enum drbd_packet cmd;
@@ -441,11 +442,87 @@ int drbd_free_peer_reqs(struct drbd_device *device, struct list_head *list)
 /*
  * See also comments in _req_mod(,BARRIER_ACKED) and receive_Barrier.
  */
+static int e_end_block(struct drbd_work *w, int cancel);
+static enum drbd_packet e_end_block_ack(struct drbd_device *device,
+					struct drbd_peer_request *peer_req);
+
+static int send_write_ack_batch(struct drbd_peer_device *peer_device,
+				struct p_block_ack_batch *p, unsigned int count)
+{
+	p->count = cpu_to_be32(count);
+	p->pad = 0;
+	return drbd_send_command(peer_device, &peer_device->connection->meta,
+				 P_WRITE_ACK_BATCH, struct_size(p, acks, count),
+				 NULL, 0);
+}
+
+/*
+ * Send the P_WRITE_ACKs e_end_block() would send for the peer requests on
+ * @work_list as P_WRITE_ACK_BATCH packets, before any of them is finished.
+ * The acks keep their order and sequence numbers, and still go out before
+ * the requests leave the interval tree or complete their epoch, so the
+ * peer sees exactly what it would have seen with one packet per ack.
+ */
+static int drbd_send_write_acks(struct drbd_peer_device *peer_device,
+				struct list_head *work_list)
+{
+	struct drbd_device *device = peer_device->device;
+	struct drbd_socket *sock = &peer_device->connection->meta;
+	struct p_block_ack_batch *p = NULL;
+	struct drbd_peer_request *peer_req;
+	unsigned int count = 0;
+	int err = 0;
+
+	BUILD_BUG_ON(sizeof(struct p_header100) +
+		     struct_size(p, acks, DRBD_MAX_ACK_BATCH) >
+		     DRBD_SOCKET_BUFFER_SIZE);
+
+	/*
+	 * Not connected: leave the acks to e_end_block(), which fails them
+	 * like it always did.  Checked only once, as the meta socket stays
+	 * locked while a batch is filled.
+	 */
+	if (device->state.conn < C_CONNECTED)
+		return 0;
+
+	list_for_each_entry(peer_req, work_list, w.list) {
+		struct p_block_ack *ack;
+
+		if (peer_req->w.cb != e_end_block ||
+		    e_end_block_ack(device, peer_req) != P_WRITE_ACK)
+			continue;
+
+		if (!p) {
+			p = drbd_prepare_command(peer_device, sock);
+			if (!p)
+				return -EIO;
+			count = 0;
+		}
+		ack = &p->acks[count];
+		ack->sector = cpu_to_be64(peer_req->i.sector);
+		ack->block_id = peer_req->block_id;
+		ack->blksize = cpu_to_be32(peer_req->i.size);
+		ack->seq_num = cpu_to_be32(atomic_inc_return(&device->packet_seq));
+		peer_req->flags |= EE_ACK_SENT;
+
+		if (++count == DRBD_MAX_ACK_BATCH) {
+			err = send_write_ack_batch(peer_device, p, count);
+			p = NULL;
+			if (err)
+				return err;
+		}
+	}
+	if (p)
+		err = send_write_ack_batch(peer_device, p, count);
+	return err;
+}
+
 static int drbd_finish_peer_reqs(struct drbd_device *device)
 {
 	LIST_HEAD(work_list);
 	LIST_HEAD(reclaimed);
 	struct drbd_peer_request *peer_req, *t;
+	struct drbd_peer_device *peer_device = first_peer_device(device);
 	int err = 0;
 
 	spin_lock_irq(&device->resource->req_lock);
@@ -456,6 +533,9 @@ static int drbd_finish_peer_reqs(struct drbd_device *device)
 	list_for_each_entry_safe(peer_req, t, &reclaimed, w.list)
 		drbd_free_net_peer_req(device, peer_req);
 
+	if (peer_device->connection->agreed_features & DRBD_FF_ACK_BATCH)
+		err = drbd_send_write_acks(peer_device, &work_list);
+
 	/* possible callbacks here:
 	 * e_end_block, and e_end_resync_block, e_send_superseded.
 	 * all ignore the last argument.
@@ -2177,6 +2257,20 @@ static void restart_conflicting_writes(struct drbd_device *device,
 	}
 }
 
+/* The ack e_end_block() sends for @peer_req, or 0 if it sends none. */
+static enum drbd_packet e_end_block_ack(struct drbd_device *device,
+					struct drbd_peer_request *peer_req)
+{
+	if (!(peer_req->flags & EE_SEND_WRITE_ACK))
+		return 0;
+	if (unlikely(peer_req->flags & EE_WAS_ERROR))
+		return P_NEG_ACK;
+	return (device->state.conn >= C_SYNC_SOURCE &&
+		device->state.conn <= C_PAUSED_SYNC_T &&
+		peer_req->flags & EE_MAY_SET_IN_SYNC) ?
+		P_RS_WRITE_ACK : P_WRITE_ACK;
+}
+
 /*
  * e_end_block() is called in ack_sender context via drbd_finish_peer_reqs().
  */
@@ -2190,19 +2284,17 @@ static int e_end_block(struct drbd_work *w, int cancel)
 	int err = 0, pcmd;
 
 	if (peer_req->flags & EE_SEND_WRITE_ACK) {
-		if (likely((peer_req->flags & EE_WAS_ERROR) == 0)) {
-			pcmd = (device->state.conn >= C_SYNC_SOURCE &&
-				device->state.conn <= C_PAUSED_SYNC_T &&
-				peer_req->flags & EE_MAY_SET_IN_SYNC) ?
-				P_RS_WRITE_ACK : P_WRITE_ACK;
+		/* already sent by drbd_send_write_acks() */
+		if (peer_req->flags & EE_ACK_SENT)
+			pcmd = 0;
+		else
+			pcmd = e_end_block_ack(device, peer_req);
+		if (pcmd)
 			err = drbd_send_ack(peer_device, pcmd, peer_req);
-			if (pcmd == P_RS_WRITE_ACK)
-				drbd_set_in_sync(device, sector, peer_req->i.size);
-		} else {
-			err = drbd_send_ack(peer_device, P_NEG_ACK, peer_req);
-			/* we expect it to be marked out of sync anyways...
-			 * maybe assert this?  */
-		}
+		if (pcmd == P_RS_WRITE_ACK)
+			drbd_set_in_sync(device, sector, peer_req->i.size);
+		/* for P_NEG_ACK we expect it to be marked out of sync
+		 * anyways... maybe assert this?  */
 		dec_unacked(device);
 	}
 
@@ -5311,12 +5403,13 @@ static int drbd_do_features(struct drbd_connection *connection)
 	drbd_info(connection, "Handshake successful: "
 	     "Agreed network protocol version %d\n", connection->agreed_pro_version);
 
-	drbd_info(connection, "Feature flags enabled on protocol level: 0x%x%s%s%s%s.\n",
+	drbd_info(connection, "Feature flags enabled on protocol level: 0x%x%s%s%s%s%s.\n",
 		  connection->agreed_features,
 		  connection->agreed_features & DRBD_FF_TRIM ? " TRIM" : "",
 		  connection->agreed_features & DRBD_FF_THIN_RESYNC ? " THIN_RESYNC" : "",
 		  connection->agreed_features & DRBD_FF_WSAME ? " WRITE_SAME" : "",
-		  connection->agreed_features & DRBD_FF_WZEROES ? " WRITE_ZEROES" :
+		  connection->agreed_features & DRBD_FF_WZEROES ? " WRITE_ZEROES" : "",
+		  connection->agreed_features & DRBD_FF_ACK_BATCH ? " ACK_BATCH" :
 		  connection->agreed_features ? "" : " none");
 
 	return 1;
@@ -5715,6 +5808,30 @@ static int got_BlockAck(struct drbd_connection *connection, struct packet_info *
 					     what, false);
 }
 
+static int got_BlockAckBatch(struct drbd_connection *connection, struct packet_info *pi)
+{
+	struct p_block_ack_batch *p = pi->data;
+	unsigned int count = be32_to_cpu(p->count);
+	struct packet_info ack_pi = {
+		.cmd = P_WRITE_ACK,
+		.size = sizeof(struct p_block_ack),
+		.vnr = pi->vnr,
+	};
+	unsigned int i;
+	int err;
+
+	if (pi->size != struct_size(p, acks, count))
+		return -EIO;
+
+	for (i = 0; i < count; i++) {
+		ack_pi.data = &p->acks[i];
+		err = got_BlockAck(connection, &ack_pi);
+		if (err)
+			return err;
+	}
+	return 0;
+}
+
 static int got_NegAck(struct drbd_connection *connection, struct packet_info *pi)
 {
 	struct drbd_peer_device *peer_device;
@@ -5894,6 +6011,7 @@ static int got_skip(struct drbd_connection *connection, struct packet_info *pi)
 struct meta_sock_cmd {
 	size_t pkt_size;
 	int (*fn)(struct drbd_connection *connection, struct packet_info *);
+	bool var_size;	/* pkt_size is the minimum, the packet may be longer */
 };
 
 static void set_rcvtimeo(struct drbd_connection *connection, bool ping_timeout)
@@ -5941,6 +6059,7 @@ static struct meta_sock_cmd ack_receiver_tbl[] = {
 	[P_RS_CANCEL]       = { sizeof(struct p_block_ack), got_NegRSDReply },
 	[P_CONN_ST_CHG_REPLY]={ sizeof(struct p_req_state_reply), got_conn_RqSReply },
 	[P_RETRY_WRITE]	    = { sizeof(struct p_block_ack), got_BlockAck },
+	[P_WRITE_ACK_BATCH] = { sizeof(struct p_block_ack_batch), got_BlockAckBatch, true },
 };
 
 int drbd_ack_receiver(struct drbd_thread *thi)
@@ -6035,6 +6154,9 @@ int drbd_ack_receiver(struct drbd_thread *thi)
 				goto disconnect;
 			}
 			expect = header_size + cmd->pkt_size;
+			if (cmd->var_size && pi.size > cmd->pkt_size &&
+			    pi.size <= DRBD_SOCKET_BUFFER_SIZE - header_size)
+				expect = header_size + pi.size;
 			if (pi.size != expect - header_size) {
 				drbd_err(connection, "Wrong packet size on meta (c: %d, l: %d)\n",
 					pi.cmd, pi.size);
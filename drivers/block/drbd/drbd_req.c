@@ -1493,6 +1493,7 @@ static void send_and_submit_pending(struct drbd_device *device, struct list_head
 
 	blk_start_plug(&plug);
 	while ((req = list_first_entry_or_null(pending, struct drbd_request, tl_requests))) {
+		device->al_wait_cnt++;
 		req->rq_state |= RQ_IN_ACT_LOG;
 		req->in_actlog_jif = jiffies;
 		atomic_dec(&device->ap_actlog_cnt);
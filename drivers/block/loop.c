@@ -81,6 +81,7 @@ struct loop_device {
 struct loop_cmd {
 	struct list_head list_entry;
 	bool use_aio; /* use AIO interface to handle I/O */
+	bool nowait; /* aio issued with IOCB_NOWAIT from ->queue_rq */
 	atomic_t ref; /* only for aio */
 	long ret;
 	struct kiocb iocb;
@@ -138,6 +139,8 @@ static void loop_global_unlock(struct loop_device *lo, bool global)
 
 static int max_part;
 static int part_shift;
+static bool dio_by_default = true;
+static bool nowait_issue;
 
 static loff_t get_size(loff_t offset, loff_t sizelimit, struct file *file)
 {
@@ -371,6 +374,8 @@ static void lo_complete_rq(struct request *rq)
 	}
 }
 
+static void loop_queue_work(struct loop_device *lo, struct loop_cmd *cmd);
+
 static void lo_rw_aio_do_completion(struct loop_cmd *cmd)
 {
 	struct request *rq = blk_mq_rq_from_pdu(cmd);
@@ -379,6 +384,26 @@ static void lo_rw_aio_do_completion(struct loop_cmd *cmd)
 		return;
 	kfree(cmd->bvec);
 	cmd->bvec = NULL;
+
+	if (cmd->nowait) {
+		cmd->nowait = false;
+		/*
+		 * The NOWAIT attempt from ->queue_rq() may still fail with
+		 * -EAGAIN once the backing I/O was submitted.  The request
+		 * isn't completed yet, hand it to the worker.
+		 */
+		if (cmd->ret == -EAGAIN) {
+			cmd->ret = 0;
+			loop_queue_work(rq->q->queuedata, cmd);
+			return;
+		}
+		/* memcg is only used by the worker, see loop_handle_cmd() */
+		if (cmd->memcg_css) {
+			css_put(cmd->memcg_css);
+			cmd->memcg_css = NULL;
+		}
+	}
+
 	if (likely(!blk_should_fake_timeout(rq->q)))
 		blk_mq_complete_request(rq);
 }
@@ -446,6 +471,8 @@ static int lo_rw_aio(struct loop_device *lo, struct loop_cmd *cmd,
 	cmd->iocb.ki_filp = file;
 	cmd->iocb.ki_complete = lo_rw_aio_complete;
 	cmd->iocb.ki_flags = IOCB_DIRECT;
+	if (cmd->nowait)
+		cmd->iocb.ki_flags |= IOCB_NOWAIT;
 	cmd->iocb.ki_ioprio = IOPRIO_PRIO_VALUE(IOPRIO_CLASS_NONE, 0);
 
 	if (rw == WRITE)
@@ -453,6 +480,13 @@ static int lo_rw_aio(struct loop_device *lo, struct loop_cmd *cmd,
 	else
 		ret = call_read_iter(file, &cmd->iocb, &iter);
 
+	/* nothing was issued, the caller retries from the worker */
+	if (ret == -EAGAIN && cmd->nowait) {
+		kfree(cmd->bvec);
+		cmd->bvec = NULL;
+		return -EAGAIN;
+	}
+
 	lo_rw_aio_do_completion(cmd);
 
 	if (ret != -EIOCBQUEUED)
@@ -834,8 +868,9 @@ static void loop_queue_work(struct loop_device *lo, struct loop_cmd *cmd)
 	struct loop_worker *cur_worker, *worker = NULL;
 	struct work_struct *work;
 	struct list_head *cmd_list;
+	unsigned long flags;
 
-	spin_lock_irq(&lo->lo_work_lock);
+	spin_lock_irqsave(&lo->lo_work_lock, flags);
 
 	if (queue_on_root_worker(cmd->blkcg_css))
 		goto queue_work;
@@ -895,7 +930,7 @@ static void loop_queue_work(struct loop_device *lo, struct loop_cmd *cmd)
 	}
 	list_add_tail(&cmd->list_entry, cmd_list);
 	queue_work(lo->workqueue, work);
-	spin_unlock_irq(&lo->lo_work_lock);
+	spin_unlock_irqrestore(&lo->lo_work_lock, flags);
 }
 
 static void loop_set_timer(struct loop_device *lo)
@@ -1070,7 +1105,7 @@ static int loop_configure(struct loop_device *lo, fmode_t mode,
 	disk_force_media_change(lo->lo_disk, DISK_EVENT_MEDIA_CHANGE);
 	set_disk_ro(lo->lo_disk, (lo->lo_flags & LO_FLAGS_READ_ONLY) != 0);
 
-	lo->use_dio = lo->lo_flags & LO_FLAGS_DIRECT_IO;
+	lo->use_dio = (lo->lo_flags & LO_FLAGS_DIRECT_IO) || dio_by_default;
 	lo->lo_device = bdev;
 	lo->lo_backing_file = file;
 	lo->old_gfp_mask = mapping_gfp_mask(mapping);
@@ -1778,6 +1813,10 @@ module_param(max_loop, int, 0444);
 MODULE_PARM_DESC(max_loop, "Maximum number of loop devices");
 module_param(max_part, int, 0444);
 MODULE_PARM_DESC(max_part, "Maximum number of partitions per loop device");
+module_param(dio_by_default, bool, 0644);
+MODULE_PARM_DESC(dio_by_default, "Use direct I/O to the backing file whenever its alignment permits. Default: true");
+module_param(nowait_issue, bool, 0444);
+MODULE_PARM_DESC(nowait_issue, "Issue direct I/O from the submitter's context when it doesn't block, with blocking queues. Default: false");
 
 static int hw_queue_depth = LOOP_DEFAULT_HW_Q_DEPTH;
 
@@ -1796,9 +1835,62 @@ static const struct kernel_param_ops loop_hw_qdepth_param_ops = {
 device_param_cb(hw_queue_depth, &loop_hw_qdepth_param_ops, &hw_queue_depth, 0444);
 MODULE_PARM_DESC(hw_queue_depth, "Queue depth for each hardware queue. Default: 128");
 
+static int nr_hw_queues = 1;
+
+static int loop_set_nr_hw_queues(const char *s, const struct kernel_param *p)
+{
+	int ret = kstrtoint(s, 10, &nr_hw_queues);
+
+	return (ret || (nr_hw_queues < 1)) ? -EINVAL : 0;
+}
+
+static const struct kernel_param_ops loop_nr_hw_queues_param_ops = {
+	.set	= loop_set_nr_hw_queues,
+	.get	= param_get_int,
+};
+
+device_param_cb(nr_hw_queues, &loop_nr_hw_queues_param_ops, &nr_hw_queues, 0444);
+MODULE_PARM_DESC(nr_hw_queues, "Number of hardware queues, capped to the number of CPUs. Default: 1");
+
 MODULE_LICENSE("GPL");
 MODULE_ALIAS_BLOCKDEV_MAJOR(LOOP_MAJOR);
 
+/*
+ * Try to issue direct I/O to the backing file right from the submitter's
+ * context, so that the common case neither pays for a worker switch nor
+ * serializes on the per-device worker. Only if the backing file would
+ * have to block (-EAGAIN) is the command punted to the worker.
+ */
+static bool loop_issue_nowait(struct loop_device *lo, struct loop_cmd *cmd)
+{
+	struct request *rq = blk_mq_rq_from_pdu(cmd);
+	loff_t pos = ((loff_t) blk_rq_pos(rq) << 9) + lo->lo_offset;
+	unsigned int noio_flags;
+	int ret;
+
+	cmd->nowait = false;
+	if (!(lo->tag_set.flags & BLK_MQ_F_BLOCKING))
+		return false;
+	if (!cmd->use_aio || !(lo->lo_backing_file->f_mode & FMODE_NOWAIT))
+		return false;
+	if (req_op(rq) != REQ_OP_READ && req_op(rq) != REQ_OP_WRITE)
+		return false;
+	if (op_is_write(req_op(rq)) && (lo->lo_flags & LO_FLAGS_READ_ONLY))
+		return false;
+
+	cmd->nowait = true;
+	noio_flags = memalloc_noio_save();
+	ret = lo_rw_aio(lo, cmd, pos, op_is_write(req_op(rq)) ? WRITE : READ);
+	memalloc_noio_restore(noio_flags);
+
+	/* -EAGAIN, or not even issued, the worker gets to handle it */
+	if (ret) {
+		cmd->nowait = false;
+		return false;
+	}
+	return true;
+}
+
 static blk_status_t loop_queue_rq(struct blk_mq_hw_ctx *hctx,
 		const struct blk_mq_queue_data *bd)
 {
@@ -1837,6 +1929,9 @@ static blk_status_t loop_queue_rq(struct blk_mq_hw_ctx *hctx,
 #endif
 	}
 #endif
+	if (loop_issue_nowait(lo, cmd))
+		return BLK_STS_OK;
+
 	loop_queue_work(lo, cmd);
 
 	return BLK_STS_OK;
@@ -1887,8 +1982,11 @@ static void loop_process_work(struct loop_worker *worker,
 {
 	int orig_flags = current->flags;
 	struct loop_cmd *cmd;
+	struct blk_plug plug;
 
 	current->flags |= PF_LOCAL_THROTTLE | PF_MEMALLOC_NOIO;
+	/* let the backing device see the worker's I/O as one batch */
+	blk_start_plug(&plug);
 	spin_lock_irq(&lo->lo_work_lock);
 	while (!list_empty(cmd_list)) {
 		cmd = container_of(
@@ -1913,6 +2011,7 @@ static void loop_process_work(struct loop_worker *worker,
 		loop_set_timer(lo);
 	}
 	spin_unlock_irq(&lo->lo_work_lock);
+	blk_finish_plug(&plug);
 	current->flags = orig_flags;
 }
 
@@ -1968,12 +2067,19 @@ static int loop_add(int i)
 	i = err;
 
 	lo->tag_set.ops = &loop_mq_ops;
-	lo->tag_set.nr_hw_queues = 1;
+	lo->tag_set.nr_hw_queues = min_t(unsigned int, nr_hw_queues,
+					 nr_cpu_ids);
 	lo->tag_set.queue_depth = hw_queue_depth;
 	lo->tag_set.numa_node = NUMA_NO_NODE;
 	lo->tag_set.cmd_size = sizeof(struct loop_cmd);
 	lo->tag_set.flags = BLK_MQ_F_SHOULD_MERGE | BLK_MQ_F_STACKING |
 		BLK_MQ_F_NO_SCHED_BY_DEFAULT;
+	/*
+	 * Issuing direct I/O with IOCB_NOWAIT from ->queue_rq() still may
+	 * allocate memory, so the queues have to be blocking for it.
+	 */
+	if (nowait_issue)
+		lo->tag_set.flags |= BLK_MQ_F_BLOCKING;
 	lo->tag_set.driver_data = lo;
 
 	err = blk_mq_alloc_tag_set(&lo->tag_set);
@@ -34,6 +34,7 @@
 #include <linux/slab.h>
 #include <net/sock.h>
 #include <linux/net.h>
+#include <linux/tcp.h>
 #include <linux/kthread.h>
 #include <linux/types.h>
 #include <linux/debugfs.h>
@@ -60,8 +61,10 @@ struct nbd_sock {
 	struct request *pending;
 	int sent;
 	bool dead;
+	bool more;
 	int fallback_index;
 	int cookie;
+	atomic_long_t inflight_bytes;
 };
 
 struct recv_thread_args {
@@ -176,6 +179,41 @@ static inline struct device *nbd_to_dev(struct nbd_device *nbd)
 	return disk_to_dev(nbd->disk);
 }
 
+/* bytes that cross the wire for a request, used to balance the connections */
+static unsigned int nbd_cmd_payload(struct request *req)
+{
+	switch (req_op(req)) {
+	case REQ_OP_READ:
+	case REQ_OP_WRITE:
+		return blk_rq_bytes(req);
+	default:
+		return 0;
+	}
+}
+
+/*
+ * The request is no longer in flight on the connection it was sent on:
+ * take it off the connection's bytes in flight.  Called with cmd->lock
+ * held, returns false if it wasn't in flight.  @config is NULL when it is
+ * being torn down.  A reconnected socket starts over from zero, so don't
+ * touch it for a request sent on the one it replaced.
+ */
+static bool nbd_clear_inflight(struct nbd_config *config, struct nbd_cmd *cmd)
+{
+	struct nbd_sock *nsock;
+
+	if (!__test_and_clear_bit(NBD_CMD_INFLIGHT, &cmd->flags))
+		return false;
+
+	if (config && cmd->index < config->num_connections) {
+		nsock = config->socks[cmd->index];
+		if (cmd->cookie == READ_ONCE(nsock->cookie))
+			atomic_long_sub(nbd_cmd_payload(blk_mq_rq_from_pdu(cmd)),
+					&nsock->inflight_bytes);
+	}
+	return true;
+}
+
 static void nbd_requeue_cmd(struct nbd_cmd *cmd)
 {
 	struct request *req = blk_mq_rq_from_pdu(cmd);
@@ -312,6 +350,7 @@ static void nbd_mark_nsock_dead(struct nbd_device *nbd, struct nbd_sock *nsock,
 		}
 	}
 	nsock->dead = true;
+	nsock->more = false;
 	nsock->pending = NULL;
 	nsock->sent = 0;
 }
@@ -409,7 +448,7 @@ static enum blk_eh_timer_return nbd_xmit_timeout(struct request *req)
 
 	if (!refcount_inc_not_zero(&nbd->config_refs)) {
 		cmd->status = BLK_STS_TIMEOUT;
-		__clear_bit(NBD_CMD_INFLIGHT, &cmd->flags);
+		nbd_clear_inflight(NULL, cmd);
 		mutex_unlock(&cmd->lock);
 		goto done;
 	}
@@ -442,6 +481,8 @@ static enum blk_eh_timer_return nbd_xmit_timeout(struct request *req)
 					nbd_mark_nsock_dead(nbd, nsock, 1);
 				mutex_unlock(&nsock->tx_lock);
 			}
+			/* it is sent again, and counted again, from the queue */
+			nbd_clear_inflight(config, cmd);
 			mutex_unlock(&cmd->lock);
 			nbd_requeue_cmd(cmd);
 			nbd_config_put(nbd);
@@ -463,6 +504,7 @@ static enum blk_eh_timer_return nbd_xmit_timeout(struct request *req)
 
 		mutex_lock(&nsock->tx_lock);
 		if (cmd->cookie != nsock->cookie) {
+			nbd_clear_inflight(config, cmd);
 			nbd_requeue_cmd(cmd);
 			mutex_unlock(&nsock->tx_lock);
 			mutex_unlock(&cmd->lock);
@@ -478,7 +520,7 @@ static enum blk_eh_timer_return nbd_xmit_timeout(struct request *req)
 	dev_err_ratelimited(nbd_to_dev(nbd), "Connection timed out\n");
 	set_bit(NBD_RT_TIMEDOUT, &config->runtime_flags);
 	cmd->status = BLK_STS_IOERR;
-	__clear_bit(NBD_CMD_INFLIGHT, &cmd->flags);
+	nbd_clear_inflight(config, cmd);
 	mutex_unlock(&cmd->lock);
 	sock_shutdown(nbd);
 	nbd_config_put(nbd);
@@ -537,6 +579,74 @@ static int sock_xmit(struct nbd_device *nbd, int index, int send,
 	return result;
 }
 
+/*
+ * Send one page of a write without copying it into the socket buffer, same
+ * return convention as sock_xmit().  The caller has to check sendpage_ok().
+ */
+static int sock_send_page(struct nbd_device *nbd, int index, struct page *page,
+			  int offset, size_t len, int msg_flags, int *sent)
+{
+	struct socket *sock = nbd->config->socks[index]->sock;
+	unsigned int noreclaim_flag;
+	int result;
+
+	if (unlikely(!sock)) {
+		dev_err_ratelimited(disk_to_dev(nbd->disk),
+			"Attempted send on closed socket in sock_send_page\n");
+		return -EINVAL;
+	}
+
+	noreclaim_flag = memalloc_noreclaim_save();
+	do {
+		sock->sk->sk_allocation = GFP_NOIO | __GFP_MEMALLOC;
+		result = kernel_sendpage(sock, page, offset, len,
+					 msg_flags | MSG_NOSIGNAL);
+		if (result <= 0) {
+			if (result == 0)
+				result = -EPIPE;
+			break;
+		}
+		if (sent)
+			*sent += result;
+		offset += result;
+		len -= result;
+	} while (len);
+
+	memalloc_noreclaim_restore(noreclaim_flag);
+
+	return result;
+}
+
+/*
+ * Push out whatever an earlier MSG_MORE send left queued on the socket.  Only
+ * TCP holds back partial segments for MSG_MORE, and clearing the cork is the
+ * way to have it transmit them right away.  Call with the tx_lock held.
+ */
+static void nbd_sock_push(struct nbd_sock *nsock)
+{
+	struct sock *sk = nsock->sock->sk;
+
+	nsock->more = false;
+	if (sk->sk_type == SOCK_STREAM && sk->sk_protocol == IPPROTO_TCP)
+		tcp_sock_set_cork(sk, false);
+}
+
+static void nbd_push_socks(struct nbd_config *config)
+{
+	int i;
+
+	for (i = 0; i < config->num_connections; i++) {
+		struct nbd_sock *nsock = config->socks[i];
+
+		if (!READ_ONCE(nsock->more))
+			continue;
+		mutex_lock(&nsock->tx_lock);
+		if (nsock->more && !nsock->dead)
+			nbd_sock_push(nsock);
+		mutex_unlock(&nsock->tx_lock);
+	}
+}
+
 /*
  * Different settings for sk->sk_sndtimeo can result in different return values
  * if there is a signal pending when we enter sendmsg, because reasons?
@@ -546,8 +656,16 @@ static inline int was_interrupted(int result)
 	return result == -ERESTARTSYS || result == -EINTR;
 }
 
-/* always call with the tx_lock held */
-static int nbd_send_cmd(struct nbd_device *nbd, struct nbd_cmd *cmd, int index)
+/*
+ * always call with the tx_lock held
+ *
+ * If @more is set blk-mq has more requests for us, so the tail of this one is
+ * sent with MSG_MORE as well and the whole dispatch batch goes out in full
+ * segments.  Whoever sends the last request of the batch, or ->commit_rqs,
+ * pushes the rest out.
+ */
+static int nbd_send_cmd(struct nbd_device *nbd, struct nbd_cmd *cmd, int index,
+			bool more)
 {
 	struct request *req = blk_mq_rq_from_pdu(cmd);
 	struct nbd_config *config = nbd->config;
@@ -613,7 +731,7 @@ static int nbd_send_cmd(struct nbd_device *nbd, struct nbd_cmd *cmd, int index)
 		req, nbdcmd_to_ascii(type),
 		(unsigned long long)blk_rq_pos(req) << 9, blk_rq_bytes(req));
 	result = sock_xmit(nbd, index, 1, &from,
-			(type == NBD_CMD_WRITE) ? MSG_MORE : 0, &sent);
+			(type == NBD_CMD_WRITE || more) ? MSG_MORE : 0, &sent);
 	trace_nbd_header_sent(req, handle);
 	if (result < 0) {
 		if (was_interrupted(result)) {
@@ -645,20 +763,36 @@ static int nbd_send_cmd(struct nbd_device *nbd, struct nbd_cmd *cmd, int index)
 
 		bio_for_each_segment(bvec, bio, iter) {
 			bool is_last = !next && bio_iter_last(bvec, iter);
-			int flags = is_last ? 0 : MSG_MORE;
+			int flags = (is_last && !more) ? 0 : MSG_MORE;
 
 			dev_dbg(nbd_to_dev(nbd), "request %p: sending %d bytes data\n",
 				req, bvec.bv_len);
-			iov_iter_bvec(&from, WRITE, &bvec, 1, bvec.bv_len);
 			if (skip) {
-				if (skip >= iov_iter_count(&from)) {
-					skip -= iov_iter_count(&from);
+				if (skip >= bvec.bv_len) {
+					skip -= bvec.bv_len;
 					continue;
 				}
-				iov_iter_advance(&from, skip);
+				bvec.bv_offset += skip;
+				bvec.bv_len -= skip;
 				skip = 0;
 			}
-			result = sock_xmit(nbd, index, 1, &from, flags, &sent);
+			/*
+			 * Hand the page to the socket instead of copying it
+			 * where we can, the skb takes its own page reference.
+			 */
+			if (sendpage_ok(bvec.bv_page)) {
+				if (flags & MSG_MORE)
+					flags |= MSG_SENDPAGE_NOTLAST;
+				result = sock_send_page(nbd, index, bvec.bv_page,
+							bvec.bv_offset,
+							bvec.bv_len, flags,
+							&sent);
+			} else {
+				iov_iter_bvec(&from, WRITE, &bvec, 1,
+					      bvec.bv_len);
+				result = sock_xmit(nbd, index, 1, &from, flags,
+						   &sent);
+			}
 			if (result < 0) {
 				if (was_interrupted(result)) {
 					/* We've already sent the header, we
@@ -785,12 +919,24 @@ static struct nbd_cmd *nbd_handle_reply(struct nbd_device *nbd, int index,
 
 	dev_dbg(nbd_to_dev(nbd), "request %p: got reply\n", req);
 	if (rq_data_dir(req) != WRITE) {
-		struct req_iterator iter;
-		struct bio_vec bvec;
+		struct bio *bio;
 		struct iov_iter to;
 
-		rq_for_each_segment(bvec, req, iter) {
-			iov_iter_bvec(&to, READ, &bvec, 1, bvec.bv_len);
+		/*
+		 * Receive straight into the bio's vector, one recvmsg per bio
+		 * rather than one per segment.
+		 */
+		__rq_for_each_bio(bio, req) {
+			struct bvec_iter iter;
+			struct bio_vec bvec;
+			unsigned int nr_bvec = 0;
+
+			bio_for_each_bvec(bvec, bio, iter)
+				nr_bvec++;
+			iov_iter_bvec(&to, READ,
+				      __bvec_iter_bvec(bio->bi_io_vec, bio->bi_iter),
+				      nr_bvec, bio->bi_iter.bi_size);
+			to.iov_offset = bio->bi_iter.bi_bvec_done;
 			result = sock_xmit(nbd, index, 0, &to, MSG_WAITALL, NULL);
 			if (result < 0) {
 				dev_err(disk_to_dev(nbd->disk), "Receive data failed (result %d)\n",
@@ -808,8 +954,8 @@ static struct nbd_cmd *nbd_handle_reply(struct nbd_device *nbd, int index,
 				ret = -EIO;
 				goto out;
 			}
-			dev_dbg(nbd_to_dev(nbd), "request %p: got %d bytes data\n",
-				req, bvec.bv_len);
+			dev_dbg(nbd_to_dev(nbd), "request %p: got %u bytes data\n",
+				req, bio->bi_iter.bi_size);
 		}
 	}
 out:
@@ -859,8 +1005,7 @@ static void recv_work(struct work_struct *work)
 			bool complete;
 
 			mutex_lock(&cmd->lock);
-			complete = __test_and_clear_bit(NBD_CMD_INFLIGHT,
-							&cmd->flags);
+			complete = nbd_clear_inflight(config, cmd);
 			mutex_unlock(&cmd->lock);
 			if (complete)
 				blk_mq_complete_request(rq);
@@ -882,13 +1027,14 @@ static void recv_work(struct work_struct *work)
 static bool nbd_clear_req(struct request *req, void *data)
 {
 	struct nbd_cmd *cmd = blk_mq_rq_to_pdu(req);
+	struct nbd_config *config = data;
 
 	/* don't abort one completed request */
 	if (blk_mq_request_completed(req))
 		return true;
 
 	mutex_lock(&cmd->lock);
-	if (!__test_and_clear_bit(NBD_CMD_INFLIGHT, &cmd->flags)) {
+	if (!nbd_clear_inflight(config, cmd)) {
 		mutex_unlock(&cmd->lock);
 		return true;
 	}
@@ -902,7 +1048,7 @@ static bool nbd_clear_req(struct request *req, void *data)
 static void nbd_clear_que(struct nbd_device *nbd)
 {
 	blk_mq_quiesce_queue(nbd->disk->queue);
-	blk_mq_tagset_busy_iter(&nbd->tag_set, nbd_clear_req, NULL);
+	blk_mq_tagset_busy_iter(&nbd->tag_set, nbd_clear_req, nbd->config);
 	blk_mq_unquiesce_queue(nbd->disk->queue);
 	dev_dbg(disk_to_dev(nbd->disk), "queue cleared\n");
 }
@@ -966,7 +1112,44 @@ static int wait_for_reconnect(struct nbd_device *nbd)
 	return !test_bit(NBD_RT_DISCONNECTED, &config->runtime_flags);
 }
 
-static int nbd_handle_cmd(struct nbd_cmd *cmd, int index)
+/* don't move a request off its queue's connection for less than this */
+#define NBD_INFLIGHT_SLACK	(128 << 10)
+
+/*
+ * With more than one connection to the server pick the live one with the
+ * fewest bytes in flight, so that a queue stuck behind large transfers or a
+ * slow path doesn't hold up everything mapped to it.  The queue's own
+ * connection wins unless another one is clearly less loaded.
+ */
+static int nbd_pick_sock(struct nbd_config *config, struct request *req,
+			 int index)
+{
+	long best = atomic_long_read(&config->socks[index]->inflight_bytes);
+	int i, best_index = index;
+
+	if (config->num_connections <= 1)
+		return index;
+
+	for (i = 0; i < config->num_connections; i++) {
+		struct nbd_sock *nsock = config->socks[i];
+		struct request *pending = READ_ONCE(nsock->pending);
+		long inflight;
+
+		/* a partially sent request has to finish where it started */
+		if (pending == req)
+			return i;
+		if (i == index || pending || READ_ONCE(nsock->dead))
+			continue;
+		inflight = atomic_long_read(&nsock->inflight_bytes);
+		if (inflight + NBD_INFLIGHT_SLACK < best) {
+			best = inflight;
+			best_index = i;
+		}
+	}
+	return best_index;
+}
+
+static int nbd_handle_cmd(struct nbd_cmd *cmd, int index, bool last)
 {
 	struct request *req = blk_mq_rq_from_pdu(cmd);
 	struct nbd_device *nbd = cmd->nbd;
@@ -987,6 +1170,7 @@ static int nbd_handle_cmd(struct nbd_cmd *cmd, int index)
 		nbd_config_put(nbd);
 		return -EINVAL;
 	}
+	index = nbd_pick_sock(config, req, index);
 	cmd->status = BLK_STS_OK;
 again:
 	nsock = config->socks[index];
@@ -1028,14 +1212,16 @@ static int nbd_handle_cmd(struct nbd_cmd *cmd, int index)
 	 * Some failures are related to the link going down, so anything that
 	 * returns EAGAIN can be retried on a different socket.
 	 */
-	ret = nbd_send_cmd(nbd, cmd, index);
+	ret = nbd_send_cmd(nbd, cmd, index, !last);
 	/*
 	 * Access to this flag is protected by cmd->lock, thus it's safe to set
 	 * the flag after nbd_send_cmd() succeed to send request to server.
 	 */
-	if (!ret)
+	if (!ret) {
 		__set_bit(NBD_CMD_INFLIGHT, &cmd->flags);
-	else if (ret == -EAGAIN) {
+		atomic_long_add(nbd_cmd_payload(req), &nsock->inflight_bytes);
+		nsock->more = !last;
+	} else if (ret == -EAGAIN) {
 		dev_err_ratelimited(disk_to_dev(nbd->disk),
 				    "Request send failed, requeueing\n");
 		nbd_mark_nsock_dead(nbd, nsock, 1);
@@ -1044,6 +1230,9 @@ static int nbd_handle_cmd(struct nbd_cmd *cmd, int index)
 	}
 out:
 	mutex_unlock(&nsock->tx_lock);
+	/* end of the batch, other connections may still hold some of it */
+	if (last)
+		nbd_push_socks(config);
 	nbd_config_put(nbd);
 	return ret;
 }
@@ -1071,7 +1260,7 @@ static blk_status_t nbd_queue_rq(struct blk_mq_hw_ctx *hctx,
 	 * this case we need to return that we are busy, otherwise error out as
 	 * appropriate.
 	 */
-	ret = nbd_handle_cmd(cmd, hctx->queue_num);
+	ret = nbd_handle_cmd(cmd, hctx->queue_num, bd->last);
 	if (ret < 0)
 		ret = BLK_STS_IOERR;
 	else if (!ret)
@@ -1081,6 +1270,16 @@ static blk_status_t nbd_queue_rq(struct blk_mq_hw_ctx *hctx,
 	return ret;
 }
 
+static void nbd_commit_rqs(struct blk_mq_hw_ctx *hctx)
+{
+	struct nbd_device *nbd = hctx->queue->tag_set->driver_data;
+
+	if (!refcount_inc_not_zero(&nbd->config_refs))
+		return;
+	nbd_push_socks(nbd->config);
+	nbd_config_put(nbd);
+}
+
 static struct socket *nbd_get_socket(struct nbd_device *nbd, unsigned long fd,
 				     int *err)
 {
@@ -1210,6 +1409,7 @@ static int nbd_reconnect_socket(struct nbd_device *nbd, unsigned long arg)
 		args->index = i;
 		args->nbd = nbd;
 		nsock->cookie++;
+		atomic_long_set(&nsock->inflight_bytes, 0);
 		mutex_unlock(&nsock->tx_lock);
 		sockfd_put(old);
 
@@ -1732,6 +1932,7 @@ static int nbd_init_request(struct blk_mq_tag_set *set, struct request *rq,
 
 static const struct blk_mq_ops nbd_mq_ops = {
 	.queue_rq	= nbd_queue_rq,
+	.commit_rqs	= nbd_commit_rqs,
 	.complete	= nbd_complete_rq,
 	.init_request	= nbd_init_request,
 	.timeout	= nbd_xmit_timeout,
@@ -51,17 +51,31 @@
 		| UBLK_F_URING_CMD_COMP_IN_TASK \
 		| UBLK_F_NEED_GET_DATA \
 		| UBLK_F_USER_RECOVERY \
-		| UBLK_F_USER_RECOVERY_REISSUE)
+		| UBLK_F_USER_RECOVERY_REISSUE \
+		| UBLK_F_BATCH_IO)
 
 /* All UBLK_PARAM_TYPE_* should be included here */
 #define UBLK_PARAM_TYPE_ALL (UBLK_PARAM_TYPE_BASIC | UBLK_PARAM_TYPE_DISCARD)
 
 struct ublk_rq_data {
 	struct callback_head work;
+	/* queued to a UBLK_IO_FLAG_BATCH io, see ublk_queue_batch_rq() */
+	struct llist_node node;
+
+	/*
+	 * Only used for UBLK_F_SUPPORT_ZERO_COPY: the request is completed
+	 * once both the server has committed the result and every io_uring
+	 * buffer borrowing its pages has been released.
+	 */
+	struct kref ref;
 };
 
 struct ublk_uring_cmd_pdu {
-	struct request *req;
+	union {
+		struct request *req;
+		/* for UBLK_IO_BATCH_COMMIT_AND_FETCH */
+		struct ublk_queue *ubq;
+	};
 };
 
 /*
@@ -102,6 +116,13 @@ struct ublk_uring_cmd_pdu {
  */
 #define UBLK_IO_FLAG_NEED_GET_DATA 0x08
 
+/*
+ * IO slot was re-armed by UBLK_IO_BATCH_COMMIT_AND_FETCH, so it doesn't
+ * own an io command. Incoming request is reported to ublksrv through the
+ * queue's pending batch command instead.
+ */
+#define UBLK_IO_FLAG_BATCH 0x10
+
 struct ublk_io {
 	/* userspace buffer address from io cmd */
 	__u64	addr;
@@ -124,6 +145,14 @@ struct ublk_queue {
 	bool force_abort;
 	unsigned short nr_io_ready;	/* how many ios setup */
 	struct ublk_device *dev;
+
+	/* UBLK_IO_BATCH_COMMIT_AND_FETCH state, see ublk_batch_fetch() */
+	struct io_uring_cmd *batch_cmd;
+	struct llist_head batch_reqs;
+	__u16 __user *batch_buf;
+	__u16 *batch_tags;
+	unsigned int nr_batch_tags;
+
 	struct ublk_io ios[];
 };
 
@@ -283,6 +312,20 @@ static inline bool ublk_need_get_data(const struct ublk_queue *ubq)
 	return false;
 }
 
+static inline bool ublk_support_batch_io(const struct ublk_queue *ubq)
+{
+	if (ubq->flags & UBLK_F_BATCH_IO)
+		return true;
+	return false;
+}
+
+static inline bool ublk_support_zero_copy(const struct ublk_queue *ubq)
+{
+	if (ubq->flags & UBLK_F_SUPPORT_ZERO_COPY)
+		return true;
+	return false;
+}
+
 static struct ublk_device *ublk_get_device(struct ublk_device *ub)
 {
 	if (kobject_get_unless_zero(&ub->cdev_dev.kobj))
@@ -467,6 +510,11 @@ static int ublk_map_io(const struct ublk_queue *ubq, const struct request *req,
 		struct ublk_io *io)
 {
 	const unsigned int rq_bytes = blk_rq_bytes(req);
+
+	/* zero copy: server accesses rq pages via UBLK_IO_REGISTER_IO_BUF */
+	if (ublk_support_zero_copy(ubq))
+		return rq_bytes;
+
 	/*
 	 * no zero copy, we delay copy WRITE request data into ublksrv
 	 * context and the big benefit is that pinning pages in current
@@ -496,6 +544,9 @@ static int ublk_unmap_io(const struct ublk_queue *ubq,
 {
 	const unsigned int rq_bytes = blk_rq_bytes(req);
 
+	if (ublk_support_zero_copy(ubq))
+		return rq_bytes;
+
 	if (req_op(req) == REQ_OP_READ && ublk_rq_has_data(req)) {
 		struct ublk_map_data data = {
 			.ubq	=	ubq,
@@ -631,6 +682,56 @@ static void ublk_complete_rq(struct request *req)
 		__blk_mq_end_request(req, BLK_STS_OK);
 }
 
+static void ublk_complete_rq_ref(struct kref *ref)
+{
+	struct ublk_rq_data *data = container_of(ref, struct ublk_rq_data,
+			ref);
+	struct request *req = blk_mq_rq_from_pdu(data);
+	struct ublk_queue *ubq = req->mq_hctx->driver_data;
+	struct ublk_io *io = &ubq->ios[req->tag];
+
+	/* see __ublk_fail_req() */
+	if (unlikely(io->flags & UBLK_IO_FLAG_ABORTED)) {
+		if (ublk_queue_can_use_recovery_reissue(ubq))
+			blk_mq_requeue_request(req, false);
+		else
+			blk_mq_end_request(req, BLK_STS_IOERR);
+		return;
+	}
+
+	ublk_complete_rq(req);
+}
+
+static inline void ublk_init_req_ref(const struct ublk_queue *ubq,
+		struct request *req)
+{
+	if (ublk_support_zero_copy(ubq)) {
+		struct ublk_rq_data *data = blk_mq_rq_to_pdu(req);
+
+		kref_init(&data->ref);
+	}
+}
+
+static inline bool ublk_get_req_ref(const struct ublk_queue *ubq,
+		struct request *req)
+{
+	struct ublk_rq_data *data = blk_mq_rq_to_pdu(req);
+
+	return kref_get_unless_zero(&data->ref);
+}
+
+static inline void ublk_put_req_ref(const struct ublk_queue *ubq,
+		struct request *req)
+{
+	if (ublk_support_zero_copy(ubq)) {
+		struct ublk_rq_data *data = blk_mq_rq_to_pdu(req);
+
+		kref_put(&data->ref, ublk_complete_rq_ref);
+	} else {
+		ublk_complete_rq(req);
+	}
+}
+
 /*
  * Since __ublk_rq_task_work always fails requests immediately during
  * exiting, __ublk_fail_req() is only called from abort context during
@@ -646,14 +747,22 @@ static void __ublk_fail_req(struct ublk_queue *ubq, struct ublk_io *io,
 
 	if (!(io->flags & UBLK_IO_FLAG_ABORTED)) {
 		io->flags |= UBLK_IO_FLAG_ABORTED;
-		if (ublk_queue_can_use_recovery_reissue(ubq))
+		/*
+		 * With zero copy, io_uring may still reference the request
+		 * pages, so only drop our reference and let the last user
+		 * fail or requeue it.
+		 */
+		if (ublk_support_zero_copy(ubq))
+			ublk_put_req_ref(ubq, req);
+		else if (ublk_queue_can_use_recovery_reissue(ubq))
 			blk_mq_requeue_request(req, false);
 		else
 			blk_mq_end_request(req, BLK_STS_IOERR);
 	}
 }
 
-static void ubq_complete_io_cmd(struct ublk_io *io, int res)
+static void ubq_complete_io_cmd(struct ublk_queue *ubq, struct ublk_io *io,
+		int res)
 {
 	/* mark this cmd owned by ublksrv */
 	io->flags |= UBLK_IO_FLAG_OWNED_BY_SRV;
@@ -664,6 +773,13 @@ static void ubq_complete_io_cmd(struct ublk_io *io, int res)
 	 */
 	io->flags &= ~UBLK_IO_FLAG_ACTIVE;
 
+	/* the tag is reported by the batch command, see ublk_batch_fetch() */
+	if (io->flags & UBLK_IO_FLAG_BATCH) {
+		io->flags &= ~UBLK_IO_FLAG_BATCH;
+		ubq->batch_tags[ubq->nr_batch_tags++] = io - ubq->ios;
+		return;
+	}
+
 	/* tell ublksrv one io request is coming */
 	io_uring_cmd_done(io->cmd, res, 0);
 }
@@ -689,8 +805,8 @@ static inline void __ublk_rq_task_work(struct request *req)
 	struct ublk_io *io = &ubq->ios[tag];
 	unsigned int mapped_bytes;
 
-	pr_devel("%s: complete: op %d, qid %d tag %d io_flags %x addr %llx\n",
-			__func__, io->cmd->cmd_op, ubq->q_id, req->tag, io->flags,
+	pr_devel("%s: complete: qid %d tag %d io_flags %x addr %llx\n",
+			__func__, ubq->q_id, req->tag, io->flags,
 			ublk_get_iod(ubq, req->tag)->addr);
 
 	/*
@@ -720,7 +836,7 @@ static inline void __ublk_rq_task_work(struct request *req)
 			pr_devel("%s: need get data. op %d, qid %d tag %d io_flags %x\n",
 					__func__, io->cmd->cmd_op, ubq->q_id,
 					req->tag, io->flags);
-			ubq_complete_io_cmd(io, UBLK_IO_RES_NEED_GET_DATA);
+			ubq_complete_io_cmd(ubq, io, UBLK_IO_RES_NEED_GET_DATA);
 			return;
 		}
 		/*
@@ -758,7 +874,8 @@ static inline void __ublk_rq_task_work(struct request *req)
 			mapped_bytes >> 9;
 	}
 
-	ubq_complete_io_cmd(io, UBLK_IO_RES_OK);
+	ublk_init_req_ref(ubq, req);
+	ubq_complete_io_cmd(ubq, io, UBLK_IO_RES_OK);
 }
 
 static void ublk_rq_task_work_cb(struct io_uring_cmd *cmd)
@@ -777,6 +894,72 @@ static void ublk_rq_task_work_fn(struct callback_head *work)
 	__ublk_rq_task_work(req);
 }
 
+/*
+ * Report every request queued to batch-armed ios since the last call to
+ * ublksrv in one completion of the batch command: tags of requests ready
+ * for handling are copied to the command's tag buffer, and cqe->res holds
+ * their count.
+ */
+static void ublk_batch_fetch(struct ublk_queue *ubq, struct io_uring_cmd *cmd)
+{
+	struct llist_node *reqs = llist_del_all(&ubq->batch_reqs);
+	struct ublk_rq_data *data, *tmp;
+	int ret;
+
+	ubq->nr_batch_tags = 0;
+	reqs = llist_reverse_order(reqs);
+	llist_for_each_entry_safe(data, tmp, reqs, node)
+		__ublk_rq_task_work(blk_mq_rq_from_pdu(data));
+
+	ret = ubq->nr_batch_tags;
+	if (ret && copy_to_user(ubq->batch_buf, ubq->batch_tags,
+				ret * sizeof(__u16)))
+		ret = -EFAULT;
+	io_uring_cmd_done(cmd, ret, 0);
+}
+
+static void ublk_batch_fetch_cb(struct io_uring_cmd *cmd)
+{
+	struct ublk_uring_cmd_pdu *pdu = ublk_get_uring_cmd_pdu(cmd);
+
+	ublk_batch_fetch(pdu->ubq, cmd);
+}
+
+/* hand the pending batch command over to task work if there is one */
+static void ublk_kick_batch_cmd(struct ublk_queue *ubq)
+{
+	struct io_uring_cmd *cmd = xchg(&ubq->batch_cmd, NULL);
+
+	if (cmd) {
+		struct ublk_uring_cmd_pdu *pdu = ublk_get_uring_cmd_pdu(cmd);
+
+		pdu->ubq = ubq;
+		io_uring_cmd_complete_in_task(cmd, ublk_batch_fetch_cb);
+	}
+}
+
+/*
+ * Only the first request added to an empty list needs to kick, the
+ * others are picked up by the same ublk_batch_fetch() run.
+ */
+static void ublk_queue_batch_rq(struct ublk_queue *ubq, struct request *rq)
+{
+	struct ublk_rq_data *data = blk_mq_rq_to_pdu(rq);
+
+	if (llist_add(&data->node, &ubq->batch_reqs))
+		ublk_kick_batch_cmd(ubq);
+}
+
+/* requests queued to batch-armed ios which never reached ublksrv */
+static void ublk_abort_batch_reqs(struct ublk_queue *ubq)
+{
+	struct llist_node *reqs = llist_del_all(&ubq->batch_reqs);
+	struct ublk_rq_data *data, *tmp;
+
+	llist_for_each_entry_safe(data, tmp, reqs, node)
+		__ublk_abort_rq(ubq, blk_mq_rq_from_pdu(data));
+}
+
 static blk_status_t ublk_queue_rq(struct blk_mq_hw_ctx *hctx,
 		const struct blk_mq_queue_data *bd)
 {
@@ -808,7 +991,12 @@ static blk_status_t ublk_queue_rq(struct blk_mq_hw_ctx *hctx,
 		return BLK_STS_OK;
 	}
 
-	if (ublk_can_use_task_work(ubq)) {
+	if (ubq->ios[rq->tag].flags & UBLK_IO_FLAG_BATCH) {
+		/* see the comment on UBLK_IO_FLAG_ABORTED below */
+		if (ubq->ios[rq->tag].flags & UBLK_IO_FLAG_ABORTED)
+			goto fail;
+		ublk_queue_batch_rq(ubq, rq);
+	} else if (ublk_can_use_task_work(ubq)) {
 		struct ublk_rq_data *data = blk_mq_rq_to_pdu(rq);
 		enum task_work_notify_mode notify_mode = bd->last ?
 			TWA_SIGNAL_NO_IPI : TWA_NONE;
@@ -934,22 +1122,21 @@ static int ublk_ch_mmap(struct file *filp, struct vm_area_struct *vma)
 }
 
 static void ublk_commit_completion(struct ublk_device *ub,
-		struct ublksrv_io_cmd *ub_cmd)
+		u16 qid, u16 tag, s32 result)
 {
-	u32 qid = ub_cmd->q_id, tag = ub_cmd->tag;
 	struct ublk_queue *ubq = ublk_get_queue(ub, qid);
 	struct ublk_io *io = &ubq->ios[tag];
 	struct request *req;
 
 	/* now this cmd slot is owned by nbd driver */
 	io->flags &= ~UBLK_IO_FLAG_OWNED_BY_SRV;
-	io->res = ub_cmd->result;
+	io->res = result;
 
 	/* find the io request and complete */
 	req = blk_mq_tag_to_rq(ub->tag_set.tags[qid], tag);
 
 	if (req && likely(!blk_should_fake_timeout(req->q)))
-		ublk_complete_rq(req);
+		ublk_put_req_ref(ubq, req);
 }
 
 /*
@@ -979,6 +1166,7 @@ static void ublk_abort_queue(struct ublk_device *ub, struct ublk_queue *ubq)
 				__ublk_fail_req(ubq, io, rq);
 		}
 	}
+	ublk_abort_batch_reqs(ubq);
 	ublk_put_device(ub);
 }
 
@@ -1021,6 +1209,7 @@ static inline bool ublk_queue_ready(struct ublk_queue *ubq)
 
 static void ublk_cancel_queue(struct ublk_queue *ubq)
 {
+	struct io_uring_cmd *cmd;
 	int i;
 
 	if (!ublk_queue_ready(ubq))
@@ -1029,10 +1218,16 @@ static void ublk_cancel_queue(struct ublk_queue *ubq)
 	for (i = 0; i < ubq->q_depth; i++) {
 		struct ublk_io *io = &ubq->ios[i];
 
-		if (io->flags & UBLK_IO_FLAG_ACTIVE)
+		if ((io->flags & UBLK_IO_FLAG_ACTIVE) &&
+				!(io->flags & UBLK_IO_FLAG_BATCH))
 			io_uring_cmd_done(io->cmd, UBLK_IO_RES_ABORT, 0);
 	}
 
+	/* batch-armed ios share the queue's batch command */
+	cmd = xchg(&ubq->batch_cmd, NULL);
+	if (cmd)
+		io_uring_cmd_done(cmd, UBLK_IO_RES_ABORT, 0);
+
 	/* all io commands are canceled */
 	ubq->nr_io_ready = 0;
 }
@@ -1182,6 +1377,119 @@ static void ublk_handle_need_get_data(struct ublk_device *ub, int q_id,
 	}
 }
 
+static void ublk_io_release(void *priv)
+{
+	struct request *req = priv;
+	struct ublk_queue *ubq = req->mq_hctx->driver_data;
+
+	ublk_put_req_ref(ubq, req);
+}
+
+static int ublk_register_io_buf(struct io_uring_cmd *cmd,
+		struct ublk_queue *ubq, struct ublk_io *io, unsigned int tag,
+		unsigned int index, unsigned int issue_flags)
+{
+	struct ublk_device *ub = ubq->dev;
+	struct request *req;
+	int ret;
+
+	if (!ublk_support_zero_copy(ubq))
+		return -EINVAL;
+
+	/* only the request being handled by server can be lent */
+	if (!(io->flags & UBLK_IO_FLAG_OWNED_BY_SRV))
+		return -EINVAL;
+
+	req = blk_mq_tag_to_rq(ub->tag_set.tags[ubq->q_id], tag);
+	if (!req || !ublk_rq_has_data(req))
+		return -EINVAL;
+
+	if (!ublk_get_req_ref(ubq, req))
+		return -EINVAL;
+
+	ret = io_uring_cmd_buffer_register_bvec(cmd, req, ublk_io_release,
+			req, index, issue_flags);
+	if (ret)
+		ublk_put_req_ref(ubq, req);
+	return ret;
+}
+
+static int ublk_batch_commit_and_fetch(struct io_uring_cmd *cmd,
+		struct ublk_device *ub)
+{
+	const struct ublksrv_io_batch_cmd *batch =
+		(const struct ublksrv_io_batch_cmd *)cmd->cmd;
+	struct ublksrv_io_batch_elem elems[UBLK_BATCH_MAX_COMMIT];
+	const u16 q_id = READ_ONCE(batch->q_id);
+	const u16 nr = READ_ONCE(batch->nr_commit);
+	const u64 fetch_buf = READ_ONCE(batch->fetch_buf);
+	struct ublk_queue *ubq;
+	int i;
+
+	/* has to fit in the command area of SQE128 */
+	BUILD_BUG_ON(sizeof(*batch) > 80);
+
+	if (q_id >= ub->dev_info.nr_hw_queues)
+		return -EINVAL;
+	ubq = ublk_get_queue(ub, q_id);
+
+	/* per-tag FETCH_REQ has to set up the queue first */
+	if (!ublk_support_batch_io(ubq) || !ublk_queue_ready(ubq))
+		return -EINVAL;
+	if (ubq->ubq_daemon != current)
+		return -EINVAL;
+	if (nr > UBLK_BATCH_MAX_COMMIT || !fetch_buf)
+		return -EINVAL;
+
+	/* only one batch command can be pending per queue */
+	if (READ_ONCE(ubq->batch_cmd))
+		return -EBUSY;
+
+	/* sqe is shared with userspace, don't read it twice */
+	memcpy(elems, batch->commit, nr * sizeof(elems[0]));
+
+	/* validate everything first, then nothing is committed on error */
+	for (i = 0; i < nr; i++) {
+		struct ublk_io *io;
+
+		if (elems[i].tag >= ubq->q_depth)
+			goto fail;
+		io = &ubq->ios[elems[i].tag];
+		if ((io->flags & UBLK_IO_FLAG_ACTIVE) ||
+				!(io->flags & UBLK_IO_FLAG_OWNED_BY_SRV))
+			goto fail;
+		io->flags |= UBLK_IO_FLAG_ACTIVE;
+	}
+
+	ubq->batch_buf = u64_to_user_ptr(fetch_buf);
+	for (i = 0; i < nr; i++) {
+		struct ublk_io *io = &ubq->ios[elems[i].tag];
+
+		io->flags |= UBLK_IO_FLAG_BATCH;
+		io->cmd = NULL;
+		ublk_commit_completion(ub, q_id, elems[i].tag,
+				elems[i].result);
+	}
+
+	/* report requests queued to batch-armed ios meanwhile right away */
+	if (!llist_empty(&ubq->batch_reqs)) {
+		ublk_batch_fetch(ubq, cmd);
+		return -EIOCBQUEUED;
+	}
+
+	WRITE_ONCE(ubq->batch_cmd, cmd);
+	/* pairs with llist_add() in ublk_queue_batch_rq() */
+	smp_mb();
+	if (!llist_empty(&ubq->batch_reqs))
+		ublk_kick_batch_cmd(ubq);
+	return -EIOCBQUEUED;
+
+ fail:
+	while (--i >= 0)
+		ubq->ios[elems[i].tag].flags &= ~UBLK_IO_FLAG_ACTIVE;
+	return -EINVAL;
+}
+
 static int ublk_ch_uring_cmd(struct io_uring_cmd *cmd, unsigned int issue_flags)
 {
 	struct ublksrv_io_cmd *ub_cmd = (struct ublksrv_io_cmd *)cmd->cmd;
@@ -1199,6 +1507,14 @@ static int ublk_ch_uring_cmd(struct io_uring_cmd *cmd, unsigned int issue_flags)
 	if (!(issue_flags & IO_URING_F_SQE128))
 		goto out;
 
+	if (cmd_op == UBLK_IO_BATCH_COMMIT_AND_FETCH) {
+		ret = ublk_batch_commit_and_fetch(cmd, ub);
+		if (ret == -EIOCBQUEUED)
+			return ret;
+		io_uring_cmd_done(cmd, ret, 0);
+		return -EIOCBQUEUED;
+	}
+
 	if (ub_cmd->q_id >= ub->dev_info.nr_hw_queues)
 		goto out;
 
@@ -1214,6 +1530,18 @@ static int ublk_ch_uring_cmd(struct io_uring_cmd *cmd, unsigned int issue_flags)
 
 	io = &ubq->ios[tag];
 
+	/*
+	 * Unregistering doesn't touch the io slot, the request pages stay
+	 * alive until io_uring releases them, so allow it any time.
+	 */
+	if (cmd_op == UBLK_IO_UNREGISTER_IO_BUF) {
+		if (!ublk_support_zero_copy(ubq))
+			goto out;
+		ret = io_uring_cmd_buffer_unregister(cmd, ub_cmd->addr,
+				issue_flags);
+		goto out;
+	}
+
 	/* there is pending io cmd, something must be wrong */
 	if (io->flags & UBLK_IO_FLAG_ACTIVE) {
 		ret = -EBUSY;
@@ -1241,8 +1569,8 @@ static int ublk_ch_uring_cmd(struct io_uring_cmd *cmd, unsigned int issue_flags)
 		 */
 		if (io->flags & UBLK_IO_FLAG_OWNED_BY_SRV)
 			goto out;
-		/* FETCH_RQ has to provide IO buffer */
-		if (!ub_cmd->addr)
+		/* FETCH_RQ has to provide IO buffer unless zero copy is used */
+		if (!ub_cmd->addr && !ublk_support_zero_copy(ubq))
 			goto out;
 		io->cmd = cmd;
 		io->flags |= UBLK_IO_FLAG_ACTIVE;
@@ -1251,15 +1579,15 @@ static int ublk_ch_uring_cmd(struct io_uring_cmd *cmd, unsigned int issue_flags)
 		ublk_mark_io_ready(ub, ubq);
 		break;
 	case UBLK_IO_COMMIT_AND_FETCH_REQ:
-		/* FETCH_RQ has to provide IO buffer */
-		if (!ub_cmd->addr)
+		/* FETCH_RQ has to provide IO buffer unless zero copy is used */
+		if (!ub_cmd->addr && !ublk_support_zero_copy(ubq))
 			goto out;
 		if (!(io->flags & UBLK_IO_FLAG_OWNED_BY_SRV))
 			goto out;
 		io->addr = ub_cmd->addr;
 		io->flags |= UBLK_IO_FLAG_ACTIVE;
 		io->cmd = cmd;
-		ublk_commit_completion(ub, ub_cmd);
+		ublk_commit_completion(ub, ub_cmd->q_id, tag, ub_cmd->result);
 		break;
 	case UBLK_IO_NEED_GET_DATA:
 		if (!(io->flags & UBLK_IO_FLAG_OWNED_BY_SRV))
@@ -1269,6 +1597,10 @@ static int ublk_ch_uring_cmd(struct io_uring_cmd *cmd, unsigned int issue_flags)
 		io->flags |= UBLK_IO_FLAG_ACTIVE;
 		ublk_handle_need_get_data(ub, ub_cmd->q_id, ub_cmd->tag, cmd);
 		break;
+	case UBLK_IO_REGISTER_IO_BUF:
+		ret = ublk_register_io_buf(cmd, ubq, io, tag, ub_cmd->addr,
+				issue_flags);
+		goto out;
 	default:
 		goto out;
 	}
@@ -1299,6 +1631,7 @@ static void ublk_deinit_queue(struct ublk_device *ub, int q_id)
 		put_task_struct(ubq->ubq_daemon);
 	if (ubq->io_cmd_buf)
 		free_pages((unsigned long)ubq->io_cmd_buf, get_order(size));
+	kfree(ubq->batch_tags);
 }
 
 static int ublk_init_queue(struct ublk_device *ub, int q_id)
@@ -1313,9 +1646,20 @@ static int ublk_init_queue(struct ublk_device *ub, int q_id)
 	ubq->q_depth = ub->dev_info.queue_depth;
 	size = ublk_queue_cmd_buf_size(ub, q_id);
 
+	if (ublk_support_batch_io(ubq)) {
+		init_llist_head(&ubq->batch_reqs);
+		ubq->batch_tags = kcalloc(ubq->q_depth,
+				sizeof(*ubq->batch_tags), GFP_KERNEL);
+		if (!ubq->batch_tags)
+			return -ENOMEM;
+	}
+
 	ptr = (void *) __get_free_pages(gfp_flags, get_order(size));
-	if (!ptr)
+	if (!ptr) {
+		kfree(ubq->batch_tags);
+		ubq->batch_tags = NULL;
 		return -ENOMEM;
+	}
 
 	ubq->io_cmd_buf = ptr;
 	ubq->dev = ub;
@@ -1658,8 +2002,13 @@ static int ublk_ctrl_add_dev(struct io_uring_cmd *cmd)
 	 */
 	ub->dev_info.flags &= UBLK_F_ALL;
 
-	/* We are not ready to support zero copy */
-	ub->dev_info.flags &= ~UBLK_F_SUPPORT_ZERO_COPY;
+	/* with zero copy there is no server buffer to get data into */
+	if (ub->dev_info.flags & UBLK_F_SUPPORT_ZERO_COPY)
+		ub->dev_info.flags &= ~UBLK_F_NEED_GET_DATA;
+
+	/* batched fetch reports tags only, it can't ask for buffers */
+	if (ub->dev_info.flags & UBLK_F_BATCH_IO)
+		ub->dev_info.flags &= ~UBLK_F_NEED_GET_DATA;
 
 	ub->dev_info.nr_hw_queues = min_t(unsigned int,
 			ub->dev_info.nr_hw_queues, nr_cpu_ids);
@@ -24,6 +24,9 @@
 /* The maximum number of sg elements that fit into a virtqueue */
 #define VIRTIO_BLK_MAX_SG_ELEMS 32768
 
+/* Used buffers taken off a virtqueue at a time */
+#define VIRTBLK_GET_BATCH 16
+
 #ifdef CONFIG_ARCH_NO_SG_CHAIN
 #define VIRTIO_BLK_INLINE_SG_CNT	0
 #else
@@ -50,6 +53,10 @@ struct virtio_blk_vq {
 	struct virtqueue *vq;
 	spinlock_t lock;
 	char name[VQ_NAME_LEN];
+
+	/* Interrupts or polls that completed requests, and how many. */
+	unsigned long nr_batches;
+	unsigned long nr_completed;
 } ____cacheline_aligned_in_smp;
 
 struct virtio_blk {
@@ -272,25 +279,65 @@ static inline void virtblk_request_done(struct request *req)
 	blk_mq_end_request(req, virtblk_result(vbr));
 }
 
+static void virtblk_complete_batch(struct io_comp_batch *iob)
+{
+	struct request *req;
+
+	rq_list_for_each(&iob->req_list, req) {
+		virtblk_unmap_data(req, blk_mq_rq_to_pdu(req));
+		virtblk_cleanup_cmd(req);
+	}
+	blk_mq_end_request_batch(iob);
+}
+
+/*
+ * Reap the used buffers of @vq.  Requests that can be completed here are
+ * added to @iob, which the caller completes once the vq lock is dropped.
+ * Called with the vq lock held.
+ */
+static int virtblk_handle_req(struct virtio_blk_vq *vq,
+			      struct io_comp_batch *iob)
+{
+	void *bufs[VIRTBLK_GET_BATCH];
+	unsigned int lens[VIRTBLK_GET_BATCH];
+	unsigned int i, nr;
+	int found = 0;
+
+	do {
+		nr = virtqueue_get_bufs(vq->vq, bufs, lens, VIRTBLK_GET_BATCH);
+		for (i = 0; i < nr; i++) {
+			struct virtblk_req *vbr = bufs[i];
+			struct request *req = blk_mq_rq_from_pdu(vbr);
+
+			if (likely(!blk_should_fake_timeout(req->q)) &&
+			    !blk_mq_complete_request_remote(req) &&
+			    !blk_mq_add_to_batch(req, iob, vbr->status,
+						 virtblk_complete_batch))
+				virtblk_request_done(req);
+		}
+		found += nr;
+	} while (nr == VIRTBLK_GET_BATCH);
+
+	if (found) {
+		vq->nr_batches++;
+		vq->nr_completed += found;
+	}
+	return found;
+}
+
 static void virtblk_done(struct virtqueue *vq)
 {
 	struct virtio_blk *vblk = vq->vdev->priv;
+	struct virtio_blk_vq *vblk_vq = &vblk->vqs[vq->index];
 	bool req_done = false;
-	int qid = vq->index;
-	struct virtblk_req *vbr;
 	unsigned long flags;
-	unsigned int len;
+	DEFINE_IO_COMP_BATCH(iob);
 
-	spin_lock_irqsave(&vblk->vqs[qid].lock, flags);
+	spin_lock_irqsave(&vblk_vq->lock, flags);
 	do {
 		virtqueue_disable_cb(vq);
-		while ((vbr = virtqueue_get_buf(vblk->vqs[qid].vq, &len)) != NULL) {
-			struct request *req = blk_mq_rq_from_pdu(vbr);
-
-			if (likely(!blk_should_fake_timeout(req->q)))
-				blk_mq_complete_request(req);
+		if (virtblk_handle_req(vblk_vq, &iob))
 			req_done = true;
-		}
 		if (unlikely(virtqueue_is_broken(vq)))
 			break;
 	} while (!virtqueue_enable_cb(vq));
@@ -298,7 +345,10 @@ static void virtblk_done(struct virtqueue *vq)
 	/* In case queue is stopped waiting for more buffers. */
 	if (req_done)
 		blk_mq_start_stopped_hw_queues(vblk->disk->queue, true);
-	spin_unlock_irqrestore(&vblk->vqs[qid].lock, flags);
+	spin_unlock_irqrestore(&vblk_vq->lock, flags);
+
+	if (!rq_list_empty(iob.req_list))
+		iob.complete(&iob);
 }
 
 static void virtio_commit_rqs(struct blk_mq_hw_ctx *hctx)
@@ -774,9 +824,33 @@ cache_type_show(struct device *dev, struct device_attribute *attr, char *buf)
 
 static DEVICE_ATTR_RW(cache_type);
 
+/*
+ * One line per virtqueue: the number of interrupts or polls that completed
+ * requests and the number of requests they completed.
+ */
+static ssize_t
+batch_stats_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct gendisk *disk = dev_to_disk(dev);
+	struct virtio_blk *vblk = disk->private_data;
+	int i, len = 0;
+
+	for (i = 0; i < vblk->num_vqs; i++) {
+		struct virtio_blk_vq *vq = &vblk->vqs[i];
+
+		len += sysfs_emit_at(buf, len, "%s %lu %lu\n", vq->name,
+				     READ_ONCE(vq->nr_batches),
+				     READ_ONCE(vq->nr_completed));
+	}
+	return len;
+}
+
+static DEVICE_ATTR_RO(batch_stats);
+
 static struct attribute *virtblk_attrs[] = {
 	&dev_attr_serial.attr,
 	&dev_attr_cache_type.attr,
+	&dev_attr_batch_stats.attr,
 	NULL,
 };
 
@@ -832,37 +906,16 @@ static void virtblk_map_queues(struct blk_mq_tag_set *set)
 	}
 }
 
-static void virtblk_complete_batch(struct io_comp_batch *iob)
-{
-	struct request *req;
-
-	rq_list_for_each(&iob->req_list, req) {
-		virtblk_unmap_data(req, blk_mq_rq_to_pdu(req));
-		virtblk_cleanup_cmd(req);
-	}
-	blk_mq_end_request_batch(iob);
-}
-
 static int virtblk_poll(struct blk_mq_hw_ctx *hctx, struct io_comp_batch *iob)
 {
 	struct virtio_blk *vblk = hctx->queue->queuedata;
 	struct virtio_blk_vq *vq = get_virtio_blk_vq(hctx);
-	struct virtblk_req *vbr;
 	unsigned long flags;
-	unsigned int len;
-	int found = 0;
+	int found;
 
 	spin_lock_irqsave(&vq->lock, flags);
 
-	while ((vbr = virtqueue_get_buf(vq->vq, &len)) != NULL) {
-		struct request *req = blk_mq_rq_from_pdu(vbr);
-
-		found++;
-		if (!blk_mq_add_to_batch(req, iob, vbr->status,
-						virtblk_complete_batch))
-			blk_mq_complete_request(req);
-	}
-
+	found = virtblk_handle_req(vq, iob);
 	if (found)
 		blk_mq_start_stopped_hw_queues(vblk->disk->queue, true);
 
@@ -926,6 +926,9 @@ static inline blk_status_t nvme_setup_rw(struct nvme_ns *ns,
 
 void nvme_cleanup_cmd(struct request *req)
 {
+	if (nvme_req(req)->flags & NVME_MPATH_CNT_ACTIVE)
+		nvme_mpath_end_request(req);
+
 	if (req->rq_flags & RQF_SPECIAL_PAYLOAD) {
 		struct nvme_ctrl *ctrl = nvme_req(req)->ctrl;
 
@@ -988,6 +991,8 @@ blk_status_t nvme_setup_cmd(struct nvme_ns *ns, struct request *req)
 
 	cmd->common.command_id = nvme_cid(req);
 	trace_nvme_setup_cmd(req, cmd);
+	if (ret == BLK_STS_OK && (req->cmd_flags & REQ_NVME_MPATH))
+		nvme_mpath_start_request(req);
 	return ret;
 }
 EXPORT_SYMBOL_GPL(nvme_setup_cmd);
@@ -3431,6 +3436,8 @@ static struct attribute *nvme_ns_id_attrs[] = {
 #ifdef CONFIG_NVME_MULTIPATH
 	&dev_attr_ana_grpid.attr,
 	&dev_attr_ana_state.attr,
+	&dev_attr_lat_ewma_ns.attr,
+	&dev_attr_nr_active.attr,
 #endif
 	NULL,
 };
@@ -3461,6 +3468,10 @@ static umode_t nvme_ns_id_attrs_are_visible(struct kobject *kobj,
 		if (!nvme_ctrl_use_ana(nvme_get_ns_from_dev(dev)->ctrl))
 			return 0;
 	}
+	if (a == &dev_attr_lat_ewma_ns.attr || a == &dev_attr_nr_active.attr) {
+		if (dev_to_disk(dev)->fops != &nvme_bdev_ops) /* per-path attr */
+			return 0;
+	}
 #endif
 	return a->mode;
 }
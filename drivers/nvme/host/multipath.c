@@ -17,6 +17,7 @@ MODULE_PARM_DESC(multipath,
 static const char *nvme_iopolicy_names[] = {
 	[NVME_IOPOLICY_NUMA]	= "numa",
 	[NVME_IOPOLICY_RR]	= "round-robin",
+	[NVME_IOPOLICY_ST]	= "service-time",
 };
 
 static int iopolicy = NVME_IOPOLICY_NUMA;
@@ -29,6 +30,8 @@ static int nvme_set_iopolicy(const char *val, const struct kernel_param *kp)
 		iopolicy = NVME_IOPOLICY_NUMA;
 	else if (!strncmp(val, "round-robin", 11))
 		iopolicy = NVME_IOPOLICY_RR;
+	else if (!strncmp(val, "service-time", 12))
+		iopolicy = NVME_IOPOLICY_ST;
 	else
 		return -EINVAL;
 
@@ -43,7 +46,7 @@ static int nvme_get_iopolicy(char *buf, const struct kernel_param *kp)
 module_param_call(iopolicy, nvme_set_iopolicy, nvme_get_iopolicy,
 	&iopolicy, 0644);
 MODULE_PARM_DESC(iopolicy,
-	"Default multipath I/O policy; 'numa' (default) or 'round-robin'");
+	"Default multipath I/O policy; 'numa' (default), 'round-robin' or 'service-time'");
 
 void nvme_mpath_default_iopolicy(struct nvme_subsystem *subsys)
 {
@@ -114,6 +117,46 @@ void nvme_failover_req(struct request *req)
 	kblockd_schedule_work(&ns->head->requeue_work);
 }
 
+/*
+ * Weight of a new sample in the per-path latency average, 1/8 lets a path
+ * follow a change in fabric latency within a few dozen completions.
+ */
+#define NVME_MPATH_EWMA_SHIFT	3
+
+void nvme_mpath_start_request(struct request *rq)
+{
+	struct nvme_ns *ns = rq->q->queuedata;
+
+	if (READ_ONCE(ns->head->subsys->iopolicy) != NVME_IOPOLICY_ST ||
+	    (nvme_req(rq)->flags & NVME_MPATH_CNT_ACTIVE))
+		return;
+
+	atomic_inc(&ns->nr_active);
+	nvme_req(rq)->start_time_ns = ktime_get_ns();
+	nvme_req(rq)->flags |= NVME_MPATH_CNT_ACTIVE;
+}
+
+void nvme_mpath_end_request(struct request *rq)
+{
+	struct nvme_ns *ns = rq->q->queuedata;
+	u64 lat = ktime_get_ns() - nvme_req(rq)->start_time_ns;
+	u64 ewma;
+
+	nvme_req(rq)->flags &= ~NVME_MPATH_CNT_ACTIVE;
+	atomic_dec(&ns->nr_active);
+
+	/*
+	 * Completions on different cpus race on the update, losing a sample
+	 * now and then only slows down convergence a little.
+	 */
+	ewma = READ_ONCE(ns->lat_ewma_ns);
+	if (ewma)
+		ewma += ((s64)lat - (s64)ewma) >> NVME_MPATH_EWMA_SHIFT;
+	else
+		ewma = lat;
+	WRITE_ONCE(ns->lat_ewma_ns, ewma);
+}
+
 void nvme_kick_requeue_lists(struct nvme_ctrl *ctrl)
 {
 	struct nvme_ns *ns;
@@ -293,6 +336,44 @@ static struct nvme_ns *nvme_round_robin_path(struct nvme_ns_head *head,
 	return found;
 }
 
+/*
+ * Pick the path with the lowest expected service time for a new I/O, that is
+ * its average completion latency times the I/O already queued on it plus
+ * this one. Paths without a latency sample yet are tried first.
+ */
+static struct nvme_ns *nvme_service_time_path(struct nvme_ns_head *head)
+{
+	struct nvme_ns *best_opt = NULL, *best_nonopt = NULL, *ns;
+	u64 min_opt = U64_MAX, min_nonopt = U64_MAX, cost;
+
+	list_for_each_entry_rcu(ns, &head->list, siblings) {
+		if (nvme_path_is_disabled(ns))
+			continue;
+
+		cost = READ_ONCE(ns->lat_ewma_ns) *
+			(atomic_read(&ns->nr_active) + 1);
+
+		switch (ns->ana_state) {
+		case NVME_ANA_OPTIMIZED:
+			if (cost < min_opt) {
+				min_opt = cost;
+				best_opt = ns;
+			}
+			break;
+		case NVME_ANA_NONOPTIMIZED:
+			if (cost < min_nonopt) {
+				min_nonopt = cost;
+				best_nonopt = ns;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	return best_opt ? best_opt : best_nonopt;
+}
+
 static inline bool nvme_path_is_optimized(struct nvme_ns *ns)
 {
 	return ns->ctrl->state == NVME_CTRL_LIVE &&
@@ -304,6 +385,9 @@ inline struct nvme_ns *nvme_find_path(struct nvme_ns_head *head)
 	int node = numa_node_id();
 	struct nvme_ns *ns;
 
+	if (READ_ONCE(head->subsys->iopolicy) == NVME_IOPOLICY_ST)
+		return nvme_service_time_path(head);
+
 	ns = srcu_dereference(head->current_path[node], &head->srcu);
 	if (unlikely(!ns))
 		return __nvme_find_path(head, node);
@@ -792,6 +876,24 @@ static ssize_t ana_state_show(struct device *dev, struct device_attribute *attr,
 }
 DEVICE_ATTR_RO(ana_state);
 
+static ssize_t lat_ewma_ns_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct nvme_ns *ns = nvme_get_ns_from_dev(dev);
+
+	return sysfs_emit(buf, "%llu\n", READ_ONCE(ns->lat_ewma_ns));
+}
+DEVICE_ATTR_RO(lat_ewma_ns);
+
+static ssize_t nr_active_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct nvme_ns *ns = nvme_get_ns_from_dev(dev);
+
+	return sysfs_emit(buf, "%d\n", atomic_read(&ns->nr_active));
+}
+DEVICE_ATTR_RO(nr_active);
+
 static int nvme_lookup_ana_group_desc(struct nvme_ctrl *ctrl,
 		struct nvme_ana_group_desc *desc, void *data)
 {
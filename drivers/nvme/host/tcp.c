@@ -8,6 +8,7 @@
 #include <linux/init.h>
 #include <linux/slab.h>
 #include <linux/err.h>
+#include <linux/debugfs.h>
 #include <linux/nvme-tcp.h>
 #include <net/sock.h>
 #include <net/tcp.h>
@@ -30,6 +31,15 @@ static int so_priority;
 module_param(so_priority, int, 0644);
 MODULE_PARM_DESC(so_priority, "nvme tcp socket optimize priority");
 
+/*
+ * Timestamp every request at submission and account its completion latency
+ * in the per queue statistics. Off by default as it costs a clock read on
+ * both ends of every I/O.
+ */
+static bool latency_stats;
+module_param(latency_stats, bool, 0644);
+MODULE_PARM_DESC(latency_stats, "account per queue completion latency");
+
 #ifdef CONFIG_DEBUG_LOCK_ALLOC
 /* lockdep can detect a circular dependency of the form
  *   sk_lock -> mmap_lock (page fault) -> fs locks -> sk_lock
@@ -97,6 +107,8 @@ struct nvme_tcp_request {
 	size_t			offset;
 	size_t			data_sent;
 	enum nvme_tcp_send_state state;
+
+	u64			start_ns;
 };
 
 enum nvme_tcp_queue_flags {
@@ -129,6 +141,7 @@ struct nvme_tcp_queue {
 	size_t			data_remaining;
 	size_t			ddgst_remaining;
 	unsigned int		nr_cqe;
+	struct io_comp_batch	*iob;
 
 	/* send state */
 	struct nvme_tcp_request *request;
@@ -148,6 +161,13 @@ struct nvme_tcp_queue {
 
 	struct page_frag_cache	pf_cache;
 
+	/* statistics, see nvme_tcp_stats_show() */
+	u64			nr_sent;
+	u64			nr_completed;
+	u64			nr_polled;
+	u64			lat_total_ns;
+	u64			lat_max_ns;
+
 	void (*state_change)(struct sock *);
 	void (*data_ready)(struct sock *);
 	void (*write_space)(struct sock *);
@@ -169,11 +189,13 @@ struct nvme_tcp_ctrl {
 	struct delayed_work	connect_work;
 	struct nvme_tcp_request async_req;
 	u32			io_queues[HCTX_MAX_TYPES];
+	struct dentry		*debugfs_stats;
 };
 
 static LIST_HEAD(nvme_tcp_ctrl_list);
 static DEFINE_MUTEX(nvme_tcp_ctrl_mutex);
 static struct workqueue_struct *nvme_tcp_wq;
+static struct dentry *nvme_tcp_debugfs;
 static const struct blk_mq_ops nvme_tcp_mq_ops;
 static const struct blk_mq_ops nvme_tcp_admin_mq_ops;
 static int nvme_tcp_try_send(struct nvme_tcp_queue *queue);
@@ -325,18 +347,20 @@ static inline void nvme_tcp_queue_request(struct nvme_tcp_request *req,
 		bool sync, bool last)
 {
 	struct nvme_tcp_queue *queue = req->queue;
-	bool empty;
+	bool idle;
 
-	empty = llist_add(&req->lentry, &queue->req_list) &&
-		list_empty(&queue->send_list) && !queue->request;
+	llist_add(&req->lentry, &queue->req_list);
+	idle = list_empty(&queue->send_list) && !queue->request;
 
 	/*
-	 * if we're the first on the send_list and we can try to send
-	 * directly, otherwise queue io_work. Also, only do that if we
-	 * are on the same cpu, so we don't introduce contention.
+	 * Requests of a single dispatch are only queued up until the last
+	 * one arrives. If the sender is idle at that point, push the whole
+	 * batch out directly so that the PDUs go out back to back under
+	 * MSG_MORE, otherwise queue io_work. Also, only do that if we are
+	 * on the same cpu, so we don't introduce contention.
 	 */
 	if (queue->io_cpu == raw_smp_processor_id() &&
-	    sync && empty && mutex_trylock(&queue->send_mutex)) {
+	    sync && last && idle && mutex_trylock(&queue->send_mutex)) {
 		nvme_tcp_send_all(queue);
 		mutex_unlock(&queue->send_mutex);
 	}
@@ -529,6 +553,56 @@ static void nvme_tcp_error_recovery(struct nvme_ctrl *ctrl)
 	queue_work(nvme_reset_wq, &to_tcp_ctrl(ctrl)->err_work);
 }
 
+static void nvme_tcp_complete_batch(struct io_comp_batch *iob)
+{
+	struct request *rq;
+
+	rq_list_for_each(&iob->req_list, rq)
+		nvme_complete_batch_req(rq);
+	blk_mq_end_request_batch(iob);
+}
+
+static void nvme_tcp_account_rq(struct nvme_tcp_queue *queue,
+		struct nvme_tcp_request *req)
+{
+	u64 lat;
+
+	queue->nr_completed++;
+	if (!req->start_ns)
+		return;
+
+	lat = ktime_get_ns() - req->start_ns;
+	queue->lat_total_ns += lat;
+	if (lat > queue->lat_max_ns)
+		queue->lat_max_ns = lat;
+}
+
+/*
+ * Complete a request from the receive path. Successful completions reaped
+ * by nvme_tcp_poll() are handed to the poller's completion batch.
+ */
+static void nvme_tcp_complete_rq(struct nvme_tcp_queue *queue,
+		struct request *rq, __le16 status, union nvme_result result)
+{
+	nvme_tcp_account_rq(queue, blk_mq_rq_to_pdu(rq));
+	if (!nvme_try_complete_req(rq, status, result) &&
+	    !blk_mq_add_to_batch(rq, queue->iob, nvme_req(rq)->status,
+				 nvme_tcp_complete_batch))
+		nvme_complete_rq(rq);
+	queue->nr_cqe++;
+}
+
+/* completion implied by a C2HData PDU with the SUCCESS flag set */
+static void nvme_tcp_complete_data_rq(struct nvme_tcp_queue *queue,
+		struct request *rq)
+{
+	struct nvme_tcp_request *req = blk_mq_rq_to_pdu(rq);
+	union nvme_result res = {};
+
+	nvme_tcp_complete_rq(queue, rq,
+			cpu_to_le16(le16_to_cpu(req->status) << 1), res);
+}
+
 static int nvme_tcp_process_nvme_cqe(struct nvme_tcp_queue *queue,
 		struct nvme_completion *cqe)
 {
@@ -548,9 +622,7 @@ static int nvme_tcp_process_nvme_cqe(struct nvme_tcp_queue *queue,
 	if (req->status == cpu_to_le16(NVME_SC_SUCCESS))
 		req->status = cqe->status;
 
-	if (!nvme_try_complete_req(rq, req->status, cqe->result))
-		nvme_complete_rq(rq);
-	queue->nr_cqe++;
+	nvme_tcp_complete_rq(queue, rq, req->status, cqe->result);
 
 	return 0;
 }
@@ -811,11 +883,8 @@ static int nvme_tcp_recv_data(struct nvme_tcp_queue *queue, struct sk_buff *skb,
 			nvme_tcp_ddgst_final(queue->rcv_hash, &queue->exp_ddgst);
 			queue->ddgst_remaining = NVME_TCP_DIGEST_LENGTH;
 		} else {
-			if (pdu->hdr.flags & NVME_TCP_F_DATA_SUCCESS) {
-				nvme_tcp_end_request(rq,
-						le16_to_cpu(req->status));
-				queue->nr_cqe++;
-			}
+			if (pdu->hdr.flags & NVME_TCP_F_DATA_SUCCESS)
+				nvme_tcp_complete_data_rq(queue, rq);
 			nvme_tcp_init_recv_ctx(queue);
 		}
 	}
@@ -858,10 +927,8 @@ static int nvme_tcp_recv_ddgst(struct nvme_tcp_queue *queue,
 	if (pdu->hdr.flags & NVME_TCP_F_DATA_SUCCESS) {
 		struct request *rq = nvme_cid_to_rq(nvme_tcp_tagset(queue),
 					pdu->command_id);
-		struct nvme_tcp_request *req = blk_mq_rq_to_pdu(rq);
 
-		nvme_tcp_end_request(rq, le16_to_cpu(req->status));
-		queue->nr_cqe++;
+		nvme_tcp_complete_data_rq(queue, rq);
 	}
 
 	nvme_tcp_init_recv_ctx(queue);
@@ -957,6 +1024,7 @@ static void nvme_tcp_state_change(struct sock *sk)
 static inline void nvme_tcp_done_send_req(struct nvme_tcp_queue *queue)
 {
 	queue->request = NULL;
+	queue->nr_sent++;
 }
 
 static void nvme_tcp_fail_request(struct nvme_tcp_request *req)
@@ -1188,7 +1256,8 @@ static int nvme_tcp_try_send(struct nvme_tcp_queue *queue)
 	return ret;
 }
 
-static int nvme_tcp_try_recv(struct nvme_tcp_queue *queue)
+static int __nvme_tcp_try_recv(struct nvme_tcp_queue *queue,
+		struct io_comp_batch *iob)
 {
 	struct socket *sock = queue->sock;
 	struct sock *sk = sock->sk;
@@ -1199,11 +1268,19 @@ static int nvme_tcp_try_recv(struct nvme_tcp_queue *queue)
 	rd_desc.count = 1;
 	lock_sock(sk);
 	queue->nr_cqe = 0;
+	/* only valid under the socket lock, io_work must not batch into it */
+	queue->iob = iob;
 	consumed = sock->ops->read_sock(sk, &rd_desc, nvme_tcp_recv_skb);
+	queue->iob = NULL;
 	release_sock(sk);
 	return consumed;
 }
 
+static inline int nvme_tcp_try_recv(struct nvme_tcp_queue *queue)
+{
+	return __nvme_tcp_try_recv(queue, NULL);
+}
+
 static void nvme_tcp_io_work(struct work_struct *w)
 {
 	struct nvme_tcp_queue *queue =
@@ -1471,8 +1548,26 @@ static bool nvme_tcp_poll_queue(struct nvme_tcp_queue *queue)
 static void nvme_tcp_set_queue_io_cpu(struct nvme_tcp_queue *queue)
 {
 	struct nvme_tcp_ctrl *ctrl = queue->ctrl;
+	struct blk_mq_tag_set *set = &ctrl->tag_set;
 	int qid = nvme_tcp_queue_id(queue);
-	int n = 0;
+	int n = 0, cpu, i;
+
+	/*
+	 * Once the tag set is mapped, run io_work on a cpu that submits to
+	 * this queue so that queue_rq can send inline and io_work stays on
+	 * the submitting cpu instead of bouncing to an unrelated one.
+	 */
+	if (qid && set->tags) {
+		for_each_online_cpu(cpu) {
+			for (i = 0; i < set->nr_maps; i++) {
+				if (set->map[i].mq_map &&
+				    set->map[i].mq_map[cpu] == qid - 1) {
+					queue->io_cpu = cpu;
+					return;
+				}
+			}
+		}
+	}
 
 	if (nvme_tcp_default_queue(queue))
 		n = qid - 1;
@@ -1539,6 +1634,11 @@ static int nvme_tcp_alloc_queue(struct nvme_ctrl *nctrl, int qid)
 	queue->sock->sk->sk_allocation = GFP_ATOMIC;
 	nvme_tcp_set_queue_io_cpu(queue);
 	queue->request = NULL;
+	queue->nr_sent = 0;
+	queue->nr_completed = 0;
+	queue->nr_polled = 0;
+	queue->lat_total_ns = 0;
+	queue->lat_max_ns = 0;
 	queue->data_remaining = 0;
 	queue->ddgst_remaining = 0;
 	queue->pdu_remaining = 0;
@@ -1677,9 +1777,11 @@ static int nvme_tcp_start_queue(struct nvme_ctrl *nctrl, int idx)
 	struct nvme_tcp_ctrl *ctrl = to_tcp_ctrl(nctrl);
 	int ret;
 
-	if (idx)
+	if (idx) {
+		/* the tag set is mapped by now, reconsider the io cpu */
+		nvme_tcp_set_queue_io_cpu(&ctrl->queues[idx]);
 		ret = nvmf_connect_io_queue(nctrl, idx);
-	else
+	} else
 		ret = nvmf_connect_admin_queue(nctrl);
 
 	if (!ret) {
@@ -2198,6 +2300,8 @@ static void nvme_tcp_free_ctrl(struct nvme_ctrl *nctrl)
 {
 	struct nvme_tcp_ctrl *ctrl = to_tcp_ctrl(nctrl);
 
+	debugfs_remove(ctrl->debugfs_stats);
+
 	if (list_empty(&ctrl->list))
 		goto free_ctrl;
 
@@ -2414,6 +2518,7 @@ static blk_status_t nvme_tcp_queue_rq(struct blk_mq_hw_ctx *hctx,
 	if (unlikely(ret))
 		return ret;
 
+	req->start_ns = latency_stats ? ktime_get_ns() : 0;
 	blk_mq_start_request(rq);
 
 	nvme_tcp_queue_request(req, true, bd->last);
@@ -2475,11 +2580,36 @@ static int nvme_tcp_poll(struct blk_mq_hw_ctx *hctx, struct io_comp_batch *iob)
 	set_bit(NVME_TCP_Q_POLLING, &queue->flags);
 	if (sk_can_busy_loop(sk) && skb_queue_empty_lockless(&sk->sk_receive_queue))
 		sk_busy_loop(sk, true);
-	nvme_tcp_try_recv(queue);
+	__nvme_tcp_try_recv(queue, iob);
+	queue->nr_polled += queue->nr_cqe;
 	clear_bit(NVME_TCP_Q_POLLING, &queue->flags);
 	return queue->nr_cqe;
 }
 
+static int nvme_tcp_stats_show(struct seq_file *m, void *unused)
+{
+	struct nvme_tcp_ctrl *ctrl = m->private;
+	int i;
+
+	seq_puts(m, "qid cpu sent completed polled avg_lat_ns max_lat_ns\n");
+	for (i = 0; i < ctrl->ctrl.queue_count; i++) {
+		struct nvme_tcp_queue *queue = &ctrl->queues[i];
+		u64 completed = READ_ONCE(queue->nr_completed);
+
+		if (!test_bit(NVME_TCP_Q_ALLOCATED, &queue->flags))
+			continue;
+
+		seq_printf(m, "%d %d %llu %llu %llu %llu %llu\n",
+			   i, queue->io_cpu, READ_ONCE(queue->nr_sent),
+			   completed, READ_ONCE(queue->nr_polled),
+			   completed ? div64_u64(READ_ONCE(queue->lat_total_ns),
+						 completed) : 0,
+			   READ_ONCE(queue->lat_max_ns));
+	}
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(nvme_tcp_stats);
+
 static int nvme_tcp_get_address(struct nvme_ctrl *ctrl, char *buf, int size)
 {
 	struct nvme_tcp_queue *queue = &to_tcp_ctrl(ctrl)->queues[0];
@@ -2639,6 +2769,9 @@ static struct nvme_ctrl *nvme_tcp_create_ctrl(struct device *dev,
 	dev_info(ctrl->ctrl.device, "new ctrl: NQN \"%s\", addr %pISp\n",
 		nvmf_ctrl_subsysnqn(&ctrl->ctrl), &ctrl->addr);
 
+	ctrl->debugfs_stats = debugfs_create_file(dev_name(ctrl->ctrl.device),
+			0400, nvme_tcp_debugfs, ctrl, &nvme_tcp_stats_fops);
+
 	mutex_lock(&nvme_tcp_ctrl_mutex);
 	list_add_tail(&ctrl->list, &nvme_tcp_ctrl_list);
 	mutex_unlock(&nvme_tcp_ctrl_mutex);
@@ -2677,6 +2810,7 @@ static int __init nvme_tcp_init_module(void)
 	if (!nvme_tcp_wq)
 		return -ENOMEM;
 
+	nvme_tcp_debugfs = debugfs_create_dir("nvme_tcp", NULL);
 	nvmf_register_transport(&nvme_tcp_transport);
 	return 0;
 }
@@ -2693,6 +2827,7 @@ static void __exit nvme_tcp_cleanup_module(void)
 	mutex_unlock(&nvme_tcp_ctrl_mutex);
 	flush_workqueue(nvme_delete_wq);
 
+	debugfs_remove(nvme_tcp_debugfs);
 	destroy_workqueue(nvme_tcp_wq);
 }
 
@@ -784,35 +784,24 @@ static inline bool more_used_split(const struct vring_virtqueue *vq)
 			vq->split.vring.used->idx);
 }
 
-static void *virtqueue_get_buf_ctx_split(struct virtqueue *_vq,
-					 unsigned int *len,
-					 void **ctx)
+/*
+ * Detach the next used buffer, the caller has checked more_used_split().
+ * Returns NULL if the ring is broken.
+ */
+static void *detach_used_buf_split(struct vring_virtqueue *vq,
+				   unsigned int *len, void **ctx)
 {
-	struct vring_virtqueue *vq = to_vvq(_vq);
 	void *ret;
 	unsigned int i;
 	u16 last_used;
 
-	START_USE(vq);
-
-	if (unlikely(vq->broken)) {
-		END_USE(vq);
-		return NULL;
-	}
-
-	if (!more_used_split(vq)) {
-		pr_debug("No more buffers in queue\n");
-		END_USE(vq);
-		return NULL;
-	}
-
 	/* Only get used array entries after they have been exposed by host. */
 	virtio_rmb(vq->weak_barriers);
 
 	last_used = (vq->last_used_idx & (vq->split.vring.num - 1));
-	i = virtio32_to_cpu(_vq->vdev,
+	i = virtio32_to_cpu(vq->vq.vdev,
 			vq->split.vring.used->ring[last_used].id);
-	*len = virtio32_to_cpu(_vq->vdev,
+	*len = virtio32_to_cpu(vq->vq.vdev,
 			vq->split.vring.used->ring[last_used].len);
 
 	if (unlikely(i >= vq->split.vring.num)) {
@@ -828,20 +817,78 @@ static void *virtqueue_get_buf_ctx_split(struct virtqueue *_vq,
 	ret = vq->split.desc_state[i].data;
 	detach_buf_split(vq, i, ctx);
 	vq->last_used_idx++;
+	return ret;
+}
+
+static void update_used_event_split(struct vring_virtqueue *vq)
+{
 	/* If we expect an interrupt for the next entry, tell host
 	 * by writing event index and flush out the write before
 	 * the read in the next get_buf call. */
 	if (!(vq->split.avail_flags_shadow & VRING_AVAIL_F_NO_INTERRUPT))
 		virtio_store_mb(vq->weak_barriers,
 				&vring_used_event(&vq->split.vring),
-				cpu_to_virtio16(_vq->vdev, vq->last_used_idx));
+				cpu_to_virtio16(vq->vq.vdev, vq->last_used_idx));
 
 	LAST_ADD_TIME_INVALID(vq);
+}
+
+static void *virtqueue_get_buf_ctx_split(struct virtqueue *_vq,
+					 unsigned int *len,
+					 void **ctx)
+{
+	struct vring_virtqueue *vq = to_vvq(_vq);
+	void *ret;
+
+	START_USE(vq);
+
+	if (unlikely(vq->broken)) {
+		END_USE(vq);
+		return NULL;
+	}
+
+	if (!more_used_split(vq)) {
+		pr_debug("No more buffers in queue\n");
+		END_USE(vq);
+		return NULL;
+	}
+
+	ret = detach_used_buf_split(vq, len, ctx);
+	if (!ret)
+		return NULL;
+	update_used_event_split(vq);
 
 	END_USE(vq);
 	return ret;
 }
 
+static unsigned int virtqueue_get_bufs_split(struct virtqueue *_vq,
+					     void **bufs, unsigned int *lens,
+					     unsigned int max)
+{
+	struct vring_virtqueue *vq = to_vvq(_vq);
+	unsigned int nr = 0;
+
+	START_USE(vq);
+
+	if (unlikely(vq->broken)) {
+		END_USE(vq);
+		return 0;
+	}
+
+	while (nr < max && more_used_split(vq)) {
+		bufs[nr] = detach_used_buf_split(vq, &lens[nr], NULL);
+		if (!bufs[nr])
+			break;
+		nr++;
+	}
+	if (nr)
+		update_used_event_split(vq);
+
+	END_USE(vq);
+	return nr;
+}
+
 static void virtqueue_disable_cb_split(struct virtqueue *_vq)
 {
 	struct vring_virtqueue *vq = to_vvq(_vq);
@@ -1612,28 +1659,17 @@ static inline bool more_used_packed(const struct vring_virtqueue *vq)
 	return is_used_desc_packed(vq, last_used, used_wrap_counter);
 }
 
-static void *virtqueue_get_buf_ctx_packed(struct virtqueue *_vq,
-					  unsigned int *len,
-					  void **ctx)
+/*
+ * Detach the next used buffer, the caller has checked more_used_packed().
+ * Returns NULL if the ring is broken.
+ */
+static void *detach_used_buf_packed(struct vring_virtqueue *vq,
+				    unsigned int *len, void **ctx)
 {
-	struct vring_virtqueue *vq = to_vvq(_vq);
 	u16 last_used, id, last_used_idx;
 	bool used_wrap_counter;
 	void *ret;
 
-	START_USE(vq);
-
-	if (unlikely(vq->broken)) {
-		END_USE(vq);
-		return NULL;
-	}
-
-	if (!more_used_packed(vq)) {
-		pr_debug("No more buffers in queue\n");
-		END_USE(vq);
-		return NULL;
-	}
-
 	/* Only get used elements after they have been exposed by host. */
 	virtio_rmb(vq->weak_barriers);
 
@@ -1664,7 +1700,11 @@ static void *virtqueue_get_buf_ctx_packed(struct virtqueue *_vq,
 
 	last_used = (last_used | (used_wrap_counter << VRING_PACKED_EVENT_F_WRAP_CTR));
 	WRITE_ONCE(vq->last_used_idx, last_used);
+	return ret;
+}
 
+static void update_used_event_packed(struct vring_virtqueue *vq)
+{
 	/*
 	 * If we expect an interrupt for the next entry, tell host
 	 * by writing event index and flush out the write before
@@ -1676,11 +1716,64 @@ static void *virtqueue_get_buf_ctx_packed(struct virtqueue *_vq,
 				cpu_to_le16(vq->last_used_idx));
 
 	LAST_ADD_TIME_INVALID(vq);
+}
+
+static void *virtqueue_get_buf_ctx_packed(struct virtqueue *_vq,
+					  unsigned int *len,
+					  void **ctx)
+{
+	struct vring_virtqueue *vq = to_vvq(_vq);
+	void *ret;
+
+	START_USE(vq);
+
+	if (unlikely(vq->broken)) {
+		END_USE(vq);
+		return NULL;
+	}
+
+	if (!more_used_packed(vq)) {
+		pr_debug("No more buffers in queue\n");
+		END_USE(vq);
+		return NULL;
+	}
+
+	ret = detach_used_buf_packed(vq, len, ctx);
+	if (!ret)
+		return NULL;
+	update_used_event_packed(vq);
 
 	END_USE(vq);
 	return ret;
 }
 
+static unsigned int virtqueue_get_bufs_packed(struct virtqueue *_vq,
+					      void **bufs, unsigned int *lens,
+					      unsigned int max)
+{
+	struct vring_virtqueue *vq = to_vvq(_vq);
+	unsigned int nr = 0;
+
+	START_USE(vq);
+
+	if (unlikely(vq->broken)) {
+		END_USE(vq);
+		return 0;
+	}
+
+	while (nr < max && more_used_packed(vq)) {
+		bufs[nr] = detach_used_buf_packed(vq, &lens[nr], NULL);
+		if (!bufs[nr])
+			break;
+		nr++;
+	}
+	if (nr)
+		update_used_event_packed(vq);
+
+	END_USE(vq);
+	return nr;
+}
+
 static void virtqueue_disable_cb_packed(struct virtqueue *_vq)
 {
 	struct vring_virtqueue *vq = to_vvq(_vq);
@@ -2296,6 +2389,32 @@ void *virtqueue_get_buf(struct virtqueue *_vq, unsigned int *len)
 	return virtqueue_get_buf_ctx(_vq, len, NULL);
 }
 EXPORT_SYMBOL_GPL(virtqueue_get_buf);
+
+/**
+ * virtqueue_get_bufs - get a batch of used buffers
+ * @_vq: the struct virtqueue we're talking about.
+ * @bufs: array filled with the "data" tokens of the used buffers
+ * @lens: array filled with the lengths written into the used buffers
+ * @max: number of entries in @bufs and @lens
+ *
+ * Like virtqueue_get_buf(), but takes up to @max used buffers in one go and
+ * tells the host about the new used index just once for all of them, rather
+ * than with a full barrier per buffer.
+ *
+ * Caller must ensure we don't call this with other virtqueue
+ * operations at the same time (except where noted).
+ *
+ * Returns the number of buffers stored in @bufs, 0 if there are none.
+ */
+unsigned int virtqueue_get_bufs(struct virtqueue *_vq, void **bufs,
+				unsigned int *lens, unsigned int max)
+{
+	struct vring_virtqueue *vq = to_vvq(_vq);
+
+	return vq->packed_ring ? virtqueue_get_bufs_packed(_vq, bufs, lens, max) :
+				 virtqueue_get_bufs_split(_vq, bufs, lens, max);
+}
+EXPORT_SYMBOL_GPL(virtqueue_get_bufs);
 /**
  * virtqueue_disable_cb - disable callbacks
  * @_vq: the struct virtqueue we're talking about.
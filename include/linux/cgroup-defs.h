@@ -25,6 +25,7 @@
 #ifdef CONFIG_CGROUPS
 
 struct cgroup;
+struct cgroup_bulk_stat;
 struct cgroup_root;
 struct cgroup_subsys;
 struct cgroup_taskset;
@@ -477,6 +478,21 @@ struct cgroup {
 	struct cgroup_rstat_cpu __percpu *rstat_cpu;
 	struct list_head rstat_css_list;
 
+	/*
+	 * Protects the global stats of this cgroup (->bstat, ->last_bstat
+	 * and whatever the controllers' ->css_rstat_flush() propagate),
+	 * which are written when flushing this cgroup and its children.
+	 */
+	raw_spinlock_t rstat_lock;
+
+	/*
+	 * Serializes cgroup_rstat_flush() calls on this cgroup.  Odd
+	 * ->rstat_flush_seq means a flush is in progress, so concurrent
+	 * readers can tell when they can piggyback on someone else's flush.
+	 */
+	struct mutex rstat_flush_mutex;
+	unsigned long rstat_flush_seq;
+
 	/* cgroup basic resource statistics */
 	struct cgroup_base_stat last_bstat;
 	struct cgroup_base_stat bstat;
@@ -657,6 +673,8 @@ struct cgroup_subsys {
 	void (*css_rstat_flush)(struct cgroup_subsys_state *css, int cpu);
 	int (*css_extra_stat_show)(struct seq_file *seq,
 				   struct cgroup_subsys_state *css);
+	void (*css_bulk_stat_fill)(struct cgroup_subsys_state *css,
+				   struct cgroup_bulk_stat *bs);
 
 	int (*can_attach)(struct cgroup_taskset *tset);
 	void (*cancel_attach)(struct cgroup_taskset *tset);
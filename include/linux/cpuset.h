@@ -73,6 +73,7 @@ extern void cpuset_update_active_cpus(void);
 extern void cpuset_wait_for_hotplug(void);
 extern void cpuset_read_lock(void);
 extern void cpuset_read_unlock(void);
+extern void cpuset_mark_dl_task(struct task_struct *p);
 extern void cpuset_cpus_allowed(struct task_struct *p, struct cpumask *mask);
 extern bool cpuset_cpus_allowed_fallback(struct task_struct *p);
 extern nodemask_t cpuset_mems_allowed(struct task_struct *p);
@@ -198,6 +199,7 @@ static inline void cpuset_wait_for_hotplug(void) { }
 
 static inline void cpuset_read_lock(void) { }
 static inline void cpuset_read_unlock(void) { }
+static inline void cpuset_mark_dl_task(struct task_struct *p) { }
 
 static inline void cpuset_cpus_allowed(struct task_struct *p,
 				       struct cpumask *mask)
@@ -404,6 +404,12 @@ struct module {
 	const s32 *gpl_crcs;
 	bool using_gplonly_symbols;
 
+#ifdef CONFIG_MODULE_SYMBOL_HASH
+	/* Entries of the module in the symbol hash tables */
+	struct mod_symhash_export *symhash_exports;
+	struct mod_symhash_ksym *symhash_ksyms;
+#endif
+
 #ifdef CONFIG_MODULE_SIG
 	/* Signature was verified. */
 	bool sig_ok;
@@ -23,6 +23,7 @@ void psi_memstall_enter(unsigned long *flags);
 void psi_memstall_leave(unsigned long *flags);
 
 int psi_show(struct seq_file *s, struct psi_group *group, enum psi_res res);
+int psi_read_totals(struct psi_group *group, u64 totals[NR_PSI_STATES - 1]);
 struct psi_trigger *psi_trigger_create(struct psi_group *group,
 			char *buf, enum psi_res res);
 void psi_trigger_destroy(struct psi_trigger *t);
@@ -64,6 +64,28 @@ TRACE_EVENT(module_free,
 	TP_printk("%s", __get_str(name))
 );
 
+TRACE_EVENT(module_load_phase,
+
+	TP_PROTO(const char *name, const char *phase, u64 duration),
+
+	TP_ARGS(name, phase, duration),
+
+	TP_STRUCT__entry(
+		__field(	u64,		duration	)
+		__string(	name,		name		)
+		__string(	phase,		phase		)
+	),
+
+	TP_fast_assign(
+		__entry->duration = duration;
+		__assign_str(name, name);
+		__assign_str(phase, phase);
+	),
+
+	TP_printk("%s %s %llu ns", __get_str(name), __get_str(phase),
+		  __entry->duration)
+);
+
 #ifdef CONFIG_MODULE_UNLOAD
 /* trace_module_get/put are only used if CONFIG_MODULE_UNLOAD is defined */
 
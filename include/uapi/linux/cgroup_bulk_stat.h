@@ -0,0 +1,55 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+#ifndef _UAPI_LINUX_CGROUP_BULK_STAT_H
+#define _UAPI_LINUX_CGROUP_BULK_STAT_H
+
+#include <linux/types.h>
+
+/*
+ * Reading "cgroup.bulk_stat" of a cgroup returns one struct
+ * cgroup_bulk_stat for the cgroup and for each of its live descendants, in
+ * pre-order.  All of them are read after a single flush of the subtree.
+ *
+ * Records start with their size, which only grows as fields get appended
+ * at the end, so that readers can step over records of a newer kernel and
+ * know which fields an older kernel didn't fill.
+ *
+ * @flags tells which groups of fields are valid: the io ones need the io
+ * controller to be enabled in the cgroup, the pressure ones need PSI.
+ * Times are in microseconds.
+ */
+#define CGROUP_BULK_STAT_CPU		(1U << 0)
+#define CGROUP_BULK_STAT_PRESSURE	(1U << 1)
+#define CGROUP_BULK_STAT_IO		(1U << 2)
+
+struct cgroup_bulk_stat {
+	__u32	size;
+	__u32	flags;
+	__u64	id;			/* as in name_to_handle_at() */
+	__u64	parent_id;		/* 0 for the cgroup being read */
+	__u32	depth;			/* below the cgroup being read */
+	__u32	__pad;
+
+	/* CGROUP_BULK_STAT_CPU, as in cpu.stat */
+	__u64	cpu_usage_usec;
+	__u64	cpu_user_usec;
+	__u64	cpu_system_usec;
+	__u64	cpu_force_idle_usec;
+
+	/* CGROUP_BULK_STAT_PRESSURE, the totals of the pressure files */
+	__u64	cpu_some_usec;
+	__u64	cpu_full_usec;
+	__u64	memory_some_usec;
+	__u64	memory_full_usec;
+	__u64	io_some_usec;
+	__u64	io_full_usec;
+
+	/* CGROUP_BULK_STAT_IO, io.stat summed over all the devices */
+	__u64	io_rbytes;
+	__u64	io_wbytes;
+	__u64	io_dbytes;
+	__u64	io_rios;
+	__u64	io_wios;
+	__u64	io_dios;
+};
+
+#endif /* _UAPI_LINUX_CGROUP_BULK_STAT_H */
@@ -38,10 +38,35 @@
  *
  *      It is only used if ublksrv set UBLK_F_NEED_GET_DATA flag
  *      while starting a ublk device.
+ *
+ * REGISTER_IO_BUF: only used with UBLK_F_SUPPORT_ZERO_COPY. Install the
+ *      pages of the request identified by q_id/tag as fixed buffer
+ *      'addr' of the io_uring instance the command is issued on. The
+ *      buffer table has to be registered as sparse beforehand, and the
+ *      slot must be empty. The buffer is addressed by offset from 0 and
+ *      can only be read for WRITE requests and filled for READ requests.
+ *      It is valid until the request is committed.
+ *
+ * UNREGISTER_IO_BUF: release fixed buffer 'addr' installed by
+ *      REGISTER_IO_BUF. The request is not completed until its buffer is
+ *      unregistered, and io_uring requests still using the buffer are done.
+ *
+ * BATCH_COMMIT_AND_FETCH: only used with UBLK_F_BATCH_IO, after the queue
+ *      is set up by FETCH_REQ. Payload is struct ublksrv_io_batch_cmd
+ *      instead of struct ublksrv_io_cmd. Results of up to
+ *      UBLK_BATCH_MAX_COMMIT requests are committed, and their io slots
+ *      are re-armed without owning a command each. The command completes
+ *      once requests arrive on re-armed slots: their tags are stored to
+ *      'fetch_buf', and cqe->res is the number of tags stored. It may be
+ *      0 if all incoming requests were requeued. One batch command can be
+ *      pending per queue.
  */
 #define	UBLK_IO_FETCH_REQ		0x20
 #define	UBLK_IO_COMMIT_AND_FETCH_REQ	0x21
 #define	UBLK_IO_NEED_GET_DATA	0x22
+#define	UBLK_IO_REGISTER_IO_BUF		0x23
+#define	UBLK_IO_UNREGISTER_IO_BUF	0x24
+#define	UBLK_IO_BATCH_COMMIT_AND_FETCH	0x25
 
 /* only ABORT means that no re-fetch */
 #define UBLK_IO_RES_OK			0
@@ -55,8 +80,10 @@
 #define UBLK_MAX_QUEUE_DEPTH	4096
 
 /*
- * zero copy requires 4k block size, and can remap ublk driver's io
- * request into ublksrv's vm space
+ * zero copy: request data isn't copied to/from ublksrv's io buffer. Instead
+ * ublksrv lends request pages to its io_uring as fixed buffer with
+ * UBLK_IO_REGISTER_IO_BUF, and does IO against them with READ_FIXED,
+ * WRITE_FIXED or SEND_ZC. 'addr' of FETCH commands is ignored.
  */
 #define UBLK_F_SUPPORT_ZERO_COPY	(1ULL << 0)
 
@@ -79,6 +106,12 @@
 
 #define UBLK_F_USER_RECOVERY_REISSUE	(1UL << 4)
 
+/*
+ * Commit and fetch requests in batches with UBLK_IO_BATCH_COMMIT_AND_FETCH,
+ * see above. Not compatible with UBLK_F_NEED_GET_DATA.
+ */
+#define UBLK_F_BATCH_IO		(1UL << 5)
+
 /* device state */
 #define UBLK_S_DEV_DEAD	0
 #define UBLK_S_DEV_LIVE	1
@@ -180,11 +213,38 @@ struct ublksrv_io_cmd {
 
 	/*
 	 * userspace buffer address in ublksrv daemon process, valid for
-	 * FETCH* command only
+	 * FETCH* command only; fixed buffer index for *REGISTER_IO_BUF
 	 */
 	__u64	addr;
 };
 
+struct ublksrv_io_batch_elem {
+	__u16	tag;
+	__u16	pad;
+	/* io result, same as ublksrv_io_cmd.result */
+	__s32	result;
+};
+
+/* fills up the 80 bytes command area of SQE128 */
+#define UBLK_BATCH_MAX_COMMIT	8
+
+/* issued to ublk driver via /dev/ublkcN with UBLK_IO_BATCH_COMMIT_AND_FETCH */
+struct ublksrv_io_batch_cmd {
+	__u16	q_id;
+
+	/* how many entries of 'commit' are valid */
+	__u16	nr_commit;
+	__u32	pad;
+
+	/*
+	 * userspace __u16 array receiving tags of fetched requests, it has
+	 * to hold queue_depth entries
+	 */
+	__u64	fetch_buf;
+
+	struct ublksrv_io_batch_elem	commit[UBLK_BATCH_MAX_COMMIT];
+};
+
 struct ublk_param_basic {
 #define UBLK_ATTR_READ_ONLY            (1 << 0)
 #define UBLK_ATTR_ROTATIONAL           (1 << 1)
@@ -9,6 +9,7 @@
 #include <linux/hugetlb.h>
 #include <linux/compat.h>
 #include <linux/io_uring.h>
+#include <linux/blk-mq.h>
 
 #include <uapi/linux/io_uring.h>
 
@@ -142,10 +143,14 @@ static void io_buffer_unmap(struct io_ring_ctx *ctx, struct io_mapped_ubuf **slo
 	unsigned int i;
 
 	if (imu != ctx->dummy_ubuf) {
-		for (i = 0; i < imu->nr_bvecs; i++)
-			unpin_user_page(imu->bvec[i].bv_page);
-		if (imu->acct_pages)
-			io_unaccount_mem(ctx, imu->acct_pages);
+		if (imu->release) {
+			imu->release(imu->priv);
+		} else {
+			for (i = 0; i < imu->nr_bvecs; i++)
+				unpin_user_page(imu->bvec[i].bv_page);
+			if (imu->acct_pages)
+				io_unaccount_mem(ctx, imu->acct_pages);
+		}
 		kvfree(imu);
 	}
 	*slot = NULL;
@@ -228,7 +233,7 @@ static __cold void io_rsrc_node_ref_zero(struct percpu_ref *ref)
 	node->done = true;
 
 	/* if we are mid-quiesce then do not delay */
-	if (node->rsrc_data->quiesce)
+	if (node->rsrc_data->quiesce || node->nodelay)
 		delay = 0;
 
 	while (!list_empty(&ctx->rsrc_ref_list)) {
@@ -1020,6 +1025,90 @@ static void io_rsrc_buf_put(struct io_ring_ctx *ctx, struct io_rsrc_put *prsrc)
 	prsrc->buf = NULL;
 }
 
+/*
+ * Install the pages of a block request as fixed buffer @index, so that
+ * READ_FIXED/WRITE_FIXED/SEND_ZC can transfer to and from them without a
+ * bounce copy. The slot must have been left empty with a sparse buffer
+ * registration. @release(@priv) is called once the buffer is unregistered
+ * and the last request that may reference it has completed; the owner must
+ * keep @rq and its pages alive until then.
+ */
+int io_buffer_register_bvec(struct io_ring_ctx *ctx, struct request *rq,
+			    void (*release)(void *), void *priv,
+			    unsigned int index)
+	__must_hold(&ctx->uring_lock)
+{
+	struct io_mapped_ubuf *imu;
+	struct req_iterator rq_iter;
+	struct bio_vec bv;
+	unsigned int nr_bvecs = 0;
+
+	if (!ctx->buf_data)
+		return -ENXIO;
+	if (index >= ctx->nr_user_bufs)
+		return -EINVAL;
+	index = array_index_nospec(index, ctx->nr_user_bufs);
+	if (ctx->user_bufs[index] != ctx->dummy_ubuf)
+		return -EBUSY;
+
+	rq_for_each_bvec(bv, rq, rq_iter)
+		nr_bvecs++;
+
+	imu = kvmalloc(struct_size(imu, bvec, nr_bvecs), GFP_KERNEL);
+	if (!imu)
+		return -ENOMEM;
+
+	nr_bvecs = 0;
+	rq_for_each_bvec(bv, rq, rq_iter)
+		imu->bvec[nr_bvecs++] = bv;
+
+	/* kernel buffers are addressed by offset, not by user address */
+	imu->ubuf = 0;
+	imu->ubuf_end = blk_rq_bytes(rq);
+	imu->nr_bvecs = nr_bvecs;
+	imu->acct_pages = 0;
+	imu->release = release;
+	imu->priv = priv;
+	/* data of a WRITE request is only read, READ is only filled in */
+	imu->ddir = rq_data_dir(rq);
+
+	*io_get_tag_slot(ctx->buf_data, index) = 0;
+	ctx->user_bufs[index] = imu;
+	return 0;
+}
+
+int io_buffer_unregister_bvec(struct io_ring_ctx *ctx, unsigned int index)
+	__must_hold(&ctx->uring_lock)
+{
+	struct io_mapped_ubuf *imu;
+	int ret;
+
+	if (!ctx->buf_data)
+		return -ENXIO;
+	if (index >= ctx->nr_user_bufs)
+		return -EINVAL;
+	index = array_index_nospec(index, ctx->nr_user_bufs);
+	imu = ctx->user_bufs[index];
+	if (imu == ctx->dummy_ubuf || !imu->release)
+		return -EINVAL;
+
+	ret = io_rsrc_node_switch_start(ctx);
+	if (ret)
+		return ret;
+	ret = io_queue_rsrc_removal(ctx->buf_data, index, ctx->rsrc_node, imu);
+	if (ret)
+		return ret;
+
+	/*
+	 * ->release() completes the block request, so don't let the put
+	 * work sit on the usual batching delay.
+	 */
+	ctx->rsrc_node->nodelay = true;
+	ctx->user_bufs[index] = ctx->dummy_ubuf;
+	io_rsrc_node_switch(ctx, ctx->buf_data);
+	return 0;
+}
+
 void __io_sqe_buffers_unregister(struct io_ring_ctx *ctx)
 {
 	unsigned int i;
@@ -1079,6 +1168,9 @@ static bool headpage_already_acct(struct io_ring_ctx *ctx, struct page **pages,
 	for (i = 0; i < ctx->nr_user_bufs; i++) {
 		struct io_mapped_ubuf *imu = ctx->user_bufs[i];
 
+		/* lent kernel pages aren't pinned or accounted by us */
+		if (imu->release)
+			continue;
 		for (j = 0; j < imu->nr_bvecs; j++) {
 			if (!PageCompound(imu->bvec[j].bv_page))
 				continue;
@@ -1232,6 +1324,7 @@ static int io_sqe_buffer_register(struct io_ring_ctx *ctx, struct iovec *iov,
 	imu->ubuf = (unsigned long) iov->iov_base;
 	imu->ubuf_end = imu->ubuf + iov->iov_len;
 	imu->nr_bvecs = nr_pages;
+	imu->release = NULL;
 	*pimu = imu;
 	ret = 0;
 done:
@@ -1328,6 +1421,18 @@ int io_import_fixed(int ddir, struct iov_iter *iter,
 	offset = buf_addr - imu->ubuf;
 	iov_iter_bvec(iter, ddir, imu->bvec, imu->nr_bvecs, offset + len);
 
+	/*
+	 * Kernel buffers come straight from a bio, so segments can have any
+	 * size and the page-sized skipping below doesn't apply.
+	 */
+	if (imu->release) {
+		if (unlikely(ddir != imu->ddir))
+			return -EFAULT;
+		if (offset)
+			iov_iter_advance(iter, offset);
+		return 0;
+	}
+
 	if (offset) {
 		/*
 		 * Don't use iov_iter_advance() here, as it's really slow for
@@ -4,6 +4,8 @@
 
 #include <net/af_unix.h>
 
+struct request;
+
 #define IO_RSRC_TAG_TABLE_SHIFT	(PAGE_SHIFT - 3)
 #define IO_RSRC_TAG_TABLE_MAX	(1U << IO_RSRC_TAG_TABLE_SHIFT)
 #define IO_RSRC_TAG_TABLE_MASK	(IO_RSRC_TAG_TABLE_MAX - 1)
@@ -43,6 +45,8 @@ struct io_rsrc_node {
 	struct io_rsrc_data		*rsrc_data;
 	struct llist_node		llist;
 	bool				done;
+	/* put without delay, a kernel buffer owner waits for ->release() */
+	bool				nodelay;
 };
 
 struct io_mapped_ubuf {
@@ -50,6 +54,14 @@ struct io_mapped_ubuf {
 	u64		ubuf_end;
 	unsigned int	nr_bvecs;
 	unsigned long	acct_pages;
+	/*
+	 * Only set for buffers lent to us by a kernel driver, see
+	 * io_buffer_register_bvec(). Such a buffer only allows transfers
+	 * in @ddir, and @release is called once no request uses it.
+	 */
+	void		(*release)(void *);
+	void		*priv;
+	int		ddir;
 	struct bio_vec	bvec[];
 };
 
@@ -68,6 +80,11 @@ int io_import_fixed(int ddir, struct iov_iter *iter,
 			   struct io_mapped_ubuf *imu,
 			   u64 buf_addr, size_t len);
 
+int io_buffer_register_bvec(struct io_ring_ctx *ctx, struct request *rq,
+			    void (*release)(void *), void *priv,
+			    unsigned int index);
+int io_buffer_unregister_bvec(struct io_ring_ctx *ctx, unsigned int index);
+
 void __io_sqe_buffers_unregister(struct io_ring_ctx *ctx);
 int io_sqe_buffers_unregister(struct io_ring_ctx *ctx);
 int io_sqe_buffers_register(struct io_ring_ctx *ctx, void __user *arg,
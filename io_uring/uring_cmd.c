@@ -156,3 +156,35 @@ int io_uring_cmd_import_fixed(u64 ubuf, unsigned long len, int rw,
 	return io_import_fixed(rw, iter, req->imu, ubuf, len);
 }
 EXPORT_SYMBOL_GPL(io_uring_cmd_import_fixed);
+
+/*
+ * Lend the pages of @rq to the ring that issued @ioucmd as fixed buffer
+ * @index, see io_buffer_register_bvec().
+ */
+int io_uring_cmd_buffer_register_bvec(struct io_uring_cmd *ioucmd,
+				      struct request *rq,
+				      void (*release)(void *), void *priv,
+				      unsigned int index, unsigned int issue_flags)
+{
+	struct io_ring_ctx *ctx = cmd_to_io_kiocb(ioucmd)->ctx;
+	int ret;
+
+	io_ring_submit_lock(ctx, issue_flags);
+	ret = io_buffer_register_bvec(ctx, rq, release, priv, index);
+	io_ring_submit_unlock(ctx, issue_flags);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(io_uring_cmd_buffer_register_bvec);
+
+int io_uring_cmd_buffer_unregister(struct io_uring_cmd *ioucmd,
+				   unsigned int index, unsigned int issue_flags)
+{
+	struct io_ring_ctx *ctx = cmd_to_io_kiocb(ioucmd)->ctx;
+	int ret;
+
+	io_ring_submit_lock(ctx, issue_flags);
+	ret = io_buffer_unregister_bvec(ctx, index);
+	io_ring_submit_unlock(ctx, issue_flags);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(io_uring_cmd_buffer_unregister);
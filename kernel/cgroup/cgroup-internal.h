@@ -81,6 +81,10 @@ struct cgroup_file_ctx {
 	struct {
 		struct cgroup_pidlist	*pidlist;
 	} procs1;
+
+	struct {
+		struct cgroup_subsys_state *pos;
+	} bulk_stat;
 };
 
 /*
@@ -274,6 +278,7 @@ int cgroup_rstat_init(struct cgroup *cgrp);
 void cgroup_rstat_exit(struct cgroup *cgrp);
 void cgroup_rstat_boot(void);
 void cgroup_base_stat_cputime_show(struct seq_file *seq);
+void cgroup_base_stat_bulk_fill(struct cgroup *cgrp, struct cgroup_bulk_stat *bs);
 
 /*
  * namespace.c
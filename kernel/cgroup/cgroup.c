@@ -58,6 +58,7 @@
 #include <linux/fs_parser.h>
 #include <linux/sched/cputime.h>
 #include <linux/psi.h>
+#include <linux/cgroup_bulk_stat.h>
 #include <net/sock.h>
 
 #define CREATE_TRACE_POINTS
@@ -5176,6 +5177,124 @@ static void *cgroup_threads_start(struct seq_file *s, loff_t *pos)
 	return __cgroup_procs_start(s, pos, 0);
 }
 
+static void cgroup_bulk_stat_release(struct kernfs_open_file *of)
+{
+	struct cgroup_file_ctx *ctx = of->priv;
+
+	if (ctx->bulk_stat.pos)
+		css_put(ctx->bulk_stat.pos);
+}
+
+/*
+ * The position is pinned, not kept online, so that the walk can go on past
+ * a cgroup removed while it was being read.  css_next_descendant_pre()
+ * copes with that.
+ */
+static void *cgroup_bulk_stat_next(struct seq_file *s, void *v, loff_t *pos)
+{
+	struct kernfs_open_file *of = s->private;
+	struct cgroup_subsys_state *root = seq_css(s);
+	struct cgroup_file_ctx *ctx = of->priv;
+	struct cgroup_subsys_state *prev = ctx->bulk_stat.pos;
+	struct cgroup_subsys_state *next = prev;
+
+	if (pos)
+		(*pos)++;
+
+	rcu_read_lock();
+	do {
+		next = css_next_descendant_pre(next, root);
+	} while (next && !css_tryget_online(next));
+	rcu_read_unlock();
+
+	ctx->bulk_stat.pos = next;
+	css_put(prev);
+	return next;
+}
+
+static void *cgroup_bulk_stat_start(struct seq_file *s, loff_t *pos)
+{
+	struct kernfs_open_file *of = s->private;
+	struct cgroup_subsys_state *root = seq_css(s);
+	struct cgroup_file_ctx *ctx = of->priv;
+
+	/* as for cgroup.procs, !0 *pos resumes where the last read stopped */
+	if (*pos)
+		return ctx->bulk_stat.pos;
+
+	if (ctx->bulk_stat.pos)
+		css_put(ctx->bulk_stat.pos);
+
+	/* one flush for the whole subtree, the records only read the result */
+	cgroup_rstat_flush(root->cgroup);
+
+	css_get(root);
+	ctx->bulk_stat.pos = root;
+	return root;
+}
+
+#ifdef CONFIG_PSI
+static void cgroup_bulk_stat_pressure(struct cgroup *cgrp,
+				      struct cgroup_bulk_stat *bs)
+{
+	u64 totals[NR_PSI_STATES - 1];
+
+	if (!cgroup_psi_enabled() ||
+	    psi_read_totals(cgroup_psi(cgrp), totals))
+		return;
+
+	bs->cpu_some_usec = div_u64(totals[PSI_CPU_SOME], NSEC_PER_USEC);
+	bs->cpu_full_usec = div_u64(totals[PSI_CPU_FULL], NSEC_PER_USEC);
+	bs->memory_some_usec = div_u64(totals[PSI_MEM_SOME], NSEC_PER_USEC);
+	bs->memory_full_usec = div_u64(totals[PSI_MEM_FULL], NSEC_PER_USEC);
+	bs->io_some_usec = div_u64(totals[PSI_IO_SOME], NSEC_PER_USEC);
+	bs->io_full_usec = div_u64(totals[PSI_IO_FULL], NSEC_PER_USEC);
+	bs->flags |= CGROUP_BULK_STAT_PRESSURE;
+}
+#else
+static void cgroup_bulk_stat_pressure(struct cgroup *cgrp,
+				      struct cgroup_bulk_stat *bs)
+{
+}
+#endif
+
+static int cgroup_bulk_stat_show(struct seq_file *s, void *v)
+{
+	struct cgroup *root = seq_css(s)->cgroup;
+	struct cgroup_subsys_state *css = v;
+	struct cgroup *cgrp = css->cgroup;
+	struct cgroup_bulk_stat bs = {
+		.size	= sizeof(bs),
+		.id	= cgroup_id(cgrp),
+		.depth	= cgrp->level - root->level,
+	};
+	struct cgroup_subsys *ss;
+	int ssid;
+
+	if (cgrp != root)
+		bs.parent_id = cgroup_id(cgroup_parent(cgrp));
+
+	cgroup_base_stat_bulk_fill(cgrp, &bs);
+	cgroup_bulk_stat_pressure(cgrp, &bs);
+
+	for_each_subsys(ss, ssid) {
+		struct cgroup_subsys_state *ss_css;
+
+		if (!ss->css_bulk_stat_fill)
+			continue;
+
+		ss_css = cgroup_tryget_css(cgrp, ss);
+		if (!ss_css)
+			continue;
+
+		ss->css_bulk_stat_fill(ss_css, &bs);
+		css_put(ss_css);
+	}
+
+	seq_write(s, &bs, sizeof(bs));
+	return 0;
+}
+
 static ssize_t cgroup_threads_write(struct kernfs_open_file *of,
 				    char *buf, size_t nbytes, loff_t off)
 {
@@ -5239,6 +5358,13 @@ static struct cftype cgroup_base_files[] = {
 		.name = "cgroup.stat",
 		.seq_show = cgroup_stat_show,
 	},
+	{
+		.name = "cgroup.bulk_stat",
+		.release = cgroup_bulk_stat_release,
+		.seq_start = cgroup_bulk_stat_start,
+		.seq_next = cgroup_bulk_stat_next,
+		.seq_show = cgroup_bulk_stat_show,
+	},
 	{
 		.name = "cgroup.freeze",
 		.flags = CFTYPE_NOT_ON_ROOT,
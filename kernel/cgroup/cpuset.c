@@ -196,6 +196,13 @@ struct cpuset {
 	/* Invalid partition error code, not lock protected */
 	enum prs_errcode prs_err;
 
+	/*
+	 * Set when a SCHED_DEADLINE task may be in the cpuset, cleared by
+	 * rebuild_root_domains() when it finds none.  Cpusets without one
+	 * are skipped when the root domain bandwidth is recomputed.
+	 */
+	bool dl_tasks;
+
 	/* Handle for cpuset.cpus.partition */
 	struct cgroup_file partition_file;
 };
@@ -335,6 +342,7 @@ static struct cpuset top_cpuset = {
 	.flags = ((1 << CS_ONLINE) | (1 << CS_CPU_EXCLUSIVE) |
 		  (1 << CS_MEM_EXCLUSIVE)),
 	.partition_root_state = PRS_ROOT,
+	.dl_tasks = true,
 };
 
 /**
@@ -415,6 +423,23 @@ void cpuset_read_unlock(void)
 	percpu_up_read(&cpuset_rwsem);
 }
 
+/**
+ * cpuset_mark_dl_task - note that a task became a SCHED_DEADLINE one
+ * @p: the task
+ *
+ * Make rebuild_root_domains() walk the tasks of the cpuset of @p again.
+ * __sched_setscheduler() holds cpuset_rwsem for reading when it switches
+ * @p to SCHED_DEADLINE, so this can't race with rebuild_root_domains()
+ * clearing the mark.  Priority inheritance boosts tasks without it, but a
+ * boosted task has no bandwidth of its own to account.
+ */
+void cpuset_mark_dl_task(struct task_struct *p)
+{
+	rcu_read_lock();
+	WRITE_ONCE(task_cs(p)->dl_tasks, true);
+	rcu_read_unlock();
+}
+
 static DEFINE_SPINLOCK(callback_lock);
 
 static struct workqueue_struct *cpuset_migrate_mm_wq;
@@ -1062,17 +1087,27 @@ static int generate_sched_domains(cpumask_var_t **domains,
 	return ndoms;
 }
 
-static void update_tasks_root_domain(struct cpuset *cs)
+/*
+ * Add the bandwidth of the deadline tasks of @cs to their root domains.
+ * Returns whether @cs has any.
+ */
+static bool update_tasks_root_domain(struct cpuset *cs)
 {
 	struct css_task_iter it;
 	struct task_struct *task;
+	bool dl_tasks = false;
 
 	css_task_iter_start(&cs->css, 0, &it);
 
-	while ((task = css_task_iter_next(&it)))
+	while ((task = css_task_iter_next(&it))) {
+		if (!dl_task(task))
+			continue;
 		dl_add_task_root_domain(task);
+		dl_tasks = true;
+	}
 
 	css_task_iter_end(&it);
+	return dl_tasks;
 }
 
 static void rebuild_root_domains(void)
@@ -1099,11 +1134,23 @@ static void rebuild_root_domains(void)
 			continue;
 		}
 
+		/*
+		 * Walking the tasks of every cpuset is what makes a rebuild
+		 * slow with many tasks, and almost none are deadline ones.
+		 */
+		if (!READ_ONCE(cs->dl_tasks))
+			continue;
+
 		css_get(&cs->css);
 
 		rcu_read_unlock();
 
-		update_tasks_root_domain(cs);
+		/*
+		 * See cpuset_mark_dl_task() for when a cpuset found without
+		 * deadline tasks has to be walked again.
+		 */
+		if (!update_tasks_root_domain(cs))
+			WRITE_ONCE(cs->dl_tasks, false);
 
 		rcu_read_lock();
 		css_put(&cs->css);
@@ -1198,6 +1245,34 @@ void rebuild_sched_domains(void)
 	cpus_read_unlock();
 }
 
+/*
+ * A single change of the cpuset configuration may need the sched domains
+ * rebuilt several times: changing a partition root updates its parent,
+ * its siblings and its children, each of which used to rebuild all the
+ * sched domains.  The update paths only call mark_sched_domains_dirty(),
+ * and the sched domains are rebuilt once by
+ * rebuild_sched_domains_if_dirty() before cpuset_rwsem is released.
+ *
+ * Protected by cpuset_rwsem.
+ */
+static bool sched_domains_dirty;
+
+static void mark_sched_domains_dirty(void)
+{
+	percpu_rwsem_assert_held(&cpuset_rwsem);
+	sched_domains_dirty = true;
+}
+
+static void rebuild_sched_domains_if_dirty(void)
+{
+	percpu_rwsem_assert_held(&cpuset_rwsem);
+
+	if (sched_domains_dirty) {
+		sched_domains_dirty = false;
+		rebuild_sched_domains_locked();
+	}
+}
+
 /**
  * update_tasks_cpumask - Update the cpumasks of tasks in the cpuset.
  * @cs: the cpuset in which each task's cpus_allowed mask needs to be changed
@@ -1509,7 +1584,7 @@ static int update_parent_subparts_cpumask(struct cpuset *cs, int cmd,
 
 	/*
 	 * Set or clear CS_SCHED_LOAD_BALANCE when partcmd_update, if necessary.
-	 * rebuild_sched_domains_locked() may be called.
+	 * The sched domains may be marked dirty.
 	 */
 	if (old_prs != new_prs) {
 		if (old_prs == PRS_ISOLATED)
@@ -1677,7 +1752,7 @@ static void update_cpumasks_hier(struct cpuset *cs, struct tmpmasks *tmp,
 	rcu_read_unlock();
 
 	if (need_rebuild_sched_domains)
-		rebuild_sched_domains_locked();
+		mark_sched_domains_dirty();
 }
 
 /**
@@ -2132,7 +2207,7 @@ static int update_relax_domain_level(struct cpuset *cs, s64 val)
 		cs->relax_domain_level = val;
 		if (!cpumask_empty(cs->cpus_allowed) &&
 		    is_sched_load_balance(cs))
-			rebuild_sched_domains_locked();
+			mark_sched_domains_dirty();
 	}
 
 	return 0;
@@ -2198,7 +2273,7 @@ static int update_flag(cpuset_flagbits_t bit, struct cpuset *cs,
 	spin_unlock_irq(&callback_lock);
 
 	if (!cpumask_empty(trialcs->cpus_allowed) && balance_flag_changed)
-		rebuild_sched_domains_locked();
+		mark_sched_domains_dirty();
 
 	if (spread_flag_changed)
 		update_tasks_flags(cs);
@@ -2218,7 +2293,6 @@ static int update_flag(cpuset_flagbits_t bit, struct cpuset *cs,
 static int update_prstate(struct cpuset *cs, int new_prs)
 {
 	int err = PERR_NONE, old_prs = cs->partition_root_state;
-	bool sched_domain_rebuilt = false;
 	struct cpuset *parent = parent_cs(cs);
 	struct tmpmasks tmpmask;
 
@@ -2267,15 +2341,13 @@ static int update_prstate(struct cpuset *cs, int new_prs)
 			 * error unless the system is running out of memory.
 			 */
 			update_flag(CS_SCHED_LOAD_BALANCE, cs, 0);
-			sched_domain_rebuilt = true;
 		}
 	} else if (old_prs && new_prs) {
 		/*
 		 * A change in load balance state only, no change in cpumasks.
 		 */
 		update_flag(CS_SCHED_LOAD_BALANCE, cs, (new_prs != PRS_ISOLATED));
-		sched_domain_rebuilt = true;
-		goto out;	/* Sched domain is rebuilt in update_flag() */
+		goto out;	/* Sched domains are marked dirty in update_flag() */
 	} else {
 		/*
 		 * Switching back to member is always allowed even if it
@@ -2301,7 +2373,6 @@ static int update_prstate(struct cpuset *cs, int new_prs)
 		if (!is_sched_load_balance(cs)) {
 			/* Make sure load balance is on */
 			update_flag(CS_SCHED_LOAD_BALANCE, cs, 1);
-			sched_domain_rebuilt = true;
 		}
 	}
 
@@ -2310,8 +2381,7 @@ static int update_prstate(struct cpuset *cs, int new_prs)
 	if (parent->child_ecpus_count)
 		update_sibling_cpumasks(parent, cs, &tmpmask);
 
-	if (!sched_domain_rebuilt)
-		rebuild_sched_domains_locked();
+	mark_sched_domains_dirty();
 out:
 	/*
 	 * Make partition invalid if an error happen
@@ -2529,6 +2599,9 @@ static void cpuset_attach(struct cgroup_taskset *tset)
 		 */
 		WARN_ON_ONCE(set_cpus_allowed_ptr(task, cpus_attach));
 
+		if (dl_task(task))
+			WRITE_ONCE(cs->dl_tasks, true);
+
 		cpuset_change_task_nodemask(task, &cpuset_attach_nodemask_to);
 		cpuset_update_task_spread_flag(cs, task);
 	}
@@ -2633,6 +2706,7 @@ static int cpuset_write_u64(struct cgroup_subsys_state *css, struct cftype *cft,
 		retval = -EINVAL;
 		break;
 	}
+	rebuild_sched_domains_if_dirty();
 out_unlock:
 	percpu_up_write(&cpuset_rwsem);
 	cpus_read_unlock();
@@ -2659,6 +2733,7 @@ static int cpuset_write_s64(struct cgroup_subsys_state *css, struct cftype *cft,
 		retval = -EINVAL;
 		break;
 	}
+	rebuild_sched_domains_if_dirty();
 out_unlock:
 	percpu_up_write(&cpuset_rwsem);
 	cpus_read_unlock();
@@ -2724,6 +2799,7 @@ static ssize_t cpuset_write_resmask(struct kernfs_open_file *of,
 	}
 
 	free_cpuset(trialcs);
+	rebuild_sched_domains_if_dirty();
 out_unlock:
 	percpu_up_write(&cpuset_rwsem);
 	cpus_read_unlock();
@@ -2878,6 +2954,7 @@ static ssize_t sched_partition_write(struct kernfs_open_file *of, char *buf,
 		goto out_unlock;
 
 	retval = update_prstate(cs, val);
+	rebuild_sched_domains_if_dirty();
 out_unlock:
 	percpu_up_write(&cpuset_rwsem);
 	cpus_read_unlock();
@@ -3151,7 +3228,7 @@ static int cpuset_css_online(struct cgroup_subsys_state *css)
 /*
  * If the cpuset being removed has its flag 'sched_load_balance'
  * enabled, then simulate turning sched_load_balance off, which
- * will call rebuild_sched_domains_locked(). That is not needed
+ * will rebuild the sched domains. That is not needed
  * in the default hierarchy where only changes in partition
  * will cause repartitioning.
  *
@@ -3183,6 +3260,7 @@ static void cpuset_css_offline(struct cgroup_subsys_state *css)
 	cpuset_dec();
 	clear_bit(CS_ONLINE, &cs->flags);
 
+	rebuild_sched_domains_if_dirty();
 	percpu_up_write(&cpuset_rwsem);
 	cpus_read_unlock();
 }
@@ -3486,6 +3564,12 @@ static void cpuset_hotplug_update_tasks(struct cpuset *cs, struct tmpmasks *tmp)
 		hotplug_update_tasks_legacy(cs, &new_cpus, &new_mems,
 					    cpus_updated, mems_updated);
 
+	/* hotplug rebuilds the sched domains once all cpusets are updated */
+	if (sched_domains_dirty) {
+		sched_domains_dirty = false;
+		cpuset_force_rebuild();
+	}
+
 	percpu_up_write(&cpuset_rwsem);
 }
 
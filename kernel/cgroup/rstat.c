@@ -2,12 +2,12 @@
 #include "cgroup-internal.h"
 
 #include <linux/sched/cputime.h>
+#include <linux/cgroup_bulk_stat.h>
 
 #include <linux/bpf.h>
 #include <linux/btf.h>
 #include <linux/btf_ids.h>
 
-static DEFINE_SPINLOCK(cgroup_rstat_lock);
 static DEFINE_PER_CPU(raw_spinlock_t, cgroup_rstat_cpu_lock);
 
 static void cgroup_base_stat_flush(struct cgroup *cgrp, int cpu);
@@ -170,51 +170,63 @@ __weak noinline void bpf_rstat_flush(struct cgroup *cgrp,
 
 __diag_pop();
 
-/* see cgroup_rstat_flush() */
-static void cgroup_rstat_flush_locked(struct cgroup *cgrp, bool may_sleep)
-	__releases(&cgroup_rstat_lock) __acquires(&cgroup_rstat_lock)
+/*
+ * Flush @pos on @cpu.  This propagates @pos's per-cpu deltas to its global
+ * stats and its global delta to its parent's, so both their rstat_locks
+ * are held.  Locks are always taken child first.
+ */
+static void cgroup_rstat_flush_one(struct cgroup *pos, int cpu)
 {
-	int cpu;
+	struct cgroup *parent = cgroup_parent(pos);
+	struct cgroup_subsys_state *css;
 
-	lockdep_assert_held(&cgroup_rstat_lock);
+	raw_spin_lock(&pos->rstat_lock);
+	if (parent)
+		raw_spin_lock_nested(&parent->rstat_lock, SINGLE_DEPTH_NESTING);
 
-	for_each_possible_cpu(cpu) {
+	cgroup_base_stat_flush(pos, cpu);
+	bpf_rstat_flush(pos, parent, cpu);
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(css, &pos->rstat_css_list, rstat_css_node)
+		css->ss->css_rstat_flush(css, cpu);
+	rcu_read_unlock();
+
+	if (parent)
+		raw_spin_unlock(&parent->rstat_lock);
+	raw_spin_unlock(&pos->rstat_lock);
+}
+
+/*
+ * See cgroup_rstat_flush().  There is no global lock: a cgroup is popped
+ * from the updated tree of a cpu and flushed under that cpu's
+ * cgroup_rstat_cpu_lock, so once a flusher finds a cgroup off the tree,
+ * its updates on that cpu have been propagated.  Flushers of disjoint
+ * subtrees only meet on the cpu locks, and only for as long as it takes
+ * to flush their own subtree on that cpu.
+ */
+static void __cgroup_rstat_flush(struct cgroup *cgrp, bool may_sleep)
+{
+	int cpu;
+
+	/*
+	 * Start with the local cpu so that concurrent flushers don't all
+	 * walk the cpus in lockstep, contending on the same cpu lock.
+	 */
+	for_each_cpu_wrap(cpu, cpu_possible_mask, raw_smp_processor_id()) {
 		raw_spinlock_t *cpu_lock = per_cpu_ptr(&cgroup_rstat_cpu_lock,
 						       cpu);
 		struct cgroup *pos = NULL;
 		unsigned long flags;
 
-		/*
-		 * The _irqsave() is needed because cgroup_rstat_lock is
-		 * spinlock_t which is a sleeping lock on PREEMPT_RT. Acquiring
-		 * this lock with the _irq() suffix only disables interrupts on
-		 * a non-PREEMPT_RT kernel. The raw_spinlock_t below disables
-		 * interrupts on both configurations. The _irqsave() ensures
-		 * that interrupts are always disabled and later restored.
-		 */
 		raw_spin_lock_irqsave(cpu_lock, flags);
-		while ((pos = cgroup_rstat_cpu_pop_updated(pos, cgrp, cpu))) {
-			struct cgroup_subsys_state *css;
-
-			cgroup_base_stat_flush(pos, cpu);
-			bpf_rstat_flush(pos, cgroup_parent(pos), cpu);
-
-			rcu_read_lock();
-			list_for_each_entry_rcu(css, &pos->rstat_css_list,
-						rstat_css_node)
-				css->ss->css_rstat_flush(css, cpu);
-			rcu_read_unlock();
-		}
+		while ((pos = cgroup_rstat_cpu_pop_updated(pos, cgrp, cpu)))
+			cgroup_rstat_flush_one(pos, cpu);
 		raw_spin_unlock_irqrestore(cpu_lock, flags);
 
 		/* if @may_sleep, play nice and yield if necessary */
-		if (may_sleep && (need_resched() ||
-				  spin_needbreak(&cgroup_rstat_lock))) {
-			spin_unlock_irq(&cgroup_rstat_lock);
-			if (!cond_resched())
-				cpu_relax();
-			spin_lock_irq(&cgroup_rstat_lock);
-		}
+		if (may_sleep)
+			cond_resched();
 	}
 }
 
@@ -229,15 +241,37 @@ static void cgroup_rstat_flush_locked(struct cgroup *cgrp, bool may_sleep)
  * This also gets all cgroups in the subtree including @cgrp off the
  * ->updated_children lists.
  *
+ * Concurrent callers on the same @cgrp don't redo the work: if a whole
+ * flush of @cgrp started and completed while a caller was waiting for
+ * ->rstat_flush_mutex, that flush covers all the updates made before the
+ * call and the caller returns right away.
+ *
  * This function may block.
  */
 void cgroup_rstat_flush(struct cgroup *cgrp)
 {
+	unsigned long seq;
+
 	might_sleep();
 
-	spin_lock_irq(&cgroup_rstat_lock);
-	cgroup_rstat_flush_locked(cgrp, true);
-	spin_unlock_irq(&cgroup_rstat_lock);
+	/*
+	 * A flush in progress may have already gone past the cpus we
+	 * updated stats on, wait for the next one to complete.  Pairs with
+	 * the smp_mb() after incrementing the seq below.
+	 */
+	smp_mb();
+	seq = (READ_ONCE(cgrp->rstat_flush_seq) + 3) & ~1UL;
+
+	mutex_lock(&cgrp->rstat_flush_mutex);
+	if (ULONG_CMP_GE(cgrp->rstat_flush_seq, seq))
+		goto out_unlock;
+
+	WRITE_ONCE(cgrp->rstat_flush_seq, cgrp->rstat_flush_seq + 1);
+	smp_mb();
+	__cgroup_rstat_flush(cgrp, true);
+	WRITE_ONCE(cgrp->rstat_flush_seq, cgrp->rstat_flush_seq + 1);
+out_unlock:
+	mutex_unlock(&cgrp->rstat_flush_mutex);
 }
 
 /**
@@ -248,37 +282,34 @@ void cgroup_rstat_flush(struct cgroup *cgrp)
  */
 void cgroup_rstat_flush_irqsafe(struct cgroup *cgrp)
 {
-	unsigned long flags;
-
-	spin_lock_irqsave(&cgroup_rstat_lock, flags);
-	cgroup_rstat_flush_locked(cgrp, false);
-	spin_unlock_irqrestore(&cgroup_rstat_lock, flags);
+	__cgroup_rstat_flush(cgrp, false);
 }
 
 /**
  * cgroup_rstat_flush_hold - flush stats in @cgrp's subtree and hold
  * @cgrp: target cgroup
  *
- * Flush stats in @cgrp's subtree and prevent further flushes.  Must be
- * paired with cgroup_rstat_flush_release().
+ * Flush stats in @cgrp's subtree and prevent further flushes into @cgrp's
+ * global stats, so that they can be read consistently.  Must be paired
+ * with cgroup_rstat_flush_release().
  *
  * This function may block.
  */
 void cgroup_rstat_flush_hold(struct cgroup *cgrp)
-	__acquires(&cgroup_rstat_lock)
+	__acquires(&cgrp->rstat_lock)
 {
-	might_sleep();
-	spin_lock_irq(&cgroup_rstat_lock);
-	cgroup_rstat_flush_locked(cgrp, true);
+	cgroup_rstat_flush(cgrp);
+	raw_spin_lock_irq(&cgrp->rstat_lock);
 }
 
 /**
  * cgroup_rstat_flush_release - release cgroup_rstat_flush_hold()
+ * @cgrp: cgroup passed to the matching cgroup_rstat_flush_hold()
  */
-void cgroup_rstat_flush_release(void)
-	__releases(&cgroup_rstat_lock)
+void cgroup_rstat_flush_release(struct cgroup *cgrp)
+	__releases(&cgrp->rstat_lock)
 {
-	spin_unlock_irq(&cgroup_rstat_lock);
+	raw_spin_unlock_irq(&cgrp->rstat_lock);
 }
 
 int cgroup_rstat_init(struct cgroup *cgrp)
@@ -292,6 +323,9 @@ int cgroup_rstat_init(struct cgroup *cgrp)
 			return -ENOMEM;
 	}
 
+	raw_spin_lock_init(&cgrp->rstat_lock);
+	mutex_init(&cgrp->rstat_flush_mutex);
+
 	/* ->updated_children list is self terminated */
 	for_each_possible_cpu(cpu) {
 		struct cgroup_rstat_cpu *rstatc = cgroup_rstat_cpu(cgrp, cpu);
@@ -487,51 +521,82 @@ static void root_cgroup_cputime(struct cgroup_base_stat *bstat)
 	}
 }
 
-void cgroup_base_stat_cputime_show(struct seq_file *seq)
+/*
+ * Read the cputime of @cgrp into @bstat, with utime and stime scaled to
+ * sum_exec_runtime.  @flush is false when the caller already flushed the
+ * subtree @cgrp is in.
+ */
+static void cgroup_base_stat_cputime_read(struct cgroup *cgrp, bool flush,
+					  struct cgroup_base_stat *bstat)
 {
-	struct cgroup *cgrp = seq_css(seq)->cgroup;
-	u64 usage, utime, stime;
-	struct cgroup_base_stat bstat;
-#ifdef CONFIG_SCHED_CORE
-	u64 forceidle_time;
-#endif
+	memset(bstat, 0, sizeof(*bstat));
+
+	if (!cgroup_parent(cgrp)) {
+		root_cgroup_cputime(bstat);
+		return;
+	}
 
-	if (cgroup_parent(cgrp)) {
+	if (flush)
 		cgroup_rstat_flush_hold(cgrp);
-		usage = cgrp->bstat.cputime.sum_exec_runtime;
-		cputime_adjust(&cgrp->bstat.cputime, &cgrp->prev_cputime,
-			       &utime, &stime);
-#ifdef CONFIG_SCHED_CORE
-		forceidle_time = cgrp->bstat.forceidle_sum;
-#endif
-		cgroup_rstat_flush_release();
-	} else {
-		root_cgroup_cputime(&bstat);
-		usage = bstat.cputime.sum_exec_runtime;
-		utime = bstat.cputime.utime;
-		stime = bstat.cputime.stime;
+	else
+		raw_spin_lock_irq(&cgrp->rstat_lock);
+
+	bstat->cputime.sum_exec_runtime = cgrp->bstat.cputime.sum_exec_runtime;
+	cputime_adjust(&cgrp->bstat.cputime, &cgrp->prev_cputime,
+		       &bstat->cputime.utime, &bstat->cputime.stime);
 #ifdef CONFIG_SCHED_CORE
-		forceidle_time = bstat.forceidle_sum;
+	bstat->forceidle_sum = cgrp->bstat.forceidle_sum;
 #endif
-	}
+	cgroup_rstat_flush_release(cgrp);
+}
 
-	do_div(usage, NSEC_PER_USEC);
-	do_div(utime, NSEC_PER_USEC);
-	do_div(stime, NSEC_PER_USEC);
+void cgroup_base_stat_cputime_show(struct seq_file *seq)
+{
+	struct cgroup *cgrp = seq_css(seq)->cgroup;
+	struct cgroup_base_stat bstat;
+	u64 usage, utime, stime;
 #ifdef CONFIG_SCHED_CORE
-	do_div(forceidle_time, NSEC_PER_USEC);
+	u64 forceidle_time;
 #endif
 
+	cgroup_base_stat_cputime_read(cgrp, true, &bstat);
+	usage = div_u64(bstat.cputime.sum_exec_runtime, NSEC_PER_USEC);
+	utime = div_u64(bstat.cputime.utime, NSEC_PER_USEC);
+	stime = div_u64(bstat.cputime.stime, NSEC_PER_USEC);
+
 	seq_printf(seq, "usage_usec %llu\n"
 		   "user_usec %llu\n"
 		   "system_usec %llu\n",
 		   usage, utime, stime);
 
 #ifdef CONFIG_SCHED_CORE
+	forceidle_time = div_u64(bstat.forceidle_sum, NSEC_PER_USEC);
 	seq_printf(seq, "core_sched.force_idle_usec %llu\n", forceidle_time);
 #endif
 }
 
+/**
+ * cgroup_base_stat_bulk_fill - fill the cpu fields of a bulk stat record
+ * @cgrp: cgroup to read
+ * @bs: record to fill
+ *
+ * The caller must have flushed a subtree @cgrp is in.
+ */
+void cgroup_base_stat_bulk_fill(struct cgroup *cgrp, struct cgroup_bulk_stat *bs)
+{
+	struct cgroup_base_stat bstat;
+
+	cgroup_base_stat_cputime_read(cgrp, false, &bstat);
+	bs->cpu_usage_usec = div_u64(bstat.cputime.sum_exec_runtime,
+				     NSEC_PER_USEC);
+	bs->cpu_user_usec = div_u64(bstat.cputime.utime, NSEC_PER_USEC);
+	bs->cpu_system_usec = div_u64(bstat.cputime.stime, NSEC_PER_USEC);
+#ifdef CONFIG_SCHED_CORE
+	bs->cpu_force_idle_usec = div_u64(bstat.forceidle_sum, NSEC_PER_USEC);
+#endif
+	bs->flags |= CGROUP_BULK_STAT_CPU;
+}
+
 /* Add bpf kfuncs for cgroup_rstat_updated() and cgroup_rstat_flush() */
 BTF_SET8_START(bpf_rstat_kfunc_ids)
 BTF_ID_FLAGS(func, cgroup_rstat_updated)
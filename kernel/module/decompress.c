@@ -11,6 +11,8 @@
 #include <linux/slab.h>
 #include <linux/sysfs.h>
 #include <linux/vmalloc.h>
+#include <linux/workqueue.h>
+#include <asm/unaligned.h>
 
 #include "internal.h"
 
@@ -58,7 +60,7 @@ static struct page *module_get_next_page(struct load_info *info)
 /*
  * Calculate length of the header which consists of signature, header
  * flags, time stamp and operating system ID (10 bytes total), plus
- * an optional filename.
+ * an optional extra field and filename.
  */
 static size_t module_gzip_header_len(const u8 *buf, size_t size)
 {
@@ -68,6 +70,14 @@ static size_t module_gzip_header_len(const u8 *buf, size_t size)
 	if (size < len || memcmp(buf, signature, sizeof(signature)))
 		return 0;
 
+	if (buf[3] & 0x04) {
+		if (size < len + 2)
+			return 0;
+		len += 2 + get_unaligned_le16(buf + len);
+		if (len > size)
+			return 0;
+	}
+
 	if (buf[3] & 0x08) {
 		do {
 			/*
@@ -82,13 +92,248 @@ static size_t module_gzip_header_len(const u8 *buf, size_t size)
 	return len;
 }
 
+/*
+ * A module compressed as a series of independent gzip members, each of
+ * them recording its own size in a "BC" extra subfield the way bgzip(1)
+ * does, can be decompressed in parallel: the size of the decompressed
+ * data of each member is in its trailer, so all the members know where
+ * their output goes before any of them is inflated.  Smaller modules are
+ * inflated by the loading task, one member after the other.
+ */
+#define MODULE_GZIP_PARALLEL_MIN	(1024 * 1024)
+#define MODULE_GZIP_MAX_WORKERS		8
+
+struct module_gzip_chunk {
+	const u8 *in;
+	size_t in_len;
+	size_t out_off;
+	size_t out_len;
+};
+
+struct module_gzip_worker {
+	struct work_struct work;
+	const struct module_gzip_chunk *chunks;
+	unsigned int nr_chunks;
+	unsigned int first;
+	unsigned int stride;
+	void *out;
+	int error;
+};
+
+/* Size of the gzip member at @buf from its "BC" subfield, 0 if none */
+static size_t module_gzip_member_size(const u8 *buf, size_t size)
+{
+	const u8 *p, *end;
+
+	if (size < 12 || !(buf[3] & 0x04))
+		return 0;
+
+	p = buf + 12;
+	end = p + get_unaligned_le16(buf + 10);
+	if (end > buf + size)
+		return 0;
+
+	while (p + 4 <= end) {
+		size_t len = get_unaligned_le16(p + 2);
+
+		if (p[0] == 'B' && p[1] == 'C' && len == 2 && p + 6 <= end)
+			return get_unaligned_le16(p + 4) + 1;
+		p += 4 + len;
+	}
+
+	return 0;
+}
+
+/*
+ * Split the module in its gzip members, filling @chunks if not NULL.
+ * Returns the number of members, 0 if the module isn't made of members
+ * recording their size, or a negative error if it is but one of them is
+ * corrupted.
+ */
+static int module_gzip_chunks(const u8 *buf, size_t size,
+			      struct module_gzip_chunk *chunks,
+			      size_t *out_size)
+{
+	size_t off = 0, total = 0;
+	int nr = 0;
+
+	while (off < size) {
+		size_t member = module_gzip_member_size(buf + off, size - off);
+		size_t hdr_len = module_gzip_header_len(buf + off, size - off);
+		size_t out_len;
+
+		if (!member)
+			return off ? -EINVAL : 0;
+		if (!hdr_len || member > size - off || member < hdr_len + 8)
+			return -EINVAL;
+
+		/* ISIZE, the size of the decompressed data modulo 2^32 */
+		out_len = get_unaligned_le32(buf + off + member - 4);
+		if (total + out_len > INT_MAX)
+			return -EFBIG;
+
+		if (chunks) {
+			chunks[nr].in = buf + off + hdr_len;
+			chunks[nr].in_len = member - hdr_len - 8;
+			chunks[nr].out_off = total;
+			chunks[nr].out_len = out_len;
+		}
+
+		total += out_len;
+		off += member;
+		nr++;
+	}
+
+	*out_size = total;
+	return nr;
+}
+
+static int module_gzip_inflate_chunk(struct z_stream_s *s,
+				     const struct module_gzip_chunk *chunk,
+				     void *out)
+{
+	int rc;
+
+	/* bgzip ends the file with an empty member */
+	if (!chunk->out_len)
+		return 0;
+
+	rc = zlib_inflateReset(s);
+	if (rc != Z_OK)
+		return -EINVAL;
+
+	s->next_in = chunk->in;
+	s->avail_in = chunk->in_len;
+	s->next_out = out + chunk->out_off;
+	s->avail_out = chunk->out_len;
+
+	rc = zlib_inflate(s, Z_FINISH);
+	if (rc != Z_STREAM_END || s->avail_out) {
+		pr_err("decompression failed with status %d\n", rc);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static void module_gzip_worker_fn(struct work_struct *work)
+{
+	struct module_gzip_worker *worker =
+		container_of(work, struct module_gzip_worker, work);
+	struct z_stream_s s = { 0 };
+	unsigned int i;
+
+	s.workspace = kmalloc(zlib_inflate_workspacesize(), GFP_KERNEL);
+	if (!s.workspace) {
+		worker->error = -ENOMEM;
+		return;
+	}
+
+	if (zlib_inflateInit2(&s, -MAX_WBITS) != Z_OK) {
+		worker->error = -EINVAL;
+		goto out;
+	}
+
+	for (i = worker->first; i < worker->nr_chunks; i += worker->stride) {
+		worker->error = module_gzip_inflate_chunk(&s,
+							  &worker->chunks[i],
+							  worker->out);
+		if (worker->error)
+			break;
+	}
+
+	zlib_inflateEnd(&s);
+out:
+	kfree(s.workspace);
+}
+
+static ssize_t module_gzip_decompress_chunks(struct load_info *info,
+					     const u8 *buf, size_t size,
+					     int nr_chunks)
+{
+	struct module_gzip_worker *workers;
+	struct module_gzip_chunk *chunks;
+	unsigned int nr_workers, n_pages, i;
+	size_t out_size;
+	ssize_t retval;
+
+	chunks = kvmalloc_array(nr_chunks, sizeof(*chunks), GFP_KERNEL);
+	if (!chunks)
+		return -ENOMEM;
+
+	module_gzip_chunks(buf, size, chunks, &out_size);
+
+	/* Allocate all the pages upfront, the chunks are inflated in place */
+	n_pages = DIV_ROUND_UP(out_size, PAGE_SIZE);
+	if (n_pages > info->max_pages) {
+		retval = module_extend_max_pages(info,
+						 n_pages - info->max_pages);
+		if (retval)
+			goto out;
+	}
+
+	while (info->used_pages < n_pages) {
+		struct page *page = module_get_next_page(info);
+
+		if (IS_ERR(page)) {
+			retval = PTR_ERR(page);
+			goto out;
+		}
+	}
+
+	info->hdr = vmap(info->pages, info->used_pages, VM_MAP, PAGE_KERNEL);
+	if (!info->hdr) {
+		retval = -ENOMEM;
+		goto out;
+	}
+
+	nr_workers = min_t(unsigned int,
+			   min_t(unsigned int, nr_chunks, num_online_cpus()),
+			   MODULE_GZIP_MAX_WORKERS);
+
+	workers = kcalloc(nr_workers, sizeof(*workers), GFP_KERNEL);
+	if (!workers) {
+		retval = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < nr_workers; i++) {
+		INIT_WORK(&workers[i].work, module_gzip_worker_fn);
+		workers[i].chunks = chunks;
+		workers[i].nr_chunks = nr_chunks;
+		workers[i].first = i;
+		workers[i].stride = nr_workers;
+		workers[i].out = info->hdr;
+		if (i)
+			queue_work(system_unbound_wq, &workers[i].work);
+	}
+
+	/* The loading task takes its share instead of just waiting */
+	module_gzip_worker_fn(&workers[0].work);
+
+	retval = out_size;
+	for (i = 0; i < nr_workers; i++) {
+		if (i)
+			flush_work(&workers[i].work);
+		if (workers[i].error)
+			retval = workers[i].error;
+	}
+
+	kfree(workers);
+out:
+	kvfree(chunks);
+	return retval;
+}
+
 static ssize_t module_gzip_decompress(struct load_info *info,
 				      const void *buf, size_t size)
 {
 	struct z_stream_s s = { 0 };
-	size_t new_size = 0;
+	size_t new_size = 0, chunked_size;
 	size_t gzip_hdr_len;
+	void *out = NULL;
 	ssize_t retval;
+	int members;
 	int rc;
 
 	gzip_hdr_len = module_gzip_header_len(buf, size);
@@ -97,6 +342,15 @@ static ssize_t module_gzip_decompress(struct load_info *info,
 		return -EINVAL;
 	}
 
+	rc = module_gzip_chunks(buf, size, NULL, &chunked_size);
+	if (rc < 0) {
+		pr_err("corrupted gzip member in module\n");
+		return rc;
+	}
+	if (rc && chunked_size >= MODULE_GZIP_PARALLEL_MIN)
+		return module_gzip_decompress_chunks(info, buf, size, rc);
+	members = rc ?: 1;
+
 	s.next_in = buf + gzip_hdr_len;
 	s.avail_in = size - gzip_hdr_len;
 
@@ -111,21 +365,59 @@ static ssize_t module_gzip_decompress(struct load_info *info,
 		goto out;
 	}
 
-	do {
-		struct page *page = module_get_next_page(info);
+	for (;;) {
+		unsigned int avail_out;
 
-		if (!page) {
-			retval = -ENOMEM;
-			goto out_inflate_end;
+		if (!s.avail_out) {
+			struct page *page;
+
+			if (out) {
+				kunmap_local(out);
+				out = NULL;
+			}
+
+			page = module_get_next_page(info);
+			if (IS_ERR(page)) {
+				retval = PTR_ERR(page);
+				goto out_inflate_end;
+			}
+
+			out = kmap_local_page(page);
+			s.next_out = out;
+			s.avail_out = PAGE_SIZE;
 		}
 
-		s.next_out = kmap_local_page(page);
-		s.avail_out = PAGE_SIZE;
+		avail_out = s.avail_out;
 		rc = zlib_inflate(&s, 0);
-		kunmap_local(s.next_out);
+		new_size += avail_out - s.avail_out;
+
+		if (rc == Z_OK)
+			continue;
+		if (rc != Z_STREAM_END || !--members)
+			break;
+
+		/*
+		 * The next member goes on in the same page, after the CRC32
+		 * and ISIZE trailer of this one and its own header.
+		 */
+		gzip_hdr_len = 0;
+		if (s.avail_in >= 8)
+			gzip_hdr_len = module_gzip_header_len(s.next_in + 8,
+							      s.avail_in - 8);
+		if (!gzip_hdr_len) {
+			rc = Z_DATA_ERROR;
+			break;
+		}
+
+		s.next_in += 8 + gzip_hdr_len;
+		s.avail_in -= 8 + gzip_hdr_len;
+		rc = zlib_inflateReset(&s);
+		if (rc != Z_OK)
+			break;
+	}
 
-		new_size += PAGE_SIZE - s.avail_out;
-	} while (rc == Z_OK);
+	if (out)
+		kunmap_local(out);
 
 	if (rc != Z_STREAM_END) {
 		pr_err("decompression failed with status %d\n", rc);
@@ -141,6 +433,7 @@ static ssize_t module_gzip_decompress(struct load_info *info,
 	kfree(s.workspace);
 	return retval;
 }
+
 #elif CONFIG_MODULE_COMPRESS_XZ
 #include <linux/xz.h>
 #define MODULE_COMPRESSION	xz
@@ -222,7 +515,10 @@ int module_decompress(struct load_info *info, const void *buf, size_t size)
 		goto err;
 	}
 
-	info->hdr = vmap(info->pages, info->used_pages, VM_MAP, PAGE_KERNEL);
+	/* Decompressing in parallel maps the pages upfront */
+	if (!info->hdr)
+		info->hdr = vmap(info->pages, info->used_pages, VM_MAP,
+				 PAGE_KERNEL);
 	if (!info->hdr) {
 		error = -ENOMEM;
 		goto err;
@@ -12,6 +12,7 @@
 #include <linux/rculist.h>
 #include <linux/rcupdate.h>
 #include <linux/mm.h>
+#include <linux/jump_label.h>
 
 #ifndef ARCH_SHF_SMALL
 #define ARCH_SHF_SMALL 0
@@ -53,7 +54,25 @@ extern const struct kernel_symbol __stop___ksymtab_gpl[];
 extern const s32 __start___kcrctab[];
 extern const s32 __start___kcrctab_gpl[];
 
+static inline const char *kernel_symbol_name(const struct kernel_symbol *sym)
+{
+#ifdef CONFIG_HAVE_ARCH_PREL32_RELOCATIONS
+	return offset_to_ptr(&sym->name_offset);
+#else
+	return sym->name;
+#endif
+}
+
 #include <linux/dynamic_debug.h>
+/* Stages of load_module() timed for the module_load_phase tracepoint */
+enum mod_load_phase {
+	MOD_PHASE_READ,
+	MOD_PHASE_DECOMPRESS,
+	MOD_PHASE_VERIFY,
+	MOD_PHASE_RELOCATE,
+	MOD_PHASE_NR
+};
+
 struct load_info {
 	const char *name;
 	/* pointer to module in temporary copy, freed at end of load_module() */
@@ -76,6 +95,7 @@ struct load_info {
 	struct {
 		unsigned int sym, str, mod, vers, info, pcpu;
 	} index;
+	u64 phase_ns[MOD_PHASE_NR];
 };
 
 enum mod_license {
@@ -99,6 +119,7 @@ struct find_symbol_arg {
 int mod_verify_sig(const void *mod, struct load_info *info);
 int try_to_force_load(struct module *mod, const char *reason);
 bool find_symbol(struct find_symbol_arg *fsa);
+bool __find_symbol(struct find_symbol_arg *fsa);
 struct module *find_module_all(const char *name, size_t len, bool even_unformed);
 int cmp_name(const void *name, const void *sym);
 long module_get_offset(struct module *mod, unsigned int *size, Elf_Shdr *sechdr,
@@ -219,6 +240,68 @@ static inline struct module *mod_find(unsigned long addr, struct mod_tree_root *
 }
 #endif /* CONFIG_MODULES_TREE_LOOKUP */
 
+#ifdef CONFIG_MODULE_SYMBOL_HASH
+DECLARE_STATIC_KEY_FALSE(mod_symhash_ready);
+
+static inline bool mod_symhash_enabled(void)
+{
+	return static_branch_likely(&mod_symhash_ready);
+}
+
+u32 mod_symhash_name(const char *name);
+bool mod_symhash_find_symbol(struct find_symbol_arg *fsa);
+int mod_symhash_insert(struct module *mod);
+void mod_symhash_remove(struct module *mod);
+void mod_symhash_free(struct module *mod);
+#ifdef CONFIG_KALLSYMS
+void mod_symhash_insert_kallsyms(struct module *mod);
+unsigned long mod_symhash_kallsyms_lookup(struct module *mod, const char *name,
+					  u32 hash);
+
+static inline bool mod_symhash_has_kallsyms(struct module *mod)
+{
+	return smp_load_acquire(&mod->symhash_ksyms);
+}
+#endif
+#else /* !CONFIG_MODULE_SYMBOL_HASH */
+
+static inline bool mod_symhash_enabled(void)
+{
+	return false;
+}
+
+static inline u32 mod_symhash_name(const char *name)
+{
+	return 0;
+}
+
+static inline bool mod_symhash_find_symbol(struct find_symbol_arg *fsa)
+{
+	return false;
+}
+
+static inline int mod_symhash_insert(struct module *mod)
+{
+	return 0;
+}
+
+static inline void mod_symhash_remove(struct module *mod) { }
+static inline void mod_symhash_free(struct module *mod) { }
+static inline void mod_symhash_insert_kallsyms(struct module *mod) { }
+
+static inline unsigned long mod_symhash_kallsyms_lookup(struct module *mod,
+							const char *name,
+							u32 hash)
+{
+	return 0;
+}
+
+static inline bool mod_symhash_has_kallsyms(struct module *mod)
+{
+	return false;
+}
+#endif /* CONFIG_MODULE_SYMBOL_HASH */
+
 void module_enable_ro(const struct module *mod, bool after_init);
 void module_enable_nx(const struct module *mod);
 void module_enable_x(const struct module *mod);
@@ -461,6 +461,7 @@ static unsigned long __module_kallsyms_lookup_name(const char *name)
 {
 	struct module *mod;
 	char *colon;
+	u32 hash = 0;
 
 	colon = strnchr(name, MODULE_NAME_LEN, ':');
 	if (colon) {
@@ -470,12 +471,22 @@ static unsigned long __module_kallsyms_lookup_name(const char *name)
 		return 0;
 	}
 
+	if (mod_symhash_enabled())
+		hash = mod_symhash_name(name);
+
+	/*
+	 * Newest module first.  Those which have their symbols hashed are
+	 * looked up there, the others, e.g. still loading, are walked.
+	 */
 	list_for_each_entry_rcu(mod, &modules, list) {
 		unsigned long ret;
 
 		if (mod->state == MODULE_STATE_UNFORMED)
 			continue;
-		ret = find_kallsyms_symbol_value(mod, name);
+		if (mod_symhash_has_kallsyms(mod))
+			ret = mod_symhash_kallsyms_lookup(mod, name, hash);
+		else
+			ret = find_kallsyms_symbol_value(mod, name);
 		if (ret)
 			return ret;
 	}
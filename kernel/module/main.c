@@ -244,15 +244,6 @@ static __maybe_unused void *any_section_objs(const struct load_info *info,
 #define symversion(base, idx) ((base != NULL) ? ((base) + (idx)) : NULL)
 #endif
 
-static const char *kernel_symbol_name(const struct kernel_symbol *sym)
-{
-#ifdef CONFIG_HAVE_ARCH_PREL32_RELOCATIONS
-	return offset_to_ptr(&sym->name_offset);
-#else
-	return sym->name;
-#endif
-}
-
 static const char *kernel_symbol_namespace(const struct kernel_symbol *sym)
 {
 #ifdef CONFIG_HAVE_ARCH_PREL32_RELOCATIONS
@@ -291,11 +282,8 @@ static bool find_exported_symbol_in_section(const struct symsearch *syms,
 	return true;
 }
 
-/*
- * Find an exported symbol and return it, along with, (optional) crc and
- * (optional) module which owns it.  Needs preempt disabled or module_mutex.
- */
-bool find_symbol(struct find_symbol_arg *fsa)
+/* Walk the exported symbols of the kernel and of each module in turn */
+bool __find_symbol(struct find_symbol_arg *fsa)
 {
 	static const struct symsearch arr[] = {
 		{ __start___ksymtab, __stop___ksymtab, __start___kcrctab,
@@ -307,8 +295,6 @@ bool find_symbol(struct find_symbol_arg *fsa)
 	struct module *mod;
 	unsigned int i;
 
-	module_assert_mutex_or_preempt();
-
 	for (i = 0; i < ARRAY_SIZE(arr); i++)
 		if (find_exported_symbol_in_section(&arr[i], NULL, fsa))
 			return true;
@@ -331,10 +317,29 @@ bool find_symbol(struct find_symbol_arg *fsa)
 				return true;
 	}
 
-	pr_debug("Failed to find symbol %s\n", fsa->name);
 	return false;
 }
 
+/*
+ * Find an exported symbol and return it, along with, (optional) crc and
+ * (optional) module which owns it.  Needs preempt disabled or module_mutex.
+ */
+bool find_symbol(struct find_symbol_arg *fsa)
+{
+	bool found;
+
+	module_assert_mutex_or_preempt();
+
+	if (mod_symhash_enabled())
+		found = mod_symhash_find_symbol(fsa);
+	else
+		found = __find_symbol(fsa);
+
+	if (!found)
+		pr_debug("Failed to find symbol %s\n", fsa->name);
+	return found;
+}
+
 /*
  * Search for module by name: must hold module_mutex (or preempt disabled
  * for read-only access).
@@ -1180,10 +1185,12 @@ static void free_module(struct module *mod)
 	/* Unlink carefully: kallsyms could be walking list. */
 	list_del_rcu(&mod->list);
 	mod_tree_remove(mod);
+	mod_symhash_remove(mod);
 	/* Remove this module from bug list, this uses list_del_rcu */
 	module_bug_cleanup(mod);
 	/* Wait for RCU-sched synchronizing before releasing mod->list and buglist. */
 	synchronize_rcu();
+	mod_symhash_free(mod);
 	if (try_add_tainted_module(mod))
 		pr_err("%s: adding tainted module to the unloaded tainted modules list failed.\n",
 		       mod->name);
@@ -2441,6 +2448,7 @@ static noinline int do_init_module(struct module *mod)
 {
 	int ret = 0;
 	struct mod_initfree *freeinit;
+	u64 start;
 
 	freeinit = kmalloc(sizeof(*freeinit), GFP_KERNEL);
 	if (!freeinit) {
@@ -2449,10 +2457,12 @@ static noinline int do_init_module(struct module *mod)
 	}
 	freeinit->module_init = mod->init_layout.base;
 
+	start = ktime_get_ns();
 	do_mod_ctors(mod);
 	/* Start the module */
 	if (mod->init != NULL)
 		ret = do_one_initcall(mod->init);
+	trace_module_load_phase(mod->name, "init", ktime_get_ns() - start);
 	if (ret < 0) {
 		goto fail_free_freeinit;
 	}
@@ -2492,6 +2502,7 @@ static noinline int do_init_module(struct module *mod)
 #ifdef CONFIG_KALLSYMS
 	/* Switch to core kallsyms now init is done: kallsyms may be walking! */
 	rcu_assign_pointer(mod->kallsyms, &mod->core_kallsyms);
+	mod_symhash_insert_kallsyms(mod);
 #endif
 	module_enable_ro(mod, true);
 	mod_tree_remove_init(mod);
@@ -2600,6 +2611,11 @@ static int complete_formation(struct module *mod, struct load_info *info)
 	if (err < 0)
 		goto out;
 
+	/* Make the exports visible to find_symbol() */
+	err = mod_symhash_insert(mod);
+	if (err)
+		goto out;
+
 	/* These rely on module_mutex for list integrity. */
 	module_bug_finalize(info->hdr, info->sechdrs, mod);
 	module_cfi_finalize(info->hdr, info->sechdrs, mod);
@@ -2664,6 +2680,27 @@ static int unknown_module_param_cb(char *param, char *val, const char *modname,
 	return 0;
 }
 
+static const char * const mod_load_phase_names[MOD_PHASE_NR] = {
+	[MOD_PHASE_READ]	= "read",
+	[MOD_PHASE_DECOMPRESS]	= "decompress",
+	[MOD_PHASE_VERIFY]	= "verify",
+	[MOD_PHASE_RELOCATE]	= "relocate",
+};
+
+static void trace_load_phases(struct module *mod, const struct load_info *info)
+{
+	int i;
+
+	if (!trace_module_load_phase_enabled())
+		return;
+
+	for (i = 0; i < MOD_PHASE_NR; i++) {
+		if (info->phase_ns[i])
+			trace_module_load_phase(mod->name, mod_load_phase_names[i],
+						info->phase_ns[i]);
+	}
+}
+
 /*
  * Allocate and load the module: note that size of section 0 is always
  * zero, and we rely on this for optional sections.
@@ -2674,6 +2711,7 @@ static int load_module(struct load_info *info, const char __user *uargs,
 	struct module *mod;
 	long err = 0;
 	char *after_dashes;
+	u64 start;
 
 	/*
 	 * Do the signature check (if any) first. All that
@@ -2687,7 +2725,9 @@ static int load_module(struct load_info *info, const char __user *uargs,
 	 * off the sig length at the end of the module, making
 	 * checks against info->len more correct.
 	 */
+	start = ktime_get_ns();
 	err = module_sig_check(info, flags);
+	info->phase_ns[MOD_PHASE_VERIFY] = ktime_get_ns() - start;
 	if (err)
 		goto free_copy;
 
@@ -2779,6 +2819,7 @@ static int load_module(struct load_info *info, const char __user *uargs,
 	setup_modinfo(mod, info);
 
 	/* Fix up syms, so that st_value is a pointer to location. */
+	start = ktime_get_ns();
 	err = simplify_symbols(mod, info);
 	if (err < 0)
 		goto free_modinfo;
@@ -2790,6 +2831,7 @@ static int load_module(struct load_info *info, const char __user *uargs,
 	err = post_relocation(mod, info);
 	if (err < 0)
 		goto free_modinfo;
+	info->phase_ns[MOD_PHASE_RELOCATE] = ktime_get_ns() - start;
 
 	flush_module_icache(mod);
 
@@ -2844,6 +2886,7 @@ static int load_module(struct load_info *info, const char __user *uargs,
 	free_copy(info, flags);
 
 	/* Done! */
+	trace_load_phases(mod, info);
 	trace_module_load(mod);
 
 	return do_init_module(mod);
@@ -2879,9 +2922,11 @@ static int load_module(struct load_info *info, const char __user *uargs,
 	/* Unlink carefully: kallsyms could be walking list. */
 	list_del_rcu(&mod->list);
 	mod_tree_remove(mod);
+	mod_symhash_remove(mod);
 	wake_up_all(&module_wq);
 	/* Wait for RCU-sched synchronizing before releasing mod->list. */
 	synchronize_rcu();
+	mod_symhash_free(mod);
 	mutex_unlock(&module_mutex);
  free_module:
 	/* Free lock-classes; relies on the preceding sync_rcu() */
@@ -2898,6 +2943,7 @@ SYSCALL_DEFINE3(init_module, void __user *, umod,
 {
 	int err;
 	struct load_info info = { };
+	u64 start;
 
 	err = may_init_module();
 	if (err)
@@ -2906,9 +2952,11 @@ SYSCALL_DEFINE3(init_module, void __user *, umod,
 	pr_debug("init_module: umod=%p, len=%lu, uargs=%p\n",
 	       umod, len, uargs);
 
+	start = ktime_get_ns();
 	err = copy_module_from_user(umod, len, &info);
 	if (err)
 		return err;
+	info.phase_ns[MOD_PHASE_READ] = ktime_get_ns() - start;
 
 	return load_module(&info, uargs, 0);
 }
@@ -2917,6 +2965,7 @@ SYSCALL_DEFINE3(finit_module, int, fd, const char __user *, uargs, int, flags)
 {
 	struct load_info info = { };
 	void *buf = NULL;
+	u64 start;
 	int len;
 	int err;
 
@@ -2931,16 +2980,20 @@ SYSCALL_DEFINE3(finit_module, int, fd, const char __user *, uargs, int, flags)
 		      |MODULE_INIT_COMPRESSED_FILE))
 		return -EINVAL;
 
+	start = ktime_get_ns();
 	len = kernel_read_file_from_fd(fd, 0, &buf, INT_MAX, NULL,
 				       READING_MODULE);
 	if (len < 0)
 		return len;
+	info.phase_ns[MOD_PHASE_READ] = ktime_get_ns() - start;
 
 	if (flags & MODULE_INIT_COMPRESSED_FILE) {
+		start = ktime_get_ns();
 		err = module_decompress(&info, buf, len);
 		vfree(buf); /* compressed data is no longer needed */
 		if (err)
 			return err;
+		info.phase_ns[MOD_PHASE_DECOMPRESS] = ktime_get_ns() - start;
 	} else {
 		info.hdr = buf;
 		info.len = len;
@@ -0,0 +1,299 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Module symbol hash
+ */
+
+#include <linux/module.h>
+#include <linux/hash.h>
+#include <linux/jump_label.h>
+#include <linux/log2.h>
+#include <linux/slab.h>
+#include <linux/stringhash.h>
+#include "internal.h"
+
+/*
+ * find_symbol() bsearches the exported symbols of the kernel and then those
+ * of each module in turn, and module_kallsyms_lookup_name() compares the
+ * name with every symbol of every module.  Both are on the module loading
+ * path for each undefined symbol, and tracers call the latter a lot.
+ *
+ * Instead, keep a hash table with an entry for each exported symbol of the
+ * kernel and of the modules, and another one with an entry for each core
+ * kallsyms symbol of the live modules.  Entries are added and removed under
+ * module_mutex; lookups need module_mutex or RCU-sched, like the module list
+ * walks they replace.  The tables are sized once at boot.
+ */
+
+#define MOD_SYMHASH_MIN_BITS	10
+#define MOD_SYMHASH_KSYM_BITS	15
+
+struct mod_symhash_export {
+	struct hlist_node node;
+	u32 hash;
+	enum mod_license license;
+	const struct kernel_symbol *sym;
+	/* NULL for the kernel's own exports */
+	struct module *owner;
+};
+
+struct mod_symhash_ksym {
+	struct hlist_node node;
+	u32 hash;
+	unsigned int symnum;
+	struct module *mod;
+};
+
+DEFINE_STATIC_KEY_FALSE(mod_symhash_ready);
+
+static struct hlist_head *mod_symhash_exports __ro_after_init;
+static unsigned int mod_symhash_export_bits __ro_after_init;
+#ifdef CONFIG_KALLSYMS
+static struct hlist_head *mod_symhash_ksyms __ro_after_init;
+#endif
+
+u32 mod_symhash_name(const char *name)
+{
+	return full_name_hash(NULL, name, strlen(name));
+}
+
+static struct hlist_head *mod_symhash_export_head(u32 hash)
+{
+	return &mod_symhash_exports[hash_32(hash, mod_symhash_export_bits)];
+}
+
+static struct mod_symhash_export *
+mod_symhash_add_exports(struct mod_symhash_export *e,
+			const struct kernel_symbol *start,
+			const struct kernel_symbol *stop,
+			enum mod_license license, struct module *owner)
+{
+	const struct kernel_symbol *sym;
+
+	for (sym = start; sym < stop; sym++, e++) {
+		e->hash = mod_symhash_name(kernel_symbol_name(sym));
+		e->license = license;
+		e->sym = sym;
+		e->owner = owner;
+		hlist_add_head_rcu(&e->node, mod_symhash_export_head(e->hash));
+	}
+
+	return e;
+}
+
+static const s32 *mod_symhash_crc(const struct mod_symhash_export *e)
+{
+#ifdef CONFIG_MODVERSIONS
+	const struct kernel_symbol *start;
+	const s32 *crcs;
+
+	if (!e->owner) {
+		start = e->license == GPL_ONLY ? __start___ksymtab_gpl :
+						 __start___ksymtab;
+		crcs = e->license == GPL_ONLY ? __start___kcrctab_gpl :
+						__start___kcrctab;
+	} else {
+		start = e->license == GPL_ONLY ? e->owner->gpl_syms :
+						 e->owner->syms;
+		crcs = e->license == GPL_ONLY ? e->owner->gpl_crcs :
+						e->owner->crcs;
+	}
+
+	return crcs ? crcs + (e->sym - start) : NULL;
+#else
+	return NULL;
+#endif
+}
+
+/*
+ * Exported symbols are unique among the modules which aren't unformed, see
+ * verify_exported_symbols(), so the first usable entry is the one the
+ * walk of __find_symbol() would find.
+ */
+bool mod_symhash_find_symbol(struct find_symbol_arg *fsa)
+{
+	u32 hash = mod_symhash_name(fsa->name);
+	struct mod_symhash_export *e;
+
+	hlist_for_each_entry_rcu(e, mod_symhash_export_head(hash), node,
+				 lockdep_is_held(&module_mutex)) {
+		if (e->hash != hash || cmp_name(fsa->name, e->sym))
+			continue;
+		if (e->owner && e->owner->state == MODULE_STATE_UNFORMED)
+			continue;
+		if (!fsa->gplok && e->license == GPL_ONLY)
+			continue;
+
+		fsa->owner = e->owner;
+		fsa->crc = mod_symhash_crc(e);
+		fsa->sym = e->sym;
+		fsa->license = e->license;
+		return true;
+	}
+
+	return false;
+}
+
+/* Called with module_mutex held, once the module exports are verified */
+int mod_symhash_insert(struct module *mod)
+{
+	struct mod_symhash_export *e;
+
+	if (!static_branch_likely(&mod_symhash_ready) ||
+	    !(mod->num_syms + mod->num_gpl_syms))
+		return 0;
+
+	e = kvmalloc_array(mod->num_syms + mod->num_gpl_syms, sizeof(*e),
+			   GFP_KERNEL);
+	if (!e)
+		return -ENOMEM;
+
+	mod->symhash_exports = e;
+	e = mod_symhash_add_exports(e, mod->syms, mod->syms + mod->num_syms,
+				    NOT_GPL_ONLY, mod);
+	mod_symhash_add_exports(e, mod->gpl_syms,
+				mod->gpl_syms + mod->num_gpl_syms, GPL_ONLY, mod);
+	return 0;
+}
+
+#ifdef CONFIG_KALLSYMS
+static struct hlist_head *mod_symhash_ksym_head(u32 hash)
+{
+	return &mod_symhash_ksyms[hash_32(hash, MOD_SYMHASH_KSYM_BITS)];
+}
+
+static const char *mod_symhash_ksym_name(const struct mod_symhash_ksym *e)
+{
+	const struct mod_kallsyms *kallsyms = &e->mod->core_kallsyms;
+
+	return kallsyms->strtab + kallsyms->symtab[e->symnum].st_name;
+}
+
+/*
+ * Called with module_mutex held once the module switched to its core
+ * kallsyms.  If this fails, module_kallsyms_lookup_name() keeps walking the
+ * symbols of the module instead.
+ */
+void mod_symhash_insert_kallsyms(struct module *mod)
+{
+	const struct mod_kallsyms *kallsyms = &mod->core_kallsyms;
+	struct mod_symhash_ksym *e;
+	unsigned int i;
+
+	if (!static_branch_likely(&mod_symhash_ready) || !kallsyms->num_symtab)
+		return;
+
+	e = kvmalloc_array(kallsyms->num_symtab, sizeof(*e), GFP_KERNEL);
+	if (!e)
+		return;
+
+	/*
+	 * Insert backwards, so that the first of several symbols of the
+	 * module with the same name is found first, as with the walk.
+	 */
+	for (i = kallsyms->num_symtab; i-- > 0; ) {
+		e[i].mod = mod;
+		e[i].symnum = i;
+		if (kallsyms->symtab[i].st_shndx == SHN_UNDEF)
+			continue;
+		e[i].hash = mod_symhash_name(mod_symhash_ksym_name(&e[i]));
+		hlist_add_head_rcu(&e[i].node, mod_symhash_ksym_head(e[i].hash));
+	}
+
+	/* pairs with mod_symhash_has_kallsyms(), publishes the entries */
+	smp_store_release(&mod->symhash_ksyms, e);
+}
+
+/*
+ * Look a symbol up in the kallsyms of @mod, which mod_symhash_has_kallsyms().
+ * @hash is mod_symhash_name(@name), computed once for all the modules.
+ */
+unsigned long mod_symhash_kallsyms_lookup(struct module *mod, const char *name,
+					  u32 hash)
+{
+	struct mod_symhash_ksym *e;
+
+	hlist_for_each_entry_rcu(e, mod_symhash_ksym_head(hash), node,
+				 lockdep_is_held(&module_mutex)) {
+		if (e->hash != hash || e->mod != mod)
+			continue;
+		if (!strcmp(name, mod_symhash_ksym_name(e)))
+			return kallsyms_symbol_value(&e->mod->core_kallsyms.symtab[e->symnum]);
+	}
+
+	return 0;
+}
+#endif /* CONFIG_KALLSYMS */
+
+/* Called with module_mutex held, before the RCU sync preceding the free */
+void mod_symhash_remove(struct module *mod)
+{
+	unsigned int i;
+
+	if (mod->symhash_exports) {
+		for (i = 0; i < mod->num_syms + mod->num_gpl_syms; i++)
+			hlist_del_rcu(&mod->symhash_exports[i].node);
+	}
+
+#ifdef CONFIG_KALLSYMS
+	if (mod->symhash_ksyms) {
+		for (i = 0; i < mod->core_kallsyms.num_symtab; i++) {
+			if (mod->core_kallsyms.symtab[i].st_shndx != SHN_UNDEF)
+				hlist_del_rcu(&mod->symhash_ksyms[i].node);
+		}
+	}
+#endif
+}
+
+/* Called once the module entries can't be looked at anymore */
+void mod_symhash_free(struct module *mod)
+{
+	kvfree(mod->symhash_exports);
+	mod->symhash_exports = NULL;
+	kvfree(mod->symhash_ksyms);
+	mod->symhash_ksyms = NULL;
+}
+
+/*
+ * Modules can't be loaded yet at this point, so only the kernel exports
+ * need adding.  Until then find_symbol() keeps using __find_symbol().
+ */
+static int __init mod_symhash_init(void)
+{
+	unsigned int nr_syms = __stop___ksymtab - __start___ksymtab;
+	unsigned int nr_gpl_syms = __stop___ksymtab_gpl - __start___ksymtab_gpl;
+	struct mod_symhash_export *e;
+
+	/* Leave room for the module exports */
+	mod_symhash_export_bits = max(order_base_2(nr_syms + nr_gpl_syms) + 1,
+				      MOD_SYMHASH_MIN_BITS);
+	mod_symhash_exports = kvcalloc(1U << mod_symhash_export_bits,
+				       sizeof(*mod_symhash_exports),
+				       GFP_KERNEL);
+	e = kvmalloc_array(nr_syms + nr_gpl_syms, sizeof(*e), GFP_KERNEL);
+	if (!mod_symhash_exports || !e)
+		goto err;
+
+#ifdef CONFIG_KALLSYMS
+	mod_symhash_ksyms = kvcalloc(1U << MOD_SYMHASH_KSYM_BITS,
+				     sizeof(*mod_symhash_ksyms), GFP_KERNEL);
+	if (!mod_symhash_ksyms)
+		goto err;
+#endif
+
+	mutex_lock(&module_mutex);
+	e = mod_symhash_add_exports(e, __start___ksymtab, __stop___ksymtab,
+				    NOT_GPL_ONLY, NULL);
+	mod_symhash_add_exports(e, __start___ksymtab_gpl, __stop___ksymtab_gpl,
+				GPL_ONLY, NULL);
+	mutex_unlock(&module_mutex);
+
+	static_branch_enable(&mod_symhash_ready);
+	return 0;
+
+err:
+	pr_warn("module symbol hash disabled: out of memory\n");
+	kvfree(e);
+	kvfree(mod_symhash_exports);
+	return -ENOMEM;
+}
+core_initcall(mod_symhash_init);
@@ -0,0 +1,130 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * KUnit test of the module symbol hash
+ */
+
+#include <kunit/test.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include "internal.h"
+
+#define NR_ROUNDS	10
+
+static void symhash_test_check(struct kunit *test,
+			       const struct kernel_symbol *sym, bool gplok)
+{
+	struct find_symbol_arg hashed = {
+		.name	= kernel_symbol_name(sym),
+		.gplok	= gplok,
+	};
+	struct find_symbol_arg walked = hashed;
+	bool found, found_hashed;
+
+	/* the lookups need RCU-sched, the checks may sleep */
+	preempt_disable();
+	found = __find_symbol(&walked);
+	found_hashed = mod_symhash_find_symbol(&hashed);
+	preempt_enable();
+
+	KUNIT_EXPECT_EQ(test, found_hashed, found);
+	if (!found || !found_hashed)
+		return;
+
+	KUNIT_EXPECT_PTR_EQ(test, hashed.sym, walked.sym);
+	KUNIT_EXPECT_PTR_EQ(test, hashed.crc, walked.crc);
+	KUNIT_EXPECT_PTR_EQ(test, hashed.owner, walked.owner);
+	KUNIT_EXPECT_EQ(test, hashed.license, walked.license);
+}
+
+/* Every export of the kernel, GPL-only ones only for GPL modules */
+static void symhash_test_exports(struct kunit *test)
+{
+	const struct kernel_symbol *sym;
+
+	KUNIT_ASSERT_TRUE(test, mod_symhash_enabled());
+
+	for (sym = __start___ksymtab; sym < __stop___ksymtab; sym++) {
+		symhash_test_check(test, sym, true);
+		symhash_test_check(test, sym, false);
+	}
+
+	for (sym = __start___ksymtab_gpl; sym < __stop___ksymtab_gpl; sym++) {
+		symhash_test_check(test, sym, true);
+		symhash_test_check(test, sym, false);
+	}
+}
+
+static void symhash_test_missing(struct kunit *test)
+{
+	struct find_symbol_arg fsa = {
+		.name	= "symhash_test_no_such_symbol",
+		.gplok	= true,
+	};
+	bool found;
+
+	preempt_disable();
+	found = mod_symhash_find_symbol(&fsa);
+	preempt_enable();
+
+	KUNIT_EXPECT_FALSE(test, found);
+#ifdef CONFIG_KALLSYMS
+	KUNIT_EXPECT_EQ(test, module_kallsyms_lookup_name(fsa.name), 0UL);
+#endif
+}
+
+static u64 symhash_test_time(bool (*lookup)(struct find_symbol_arg *fsa))
+{
+	const struct kernel_symbol *sym;
+	u64 start = ktime_get_ns();
+	int i;
+
+	for (i = 0; i < NR_ROUNDS; i++) {
+		for (sym = __start___ksymtab_gpl; sym < __stop___ksymtab_gpl;
+		     sym++) {
+			struct find_symbol_arg fsa = {
+				.name	= kernel_symbol_name(sym),
+				.gplok	= true,
+			};
+
+			preempt_disable();
+			lookup(&fsa);
+			preempt_enable();
+		}
+	}
+
+	return ktime_get_ns() - start;
+}
+
+/*
+ * Looking up the GPL-only exports is the worst case for the walk, which
+ * bsearches the other exports of the kernel first.
+ */
+static void symhash_test_benchmark(struct kunit *test)
+{
+	unsigned int nr = __stop___ksymtab_gpl - __start___ksymtab_gpl;
+	u64 hashed, walked;
+
+	if (!nr)
+		kunit_skip(test, "no GPL-only exports");
+
+	walked = symhash_test_time(__find_symbol);
+	hashed = symhash_test_time(mod_symhash_find_symbol);
+
+	kunit_info(test, "%u lookups: walk %llu ns, hash %llu ns per lookup\n",
+		   nr * NR_ROUNDS, div_u64(walked, nr * NR_ROUNDS),
+		   div_u64(hashed, nr * NR_ROUNDS));
+}
+
+static struct kunit_case symhash_test_cases[] = {
+	KUNIT_CASE(symhash_test_exports),
+	KUNIT_CASE(symhash_test_missing),
+	KUNIT_CASE(symhash_test_benchmark),
+	{}
+};
+
+static struct kunit_suite symhash_test_suite = {
+	.name = "module-symhash",
+	.test_cases = symhash_test_cases,
+};
+
+kunit_test_suite(symhash_test_suite);
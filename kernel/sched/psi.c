@@ -1185,6 +1185,31 @@ int psi_show(struct seq_file *m, struct psi_group *group, enum psi_res res)
 	return 0;
 }
 
+/**
+ * psi_read_totals - read the stall times of a group
+ * @group: group to read
+ * @totals: filled with the stall time of each state, in nsecs
+ *
+ * Same totals as the ones psi_show() reports, without the averages.
+ */
+int psi_read_totals(struct psi_group *group, u64 totals[NR_PSI_STATES - 1])
+{
+	if (static_branch_likely(&psi_disabled))
+		return -EOPNOTSUPP;
+
+	mutex_lock(&group->avgs_lock);
+	collect_percpu_times(group, PSI_AVGS, NULL);
+	memcpy(totals, group->total[PSI_AVGS],
+	       sizeof(group->total[PSI_AVGS]));
+	mutex_unlock(&group->avgs_lock);
+
+	/* CPU FULL is undefined at the system level */
+	if (group == &psi_system)
+		totals[PSI_CPU_FULL] = 0;
+
+	return 0;
+}
+
 struct psi_trigger *psi_trigger_create(struct psi_group *group,
 			char *buf, enum psi_res res)
 {
@@ -107,6 +107,7 @@ FEATURE_TESTS_EXTRA :=                  \
          libbpf-bpf_create_map		\
          libpfm4                        \
          libdebuginfod			\
+         io_uring			\
          clang-bpf-co-re
 
 
@@ -0,0 +1,11 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+int main(void)
+{
+	struct io_uring_params p = { .flags = IORING_SETUP_SQPOLL, };
+
+	return syscall(__NR_io_uring_setup, 1, &p) + IORING_OP_READ;
+}
@@ -0,0 +1,500 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * io-file: compare the block I/O submission paths of the kernel.
+ *
+ * Each thread keeps --depth requests of --bs bytes in flight to the same
+ * file, at random block aligned offsets, through one of:
+ *
+ *   psync    ... pread(2)/pwrite(2), one request at a time
+ *   aio      ... io_submit(2)/io_getevents(2)
+ *   io_uring ... io_uring_enter(2), optionally with IOPOLL, SQPOLL,
+ *                registered files and registered buffers
+ *
+ * and the number of requests completed per second and the percentiles of
+ * their latency are reported for each.  To measure the submission and
+ * completion paths rather than a device, use a null_blk (/dev/nullb0) or
+ * brd (/dev/ram0) device; the default, /dev/zero, has no block layer at all.
+ */
+
+#include <string.h>
+#include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <linux/aio_abi.h>
+#include <linux/compiler.h>
+#include <linux/kernel.h>
+#include <linux/time64.h>
+#include <linux/zalloc.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#include <subcmd/parse-options.h>
+#include "bench.h"
+#include "io.h"
+
+#include <err.h>
+
+static const char *filename = "/dev/zero";
+static const char *engine_str = "all";
+static unsigned int nthreads = 1;
+static unsigned int nsecs = 5;
+static unsigned int bs = 4096;
+static unsigned int depth = 32;
+static bool do_write, direct, polled, sqpoll, fixed_files, fixed_bufs;
+static bool done, interrupted;
+
+static const struct option options[] = {
+	OPT_STRING('f', "file", &filename, "path", "File or block device to do I/O on (default: /dev/zero)"),
+	OPT_STRING('e', "engine", &engine_str, "name", "I/O engine: psync, aio, io_uring or all (default)"),
+	OPT_UINTEGER('t', "threads", &nthreads, "Specify amount of threads"),
+	OPT_UINTEGER('r', "runtime", &nsecs, "Specify runtime (in seconds)"),
+	OPT_UINTEGER('b', "bs", &bs, "Size of each I/O request (default: 4096)"),
+	OPT_UINTEGER('d', "depth", &depth, "Requests in flight per thread (default: 32)"),
+	OPT_BOOLEAN('w', "write", &do_write, "Write instead of read"),
+	OPT_BOOLEAN('D', "direct", &direct, "Bypass the page cache (O_DIRECT)"),
+	OPT_BOOLEAN('p', "polled", &polled, "io_uring: poll for completions (IOPOLL, implies --direct)"),
+	OPT_BOOLEAN('S', "sqpoll", &sqpoll, "io_uring: submit from a kernel thread (SQPOLL)"),
+	OPT_BOOLEAN('F', "fixed-files", &fixed_files, "io_uring: use registered files"),
+	OPT_BOOLEAN('B', "fixed-buffers", &fixed_bufs, "io_uring: use registered buffers"),
+	OPT_END()
+};
+
+static const char * const bench_io_file_usage[] = {
+	"perf bench io file <options>",
+	NULL
+};
+
+struct worker {
+	pthread_t thread;
+	int fd;
+	int err;
+	unsigned int seed;
+	u64 nr_blocks;
+	void *bufs;
+	u64 ops;
+	u64 bytes;
+	u64 runtime;
+	struct io_lat lat;
+};
+
+struct io_engine {
+	const char *name;
+	int (*run)(struct worker *w);
+};
+
+static off_t next_offset(struct worker *w)
+{
+	if (!w->nr_blocks)
+		return 0;
+	return (off_t)(rand_r(&w->seed) % w->nr_blocks) * bs;
+}
+
+static int psync_run(struct worker *w)
+{
+	while (!READ_ONCE(done)) {
+		off_t off = next_offset(w);
+		u64 start = io_bench__nsecs();
+		ssize_t ret;
+
+		if (do_write)
+			ret = pwrite(w->fd, w->bufs, bs, off);
+		else
+			ret = pread(w->fd, w->bufs, bs, off);
+		if (ret < 0)
+			return -errno;
+
+		io_lat__add(&w->lat, io_bench__nsecs() - start);
+		w->ops++;
+		w->bytes += ret;
+	}
+	return 0;
+}
+
+static int aio_run(struct worker *w)
+{
+	struct iocb *iocbs, **ptrs;
+	struct io_event *events;
+	aio_context_t ctx = 0;
+	unsigned int i, nr, inflight = 0;
+	u64 *start;
+	int ret = 0;
+
+	iocbs = calloc(depth, sizeof(*iocbs));
+	ptrs = calloc(depth, sizeof(*ptrs));
+	events = calloc(depth, sizeof(*events));
+	start = calloc(depth, sizeof(*start));
+	if (!iocbs || !ptrs || !events || !start) {
+		ret = -ENOMEM;
+		goto out_free;
+	}
+
+	if (syscall(__NR_io_setup, depth, &ctx) < 0) {
+		ret = -errno;
+		goto out_free;
+	}
+
+	for (i = 0; i < depth; i++) {
+		iocbs[i].aio_fildes = w->fd;
+		iocbs[i].aio_lio_opcode = do_write ? IOCB_CMD_PWRITE : IOCB_CMD_PREAD;
+		iocbs[i].aio_buf = (unsigned long)(w->bufs + i * bs);
+		iocbs[i].aio_nbytes = bs;
+		iocbs[i].aio_data = i;
+	}
+
+	nr = depth;
+	for (i = 0; i < depth; i++)
+		ptrs[i] = &iocbs[i];
+
+	while (nr || inflight) {
+		int n;
+
+		for (i = 0; i < nr; i++) {
+			ptrs[i]->aio_offset = next_offset(w);
+			start[ptrs[i]->aio_data] = io_bench__nsecs();
+		}
+		if (nr) {
+			n = syscall(__NR_io_submit, ctx, nr, ptrs);
+			if (n < 0) {
+				ret = -errno;
+				break;
+			}
+			/* the rest failed to submit, it's an error below */
+			inflight += n;
+			if ((unsigned int)n < nr) {
+				ret = -EAGAIN;
+				break;
+			}
+		}
+
+		do {
+			n = syscall(__NR_io_getevents, ctx, 1, depth, events, NULL);
+		} while (n < 0 && errno == EINTR);
+		if (n < 0) {
+			ret = -errno;
+			break;
+		}
+
+		for (i = 0, nr = 0; i < (unsigned int)n; i++) {
+			struct io_event *ev = &events[i];
+
+			inflight--;
+			if ((s64)ev->res < 0) {
+				ret = ev->res;
+				continue;
+			}
+			io_lat__add(&w->lat, io_bench__nsecs() - start[ev->data]);
+			w->ops++;
+			w->bytes += ev->res;
+			if (!READ_ONCE(done) && !ret)
+				ptrs[nr++] = &iocbs[ev->data];
+		}
+	}
+
+	/* io_destroy() waits for anything still in flight after an error */
+	syscall(__NR_io_destroy, ctx);
+out_free:
+	free(start);
+	free(events);
+	free(ptrs);
+	free(iocbs);
+	return ret;
+}
+
+#ifdef HAVE_IO_URING_SUPPORT
+static void io_uring_prep(struct io_ring *ring, struct worker *w,
+			  unsigned int i, u64 *start)
+{
+	struct io_uring_sqe *sqe = io_ring__get_sqe(ring);
+
+	/* never more than depth SQEs in the ring */
+	BUG_ON(!sqe);
+
+	if (fixed_bufs) {
+		sqe->opcode = do_write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+		sqe->buf_index = i;
+	} else {
+		sqe->opcode = do_write ? IORING_OP_WRITE : IORING_OP_READ;
+	}
+	if (fixed_files) {
+		sqe->fd = 0;
+		sqe->flags |= IOSQE_FIXED_FILE;
+	} else {
+		sqe->fd = w->fd;
+	}
+	sqe->addr = (unsigned long)(w->bufs + i * bs);
+	sqe->len = bs;
+	sqe->off = next_offset(w);
+	sqe->user_data = i;
+	start[i] = io_bench__nsecs();
+}
+
+static int io_uring_run(struct worker *w)
+{
+	struct io_ring ring;
+	struct iovec *iovecs = NULL;
+	unsigned int i, flags = 0, inflight = 0;
+	u64 *start;
+	int ret;
+
+	start = calloc(depth, sizeof(*start));
+	if (!start)
+		return -ENOMEM;
+
+	if (polled)
+		flags |= IORING_SETUP_IOPOLL;
+	if (sqpoll)
+		flags |= IORING_SETUP_SQPOLL;
+
+	ret = io_ring__init(&ring, depth, flags);
+	if (ret)
+		goto out_free;
+
+	if (fixed_files) {
+		ret = io_ring__register(&ring, IORING_REGISTER_FILES, &w->fd, 1);
+		if (ret)
+			goto out_exit;
+	}
+
+	if (fixed_bufs) {
+		iovecs = calloc(depth, sizeof(*iovecs));
+		if (!iovecs) {
+			ret = -ENOMEM;
+			goto out_exit;
+		}
+		for (i = 0; i < depth; i++) {
+			iovecs[i].iov_base = w->bufs + i * bs;
+			iovecs[i].iov_len = bs;
+		}
+		ret = io_ring__register(&ring, IORING_REGISTER_BUFFERS, iovecs, depth);
+		if (ret)
+			goto out_exit;
+	}
+
+	for (i = 0; i < depth; i++, inflight++)
+		io_uring_prep(&ring, w, i, start);
+
+	while (inflight) {
+		struct io_uring_cqe *cqe;
+		int err = io_ring__submit(&ring, 1);
+
+		if (err < 0) {
+			ret = err;
+			break;
+		}
+
+		while ((cqe = io_ring__peek_cqe(&ring)) != NULL) {
+			unsigned int idx = cqe->user_data;
+			int res = cqe->res;
+
+			io_ring__cqe_seen(&ring);
+			if (res < 0) {
+				ret = res;
+				inflight--;
+				continue;
+			}
+
+			io_lat__add(&w->lat, io_bench__nsecs() - start[idx]);
+			w->ops++;
+			w->bytes += res;
+
+			if (READ_ONCE(done) || ret)
+				inflight--;
+			else
+				io_uring_prep(&ring, w, idx, start);
+		}
+	}
+
+out_exit:
+	io_ring__exit(&ring);
+out_free:
+	free(iovecs);
+	free(start);
+	return ret;
+}
+#endif // HAVE_IO_URING_SUPPORT
+
+static const struct io_engine engines[] = {
+	{ "psync",	psync_run	},
+	{ "aio",	aio_run		},
+#ifdef HAVE_IO_URING_SUPPORT
+	{ "io_uring",	io_uring_run	},
+#endif
+};
+
+static const struct io_engine *engine;
+
+static void *workerfn(void *arg)
+{
+	struct worker *w = arg;
+	u64 start = io_bench__nsecs();
+
+	w->err = engine->run(w);
+	w->runtime = io_bench__nsecs() - start;
+	return NULL;
+}
+
+static int worker_init(struct worker *w, int tid)
+{
+	int flags = do_write ? O_WRONLY : O_RDONLY;
+	off_t size;
+
+	if (direct)
+		flags |= O_DIRECT;
+
+	w->fd = open(filename, flags);
+	if (w->fd < 0)
+		return -errno;
+
+	/* works for block devices too, and is 0 for character devices */
+	size = lseek(w->fd, 0, SEEK_END);
+	w->nr_blocks = size > 0 ? size / bs : 0;
+	w->seed = tid + 1;
+	io_lat__init(&w->lat);
+
+	/* O_DIRECT wants aligned buffers */
+	if (posix_memalign(&w->bufs, sysconf(_SC_PAGESIZE), (size_t)depth * bs)) {
+		close(w->fd);
+		return -ENOMEM;
+	}
+	memset(w->bufs, 0xaa, (size_t)depth * bs);
+	return 0;
+}
+
+static void print_result(struct worker *worker)
+{
+	struct io_lat lat;
+	double iops = 0, mbps = 0;
+	unsigned int i;
+
+	io_lat__init(&lat);
+	for (i = 0; i < nthreads; i++) {
+		struct worker *w = &worker[i];
+		double secs = (double)w->runtime / NSEC_PER_SEC;
+
+		io_lat__merge(&lat, &w->lat);
+		if (secs > 0) {
+			iops += w->ops / secs;
+			mbps += w->bytes / secs / (1024 * 1024);
+		}
+	}
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf(" %14s: %.0f IOPS, %.2f MB/sec\n", "Throughput", iops, mbps);
+		io_lat__fprintf(&lat, stdout);
+		printf("\n");
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		printf("%s %.0f %" PRIu64 " %" PRIu64 " %" PRIu64 "\n", engine->name,
+		       iops, io_lat__percentile(&lat, 50) / NSEC_PER_USEC,
+		       io_lat__percentile(&lat, 99) / NSEC_PER_USEC,
+		       io_lat__percentile(&lat, 99.9) / NSEC_PER_USEC);
+		break;
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+	}
+}
+
+static int run_engine(void)
+{
+	struct worker *worker;
+	unsigned int i, nr = 0;
+	int ret = 0;
+
+	if (bench_format == BENCH_FORMAT_DEFAULT) {
+		printf("# %s: %u thread(s), %u byte %ss, depth %u, on %s for %u secs\n",
+		       engine->name, nthreads, bs, do_write ? "write" : "read",
+		       !strcmp(engine->name, "psync") ? 1 : depth, filename, nsecs);
+	}
+
+	worker = calloc(nthreads, sizeof(*worker));
+	if (!worker)
+		err(EXIT_FAILURE, "calloc");
+
+	done = false;
+	for (i = 0; i < nthreads; i++, nr++) {
+		ret = worker_init(&worker[i], i);
+		if (ret)
+			break;
+		ret = pthread_create(&worker[i].thread, NULL, workerfn, &worker[i]);
+		if (ret) {
+			ret = -ret;
+			free(worker[i].bufs);
+			close(worker[i].fd);
+			break;
+		}
+	}
+
+	if (!ret)
+		sleep(nsecs);
+	done = true;
+
+	for (i = 0; i < nr; i++) {
+		pthread_join(worker[i].thread, NULL);
+		if (worker[i].err && !ret)
+			ret = worker[i].err;
+		free(worker[i].bufs);
+		close(worker[i].fd);
+	}
+
+	if (ret)
+		fprintf(stderr, " %s: %s\n\n", engine->name, strerror(-ret));
+	else
+		print_result(worker);
+
+	free(worker);
+	return ret;
+}
+
+static void toggle_done(int sig __maybe_unused,
+			siginfo_t *info __maybe_unused,
+			void *uc __maybe_unused)
+{
+	done = true;
+	interrupted = true;
+}
+
+int bench_io_file(int argc, const char **argv)
+{
+	struct sigaction act;
+	bool all, found = false;
+	int ret = 0;
+	size_t i;
+
+	argc = parse_options(argc, argv, options, bench_io_file_usage, 0);
+	if (argc || !nthreads || !bs || !depth) {
+		usage_with_options(bench_io_file_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	if (polled)
+		direct = true;
+
+	memset(&act, 0, sizeof(act));
+	sigfillset(&act.sa_mask);
+	act.sa_sigaction = toggle_done;
+	sigaction(SIGINT, &act, NULL);
+
+	all = !strcmp(engine_str, "all");
+	for (i = 0; i < ARRAY_SIZE(engines) && !interrupted; i++) {
+		if (!all && strcmp(engine_str, engines[i].name))
+			continue;
+
+		found = true;
+		engine = &engines[i];
+		if (run_engine() && !all)
+			ret = -1;
+	}
+
+	if (!found) {
+		fprintf(stderr, "Unknown or unsupported I/O engine: %s\n", engine_str);
+		return -1;
+	}
+	return ret;
+}
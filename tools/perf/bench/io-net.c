@@ -0,0 +1,580 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * io-net: network echo over loopback TCP.
+ *
+ * Each client thread owns one connection and does blocking round trips of
+ * --size bytes on it, timing each one.  A single server thread echoes what
+ * it gets on all the connections back, using either:
+ *
+ *   epoll    ... epoll_wait(2) + recv(2) + send(2)
+ *   io_uring ... a multishot IORING_OP_RECV per connection picking buffers
+ *                from a provided buffer ring, and IORING_OP_SEND
+ *
+ * so that the round trips per second and their latency percentiles show the
+ * cost of the server side event loop.
+ */
+
+#include <string.h>
+#include <pthread.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/compiler.h>
+#include <linux/kernel.h>
+#include <linux/log2.h>
+#include <linux/time64.h>
+#include <linux/zalloc.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <asm/barrier.h>
+
+#include <subcmd/parse-options.h>
+#include "bench.h"
+#include "io.h"
+
+#include <err.h>
+
+#if defined(HAVE_IO_URING_SUPPORT) && defined(IORING_RECV_MULTISHOT)
+#define HAVE_IO_URING_MULTISHOT_RECV
+#endif
+
+#define SERVER_BUF_SIZE		16384
+
+static const char *mode_str = "all";
+static unsigned int nconns = 4;
+static unsigned int nsecs = 5;
+static unsigned int msg_size = 64;
+static bool done, interrupted;
+
+static const struct option options[] = {
+	OPT_STRING('m', "mode", &mode_str, "name", "Server loop: epoll, io_uring or all (default)"),
+	OPT_UINTEGER('c', "connections", &nconns, "Specify amount of connections (and client threads)"),
+	OPT_UINTEGER('r', "runtime", &nsecs, "Specify runtime (in seconds)"),
+	OPT_UINTEGER('s', "size", &msg_size, "Size of each message (default: 64)"),
+	OPT_END()
+};
+
+static const char * const bench_io_net_usage[] = {
+	"perf bench io net <options>",
+	NULL
+};
+
+struct client {
+	pthread_t thread;
+	int fd;
+	int err;
+	u64 ops;
+	u64 runtime;
+	struct io_lat lat;
+};
+
+struct server;
+
+struct echo_mode {
+	const char *name;
+	int (*serve)(struct server *s);
+};
+
+struct server {
+	pthread_t thread;
+	const struct echo_mode *mode;
+	int *fds;
+	int err;
+};
+
+static void *client_fn(void *arg)
+{
+	struct client *c = arg;
+	u64 start = io_bench__nsecs();
+	ssize_t ret = 0;
+	char *buf;
+
+	buf = malloc(msg_size);
+	if (!buf) {
+		c->err = -ENOMEM;
+		goto out;
+	}
+	memset(buf, 0x5a, msg_size);
+
+	while (!READ_ONCE(done)) {
+		u64 t = io_bench__nsecs();
+		size_t n;
+
+		for (n = 0; n < msg_size; n += ret) {
+			ret = send(c->fd, buf + n, msg_size - n, MSG_NOSIGNAL);
+			if (ret < 0)
+				goto out_err;
+		}
+		/* the echo can come back in pieces */
+		for (n = 0; n < msg_size; n += ret) {
+			ret = recv(c->fd, buf + n, msg_size - n, 0);
+			if (ret <= 0)
+				goto out_err;
+		}
+
+		io_lat__add(&c->lat, io_bench__nsecs() - t);
+		c->ops++;
+	}
+	goto out_free;
+
+out_err:
+	/* recv() returning 0 means the server went away */
+	c->err = ret < 0 ? -errno : -EPIPE;
+out_free:
+	free(buf);
+out:
+	c->runtime = io_bench__nsecs() - start;
+	/* let the server see the end of the stream */
+	shutdown(c->fd, SHUT_WR);
+	return NULL;
+}
+
+static int echo(int fd, const char *buf, size_t len)
+{
+	size_t n;
+	ssize_t ret;
+
+	for (n = 0; n < len; n += ret) {
+		ret = send(fd, buf + n, len - n, MSG_NOSIGNAL);
+		if (ret < 0)
+			return -errno;
+	}
+	return 0;
+}
+
+static int epoll_serve(struct server *s)
+{
+	struct epoll_event *events;
+	unsigned int i, nr_open = nconns;
+	char *buf;
+	int efd, err = 0;
+
+	events = calloc(nconns, sizeof(*events));
+	buf = malloc(SERVER_BUF_SIZE);
+	efd = epoll_create1(0);
+	if (!events || !buf || efd < 0) {
+		err = efd < 0 ? -errno : -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < nconns; i++) {
+		struct epoll_event ev = {
+			.events = EPOLLIN,
+			.data.u32 = i,
+		};
+
+		if (epoll_ctl(efd, EPOLL_CTL_ADD, s->fds[i], &ev) < 0) {
+			err = -errno;
+			goto out;
+		}
+	}
+
+	while (nr_open) {
+		int n = epoll_wait(efd, events, nconns, -1);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			err = -errno;
+			break;
+		}
+
+		for (i = 0; i < (unsigned int)n; i++) {
+			int fd = s->fds[events[i].data.u32];
+			ssize_t ret = recv(fd, buf, SERVER_BUF_SIZE, 0);
+
+			if (ret <= 0) {
+				epoll_ctl(efd, EPOLL_CTL_DEL, fd, NULL);
+				nr_open--;
+				continue;
+			}
+
+			ret = echo(fd, buf, ret);
+			if (ret && !READ_ONCE(done) && !err)
+				err = ret;
+		}
+	}
+
+out:
+	if (efd >= 0)
+		close(efd);
+	free(buf);
+	free(events);
+	return err;
+}
+
+#ifdef HAVE_IO_URING_MULTISHOT_RECV
+enum {
+	ECHO_RECV = 1,
+	ECHO_SEND,
+};
+
+#define ECHO_DATA(op, idx)	((u64)(op) << 32 | (idx))
+
+struct echo_bufs {
+	struct io_uring_buf_ring *br;
+	char *mem;
+	unsigned int nr;
+	unsigned int tail;
+};
+
+static void echo_bufs__put(struct echo_bufs *b, unsigned int bid)
+{
+	struct io_uring_buf *buf = &b->br->bufs[b->tail & (b->nr - 1)];
+
+	buf->addr = (unsigned long)(b->mem + (size_t)bid * SERVER_BUF_SIZE);
+	buf->len = SERVER_BUF_SIZE;
+	buf->bid = bid;
+	smp_store_release(&b->br->tail, ++b->tail);
+}
+
+/* Flush the submission queue when it is full */
+static struct io_uring_sqe *echo_get_sqe(struct io_ring *ring)
+{
+	struct io_uring_sqe *sqe;
+
+	while ((sqe = io_ring__get_sqe(ring)) == NULL)
+		io_ring__submit(ring, 0);
+	return sqe;
+}
+
+static void echo_prep_recv(struct io_ring *ring, int fd, unsigned int idx)
+{
+	struct io_uring_sqe *sqe = echo_get_sqe(ring);
+
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = fd;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = 0;
+	sqe->user_data = ECHO_DATA(ECHO_RECV, idx);
+}
+
+static void echo_prep_send(struct io_ring *ring, int fd, struct echo_bufs *b,
+			   unsigned int bid, unsigned int len)
+{
+	struct io_uring_sqe *sqe = echo_get_sqe(ring);
+
+	sqe->opcode = IORING_OP_SEND;
+	sqe->fd = fd;
+	sqe->addr = (unsigned long)(b->mem + (size_t)bid * SERVER_BUF_SIZE);
+	sqe->len = len;
+	sqe->msg_flags = MSG_NOSIGNAL;
+	sqe->user_data = ECHO_DATA(ECHO_SEND, bid);
+}
+
+static int io_uring_serve(struct server *s)
+{
+	struct io_uring_buf_reg reg;
+	struct echo_bufs bufs = { .nr = 0, };
+	struct io_ring ring = { .fd = -1, };
+	unsigned int i, nr_open = nconns;
+	int ret, err = 0;
+
+	/* a few buffers per connection, the echo gives them back quickly */
+	bufs.nr = roundup_pow_of_two(max(nconns * 4, 64U));
+	bufs.mem = malloc((size_t)bufs.nr * SERVER_BUF_SIZE);
+	if (!bufs.mem ||
+	    posix_memalign((void **)&bufs.br, sysconf(_SC_PAGESIZE),
+			   bufs.nr * sizeof(struct io_uring_buf))) {
+		bufs.br = NULL;
+		err = -ENOMEM;
+		goto out;
+	}
+	memset(bufs.br, 0, bufs.nr * sizeof(struct io_uring_buf));
+
+	err = io_ring__init(&ring, bufs.nr, 0);
+	if (err)
+		goto out;
+
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (unsigned long)bufs.br;
+	reg.ring_entries = bufs.nr;
+	reg.bgid = 0;
+	err = io_ring__register(&ring, IORING_REGISTER_PBUF_RING, &reg, 1);
+	if (err)
+		goto out;
+
+	for (i = 0; i < bufs.nr; i++)
+		echo_bufs__put(&bufs, i);
+
+	for (i = 0; i < nconns; i++)
+		echo_prep_recv(&ring, s->fds[i], i);
+
+	while (nr_open) {
+		struct io_uring_cqe *cqe;
+
+		ret = io_ring__submit(&ring, 1);
+		if (ret < 0) {
+			err = ret;
+			break;
+		}
+
+		while ((cqe = io_ring__peek_cqe(&ring)) != NULL) {
+			unsigned int op = cqe->user_data >> 32;
+			unsigned int idx = (u32)cqe->user_data;
+			unsigned int flags = cqe->flags;
+			int res = cqe->res;
+
+			io_ring__cqe_seen(&ring);
+
+			if (op == ECHO_SEND) {
+				if (res < 0 && !READ_ONCE(done) && !err)
+					err = res;
+				echo_bufs__put(&bufs, idx);
+				continue;
+			}
+
+			if (res > 0) {
+				echo_prep_send(&ring, s->fds[idx], &bufs,
+					       flags >> IORING_CQE_BUFFER_SHIFT, res);
+			}
+
+			if (flags & IORING_CQE_F_MORE)
+				continue;
+
+			/* rearm, unless the client is gone */
+			if (res > 0 || res == -ENOBUFS)
+				echo_prep_recv(&ring, s->fds[idx], idx);
+			else
+				nr_open--;
+		}
+	}
+
+out:
+	if (ring.fd >= 0)
+		io_ring__exit(&ring);
+	free(bufs.br);
+	free(bufs.mem);
+	return err;
+}
+#endif // HAVE_IO_URING_MULTISHOT_RECV
+
+static const struct echo_mode modes[] = {
+	{ "epoll",	epoll_serve	},
+#ifdef HAVE_IO_URING_MULTISHOT_RECV
+	{ "io_uring",	io_uring_serve	},
+#endif
+};
+
+static void *server_fn(void *arg)
+{
+	struct server *s = arg;
+	unsigned int i;
+
+	s->err = s->mode->serve(s);
+
+	/* don't leave the clients waiting for an echo if something failed */
+	for (i = 0; i < nconns; i++)
+		shutdown(s->fds[i], SHUT_RDWR);
+	return NULL;
+}
+
+static int set_nodelay(int fd)
+{
+	int one = 1;
+
+	return setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+/* Connect the clients to the server over loopback */
+static int setup_connections(struct client *clients, struct server *server)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	socklen_t len = sizeof(addr);
+	unsigned int i;
+	int lfd, ret = 0;
+
+	lfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (lfd < 0)
+		return -errno;
+
+	if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    listen(lfd, nconns) < 0 ||
+	    getsockname(lfd, (struct sockaddr *)&addr, &len) < 0) {
+		ret = -errno;
+		goto out;
+	}
+
+	for (i = 0; i < nconns; i++) {
+		clients[i].fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (clients[i].fd < 0 ||
+		    connect(clients[i].fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+		    set_nodelay(clients[i].fd) < 0) {
+			ret = -errno;
+			goto out;
+		}
+
+		server->fds[i] = accept(lfd, NULL, NULL);
+		if (server->fds[i] < 0 || set_nodelay(server->fds[i]) < 0) {
+			ret = -errno;
+			goto out;
+		}
+	}
+out:
+	close(lfd);
+	return ret;
+}
+
+static void print_result(const struct echo_mode *mode, struct client *clients)
+{
+	struct io_lat lat;
+	double rate = 0;
+	unsigned int i;
+
+	io_lat__init(&lat);
+	for (i = 0; i < nconns; i++) {
+		struct client *c = &clients[i];
+
+		io_lat__merge(&lat, &c->lat);
+		if (c->runtime)
+			rate += (double)c->ops * NSEC_PER_SEC / c->runtime;
+	}
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf(" %14s: %.0f round trips/sec, %.2f MB/sec\n", "Throughput",
+		       rate, rate * msg_size * 2 / (1024 * 1024));
+		io_lat__fprintf(&lat, stdout);
+		printf("\n");
+		break;
+	case BENCH_FORMAT_SIMPLE:
+		printf("%s %.0f %" PRIu64 " %" PRIu64 " %" PRIu64 "\n", mode->name,
+		       rate, io_lat__percentile(&lat, 50) / NSEC_PER_USEC,
+		       io_lat__percentile(&lat, 99) / NSEC_PER_USEC,
+		       io_lat__percentile(&lat, 99.9) / NSEC_PER_USEC);
+		break;
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+	}
+}
+
+static int run_mode(const struct echo_mode *mode)
+{
+	struct server server = { .err = 0, };
+	struct client *clients;
+	unsigned int i, nr = 0;
+	int ret;
+
+	if (bench_format == BENCH_FORMAT_DEFAULT) {
+		printf("# %s: %u connection(s), %u byte messages, for %u secs\n",
+		       mode->name, nconns, msg_size, nsecs);
+	}
+
+	clients = calloc(nconns, sizeof(*clients));
+	server.fds = calloc(nconns, sizeof(*server.fds));
+	if (!clients || !server.fds)
+		err(EXIT_FAILURE, "calloc");
+
+	for (i = 0; i < nconns; i++) {
+		clients[i].fd = server.fds[i] = -1;
+		io_lat__init(&clients[i].lat);
+	}
+
+	done = false;
+	ret = setup_connections(clients, &server);
+	if (ret)
+		goto out;
+
+	server.mode = mode;
+	ret = pthread_create(&server.thread, NULL, server_fn, &server);
+	if (ret) {
+		ret = -ret;
+		goto out;
+	}
+
+	for (i = 0; i < nconns; i++, nr++) {
+		ret = pthread_create(&clients[i].thread, NULL, client_fn, &clients[i]);
+		if (ret) {
+			ret = -ret;
+			break;
+		}
+	}
+
+	if (!ret)
+		sleep(nsecs);
+	done = true;
+
+	/* clients which never started can't close their end by themselves */
+	for (i = nr; i < nconns; i++)
+		shutdown(clients[i].fd, SHUT_WR);
+	for (i = 0; i < nr; i++)
+		pthread_join(clients[i].thread, NULL);
+	pthread_join(server.thread, NULL);
+
+	/* the clients fail when the server does, report why it did */
+	if (!ret)
+		ret = server.err;
+	for (i = 0; i < nr && !ret; i++)
+		ret = clients[i].err;
+
+out:
+	for (i = 0; i < nconns; i++) {
+		if (clients[i].fd >= 0)
+			close(clients[i].fd);
+		if (server.fds[i] >= 0)
+			close(server.fds[i]);
+	}
+
+	if (ret)
+		fprintf(stderr, " %s: %s\n\n", mode->name, strerror(-ret));
+	else
+		print_result(mode, clients);
+
+	free(server.fds);
+	free(clients);
+	return ret;
+}
+
+static void toggle_done(int sig __maybe_unused,
+			siginfo_t *info __maybe_unused,
+			void *uc __maybe_unused)
+{
+	done = true;
+	interrupted = true;
+}
+
+int bench_io_net(int argc, const char **argv)
+{
+	struct sigaction act;
+	bool all, found = false;
+	int ret = 0;
+	size_t i;
+
+	argc = parse_options(argc, argv, options, bench_io_net_usage, 0);
+	if (argc || !nconns || !msg_size) {
+		usage_with_options(bench_io_net_usage, options);
+		exit(EXIT_FAILURE);
+	}
+
+	memset(&act, 0, sizeof(act));
+	sigfillset(&act.sa_mask);
+	act.sa_sigaction = toggle_done;
+	sigaction(SIGINT, &act, NULL);
+
+	all = !strcmp(mode_str, "all");
+	for (i = 0; i < ARRAY_SIZE(modes) && !interrupted; i++) {
+		if (!all && strcmp(mode_str, modes[i].name))
+			continue;
+
+		found = true;
+		if (run_mode(&modes[i]) && !all)
+			ret = -1;
+	}
+
+	if (!found) {
+		fprintf(stderr, "Unknown or unsupported server mode: %s\n", mode_str);
+		return -1;
+	}
+	return ret;
+}
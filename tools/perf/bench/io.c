@@ -0,0 +1,269 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Helpers shared by the 'perf bench io' benchmarks: a latency histogram
+ * to report percentiles, and just enough of an io_uring to submit requests
+ * and reap completions without depending on liburing.
+ */
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/bitops.h>
+#include <linux/kernel.h>
+#include <linux/time64.h>
+#include <asm/barrier.h>
+
+#include "io.h"
+
+u64 io_bench__nsecs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+void io_lat__init(struct io_lat *lat)
+{
+	memset(lat, 0, sizeof(*lat));
+	lat->min = ~0ULL;
+}
+
+static int io_lat__bucket(u64 nsecs)
+{
+	int shift, idx;
+
+	if (nsecs < 2 * IO_LAT_SUB)
+		return nsecs;
+
+	shift = fls64(nsecs) - 1 - IO_LAT_SUB_BITS;
+	idx = (shift + 1) * IO_LAT_SUB + (nsecs >> shift) - IO_LAT_SUB;
+	return min(idx, IO_LAT_NR_BUCKETS - 1);
+}
+
+/* The highest value that goes in bucket @idx */
+static u64 io_lat__bucket_max(int idx)
+{
+	int shift;
+
+	if (idx < 2 * IO_LAT_SUB)
+		return idx;
+
+	shift = idx / IO_LAT_SUB - 1;
+	return ((u64)(IO_LAT_SUB + idx % IO_LAT_SUB + 1) << shift) - 1;
+}
+
+void io_lat__add(struct io_lat *lat, u64 nsecs)
+{
+	lat->count++;
+	lat->total += nsecs;
+	lat->min = min(lat->min, nsecs);
+	lat->max = max(lat->max, nsecs);
+	lat->buckets[io_lat__bucket(nsecs)]++;
+}
+
+void io_lat__merge(struct io_lat *dst, const struct io_lat *src)
+{
+	int i;
+
+	dst->count += src->count;
+	dst->total += src->total;
+	dst->min = min(dst->min, src->min);
+	dst->max = max(dst->max, src->max);
+	for (i = 0; i < IO_LAT_NR_BUCKETS; i++)
+		dst->buckets[i] += src->buckets[i];
+}
+
+u64 io_lat__percentile(const struct io_lat *lat, double pct)
+{
+	u64 target = lat->count * pct / 100.0, sum = 0;
+	int i;
+
+	if (!lat->count)
+		return 0;
+
+	for (i = 0; i < IO_LAT_NR_BUCKETS; i++) {
+		sum += lat->buckets[i];
+		if (sum > target)
+			break;
+	}
+
+	if (i >= IO_LAT_NR_BUCKETS)
+		return lat->max;
+	return clamp(io_lat__bucket_max(i), lat->min, lat->max);
+}
+
+void io_lat__fprintf(const struct io_lat *lat, FILE *fp)
+{
+	static const double pcts[] = { 50, 90, 99, 99.9 };
+	size_t i;
+
+	if (!lat->count)
+		return;
+
+	fprintf(fp, " %14s: %.2f usecs (min %.2f, max %.2f)\n", "Latency avg",
+		(double)lat->total / lat->count / NSEC_PER_USEC,
+		(double)lat->min / NSEC_PER_USEC,
+		(double)lat->max / NSEC_PER_USEC);
+
+	fprintf(fp, " %14s:", "percentiles");
+	for (i = 0; i < ARRAY_SIZE(pcts); i++) {
+		fprintf(fp, " p%g %.2f%s", pcts[i],
+			(double)io_lat__percentile(lat, pcts[i]) / NSEC_PER_USEC,
+			i == ARRAY_SIZE(pcts) - 1 ? " usecs\n" : ",");
+	}
+}
+
+#ifdef HAVE_IO_URING_SUPPORT
+static int sys_io_uring_setup(unsigned int entries, struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned int to_submit,
+			      unsigned int min_complete, unsigned int flags)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+		       flags, NULL, _NSIG / 8);
+}
+
+int io_ring__register(struct io_ring *ring, unsigned int opcode, void *arg,
+		      unsigned int nr_args)
+{
+	if (syscall(__NR_io_uring_register, ring->fd, opcode, arg, nr_args) < 0)
+		return -errno;
+	return 0;
+}
+
+int io_ring__init(struct io_ring *ring, unsigned int entries,
+		  unsigned int flags)
+{
+	struct io_uring_params p;
+	void *ptr;
+	int err;
+
+	memset(ring, 0, sizeof(*ring));
+	memset(&p, 0, sizeof(p));
+	p.flags = flags;
+
+	ring->fd = sys_io_uring_setup(entries, &p);
+	if (ring->fd < 0)
+		return -errno;
+	ring->flags = flags;
+
+	ring->sq_ring_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	ptr = mmap(NULL, ring->sq_ring_sz, PROT_READ | PROT_WRITE,
+		   MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (ptr == MAP_FAILED)
+		goto out_err;
+	ring->sq_ring = ptr;
+	ring->sq_head = ptr + p.sq_off.head;
+	ring->sq_tail = ptr + p.sq_off.tail;
+	ring->sq_flags = ptr + p.sq_off.flags;
+	ring->sq_array = ptr + p.sq_off.array;
+	ring->sq_mask = *(unsigned int *)(ptr + p.sq_off.ring_mask);
+	ring->sq_entries = p.sq_entries;
+	ring->sqe_tail = *ring->sq_tail;
+
+	ring->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+	ptr = mmap(NULL, ring->sqes_sz, PROT_READ | PROT_WRITE,
+		   MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+	if (ptr == MAP_FAILED)
+		goto out_err;
+	ring->sqes = ptr;
+
+	ring->cq_ring_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	ptr = mmap(NULL, ring->cq_ring_sz, PROT_READ | PROT_WRITE,
+		   MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+	if (ptr == MAP_FAILED)
+		goto out_err;
+	ring->cq_ring = ptr;
+	ring->cq_head = ptr + p.cq_off.head;
+	ring->cq_tail = ptr + p.cq_off.tail;
+	ring->cq_mask = *(unsigned int *)(ptr + p.cq_off.ring_mask);
+	ring->cqes = ptr + p.cq_off.cqes;
+
+	return 0;
+
+out_err:
+	err = -errno;
+	io_ring__exit(ring);
+	return err;
+}
+
+void io_ring__exit(struct io_ring *ring)
+{
+	if (ring->cq_ring)
+		munmap(ring->cq_ring, ring->cq_ring_sz);
+	if (ring->sqes)
+		munmap(ring->sqes, ring->sqes_sz);
+	if (ring->sq_ring)
+		munmap(ring->sq_ring, ring->sq_ring_sz);
+	close(ring->fd);
+	memset(ring, 0, sizeof(*ring));
+	ring->fd = -1;
+}
+
+/* Returns a cleared SQE, or NULL if the submission queue is full */
+struct io_uring_sqe *io_ring__get_sqe(struct io_ring *ring)
+{
+	unsigned int head = smp_load_acquire(ring->sq_head);
+	unsigned int idx = ring->sqe_tail & ring->sq_mask;
+	struct io_uring_sqe *sqe;
+
+	if (ring->sqe_tail - head >= ring->sq_entries)
+		return NULL;
+
+	sqe = &ring->sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	ring->sq_array[idx] = idx;
+	ring->sqe_tail++;
+	return sqe;
+}
+
+/*
+ * Submit the SQEs got since the last call, and wait for at least @wait_nr
+ * completions.  With SQPOLL the kernel thread picks them up by itself, only
+ * enter the kernel when it needs a wakeup or to wait.
+ */
+int io_ring__submit(struct io_ring *ring, unsigned int wait_nr)
+{
+	unsigned int to_submit = ring->sqe_tail - *ring->sq_tail;
+	unsigned int flags = wait_nr ? IORING_ENTER_GETEVENTS : 0;
+	int ret;
+
+	smp_store_release(ring->sq_tail, ring->sqe_tail);
+
+	if (ring->flags & IORING_SETUP_SQPOLL) {
+		/* order the tail store against the flags load */
+		smp_mb();
+		if (READ_ONCE(*ring->sq_flags) & IORING_SQ_NEED_WAKEUP)
+			flags |= IORING_ENTER_SQ_WAKEUP;
+		else if (!wait_nr)
+			return 0;
+	}
+
+	do {
+		ret = sys_io_uring_enter(ring->fd, to_submit, wait_nr, flags);
+	} while (ret < 0 && errno == EINTR);
+
+	return ret < 0 ? -errno : ret;
+}
+
+struct io_uring_cqe *io_ring__peek_cqe(struct io_ring *ring)
+{
+	unsigned int head = *ring->cq_head;
+
+	if (head == smp_load_acquire(ring->cq_tail))
+		return NULL;
+	return &ring->cqes[head & ring->cq_mask];
+}
+
+void io_ring__cqe_seen(struct io_ring *ring)
+{
+	smp_store_release(ring->cq_head, *ring->cq_head + 1);
+}
+#endif // HAVE_IO_URING_SUPPORT
@@ -0,0 +1,78 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef BENCH_IO_H
+#define BENCH_IO_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <linux/types.h>
+
+/*
+ * Log-linear latency histogram: values below 32 nsecs get a bucket each,
+ * above that every power of 2 is split in 16 buckets, so the percentiles
+ * are within ~6% of the real value.
+ */
+#define IO_LAT_SUB_BITS		4
+#define IO_LAT_SUB		(1 << IO_LAT_SUB_BITS)
+#define IO_LAT_NR_BUCKETS	(IO_LAT_SUB * 38)
+
+struct io_lat {
+	u64 count;
+	u64 total;
+	u64 min;
+	u64 max;
+	u64 buckets[IO_LAT_NR_BUCKETS];
+};
+
+void io_lat__init(struct io_lat *lat);
+void io_lat__add(struct io_lat *lat, u64 nsecs);
+void io_lat__merge(struct io_lat *dst, const struct io_lat *src);
+u64 io_lat__percentile(const struct io_lat *lat, double pct);
+void io_lat__fprintf(const struct io_lat *lat, FILE *fp);
+
+u64 io_bench__nsecs(void);
+
+#ifdef HAVE_IO_URING_SUPPORT
+/* for __DECLARE_FLEX_ARRAY, tools/include/linux/types.h doesn't pull it in */
+#include <linux/stddef.h>
+#include <linux/io_uring.h>
+
+/* A minimal io_uring, set up and driven with the raw system calls */
+struct io_ring {
+	int fd;
+	unsigned int flags;
+
+	unsigned int *sq_head;
+	unsigned int *sq_tail;
+	unsigned int *sq_flags;
+	unsigned int *sq_array;
+	unsigned int sq_mask;
+	unsigned int sq_entries;
+	/* SQEs handed out by io_ring__get_sqe(), not yet submitted */
+	unsigned int sqe_tail;
+	struct io_uring_sqe *sqes;
+
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int cq_mask;
+	struct io_uring_cqe *cqes;
+
+	void *sq_ring;
+	size_t sq_ring_sz;
+	void *cq_ring;
+	size_t cq_ring_sz;
+	size_t sqes_sz;
+};
+
+int io_ring__init(struct io_ring *ring, unsigned int entries,
+		  unsigned int flags);
+void io_ring__exit(struct io_ring *ring);
+int io_ring__register(struct io_ring *ring, unsigned int opcode, void *arg,
+		      unsigned int nr_args);
+
+struct io_uring_sqe *io_ring__get_sqe(struct io_ring *ring);
+int io_ring__submit(struct io_ring *ring, unsigned int wait_nr);
+struct io_uring_cqe *io_ring__peek_cqe(struct io_ring *ring);
+void io_ring__cqe_seen(struct io_ring *ring);
+#endif // HAVE_IO_URING_SUPPORT
+
+#endif
@@ -16,6 +16,7 @@
  *  numa  ... NUMA scheduling and MM performance
  *  futex ... Futex performance
  *  epoll ... Event poll performance
+ *  io    ... I/O submission performance
  */
 #include <subcmd/parse-options.h>
 #include "builtin.h"
@@ -84,6 +85,13 @@ static struct bench epoll_benchmarks[] = {
 };
 #endif // HAVE_EVENTFD_SUPPORT
 
+static struct bench io_benchmarks[] = {
+	{ "file",	"Benchmark psync vs aio vs io_uring file I/O",	bench_io_file		},
+	{ "net",	"Benchmark epoll vs io_uring loopback echo",	bench_io_net		},
+	{ "all",	"Run all I/O benchmarks",			NULL			},
+	{ NULL,		NULL,						NULL			}
+};
+
 static struct bench internals_benchmarks[] = {
 	{ "synthesize", "Benchmark perf event synthesis",	bench_synthesize	},
 	{ "kallsyms-parse", "Benchmark kallsyms parsing",	bench_kallsyms_parse	},
@@ -116,6 +124,7 @@ static struct collection collections[] = {
 #ifdef HAVE_EVENTFD_SUPPORT
 	{"epoll",       "Epoll stressing benchmarks",                   epoll_benchmarks        },
 #endif
+	{ "io",		"I/O submission benchmarks",			io_benchmarks		},
 	{ "internals",	"Perf-internals benchmarks",			internals_benchmarks	},
 	{ "breakpoint",	"Breakpoint benchmarks",			breakpoint_benchmarks	},
 	{ "all",	"All benchmarks",				NULL			},
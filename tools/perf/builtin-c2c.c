@@ -45,6 +45,13 @@
 #include "pmu.h"
 #include "pmu-hybrid.h"
 #include "string2.h"
+#include "strbuf.h"
+#include "hashmap.h"
+#include "parallel.h"
+#ifdef HAVE_DWARF_SUPPORT
+#include "dwarf-aux.h"
+#include "probe-finder.h"
+#endif
 
 struct c2c_hists {
 	struct hists		hists;
@@ -60,6 +67,25 @@ struct compute_stats {
 	struct stats		 load;
 };
 
+/*
+ * A struct, union or class (or a plain variable) with fields accessed on
+ * falsely shared cachelines, ranked by the HITMs (or peer snoops) there.
+ */
+struct c2c_data_field {
+	char			*name;
+	u64			 cost;
+	u64			 stores;
+};
+
+struct c2c_data_type {
+	char			*name;
+	u64			 cost;
+	int			 nr_clines;
+	unsigned int		 last_cline;
+	struct c2c_data_field	*fields;
+	int			 nr_fields;
+};
+
 struct c2c_hist_entry {
 	struct c2c_hists	*hists;
 	struct c2c_stats	 stats;
@@ -75,6 +101,11 @@ struct c2c_hist_entry {
 	bool			 paddr_zero;
 	char			*nodestr;
 
+	/* data structure field the accessed offset falls into */
+	char			*data_field;
+	char			*data_member;
+	struct c2c_data_type	*data_type;
+
 	/*
 	 * must be at the end,
 	 * because of its callchain dynamic entry
@@ -101,6 +132,13 @@ struct perf_c2c {
 	bool			 stats_only;
 	bool			 symbol_full;
 	bool			 stitch_lbr;
+	bool			 data_type;
+	unsigned int		 nr_threads;
+
+	/* DWARF data type attribution, see c2c__attribute_data_types() */
+	struct hashmap		*debuginfos;
+	struct hashmap		*data_vars;
+	struct hashmap		*data_types;
 
 	/* Shared cache line stats */
 	struct c2c_stats	shared_clines_stats;
@@ -185,6 +223,8 @@ static void c2c_he_free(void *he)
 	free(c2c_he->nodeset);
 	free(c2c_he->nodestr);
 	free(c2c_he->node_stats);
+	free(c2c_he->data_field);
+	free(c2c_he->data_member);
 	free(c2c_he);
 }
 
@@ -395,6 +435,7 @@ static struct perf_c2c c2c = {
 		.ordered_events	= true,
 		.ordering_requires_timestamps = true,
 	},
+	.data_type	= true,
 };
 
 static const char * const c2c_usage[] = {
@@ -1819,6 +1860,26 @@ static struct c2c_dimension dim_dcacheline_num_empty = {
 	.width		= 5,
 };
 
+static int
+data_field_entry(struct perf_hpp_fmt *fmt, struct perf_hpp *hpp,
+		 struct hist_entry *he)
+{
+	struct c2c_hist_entry *c2c_he;
+	int width = c2c_width(fmt, hpp, he->hists);
+
+	c2c_he = container_of(he, struct c2c_hist_entry, he);
+	return scnprintf(hpp->buf, hpp->size, "%*s", width,
+			 c2c_he->data_field ?: "");
+}
+
+static struct c2c_dimension dim_data_field = {
+	.header		= HEADER_BOTH("Data", "Field"),
+	.name		= "data_field",
+	.cmp		= empty_cmp,
+	.entry		= data_field_entry,
+	.width		= 5,
+};
+
 static struct c2c_dimension *dimensions[] = {
 	&dim_dcacheline,
 	&dim_dcacheline_node,
@@ -1875,6 +1936,7 @@ static struct c2c_dimension *dimensions[] = {
 	&dim_dcacheline_idx,
 	&dim_dcacheline_num,
 	&dim_dcacheline_num_empty,
+	&dim_data_field,
 	NULL,
 };
 
@@ -2200,7 +2262,16 @@ static void calc_width(struct c2c_hist_entry *c2c_he)
 	set_nodestr(c2c_he);
 }
 
-static int filter_cb(struct hist_entry *he, void *arg __maybe_unused)
+static int filter_valid_cb(struct hist_entry *he, void *arg __maybe_unused)
+{
+	if (!is_valid_hist_entry(he))
+		he->filtered = HIST_FILTER__C2C;
+
+	return 0;
+}
+
+/* srcline lookup and column widths go through state shared by all lines */
+static int filter_width_cb(struct hist_entry *he, void *arg __maybe_unused)
 {
 	struct c2c_hist_entry *c2c_he;
 
@@ -2210,15 +2281,29 @@ static int filter_cb(struct hist_entry *he, void *arg __maybe_unused)
 		he->srcline = hist_entry__srcline(he);
 
 	calc_width(c2c_he);
-
-	if (!is_valid_hist_entry(he))
-		he->filtered = HIST_FILTER__C2C;
-
 	return 0;
 }
 
-static int resort_cl_cb(struct hist_entry *he, void *arg __maybe_unused)
+static int filter_cb(struct hist_entry *he, void *arg)
+{
+	filter_width_cb(he, arg);
+	return filter_valid_cb(he, arg);
+}
+
+/*
+ * Every shared cacheline has its own hists of offsets, which don't share
+ * anything while being collapsed and sorted.  With --num-threads the lines
+ * are queued by resort_cl_cb() and handed out to a pool of threads, the
+ * parts touching global state are done afterwards, one line at a time.
+ */
+struct c2c_cl_resort {
+	struct c2c_hists	**clines;
+	int			 nr_clines;
+};
+
+static int resort_cl_cb(struct hist_entry *he, void *arg)
 {
+	struct c2c_cl_resort *work = arg;
 	struct c2c_hist_entry *c2c_he;
 	struct c2c_hists *c2c_hists;
 	bool display = he__display(he, &c2c.shared_clines_stats);
@@ -2234,6 +2319,11 @@ static int resort_cl_cb(struct hist_entry *he, void *arg __maybe_unused)
 
 		c2c_hists__reinit(c2c_hists, c2c.cl_output, c2c.cl_resort);
 
+		if (work) {
+			work->clines[work->nr_clines++] = c2c_hists;
+			return 0;
+		}
+
 		hists__collapse_resort(&c2c_hists->hists, NULL);
 		hists__output_resort_cb(&c2c_hists->hists, NULL, filter_cb);
 	}
@@ -2241,6 +2331,16 @@ static int resort_cl_cb(struct hist_entry *he, void *arg __maybe_unused)
 	return 0;
 }
 
+static int resort_cl_worker(int idx, void *arg)
+{
+	struct c2c_cl_resort *work = arg;
+	struct c2c_hists *c2c_hists = work->clines[idx];
+
+	hists__collapse_resort(&c2c_hists->hists, NULL);
+	hists__output_resort_cb(&c2c_hists->hists, NULL, filter_valid_cb);
+	return 0;
+}
+
 static struct c2c_header header_node_0 = HEADER_LOW("Node");
 static struct c2c_header header_node_1_hitms_stores =
 		HEADER_LOW("Node{cpus %hitms %stores}");
@@ -2347,7 +2447,8 @@ static int resort_shared_cl_cb(struct hist_entry *he, void *arg __maybe_unused)
 	return 0;
 }
 
-static int hists__iterate_cb(struct hists *hists, hists__resort_cb_t cb)
+static int hists__iterate_cb(struct hists *hists, hists__resort_cb_t cb,
+			     void *arg)
 {
 	struct rb_node *next = rb_first_cached(&hists->entries);
 	int ret = 0;
@@ -2356,7 +2457,7 @@ static int hists__iterate_cb(struct hists *hists, hists__resort_cb_t cb)
 		struct hist_entry *he;
 
 		he = rb_entry(next, struct hist_entry, rb_node);
-		ret = cb(he, NULL);
+		ret = cb(he, arg);
 		if (ret)
 			break;
 		next = rb_next(&he->rb_node);
@@ -2365,6 +2466,589 @@ static int hists__iterate_cb(struct hists *hists, hists__resort_cb_t cb)
 	return ret;
 }
 
+static int resort_cachelines(void)
+{
+	struct c2c_cl_resort work = { .nr_clines = 0, };
+	struct hists *hists = &c2c.hists.hists;
+	int i;
+
+	if (c2c.nr_threads <= 1)
+		return hists__iterate_cb(hists, resort_cl_cb, NULL);
+
+	work.clines = calloc(hists->nr_entries, sizeof(*work.clines));
+	if (!work.clines)
+		return -ENOMEM;
+
+	hists__iterate_cb(hists, resort_cl_cb, &work);
+
+	parallel_for(work.nr_clines, c2c.nr_threads, resort_cl_worker, &work);
+
+	for (i = 0; i < work.nr_clines; i++)
+		hists__iterate_cb(&work.clines[i]->hists, filter_width_cb, NULL);
+
+	free(work.clines);
+	return 0;
+}
+
+static size_t c2c__ptr_hash(const void *key, void *ctx __maybe_unused)
+{
+	return (size_t)key;
+}
+
+static bool c2c__ptr_equal(const void *key1, const void *key2,
+			   void *ctx __maybe_unused)
+{
+	return key1 == key2;
+}
+
+static size_t c2c__str_hash(const void *key, void *ctx __maybe_unused)
+{
+	return str_hash(key);
+}
+
+static bool c2c__str_equal(const void *key1, const void *key2,
+			   void *ctx __maybe_unused)
+{
+	return !strcmp(key1, key2);
+}
+
+#ifdef HAVE_DWARF_SUPPORT
+struct c2c_data_var {
+	Dwarf_Die		 die;
+	const char		*name;
+};
+
+static struct debuginfo *c2c__debuginfo(struct dso *dso)
+{
+	struct debuginfo *dinfo;
+	void *v;
+
+	if (hashmap__find(c2c.debuginfos, dso, &v))
+		return v;
+
+	/* remember the failures too, they are the expensive ones */
+	dinfo = debuginfo__new(dso->long_name);
+	if (hashmap__add(c2c.debuginfos, dso, dinfo)) {
+		debuginfo__delete(dinfo);
+		return NULL;
+	}
+	return dinfo;
+}
+
+struct find_var_arg {
+	const char	*name;
+	u64		 addr;
+	bool		 exact;
+};
+
+static int find_var_cb(Dwarf_Die *die, void *data)
+{
+	struct find_var_arg *arg = data;
+	Dwarf_Attribute attr;
+	Dwarf_Op *ops;
+	size_t nops;
+
+	switch (dwarf_tag(die)) {
+	case DW_TAG_namespace:
+		return DIE_FIND_CB_CONTINUE;
+	case DW_TAG_variable:
+		break;
+	default:
+		return DIE_FIND_CB_SIBLING;
+	}
+
+	if (!die_compare_name(die, arg->name) || !dwarf_hasattr(die, DW_AT_type))
+		return DIE_FIND_CB_SIBLING;
+
+	if (!arg->exact)
+		return DIE_FIND_CB_END;
+
+	if (dwarf_attr(die, DW_AT_location, &attr) &&
+	    !dwarf_getlocation(&attr, &ops, &nops) && nops == 1 &&
+	    ops[0].atom == DW_OP_addr && ops[0].number == arg->addr)
+		return DIE_FIND_CB_END;
+
+	return DIE_FIND_CB_SIBLING;
+}
+
+/*
+ * Find the DWARF variable of a data symbol, by its address first, which also
+ * tells apart statics of the same name, then by name alone, as the symbol
+ * address may have been adjusted.
+ */
+static bool c2c__find_variable(struct debuginfo *dinfo, const char *name,
+			       u64 addr, Dwarf_Die *var_die)
+{
+	struct find_var_arg arg = {
+		.name	= name,
+		.addr	= addr,
+	};
+	int pass;
+
+	for (pass = 0; pass < 2; pass++) {
+		Dwarf_Off off = 0, noff;
+		size_t cuhl;
+		Dwarf_Die cu_die;
+
+		arg.exact = pass == 0;
+
+		while (!dwarf_nextcu(dinfo->dbg, off, &noff, &cuhl, NULL, NULL, NULL)) {
+			if (dwarf_offdie(dinfo->dbg, off + cuhl, &cu_die) &&
+			    die_find_child(&cu_die, find_var_cb, &arg, var_die))
+				return true;
+			off = noff;
+		}
+	}
+
+	return false;
+}
+
+static struct c2c_data_var *c2c__data_var(struct dso *dso, struct symbol *sym)
+{
+	struct c2c_data_var *var = NULL;
+	struct debuginfo *dinfo;
+	const char *p;
+	char *name;
+	void *v;
+
+	if (hashmap__find(c2c.data_vars, sym, &v))
+		return v;
+
+	dinfo = c2c__debuginfo(dso);
+	if (!dinfo)
+		goto out;
+
+	/* DW_AT_name has no C++ scope, nor the .lto_priv and the like suffixes */
+	p = strrchr(sym->name, ':');
+	name = strdup(p ? p + 1 : sym->name);
+	if (!name)
+		goto out;
+	name[strcspn(name, ".")] = '\0';
+
+	var = zalloc(sizeof(*var));
+	if (var && c2c__find_variable(dinfo, name, sym->start, &var->die)) {
+		var->name = sym->name;
+	} else {
+		zfree(&var);
+	}
+	free(name);
+out:
+	if (hashmap__add(c2c.data_vars, sym, var))
+		zfree(&var);
+	return var;
+}
+
+static bool die_find_member_at(Dwarf_Die *type_die, Dwarf_Word offset,
+			       Dwarf_Die *mb_die, Dwarf_Word *mb_offset)
+{
+	if (dwarf_child(type_die, mb_die))
+		return false;
+
+	do {
+		Dwarf_Die mb_type;
+		Dwarf_Word off = 0, size;
+
+		if (dwarf_tag(mb_die) != DW_TAG_member &&
+		    dwarf_tag(mb_die) != DW_TAG_inheritance)
+			continue;
+		/* static class members live somewhere else */
+		if (dwarf_hasattr(mb_die, DW_AT_declaration))
+			continue;
+
+		/* union members have no location */
+		die_get_data_member_location(mb_die, &off);
+
+		if (!die_get_real_type(mb_die, &mb_type) ||
+		    dwarf_aggregate_size(&mb_type, &size))
+			continue;
+
+		if (offset >= off && offset < off + size) {
+			*mb_offset = off;
+			return true;
+		}
+	} while (!dwarf_siblingof(mb_die, mb_die));
+
+	return false;
+}
+
+static const char *die_tag_keyword(Dwarf_Die *type_die)
+{
+	switch (dwarf_tag(type_die)) {
+	case DW_TAG_structure_type:
+		return "struct";
+	case DW_TAG_union_type:
+		return "union";
+	case DW_TAG_class_type:
+		return "class";
+	default:
+		return NULL;
+	}
+}
+
+/*
+ * Walk down from the variable to the innermost member covering @offset,
+ * through nested structs and arrays, building the access path in @path.
+ * The innermost named struct/union/class and the member in it are returned
+ * in @type_name and @member, for a plain variable that's the variable.
+ */
+static int c2c__describe_offset(struct c2c_data_var *var, Dwarf_Word offset,
+				struct strbuf *path, char **type_name,
+				char **member)
+{
+	Dwarf_Die cur = var->die, type, elem;
+	const char *owner = NULL, *owner_kw = NULL, *mb_name = NULL;
+	int depth;
+
+	if (strbuf_addstr(path, var->name))
+		return -ENOMEM;
+
+	for (depth = 0; depth < 32; depth++) {
+		Dwarf_Word size, mb_offset;
+		const char *name;
+
+		if (!die_get_real_type(&cur, &type))
+			break;
+
+		if (dwarf_tag(&type) == DW_TAG_array_type) {
+			if (!die_get_real_type(&type, &elem) ||
+			    dwarf_aggregate_size(&elem, &size) || !size)
+				break;
+			if (strbuf_addf(path, "[%" PRIu64 "]", (u64)(offset / size)))
+				return -ENOMEM;
+			offset %= size;
+			cur = type;
+			continue;
+		}
+
+		if (!die_tag_keyword(&type) ||
+		    !die_find_member_at(&type, offset, &elem, &mb_offset))
+			break;
+
+		/* anonymous unions and base classes don't show up in the path */
+		name = dwarf_diename(&elem);
+		if (name) {
+			owner_kw = die_tag_keyword(&type);
+			owner = dwarf_diename(&type) ?: "<anon>";
+			mb_name = name;
+			if (strbuf_addf(path, ".%s", name))
+				return -ENOMEM;
+		}
+
+		offset -= mb_offset;
+		cur = elem;
+	}
+
+	if (owner) {
+		if (asprintf(type_name, "%s %s", owner_kw, owner) < 0)
+			return -ENOMEM;
+		*member = strdup(mb_name);
+	} else {
+		if (asprintf(type_name, "var %s", var->name) < 0)
+			return -ENOMEM;
+		*member = strdup(path->buf);
+	}
+
+	if (!*member) {
+		zfree(type_name);
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+static struct c2c_data_type *c2c__data_type(char *name)
+{
+	struct c2c_data_type *type;
+	void *v;
+
+	if (hashmap__find(c2c.data_types, name, &v)) {
+		free(name);
+		return v;
+	}
+
+	type = zalloc(sizeof(*type));
+	if (!type || hashmap__add(c2c.data_types, name, type)) {
+		free(type);
+		free(name);
+		return NULL;
+	}
+
+	type->name = name;
+	type->last_cline = -1U;
+	return type;
+}
+
+static void c2c_he__attribute_data_type(struct c2c_hist_entry *c2c_he)
+{
+	struct mem_info *mi = c2c_he->he.mem_info;
+	struct symbol *sym = mi ? mi->daddr.ms.sym : NULL;
+	struct map *map = mi ? mi->daddr.ms.map : NULL;
+	struct c2c_data_var *var;
+	struct strbuf path;
+	char *type_name = NULL;
+	int len;
+
+	if (c2c_he->data_field || !sym || !map || !map->dso)
+		return;
+
+	if (mi->daddr.al_addr < sym->start || mi->daddr.al_addr >= sym->end)
+		return;
+
+	var = c2c__data_var(map->dso, sym);
+	if (!var)
+		return;
+
+	if (strbuf_init(&path, 64))
+		return;
+
+	if (c2c__describe_offset(var, mi->daddr.al_addr - sym->start, &path,
+				 &type_name, &c2c_he->data_member)) {
+		strbuf_release(&path);
+		return;
+	}
+
+	c2c_he->data_field = strbuf_detach(&path, NULL);
+	c2c_he->data_type = c2c__data_type(type_name);
+
+	len = strlen(c2c_he->data_field);
+	if (len > dim_data_field.width)
+		dim_data_field.width = len;
+}
+#else
+static void c2c_he__attribute_data_type(struct c2c_hist_entry *c2c_he __maybe_unused)
+{
+}
+#endif /* HAVE_DWARF_SUPPORT */
+
+static u32 c2c_he__cost(struct c2c_hist_entry *c2c_he)
+{
+	switch (c2c.display) {
+	case DISPLAY_LCL_HITM:
+		return c2c_he->stats.lcl_hitm;
+	case DISPLAY_RMT_HITM:
+		return c2c_he->stats.rmt_hitm;
+	case DISPLAY_SNP_PEER:
+		return c2c_he->stats.tot_peer;
+	case DISPLAY_TOT_HITM:
+	default:
+		return c2c_he->stats.tot_hitm;
+	}
+}
+
+static struct c2c_data_field *c2c_data_type__field(struct c2c_data_type *type,
+						   const char *name)
+{
+	struct c2c_data_field *fields;
+	int i;
+
+	for (i = 0; i < type->nr_fields; i++) {
+		if (!strcmp(type->fields[i].name, name))
+			return &type->fields[i];
+	}
+
+	fields = realloc(type->fields, (type->nr_fields + 1) * sizeof(*fields));
+	if (!fields)
+		return NULL;
+
+	type->fields = fields;
+	fields = &type->fields[type->nr_fields];
+	fields->name = strdup(name);
+	if (!fields->name)
+		return NULL;
+
+	fields->cost = fields->stores = 0;
+	type->nr_fields++;
+	return fields;
+}
+
+/*
+ * Account the accesses of a cacheline to the data types they fall into, if
+ * it's falsely shared, i.e. more than one field of it is being accessed.
+ * Bouncing a line for a single field is true sharing, and padding won't
+ * help it.
+ */
+static void c2c__account_false_sharing(struct c2c_hist_entry *cl_he)
+{
+	struct hists *hists = &cl_he->hists->hists;
+	const char *first = NULL;
+	bool shared = false;
+	struct rb_node *nd;
+
+	for (nd = rb_first_cached(&hists->entries); nd; nd = rb_next(nd)) {
+		struct hist_entry *he = rb_entry(nd, struct hist_entry, rb_node);
+		struct c2c_hist_entry *c2c_he;
+
+		c2c_he = container_of(he, struct c2c_hist_entry, he);
+		c2c_he__attribute_data_type(c2c_he);
+
+		if (he->filtered || !c2c_he->data_field)
+			continue;
+
+		if (!first)
+			first = c2c_he->data_field;
+		else if (strcmp(first, c2c_he->data_field))
+			shared = true;
+	}
+
+	if (!shared)
+		return;
+
+	for (nd = rb_first_cached(&hists->entries); nd; nd = rb_next(nd)) {
+		struct hist_entry *he = rb_entry(nd, struct hist_entry, rb_node);
+		struct c2c_hist_entry *c2c_he;
+		struct c2c_data_type *type;
+		struct c2c_data_field *field;
+
+		c2c_he = container_of(he, struct c2c_hist_entry, he);
+		type = c2c_he->data_type;
+		if (he->filtered || !type)
+			continue;
+
+		field = c2c_data_type__field(type, c2c_he->data_member);
+		if (!field)
+			continue;
+
+		field->cost += c2c_he__cost(c2c_he);
+		field->stores += c2c_he->stats.store;
+		type->cost += c2c_he__cost(c2c_he);
+
+		if (type->last_cline != cl_he->cacheline_idx) {
+			type->last_cline = cl_he->cacheline_idx;
+			type->nr_clines++;
+		}
+	}
+}
+
+static void c2c__attribute_data_types(void)
+{
+	struct rb_node *nd;
+
+	if (!c2c.data_type)
+		return;
+
+	c2c.debuginfos = hashmap__new(c2c__ptr_hash, c2c__ptr_equal, NULL);
+	c2c.data_vars  = hashmap__new(c2c__ptr_hash, c2c__ptr_equal, NULL);
+	c2c.data_types = hashmap__new(c2c__str_hash, c2c__str_equal, NULL);
+	if (IS_ERR(c2c.debuginfos) || IS_ERR(c2c.data_vars) ||
+	    IS_ERR(c2c.data_types)) {
+		pr_debug("Not enough memory for data type attribution\n");
+		return;
+	}
+
+	for (nd = rb_first_cached(&c2c.hists.hists.entries); nd; nd = rb_next(nd)) {
+		struct hist_entry *he = rb_entry(nd, struct hist_entry, rb_node);
+		struct c2c_hist_entry *c2c_he;
+
+		c2c_he = container_of(he, struct c2c_hist_entry, he);
+		if (he->filtered || !c2c_he->hists)
+			continue;
+
+		c2c__account_false_sharing(c2c_he);
+	}
+}
+
+static void c2c__free_data_types(void)
+{
+	struct hashmap_entry *cur;
+	size_t bkt;
+	int i;
+
+	if (!IS_ERR_OR_NULL(c2c.data_types)) {
+		hashmap__for_each_entry(c2c.data_types, cur, bkt) {
+			struct c2c_data_type *type = cur->value;
+
+			for (i = 0; i < type->nr_fields; i++)
+				free(type->fields[i].name);
+			free(type->fields);
+			free(type->name);
+			free(type);
+		}
+	}
+	if (!IS_ERR_OR_NULL(c2c.data_vars)) {
+		hashmap__for_each_entry(c2c.data_vars, cur, bkt)
+			free(cur->value);
+	}
+#ifdef HAVE_DWARF_SUPPORT
+	if (!IS_ERR_OR_NULL(c2c.debuginfos)) {
+		hashmap__for_each_entry(c2c.debuginfos, cur, bkt)
+			debuginfo__delete(cur->value);
+	}
+#endif
+	hashmap__free(c2c.data_types);
+	hashmap__free(c2c.data_vars);
+	hashmap__free(c2c.debuginfos);
+}
+
+static int data_type_cmp(const void *a, const void *b)
+{
+	const struct c2c_data_type *l = *(const struct c2c_data_type **)a;
+	const struct c2c_data_type *r = *(const struct c2c_data_type **)b;
+
+	if (l->cost == r->cost)
+		return 0;
+	return l->cost < r->cost ? 1 : -1;
+}
+
+static int data_field_cmp(const void *a, const void *b)
+{
+	const struct c2c_data_field *l = a, *r = b;
+
+	if (l->cost == r->cost)
+		return 0;
+	return l->cost < r->cost ? 1 : -1;
+}
+
+static void print_false_sharing(FILE *out)
+{
+	struct c2c_data_type **types;
+	struct hashmap_entry *cur;
+	size_t bkt, nr = 0, i;
+	int j;
+
+	if (IS_ERR_OR_NULL(c2c.data_types) || !hashmap__size(c2c.data_types))
+		return;
+
+	types = calloc(hashmap__size(c2c.data_types), sizeof(*types));
+	if (!types)
+		return;
+
+	hashmap__for_each_entry(c2c.data_types, cur, bkt) {
+		struct c2c_data_type *type = cur->value;
+
+		if (type->nr_fields)
+			types[nr++] = type;
+	}
+	qsort(types, nr, sizeof(*types), data_type_cmp);
+
+	fprintf(out, "\n");
+	fprintf(out, "=================================================\n");
+	fprintf(out, "         False Sharing Data Types                \n");
+	fprintf(out, "=================================================\n");
+	fprintf(out, "#\n");
+	fprintf(out, "# %12s  %9s  %9s  %s\n", display_str[c2c.display],
+		"Lines", "Stores", "Data Type / Field");
+	fprintf(out, "# %12s  %9s  %9s  %s\n", "............",
+		".........", ".........", ".................");
+
+	for (i = 0; i < nr; i++) {
+		struct c2c_data_type *type = types[i];
+
+		qsort(type->fields, type->nr_fields, sizeof(*type->fields),
+		      data_field_cmp);
+
+		fprintf(out, "\n  %12" PRIu64 "  %9d  %9s  %s\n",
+			type->cost, type->nr_clines, "", type->name);
+
+		for (j = 0; j < type->nr_fields; j++) {
+			struct c2c_data_field *field = &type->fields[j];
+
+			fprintf(out, "  %12" PRIu64 "  %9s  %9" PRIu64 "    %s\n",
+				field->cost, "", field->stores, field->name);
+		}
+	}
+
+	free(types);
+}
+
 static void print_c2c__display_stats(FILE *out)
 {
 	int llc_misses;
@@ -2553,6 +3237,7 @@ static void perf_c2c__hists_fprintf(FILE *out, struct perf_session *session)
 	fprintf(out, "#\n");
 
 	print_pareto(out);
+	print_false_sharing(out);
 }
 
 #ifdef HAVE_SLANG_SUPPORT
@@ -2931,7 +3616,7 @@ static int build_cl_output(char *cl_sort, bool no_source)
 	}
 
 	if (asprintf(&c2c.cl_output,
-		"%s%s%s%s%s%s%s%s%s%s%s%s",
+		"%s%s%s%s%s%s%s%s%s%s%s%s%s",
 		c2c.use_stdio ? "cl_num_empty," : "",
 		c2c.display == DISPLAY_SNP_PEER ? "percent_rmt_peer,"
 						  "percent_lcl_peer," :
@@ -2941,6 +3626,7 @@ static int build_cl_output(char *cl_sort, bool no_source)
 		"percent_stores_l1miss,"
 		"percent_stores_na,"
 		"offset,offset_node,dcacheline_count,",
+		c2c.data_type ? "data_field," : "",
 		add_pid   ? "pid," : "",
 		add_tid   ? "tid," : "",
 		add_iaddr ? "iaddr," : "",
@@ -3037,6 +3723,10 @@ static int perf_c2c__report(int argc, const char **argv)
 	OPT_BOOLEAN('f', "force", &symbol_conf.force, "don't complain, do it"),
 	OPT_BOOLEAN(0, "stitch-lbr", &c2c.stitch_lbr,
 		    "Enable LBR callgraph stitching approach"),
+	OPT_BOOLEAN(0, "data-type", &c2c.data_type,
+		    "Attribute cacheline offsets to data type fields using DWARF"),
+	OPT_UINTEGER(0, "num-threads", &c2c.nr_threads,
+		     "Number of threads to sort the cachelines with"),
 	OPT_PARENT(c2c_options),
 	OPT_END()
 	};
@@ -3051,6 +3741,9 @@ static int perf_c2c__report(int argc, const char **argv)
 #ifndef HAVE_SLANG_SUPPORT
 	c2c.use_stdio = true;
 #endif
+#ifndef HAVE_DWARF_SUPPORT
+	c2c.data_type = false;
+#endif
 
 	if (c2c.stats_only)
 		c2c.use_stdio = true;
@@ -3184,10 +3877,17 @@ static int perf_c2c__report(int argc, const char **argv)
 
 	hists__collapse_resort(&c2c.hists.hists, NULL);
 	hists__output_resort_cb(&c2c.hists.hists, &prog, resort_shared_cl_cb);
-	hists__iterate_cb(&c2c.hists.hists, resort_cl_cb);
+	err = resort_cachelines();
 
 	ui_progress__finish();
 
+	if (err) {
+		pr_err("failed to sort cachelines\n");
+		goto out_mem2node;
+	}
+
+	c2c__attribute_data_types();
+
 	if (ui_quirks()) {
 		pr_err("failed to setup UI\n");
 		goto out_mem2node;
@@ -3196,6 +3896,7 @@ static int perf_c2c__report(int argc, const char **argv)
 	perf_c2c_display(session);
 
 out_mem2node:
+	c2c__free_data_types();
 	mem2node__exit(&c2c.mem2node);
 out_session:
 	perf_session__delete(session);
@@ -7,8 +7,12 @@
 
 #include "builtin.h"
 
+#include "util/bpf-aggr.h"
 #include "util/data.h"
 #include "util/kwork.h"
+#include "util/kwork-live.h"
+#include "util/machine.h"
+#include "util/map.h"
 #include "util/debug.h"
 #include "util/symbol.h"
 #include "util/thread.h"
@@ -21,6 +25,9 @@
 
 #include <errno.h>
 #include <inttypes.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
 #include <linux/err.h>
 #include <linux/time64.h>
 #include <linux/zalloc.h>
@@ -1665,6 +1672,350 @@ static int perf_kwork__record(struct perf_kwork *kwork,
 	return cmd_record(i, rec_argv);
 }
 
+/*
+ * perf kwork live: let a BPF program aggregate the delay and the runtime
+ * of each irq, softirq vector, work function and hrtimer function per cpu
+ * in the kernel, and only read and print the top offenders every interval.
+ * Nothing is recorded, so it is cheap enough to be left running.
+ */
+enum kwork_live_sort {
+	KWORK_LIVE_SORT_DELAY,
+	KWORK_LIVE_SORT_RUNTIME,
+	KWORK_LIVE_SORT_COUNT,
+};
+
+static const char * const kwork_live_class_names[KWORK_LIVE_CLASS_MAX] = {
+	[KWORK_LIVE_IRQ]	= "irq",
+	[KWORK_LIVE_SOFTIRQ]	= "softirq",
+	[KWORK_LIVE_WORKQUEUE]	= "workqueue",
+	[KWORK_LIVE_TIMER]	= "timer",
+};
+
+/* from softirq_to_name in kernel/softirq.c */
+static const char * const kwork_live_softirq_names[] = {
+	"HI", "TIMER", "NET_TX", "NET_RX", "BLOCK",
+	"IRQ_POLL", "TASKLET", "SCHED", "HRTIMER", "RCU",
+};
+
+static unsigned int live_interval = 1000;
+static unsigned int live_top = 10;
+static unsigned int live_map_entries = 10240;
+static const char *live_sort_str = "delay";
+static enum kwork_live_sort live_sort;
+static bool live_per_cpu;
+static bool live_hist;
+static volatile int live_done;
+
+static void live_sig_handler(int sig __maybe_unused)
+{
+	live_done = 1;
+}
+
+static int live_stat_id_cmp(const void *a, const void *b)
+{
+	const struct kwork_live_stat *l = a, *r = b;
+
+	if (l->class != r->class)
+		return l->class < r->class ? -1 : 1;
+	if (l->id != r->id)
+		return l->id < r->id ? -1 : 1;
+	if (live_per_cpu && l->cpu != r->cpu)
+		return l->cpu < r->cpu ? -1 : 1;
+	return 0;
+}
+
+static int live_stat_cmp(const void *a, const void *b)
+{
+	const struct kwork_live_data *l = &((const struct kwork_live_stat *)a)->data;
+	const struct kwork_live_data *r = &((const struct kwork_live_stat *)b)->data;
+	u64 lv, rv;
+
+	switch (live_sort) {
+	case KWORK_LIVE_SORT_RUNTIME:
+		lv = l->run_max;
+		rv = r->run_max;
+		break;
+	case KWORK_LIVE_SORT_COUNT:
+		lv = l->count;
+		rv = r->count;
+		break;
+	case KWORK_LIVE_SORT_DELAY:
+	default:
+		/* irqs have no delay, rank them by their runtime */
+		lv = l->delay_max ?: l->run_max;
+		rv = r->delay_max ?: r->run_max;
+		break;
+	}
+
+	if (lv == rv)
+		return 0;
+	return lv < rv ? 1 : -1;
+}
+
+/* sum up the entries of all cpus, unless --per-cpu */
+static void live_merge_stats(struct kwork_live *live)
+{
+	int i, j, k, nr = 0;
+
+	qsort(live->stats, live->nr_stats, sizeof(*live->stats),
+	      live_stat_id_cmp);
+
+	for (i = 0; i < live->nr_stats; i++) {
+		struct kwork_live_stat *dst = &live->stats[nr];
+		struct kwork_live_data *src = &live->stats[i].data;
+
+		if (!nr || live_stat_id_cmp(&live->stats[nr - 1], &live->stats[i])) {
+			if (i != nr)
+				*dst = live->stats[i];
+			nr++;
+			continue;
+		}
+
+		dst = &live->stats[nr - 1];
+		dst->data.count += src->count;
+		dst->data.delay_total += src->delay_total;
+		dst->data.delay_max = max(dst->data.delay_max, src->delay_max);
+		dst->data.run_total += src->run_total;
+		dst->data.run_max = max(dst->data.run_max, src->run_max);
+		for (k = 0; k < KWORK_LIVE_NR_SLOTS; k++) {
+			dst->data.delay_hist[k] += src->delay_hist[k];
+			dst->data.run_hist[k] += src->run_hist[k];
+		}
+		if (!dst->data.name[0])
+			memcpy(dst->data.name, src->name, sizeof(src->name));
+	}
+
+	for (j = nr; j < live->nr_stats; j++)
+		memset(&live->stats[j], 0, sizeof(live->stats[j]));
+	live->nr_stats = nr;
+}
+
+static void live_print_hist(const char *title, const __u64 *hist)
+{
+	if (!bpf_aggr__hist_count(hist, KWORK_LIVE_NR_SLOTS))
+		return;
+
+	printf("  %s\n", title);
+	bpf_aggr__fprintf_hist(stdout, hist, KWORK_LIVE_NR_SLOTS, 8, 1);
+}
+
+static void live_work_name(struct machine *machine, struct kwork_live_stat *st,
+			   char *buf, int len)
+{
+	struct symbol *sym = NULL;
+	struct map *kmap;
+
+	switch (st->class) {
+	case KWORK_LIVE_IRQ:
+		snprintf(buf, len, "%s:%" PRIu64 "",
+			 st->data.name[0] ? st->data.name : "<unknown>", st->id);
+		return;
+	case KWORK_LIVE_SOFTIRQ:
+		snprintf(buf, len, "(s)%s:%" PRIu64 "",
+			 st->id < ARRAY_SIZE(kwork_live_softirq_names) ?
+			 kwork_live_softirq_names[st->id] : "<unknown>", st->id);
+		return;
+	case KWORK_LIVE_WORKQUEUE:
+	case KWORK_LIVE_TIMER:
+		if (machine)
+			sym = machine__find_kernel_symbol(machine, st->id, &kmap);
+		if (sym)
+			snprintf(buf, len, "(%c)%s",
+				 st->class == KWORK_LIVE_TIMER ? 't' : 'w', sym->name);
+		else
+			snprintf(buf, len, "(%c)0x%" PRIx64 "",
+				 st->class == KWORK_LIVE_TIMER ? 't' : 'w', st->id);
+		return;
+	case KWORK_LIVE_CLASS_MAX:
+	default:
+		snprintf(buf, len, "<unknown>");
+		return;
+	}
+}
+
+static void live_print_ms(u64 nsec)
+{
+	printf(" %*.*f ms |", PRINT_LATENCY_WIDTH, RPINT_DECIMAL_WIDTH,
+	       (double)nsec / NSEC_PER_MSEC);
+}
+
+static int live_print_header(void)
+{
+	int ret;
+
+	printf("\n ");
+	ret = printf(" %-*s | %-*s | %-*s |",
+		     PRINT_KWORK_NAME_WIDTH, "Kwork Name",
+		     PRINT_CPU_WIDTH, "Cpu",
+		     PRINT_COUNT_WIDTH, "Count");
+	ret += printf(" %-*s | %-*s | %-*s | %-*s |",
+		      PRINT_LATENCY_HEADER_WIDTH, "Avg delay",
+		      PRINT_LATENCY_HEADER_WIDTH, "P99 delay",
+		      PRINT_LATENCY_HEADER_WIDTH, "Max delay",
+		      PRINT_RUNTIME_HEADER_WIDTH, "Max runtime");
+	printf("\n");
+	print_separator(ret);
+	return ret;
+}
+
+static void live_print_work(struct kwork_live_stat *st, struct machine *machine)
+{
+	struct kwork_live_data *data = &st->data;
+	u64 nr_delay = bpf_aggr__hist_count(data->delay_hist, KWORK_LIVE_NR_SLOTS);
+	char kwork_name[PRINT_KWORK_NAME_WIDTH];
+
+	live_work_name(machine, st, kwork_name, sizeof(kwork_name));
+	printf("  %-*s |", PRINT_KWORK_NAME_WIDTH, kwork_name);
+
+	if (live_per_cpu)
+		printf(" %0*u |", PRINT_CPU_WIDTH, st->cpu);
+	else
+		printf(" %-*s |", PRINT_CPU_WIDTH, "all");
+
+	printf(" %*" PRIu64 " |", PRINT_COUNT_WIDTH, (u64)data->count);
+
+	/* avg, p99 and max delay, irqs have none */
+	if (nr_delay) {
+		live_print_ms(data->delay_total / nr_delay);
+		live_print_ms(bpf_aggr__hist_percentile(data->delay_hist,
+							KWORK_LIVE_NR_SLOTS, 99,
+							1, data->delay_max));
+		live_print_ms(data->delay_max);
+	} else {
+		printf(" %*s | %*s | %*s |",
+		       PRINT_LATENCY_HEADER_WIDTH, "-",
+		       PRINT_LATENCY_HEADER_WIDTH, "-",
+		       PRINT_LATENCY_HEADER_WIDTH, "-");
+	}
+
+	live_print_ms(data->run_max);
+	printf("\n");
+
+	if (live_hist) {
+		live_print_hist("delay:", data->delay_hist);
+		live_print_hist("runtime:", data->run_hist);
+	}
+}
+
+static void output_kwork_live(struct kwork_live *live, struct machine *machine,
+			      double interval)
+{
+	u64 all_count = 0;
+	int i, len;
+
+	live_merge_stats(live);
+	qsort(live->stats, live->nr_stats, sizeof(*live->stats), live_stat_cmp);
+
+	len = live_print_header();
+
+	for (i = 0; i < live->nr_stats; i++) {
+		all_count += live->stats[i].data.count;
+		if (!live_top || i < (int)live_top)
+			live_print_work(&live->stats[i], machine);
+	}
+
+	print_separator(len);
+	printf("  Total count: %9" PRIu64 ", %d works in %.3f s\n",
+	       all_count, live->nr_stats, interval);
+
+	if (live->lost) {
+		printf("  WARNING: %d kwork events not accounted, try a bigger --map-nr-entries\n",
+		       live->lost);
+	}
+	if (live->collisions) {
+		printf("  INFO: %d works were queued again before they finished running\n",
+		       live->collisions);
+	}
+	fflush(stdout);
+}
+
+/* unlike the other subcommands, hrtimers can be profiled too */
+static unsigned int live_class_mask(struct perf_kwork *kwork,
+				    const struct option *options,
+				    const char * const usage_msg[])
+{
+	unsigned int mask = 0;
+	char *tmp, *tok, *str;
+	int i;
+
+	if (kwork->event_list_str == NULL)
+		return (1 << KWORK_LIVE_CLASS_MAX) - 1;
+
+	str = strdup(kwork->event_list_str);
+	for (tok = strtok_r(str, ", ", &tmp);
+	     tok; tok = strtok_r(NULL, ", ", &tmp)) {
+		for (i = 0; i < KWORK_LIVE_CLASS_MAX; i++) {
+			if (strcmp(tok, kwork_live_class_names[i]) == 0) {
+				mask |= 1 << i;
+				break;
+			}
+		}
+		if (i == KWORK_LIVE_CLASS_MAX) {
+			usage_with_options_msg(usage_msg, options,
+					       "Unknown --event key: `%s'", tok);
+		}
+	}
+	free(str);
+
+	return mask ?: (1 << KWORK_LIVE_CLASS_MAX) - 1;
+}
+
+static int perf_kwork__live(struct perf_kwork *kwork, unsigned int class_mask)
+{
+	struct kwork_live live = {
+		.class_mask	= class_mask,
+		.cpu_list	= kwork->cpu_list,
+		.map_nr_entries	= live_map_entries,
+	};
+	struct machine *machine = NULL;
+	struct timespec start, now;
+	int err = -1;
+
+	if (!live_interval)
+		live_interval = 1000;
+
+	if (symbol__init(NULL) == 0)
+		machine = machine__new_host();
+	if (machine == NULL)
+		pr_warning("Failed to read kernel symbols, showing raw addresses\n");
+
+	if (kwork_live_prepare(&live) < 0) {
+#ifdef HAVE_BPF_SKEL
+		pr_err("kwork live BPF setup failed\n");
+#else
+		pr_err("kwork live needs perf built with BUILD_BPF_SKEL=1\n");
+#endif
+		goto out;
+	}
+
+	signal(SIGINT, live_sig_handler);
+	signal(SIGTERM, live_sig_handler);
+
+	kwork_live_start();
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	while (!live_done) {
+		usleep(live_interval * USEC_PER_MSEC);
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		err = kwork_live_read(&live);
+		if (err)
+			break;
+
+		output_kwork_live(&live, machine,
+				  (now.tv_sec - start.tv_sec) +
+				  (now.tv_nsec - start.tv_nsec) / (double)NSEC_PER_SEC);
+		start = now;
+	}
+
+	kwork_live_stop();
+out:
+	kwork_live_finish(&live);
+	if (machine)
+		machine__delete(machine);
+	return err;
+}
+
 int cmd_kwork(int argc, const char **argv)
 {
 	static struct perf_kwork kwork = {
@@ -1766,6 +2117,23 @@ int cmd_kwork(int argc, const char **argv)
 		   "input file name"),
 	OPT_PARENT(kwork_options)
 	};
+	const struct option live_options[] = {
+	OPT_UINTEGER('I', "interval", &live_interval,
+		     "print stats every N msecs (default: 1000)"),
+	OPT_UINTEGER('N', "top", &live_top,
+		     "show only the N worst kwork, 0 for all (default: 10)"),
+	OPT_STRING('s', "sort", &live_sort_str, "key",
+		   "sort by key: delay, runtime, count (default: delay)"),
+	OPT_STRING('C', "cpu", &kwork.cpu_list, "cpu",
+		   "list of cpus to profile"),
+	OPT_BOOLEAN(0, "per-cpu", &live_per_cpu,
+		    "show stats per cpu instead of summing them up"),
+	OPT_BOOLEAN('H', "hist", &live_hist,
+		    "show delay and runtime histograms"),
+	OPT_UINTEGER(0, "map-nr-entries", &live_map_entries,
+		     "max number of BPF map entries (default: 10240)"),
+	OPT_PARENT(kwork_options)
+	};
 	const char *kwork_usage[] = {
 		NULL,
 		NULL
@@ -1782,8 +2150,12 @@ int cmd_kwork(int argc, const char **argv)
 		"perf kwork timehist [<options>]",
 		NULL
 	};
+	const char * const live_usage[] = {
+		"perf kwork live [<options>]",
+		NULL
+	};
 	const char *const kwork_subcommands[] = {
-		"record", "report", "latency", "timehist", NULL
+		"record", "report", "latency", "timehist", "live", NULL
 	};
 
 	argc = parse_options_subcommand(argc, argv, kwork_options,
@@ -1792,6 +2164,29 @@ int cmd_kwork(int argc, const char **argv)
 	if (!argc)
 		usage_with_options(kwork_usage, kwork_options);
 
+	if (strlen(argv[0]) > 2 && strstarts("live", argv[0])) {
+		unsigned int class_mask;
+
+		if (argc > 1) {
+			argc = parse_options(argc, argv, live_options, live_usage, 0);
+			if (argc)
+				usage_with_options(live_usage, live_options);
+		}
+		class_mask = live_class_mask(&kwork, live_options, live_usage);
+
+		if (!strcmp(live_sort_str, "delay"))
+			live_sort = KWORK_LIVE_SORT_DELAY;
+		else if (!strcmp(live_sort_str, "runtime"))
+			live_sort = KWORK_LIVE_SORT_RUNTIME;
+		else if (!strcmp(live_sort_str, "count"))
+			live_sort = KWORK_LIVE_SORT_COUNT;
+		else
+			usage_with_options_msg(live_usage, live_options,
+					       "Unknown --sort key: `%s'", live_sort_str);
+
+		return perf_kwork__live(&kwork, class_mask);
+	}
+
 	setup_event_list(&kwork, kwork_options, kwork_usage);
 	sort_dimension__add(&kwork, "id", &kwork.cmp_id);
 
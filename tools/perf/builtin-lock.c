@@ -11,7 +11,9 @@
 #include "util/header.h"
 #include "util/target.h"
 #include "util/callchain.h"
+#include "util/bpf-aggr.h"
 #include "util/lock-contention.h"
+#include "util/lock-hist.h"
 
 #include <subcmd/pager.h>
 #include <subcmd/parse-options.h>
@@ -30,6 +32,8 @@
 #include <semaphore.h>
 #include <math.h>
 #include <limits.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <linux/list.h>
 #include <linux/hash.h>
@@ -37,6 +41,7 @@
 #include <linux/zalloc.h>
 #include <linux/err.h>
 #include <linux/stringify.h>
+#include <linux/time64.h>
 
 static struct perf_session *session;
 static struct target target;
@@ -59,6 +64,11 @@ static unsigned long bpf_map_entries = 10240;
 static int max_stack_depth = CONTENTION_STACK_DEPTH;
 static int stack_skip = CONTENTION_STACK_SKIP;
 static int print_nr_entries = INT_MAX / 2;
+static bool show_lock_hist;
+static bool aggr_lock_addr;
+static int contention_interval;
+static const char *cgroup_filter;
+static volatile int done;
 
 static enum {
 	LOCK_AGGR_ADDR,
@@ -1445,7 +1455,7 @@ static void sort_result(void)
 	}
 }
 
-static const char *get_type_str(struct lock_stat *st)
+static const char *get_type_str(unsigned int flags)
 {
 	static const struct {
 		unsigned int flags;
@@ -1467,7 +1477,7 @@ static const char *get_type_str(struct lock_stat *st)
 	};
 
 	for (unsigned int i = 0; i < ARRAY_SIZE(table); i++) {
-		if (table[i].flags == st->flags)
+		if (table[i].flags == flags)
 			return table[i].name;
 	}
 	return "unknown";
@@ -1518,7 +1528,7 @@ static void print_contention_result(struct lock_contention *con)
 			goto next;
 		}
 
-		pr_info("  %10s   %s\n", get_type_str(st), st->name);
+		pr_info("  %10s   %s\n", get_type_str(st->flags), st->name);
 		if (verbose) {
 			struct map *kmap;
 			struct symbol *sym;
@@ -1626,6 +1636,177 @@ static int __cmd_report(bool display_info)
 
 static void sighandler(int sig __maybe_unused)
 {
+	done = 1;
+}
+
+/*
+ * The histogram mode keeps log2 histograms of the wait time for each lock
+ * type and caller (and lock address with --lock-addr) in a BPF map, so it
+ * is cheap enough to leave running and to dump the stats every interval.
+ */
+static bool use_lock_hist(void)
+{
+	return show_lock_hist || aggr_lock_addr || contention_interval ||
+	       cgroup_filter;
+}
+
+static u64 lock_hist__avg(const struct lock_hist_data *data)
+{
+	return data->count ? data->total / data->count : 0;
+}
+
+static int lock_hist__cmp(const void *a, const void *b)
+{
+	const struct lock_hist_entry *l = a, *r = b;
+	const struct lock_hist_data *ld = &l->data, *rd = &r->data;
+	u64 lv, rv;
+
+	if (!strcmp(sort_key, "contended")) {
+		lv = ld->count;
+		rv = rd->count;
+	} else if (!strcmp(sort_key, "wait_max")) {
+		lv = ld->max;
+		rv = rd->max;
+	} else if (!strcmp(sort_key, "wait_min")) {
+		lv = ld->min;
+		rv = rd->min;
+	} else if (!strcmp(sort_key, "avg_wait")) {
+		lv = lock_hist__avg(ld);
+		rv = lock_hist__avg(rd);
+	} else {
+		lv = ld->total;
+		rv = rd->total;
+	}
+
+	if (lv == rv)
+		return 0;
+	return lv < rv ? 1 : -1;
+}
+
+static void lock_hist__caller(struct machine *machine, u64 *callstack,
+			      char *buf, int size)
+{
+	struct map *kmap;
+	struct symbol *sym;
+	int i;
+
+	for (i = stack_skip; callstack && i < max_stack_depth; i++) {
+		u64 ip = callstack[i];
+
+		if (!ip)
+			break;
+
+		/* skip lock internal functions */
+		if (is_lock_function(machine, ip))
+			continue;
+
+		sym = machine__find_kernel_symbol(machine, ip, &kmap);
+		if (sym) {
+			get_symbol_name_offset(kmap, sym, ip, buf, size);
+			return;
+		}
+	}
+	strlcpy(buf, "unknown", size);
+}
+
+static void print_lock_hist(struct lock_hist *hist, struct machine *machine)
+{
+	char buf[128];
+	int i, nr;
+
+	qsort(hist->entries, hist->nr_entries, sizeof(*hist->entries),
+	      lock_hist__cmp);
+
+	pr_info("%10s %12s %12s %12s %12s %12s %14s   %s\n", "contended",
+		"total wait", "max wait", "avg wait", "p50 wait", "p99 wait",
+		"type", aggr_lock_addr ? "lock address / caller" : "caller");
+	pr_info("\n");
+
+	nr = min(hist->nr_entries, print_nr_entries);
+	for (i = 0; i < nr; i++) {
+		struct lock_hist_entry *entry = &hist->entries[i];
+		struct lock_hist_data *data = &entry->data;
+
+		pr_info("%10" PRIu64 " ", (u64)data->count);
+		lock_stat_key_print_time(data->total, 12);
+		lock_stat_key_print_time(data->max, 12);
+		lock_stat_key_print_time(lock_hist__avg(data), 12);
+		lock_stat_key_print_time(bpf_aggr__hist_percentile(data->hist,
+					LOCK_HIST_NR_SLOTS, 50, 1, data->max), 12);
+		lock_stat_key_print_time(bpf_aggr__hist_percentile(data->hist,
+					LOCK_HIST_NR_SLOTS, 99, 1, data->max), 12);
+		pr_info(" %14s   ", get_type_str(entry->key.flags));
+
+		if (aggr_lock_addr) {
+			struct map *kmap;
+			struct symbol *sym;
+
+			/* static locks have a symbol, dynamic ones don't */
+			sym = machine__find_kernel_symbol(machine,
+							  entry->key.lock_addr,
+							  &kmap);
+			pr_info("%#" PRIx64 " %s ", (u64)entry->key.lock_addr,
+				sym ? sym->name : "");
+		}
+
+		lock_hist__caller(machine, entry->callstack, buf, sizeof(buf));
+		pr_info("%s\n", buf);
+
+		if (show_lock_hist) {
+			/* pr_info() prints to stderr */
+			bpf_aggr__fprintf_hist(stderr, data->hist,
+					       LOCK_HIST_NR_SLOTS, 16, 1);
+			pr_info("\n");
+		}
+	}
+
+	if (hist->lost)
+		pr_info("\n=== lost %d contention entries (map full or stack lost) ===\n",
+			hist->lost);
+}
+
+static int __cmd_contention_hist(struct lock_hist *hist, struct machine *machine,
+				 int argc)
+{
+	int err;
+
+	lock_hist_start();
+	if (argc)
+		evlist__start_workload(hist->evlist);
+
+	if (!contention_interval)
+		setup_pager();
+
+	while (true) {
+		if (contention_interval)
+			usleep(contention_interval * USEC_PER_MSEC);
+		else
+			pause();
+
+		if (done)
+			lock_hist_stop();
+
+		err = lock_hist_read(hist);
+		if (err < 0) {
+			pr_err("failed to read lock contention stats\n");
+			break;
+		}
+
+		if (contention_interval) {
+			time_t now = time(NULL);
+			char tbuf[32];
+
+			strftime(tbuf, sizeof(tbuf), "%H:%M:%S", localtime(&now));
+			pr_info("\n%s\n", tbuf);
+		}
+		print_lock_hist(hist, machine);
+
+		if (done || !contention_interval)
+			break;
+	}
+
+	lock_hist_stop();
+	return err;
 }
 
 static int __cmd_contention(int argc, const char **argv)
@@ -1649,6 +1830,19 @@ static int __cmd_contention(int argc, const char **argv)
 		.max_stack = max_stack_depth,
 		.stack_skip = stack_skip,
 	};
+	struct lock_hist hist = {
+		.target = &target,
+		.cgroups = cgroup_filter,
+		.map_nr_entries = bpf_map_entries,
+		.max_stack = max_stack_depth,
+		.aggr_addr = aggr_lock_addr,
+	};
+
+	if (use_lock_hist() && (!use_bpf || show_thread_stats)) {
+		pr_err("--hist, --lock-addr, --interval and --cgroup-filter "
+		       "need -b and don't work with -t\n");
+		return -EINVAL;
+	}
 
 	session = perf_session__new(use_bpf ? NULL : &data, &eops);
 	if (IS_ERR(session)) {
@@ -1693,6 +1887,23 @@ static int __cmd_contention(int argc, const char **argv)
 				goto out_delete;
 		}
 
+		if (use_lock_hist()) {
+			/* the histograms are sorted by the same keys */
+			err = select_key(true);
+			if (err < 0)
+				goto out_delete;
+
+			hist.evlist = con.evlist;
+			err = lock_hist_prepare(&hist);
+			if (err < 0) {
+				pr_err("lock contention BPF setup failed\n");
+				goto out_delete;
+			}
+
+			err = __cmd_contention_hist(&hist, con.machine, argc);
+			goto out_delete;
+		}
+
 		if (lock_contention_prepare(&con) < 0) {
 			pr_err("lock contention BPF setup failed\n");
 			goto out_delete;
@@ -1752,6 +1963,7 @@ static int __cmd_contention(int argc, const char **argv)
 out_delete:
 	evlist__delete(con.evlist);
 	lock_contention_finish();
+	lock_hist_finish(&hist);
 	perf_session__delete(session);
 	return err;
 }
@@ -1920,6 +2132,14 @@ int cmd_lock(int argc, const char **argv)
 		    "Set the number of stack depth to skip when finding a lock caller, "
 		    "Default: " __stringify(CONTENTION_STACK_SKIP)),
 	OPT_INTEGER('E', "entries", &print_nr_entries, "display this many functions"),
+	OPT_BOOLEAN(0, "hist", &show_lock_hist,
+		    "show log2 histograms of the wait time (with -b)"),
+	OPT_BOOLEAN(0, "lock-addr", &aggr_lock_addr,
+		    "aggregate stats per lock address and caller (with -b)"),
+	OPT_INTEGER('I', "interval", &contention_interval,
+		    "print and reset the stats every N msecs (with -b)"),
+	OPT_STRING('G', "cgroup-filter", &cgroup_filter, "cgroups",
+		   "only collect contention in these cgroups (with -b)"),
 	OPT_PARENT(lock_options)
 	};
 
@@ -1984,6 +2204,14 @@ int cmd_lock(int argc, const char **argv)
 #ifndef HAVE_BPF_SKEL
 		set_option_nobuild(contention_options, 'b', "use-bpf",
 				   "no BUILD_BPF_SKEL=1", false);
+		set_option_nobuild(contention_options, 0, "hist",
+				   "no BUILD_BPF_SKEL=1", false);
+		set_option_nobuild(contention_options, 0, "lock-addr",
+				   "no BUILD_BPF_SKEL=1", false);
+		set_option_nobuild(contention_options, 'I', "interval",
+				   "no BUILD_BPF_SKEL=1", false);
+		set_option_nobuild(contention_options, 'G', "cgroup-filter",
+				   "no BUILD_BPF_SKEL=1", false);
 #endif
 		if (argc) {
 			argc = parse_options(argc, argv, contention_options,
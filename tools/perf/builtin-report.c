@@ -42,6 +42,7 @@
 #include "util/thread.h"
 #include "util/sort.h"
 #include "util/hist.h"
+#include "util/hist-parallel.h"
 #include "util/data.h"
 #include "arch/common.h"
 #include "util/time-utils.h"
@@ -93,6 +94,7 @@ struct report {
 	bool			disable_order;
 	bool			skip_empty;
 	int			max_stack;
+	unsigned int		nr_threads;
 	struct perf_read_values	show_threads_values;
 	struct annotation_options annotation_opts;
 	const char		*pretty_printing_style;
@@ -678,10 +680,31 @@ static int report__browse_hists(struct report *rep)
 	return ret;
 }
 
+/*
+ * With --num-threads the hists are collapsed and sorted for output by a pool
+ * of threads, see util/hist-parallel.c.  Samples are still processed and
+ * added to the hists by the main thread.
+ */
+static bool report__parallel_resort(struct report *rep)
+{
+	/*
+	 * IPC annotation and source line lookup go through per symbol and per
+	 * DSO state that is shared between events, keep those single threaded.
+	 */
+	if (rep->symbol_ipc)
+		return false;
+	if ((sort_order && strstr(sort_order, "src")) ||
+	    (field_order && strstr(field_order, "src")))
+		return false;
+
+	return rep->nr_threads > 1;
+}
+
 static int report__collapse_hists(struct report *rep)
 {
 	struct ui_progress prog;
 	struct evsel *pos;
+	bool parallel = report__parallel_resort(rep);
 	int ret = 0;
 
 	ui_progress__init(&prog, rep->nr_entries, "Merging related events...");
@@ -694,6 +717,9 @@ static int report__collapse_hists(struct report *rep)
 
 		hists->socket_filter = rep->socket_filter;
 
+		if (parallel)
+			continue;
+
 		ret = hists__collapse_resort(hists, &prog);
 		if (ret < 0)
 			break;
@@ -707,6 +733,25 @@ static int report__collapse_hists(struct report *rep)
 		}
 	}
 
+	if (parallel) {
+		ret = evlist__collapse_resort_parallel(rep->session->evlist,
+						       rep->nr_threads, &prog);
+
+		/* linking needs both the leader and the member collapsed */
+		evlist__for_each_entry(rep->session->evlist, pos) {
+			if (ret < 0)
+				break;
+
+			if (symbol_conf.event_group && !evsel__is_group_leader(pos)) {
+				struct hists *leader_hists = evsel__hists(evsel__leader(pos));
+				struct hists *hists = evsel__hists(pos);
+
+				hists__match(leader_hists, hists);
+				hists__link(leader_hists, hists);
+			}
+		}
+	}
+
 	ui_progress__finish();
 	return ret;
 }
@@ -733,6 +778,13 @@ static void report__output_resort(struct report *rep)
 
 	ui_progress__init(&prog, rep->nr_entries, "Sorting events for output...");
 
+	if (report__parallel_resort(rep) &&
+	    evlist__output_resort_parallel(rep->session->evlist, rep->nr_threads,
+					   &prog, hists__resort_cb, rep) == 0) {
+		ui_progress__finish();
+		return;
+	}
+
 	evlist__for_each_entry(rep->session->evlist, pos) {
 		evsel__output_resort_cb(pos, &prog, hists__resort_cb, rep);
 	}
@@ -1241,6 +1293,8 @@ int cmd_report(int argc, const char **argv)
 		    "Show a column with the number of samples"),
 	OPT_BOOLEAN('T', "threads", &report.show_threads,
 		    "Show per-thread event counters"),
+	OPT_UINTEGER(0, "num-threads", &report.nr_threads,
+		     "Number of threads to collapse and sort the histograms with, samples are still processed by a single thread"),
 	OPT_STRING(0, "pretty", &report.pretty_printing_style, "key",
 		   "pretty printing style key: normal raw"),
 #ifdef HAVE_SLANG_SUPPORT
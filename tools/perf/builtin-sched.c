@@ -20,6 +20,8 @@
 #include "util/string2.h"
 #include "util/callchain.h"
 #include "util/time-utils.h"
+#include "util/bpf-aggr.h"
+#include "util/sched-latency.h"
 
 #include <subcmd/pager.h>
 #include <subcmd/parse-options.h>
@@ -33,12 +35,17 @@
 #include <linux/zalloc.h>
 #include <sys/prctl.h>
 #include <sys/resource.h>
+#include <sys/stat.h>
 #include <inttypes.h>
 
 #include <errno.h>
+#include <ftw.h>
 #include <semaphore.h>
 #include <pthread.h>
 #include <math.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
 #include <api/fs/fs.h>
 #include <perf/cpumap.h>
 #include <linux/time64.h>
@@ -247,6 +254,12 @@ struct perf_sched {
 	struct perf_time_interval ptime;
 	struct perf_time_interval hist_time;
 	volatile bool   thread_funcs_exit;
+
+	/* options for latency --live */
+	bool		live;
+	bool		live_cgroup;
+	unsigned int	live_interval;
+	unsigned int	live_map_entries;
 };
 
 /* per thread run time data */
@@ -3234,6 +3247,163 @@ static int perf_sched__lat(struct perf_sched *sched)
 	return 0;
 }
 
+static volatile int live_done;
+
+static void live_sig_handler(int sig __maybe_unused)
+{
+	live_done = 1;
+}
+
+static struct sched_latency *live_lat;
+static size_t live_cgroup_root_len;
+
+/* cgroup v2 ids are the inode numbers of the cgroup directories */
+static int live_cgroup_walk(const char *fpath, const struct stat *sb,
+			    int typeflag, struct FTW *ftwbuf __maybe_unused)
+{
+	int i;
+
+	if (typeflag != FTW_D)
+		return 0;
+
+	for (i = 0; i < live_lat->nr_stats; i++) {
+		struct sched_latency_stat *st = &live_lat->stats[i];
+		const char *name = fpath + live_cgroup_root_len;
+
+		if (st->name || st->id != sb->st_ino)
+			continue;
+
+		st->name = strdup(*name ? name : "/");
+	}
+	return 0;
+}
+
+static void live_resolve_cgroups(struct sched_latency *lat)
+{
+	char mnt[PATH_MAX];
+
+	if (cgroupfs_find_mountpoint(mnt, sizeof(mnt), "perf_event"))
+		return;
+
+	live_lat = lat;
+	live_cgroup_root_len = strlen(mnt);
+	nftw(mnt, live_cgroup_walk, 16, FTW_PHYS);
+	live_lat = NULL;
+}
+
+static int live_stat_cmp(const void *a, const void *b)
+{
+	const struct sched_latency_stat *l = a, *r = b;
+
+	if (l->max == r->max)
+		return 0;
+	return l->max < r->max ? 1 : -1;
+}
+
+/* upper bound of the latency of the 99th percentile, in nsec */
+static void output_lat_live(struct sched_latency *lat, double interval)
+{
+	u64 all_count = 0, all_total = 0, all_max = 0;
+	int i, j, ret;
+
+	if (lat->aggr_mode == SCHED_LAT_AGGR_CGROUP)
+		live_resolve_cgroups(lat);
+
+	qsort(lat->stats, lat->nr_stats, sizeof(*lat->stats), live_stat_cmp);
+
+	printf("\n -------------------------------------------------------------------------------------------------\n");
+	printf("  %-22s| Switches | Avg delay ms    | P99 delay ms     | Max delay ms    |\n",
+	       lat->aggr_mode == SCHED_LAT_AGGR_CGROUP ? "Cgroup" : "Task");
+	printf(" -------------------------------------------------------------------------------------------------\n");
+
+	for (i = 0; i < lat->nr_stats; i++) {
+		struct sched_latency_stat *st = &lat->stats[i];
+
+		if (!st->count)
+			continue;
+
+		all_count += st->count;
+		all_total += st->total;
+		if (all_max < st->max)
+			all_max = st->max;
+
+		if (lat->aggr_mode == SCHED_LAT_AGGR_CGROUP)
+			ret = printf("  %s ", st->name ?: "<unknown>");
+		else
+			ret = printf("  %s:%" PRIu64 " ", st->name ?: "<unknown>", st->id);
+
+		for (j = 0; j < 24 - ret; j++)
+			printf(" ");
+
+		printf("|%9" PRIu64 " | avg:%8.3f ms | p99:<%8.3f ms | max:%8.3f ms |\n",
+		       st->count, (double)st->total / st->count / NSEC_PER_MSEC,
+		       (double)bpf_aggr__hist_percentile(st->hist, SCHED_LAT_NR_SLOTS, 99,
+						 NSEC_PER_USEC, st->max) / NSEC_PER_MSEC,
+		       (double)st->max / NSEC_PER_MSEC);
+	}
+
+	printf(" -------------------------------------------------------------------------------------------------\n");
+	printf("  TOTAL: (%.3f s)       |%9" PRIu64 " | avg:%8.3f ms |                  | max:%8.3f ms |\n",
+	       interval, all_count,
+	       all_count ? (double)all_total / all_count / NSEC_PER_MSEC : 0.0,
+	       (double)all_max / NSEC_PER_MSEC);
+
+	if (lat->lost) {
+		printf("  WARNING: %d wakeups not accounted, try a bigger --map-nr-entries\n",
+		       lat->lost);
+	}
+	fflush(stdout);
+}
+
+/*
+ * perf sched latency --live: instead of recording every sched_switch and
+ * sched_wakeup and post-processing them, let a BPF program aggregate the
+ * wakeup-to-run latency per task (or per cgroup) in the kernel, and only
+ * read and print the aggregates every interval.
+ */
+static int perf_sched__lat_live(struct perf_sched *sched)
+{
+	struct sched_latency lat = {
+		.aggr_mode	= sched->live_cgroup ? SCHED_LAT_AGGR_CGROUP :
+						       SCHED_LAT_AGGR_TASK,
+		.map_nr_entries	= sched->live_map_entries,
+	};
+	struct timespec start, now;
+	int err = -1;
+
+	if (!sched->live_interval)
+		sched->live_interval = 1000;
+
+	if (sched_latency_prepare(&lat) < 0) {
+		pr_err("sched latency BPF setup failed\n");
+		goto out;
+	}
+
+	signal(SIGINT, live_sig_handler);
+	signal(SIGTERM, live_sig_handler);
+
+	sched_latency_start();
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	while (!live_done) {
+		usleep(sched->live_interval * USEC_PER_MSEC);
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		err = sched_latency_read(&lat);
+		if (err)
+			break;
+
+		output_lat_live(&lat, (now.tv_sec - start.tv_sec) +
+				      (now.tv_nsec - start.tv_nsec) / (double)NSEC_PER_SEC);
+		start = now;
+	}
+
+	sched_latency_stop();
+out:
+	sched_latency_finish(&lat);
+	return err;
+}
+
 static int setup_map_cpus(struct perf_sched *sched)
 {
 	struct perf_cpu_map *map;
@@ -3477,6 +3647,8 @@ int cmd_sched(int argc, const char **argv)
 		.skip_merge           = 0,
 		.show_callchain	      = 1,
 		.max_stack            = 5,
+		.live_interval	      = 1000,
+		.live_map_entries     = 10240,
 	};
 	const struct option sched_options[] = {
 	OPT_STRING('i', "input", &input_name, "file",
@@ -3488,13 +3660,21 @@ int cmd_sched(int argc, const char **argv)
 	OPT_BOOLEAN('f', "force", &sched.force, "don't complain, do it"),
 	OPT_END()
 	};
-	const struct option latency_options[] = {
+	struct option latency_options[] = {
 	OPT_STRING('s', "sort", &sched.sort_order, "key[,key2...]",
 		   "sort by key(s): runtime, switch, avg, max"),
 	OPT_INTEGER('C', "CPU", &sched.profile_cpu,
 		    "CPU to profile on"),
 	OPT_BOOLEAN('p', "pids", &sched.skip_merge,
 		    "latency stats per pid instead of per comm"),
+	OPT_BOOLEAN(0, "live", &sched.live,
+		    "aggregate latencies in the kernel with BPF, without recording"),
+	OPT_BOOLEAN(0, "cgroup", &sched.live_cgroup,
+		    "live latency stats per cgroup instead of per task"),
+	OPT_UINTEGER('I', "interval", &sched.live_interval,
+		     "print live latency stats every N msecs (default: 1000)"),
+	OPT_UINTEGER(0, "map-nr-entries", &sched.live_map_entries,
+		     "max number of tasks or cgroups in the BPF map (default: 10240)"),
 	OPT_PARENT(sched_options)
 	};
 	const struct option replay_options[] = {
@@ -3603,11 +3783,25 @@ int cmd_sched(int argc, const char **argv)
 		ret = __cmd_record(argc, argv);
 	} else if (strlen(argv[0]) > 2 && strstarts("latency", argv[0])) {
 		sched.tp_handler = &lat_ops;
+#ifndef HAVE_BPF_SKEL
+		set_option_nobuild(latency_options, 0, "live",
+				   "no BUILD_BPF_SKEL=1", false);
+#endif
 		if (argc > 1) {
 			argc = parse_options(argc, argv, latency_options, latency_usage, 0);
 			if (argc)
 				usage_with_options(latency_usage, latency_options);
 		}
+		if (sched.live_cgroup && !sched.live) {
+			pr_err(" Error: --cgroup requires --live\n");
+			parse_options_usage(latency_usage, latency_options, "cgroup", false);
+			ret = -EINVAL;
+			goto out;
+		}
+		if (sched.live) {
+			ret = perf_sched__lat_live(&sched);
+			goto out;
+		}
 		setup_sorting(&sched, latency_options, latency_usage);
 		ret = perf_sched__lat(&sched);
 	} else if (!strcmp(argv[0], "map")) {
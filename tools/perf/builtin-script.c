@@ -37,6 +37,7 @@
 #include "archinsn.h"
 #include <linux/bitmap.h>
 #include <linux/kernel.h>
+#include <linux/string.h>
 #include <linux/stringify.h>
 #include <linux/time64.h>
 #include <linux/zalloc.h>
@@ -59,6 +60,7 @@
 #include "util/dlfilter.h"
 #include "util/record.h"
 #include "util/util.h"
+#include "util/hashmap.h"
 #include "perf.h"
 
 #include <linux/ctype.h>
@@ -2306,6 +2308,615 @@ static bool filter_cpu(struct perf_sample *sample)
 	return false;
 }
 
+/*
+ * Columnar export, --columnar=<file>.
+ *
+ * Instead of formatting a line of text per sample, samples are buffered and
+ * written out column by column in chunks, which is what analytics engines
+ * want to load.  Symbol names, DSOs and callchains are not repeated for every
+ * sample: they are interned in tables that are emitted once, right before the
+ * first chunk of samples referring to them, so the file can be read in a
+ * single pass.  Callchains are deduplicated per process and only the first
+ * occurrence of a stack gets symbolized.  A stack is only reused while the
+ * process keeps the same comm and maps, as after an exec or a new mmap the
+ * same addresses can resolve to other symbols.
+ *
+ * The file starts with:
+ *
+ *	char	magic[8];		"PERFCOL1"
+ *	u32	version;		1
+ *	u32	byte_order;		0x01020304 in the byte order of the writer
+ *
+ * followed by chunks, each with a struct columnar_chunk header and a payload
+ * of 'size' bytes, always a multiple of 8:
+ *
+ *	STRING	{ u32 id; u32 len; char str[len]; } padded to 8 bytes
+ *	FRAME	{ u32 id; u32 dso; u32 sym; u32 pad; }	dso/sym are string ids
+ *	STACK	{ u32 id; u32 nr; u64 ip[nr]; u32 frame[nr]; } padded to 8 bytes,
+ *		leaf first
+ *	EVENT	{ u32 idx; u32 name; }			name is a string id
+ *	SAMPLE	u64 time[nr]; u64 period[nr]; u64 ip[nr];
+ *		u32 pid[nr]; u32 tid[nr]; u32 cpu[nr]; u32 event[nr];
+ *		u32 frame[nr]; u32 stack[nr];
+ *
+ * Id 0 of strings, frames and stacks means "none", e.g. an unresolved symbol
+ * or a sample without callchain.
+ */
+
+#define COLUMNAR_MAGIC		"PERFCOL1"
+#define COLUMNAR_VERSION	1
+#define COLUMNAR_CHUNK_SAMPLES	65536
+
+enum columnar_chunk_type {
+	COLUMNAR_CHUNK_STRING	= 1,
+	COLUMNAR_CHUNK_FRAME	= 2,
+	COLUMNAR_CHUNK_STACK	= 3,
+	COLUMNAR_CHUNK_EVENT	= 4,
+	COLUMNAR_CHUNK_SAMPLE	= 5,
+	COLUMNAR_CHUNK_MAX,
+};
+
+struct columnar_chunk {
+	u32	type;
+	u32	nr;
+	u64	size;
+};
+
+/* records of a table not written out yet */
+struct columnar_table {
+	void	*buf;
+	size_t	size;
+	size_t	alloc;
+	u32	nr;
+};
+
+/*
+ * Dedup key of a callchain: the addresses are resolved in the maps of @pid as
+ * they were at generation @gen, and @ips has the context markers too.
+ */
+struct columnar_stack {
+	u32	pid;
+	u32	gen;
+	u32	kernel_gen;
+	u32	nr;
+	u64	ips[];
+};
+
+struct columnar {
+	FILE			*fp;
+	const char		*path;
+	int			err;
+	struct hashmap		*strings;	/* name -> string id */
+	struct hashmap		*frames;	/* symbol or dso -> frame id */
+	struct hashmap		*stacks;	/* struct columnar_stack -> id */
+	struct hashmap		*events;	/* evsel -> NULL */
+	struct hashmap		*gens;		/* pid -> maps generation */
+	u32			nr_gens;
+	u32			kernel_gen;
+	u32			nr_strings;
+	u32			nr_frames;
+	u32			nr_stacks;
+	struct columnar_stack	*key;		/* lookup scratch */
+	u32			key_max;
+	struct columnar_table	tables[COLUMNAR_CHUNK_MAX];
+	u64			nr_samples;
+	u32			nr;
+	u64			*time;
+	u64			*period;
+	u64			*ip;
+	u32			*pid;
+	u32			*tid;
+	u32			*cpu;
+	u32			*event;
+	u32			*frame;
+	u32			*stack;
+};
+
+static const char	*columnar_file;
+static struct columnar	*columnar;
+
+static size_t columnar__ptr_hash(const void *key, void *ctx __maybe_unused)
+{
+	return (size_t)key;
+}
+
+static bool columnar__ptr_equal(const void *key1, const void *key2,
+				void *ctx __maybe_unused)
+{
+	return key1 == key2;
+}
+
+static size_t columnar__str_hash(const void *key, void *ctx __maybe_unused)
+{
+	return str_hash(key);
+}
+
+static bool columnar__str_equal(const void *key1, const void *key2,
+				void *ctx __maybe_unused)
+{
+	return !strcmp(key1, key2);
+}
+
+static size_t columnar__stack_hash(const void *key, void *ctx __maybe_unused)
+{
+	const struct columnar_stack *stack = key;
+	size_t h = stack->pid ^ ((size_t)stack->gen << 16) ^ stack->kernel_gen;
+	u32 i;
+
+	for (i = 0; i < stack->nr; i++)
+		h = h * 31 + stack->ips[i];
+	return h;
+}
+
+static bool columnar__stack_equal(const void *key1, const void *key2,
+				  void *ctx __maybe_unused)
+{
+	const struct columnar_stack *a = key1, *b = key2;
+
+	return a->pid == b->pid && a->gen == b->gen &&
+	       a->kernel_gen == b->kernel_gen && a->nr == b->nr &&
+	       !memcmp(a->ips, b->ips, a->nr * sizeof(a->ips[0]));
+}
+
+static void columnar__write(struct columnar *col, const void *buf, size_t size)
+{
+	if (!col->err && size && fwrite(buf, size, 1, col->fp) != 1)
+		col->err = -errno;
+}
+
+/* append a record of @size bytes, padded to 8 bytes, to @type's table */
+static void *columnar__record(struct columnar *col,
+			      enum columnar_chunk_type type, size_t size)
+{
+	struct columnar_table *t = &col->tables[type];
+	size_t aligned = PERF_ALIGN(size, sizeof(u64));
+	void *rec;
+
+	if (t->size + aligned > t->alloc) {
+		size_t alloc = max(t->alloc * 2, t->size + aligned + 4096);
+		void *buf = realloc(t->buf, alloc);
+
+		if (!buf)
+			return NULL;
+		t->buf = buf;
+		t->alloc = alloc;
+	}
+
+	rec = t->buf + t->size;
+	memset(rec, 0, aligned);
+	t->size += aligned;
+	t->nr++;
+	return rec;
+}
+
+static void columnar__flush_table(struct columnar *col,
+				  enum columnar_chunk_type type)
+{
+	struct columnar_table *t = &col->tables[type];
+	struct columnar_chunk chunk = {
+		.type = type,
+		.nr   = t->nr,
+		.size = t->size,
+	};
+
+	if (!t->nr)
+		return;
+
+	columnar__write(col, &chunk, sizeof(chunk));
+	columnar__write(col, t->buf, t->size);
+	t->size = 0;
+	t->nr = 0;
+}
+
+static int columnar__flush(struct columnar *col)
+{
+	struct columnar_chunk chunk = {
+		.type = COLUMNAR_CHUNK_SAMPLE,
+		.nr   = col->nr,
+		.size = (u64)col->nr * (3 * sizeof(u64) + 6 * sizeof(u32)),
+	};
+	u32 nr = col->nr;
+
+	/* everything the samples refer to goes first */
+	columnar__flush_table(col, COLUMNAR_CHUNK_STRING);
+	columnar__flush_table(col, COLUMNAR_CHUNK_FRAME);
+	columnar__flush_table(col, COLUMNAR_CHUNK_STACK);
+	columnar__flush_table(col, COLUMNAR_CHUNK_EVENT);
+
+	if (nr) {
+		columnar__write(col, &chunk, sizeof(chunk));
+		columnar__write(col, col->time,   nr * sizeof(u64));
+		columnar__write(col, col->period, nr * sizeof(u64));
+		columnar__write(col, col->ip,     nr * sizeof(u64));
+		columnar__write(col, col->pid,    nr * sizeof(u32));
+		columnar__write(col, col->tid,    nr * sizeof(u32));
+		columnar__write(col, col->cpu,    nr * sizeof(u32));
+		columnar__write(col, col->event,  nr * sizeof(u32));
+		columnar__write(col, col->frame,  nr * sizeof(u32));
+		columnar__write(col, col->stack,  nr * sizeof(u32));
+		col->nr = 0;
+	}
+
+	return col->err;
+}
+
+static int columnar__string(struct columnar *col, const char *str, u32 *id)
+{
+	size_t len;
+	char *key;
+	u32 *rec;
+	void *v;
+
+	if (!str) {
+		*id = 0;
+		return 0;
+	}
+
+	if (hashmap__find(col->strings, str, &v)) {
+		*id = (uintptr_t)v;
+		return 0;
+	}
+
+	len = strlen(str);
+	key = strdup(str);
+	rec = columnar__record(col, COLUMNAR_CHUNK_STRING, 2 * sizeof(u32) + len);
+	if (!key || !rec)
+		goto out_enomem;
+
+	*id = ++col->nr_strings;
+	if (hashmap__add(col->strings, key, (void *)(uintptr_t)*id))
+		goto out_enomem;
+
+	rec[0] = *id;
+	rec[1] = len;
+	memcpy(&rec[2], str, len);
+	return 0;
+
+out_enomem:
+	free(key);
+	return -ENOMEM;
+}
+
+static int columnar__frame(struct columnar *col, struct map *map,
+			   struct symbol *sym, u32 *id)
+{
+	struct dso *dso = map ? map->dso : NULL;
+	const void *key = sym ?: (void *)dso;
+	u32 *rec, dso_id, sym_id;
+	void *v;
+
+	if (!key) {
+		*id = 0;
+		return 0;
+	}
+
+	if (hashmap__find(col->frames, key, &v)) {
+		*id = (uintptr_t)v;
+		return 0;
+	}
+
+	if (columnar__string(col, dso ? dso->long_name : NULL, &dso_id) ||
+	    columnar__string(col, sym ? sym->name : NULL, &sym_id))
+		return -ENOMEM;
+
+	rec = columnar__record(col, COLUMNAR_CHUNK_FRAME, 4 * sizeof(u32));
+	if (!rec)
+		return -ENOMEM;
+
+	*id = ++col->nr_frames;
+	if (hashmap__add(col->frames, key, (void *)(uintptr_t)*id))
+		return -ENOMEM;
+
+	rec[0] = *id;
+	rec[1] = dso_id;
+	rec[2] = sym_id;
+	return 0;
+}
+
+static u8 columnar__context_cpumode(u64 context)
+{
+	switch (context) {
+	case PERF_CONTEXT_HV:
+		return PERF_RECORD_MISC_HYPERVISOR;
+	case PERF_CONTEXT_KERNEL:
+		return PERF_RECORD_MISC_KERNEL;
+	case PERF_CONTEXT_USER:
+		return PERF_RECORD_MISC_USER;
+	case PERF_CONTEXT_GUEST_KERNEL:
+		return PERF_RECORD_MISC_GUEST_KERNEL;
+	case PERF_CONTEXT_GUEST_USER:
+		return PERF_RECORD_MISC_GUEST_USER;
+	default:
+		return PERF_RECORD_MISC_CPUMODE_UNKNOWN;
+	}
+}
+
+/* symbolize a stack seen for the first time and add it to the stack table */
+static int columnar__new_stack(struct columnar *col, struct thread *thread,
+			       u32 *id)
+{
+	struct columnar_stack *stack = col->key;
+	size_t size = sizeof(*stack) + stack->nr * sizeof(stack->ips[0]);
+	u8 cpumode = PERF_RECORD_MISC_USER;
+	u32 *rec, *frames;
+	u64 *ips;
+	u32 i, nr = 0;
+
+	for (i = 0; i < stack->nr; i++) {
+		if (stack->ips[i] < PERF_CONTEXT_MAX)
+			nr++;
+	}
+
+	rec = columnar__record(col, COLUMNAR_CHUNK_STACK,
+			       2 * sizeof(u32) + nr * (sizeof(u64) + sizeof(u32)));
+	if (!rec)
+		return -ENOMEM;
+
+	ips = (void *)&rec[2];
+	frames = (void *)&rec[2] + nr * sizeof(u64);
+	nr = 0;
+
+	for (i = 0; i < stack->nr; i++) {
+		struct addr_location al;
+		u64 ip = stack->ips[i];
+
+		if (ip >= PERF_CONTEXT_MAX) {
+			cpumode = columnar__context_cpumode(ip);
+			continue;
+		}
+
+		memset(&al, 0, sizeof(al));
+		thread__find_symbol_fb(thread, cpumode, ip, &al);
+		ips[nr] = ip;
+		if (columnar__frame(col, al.map, al.sym, &frames[nr++]))
+			return -ENOMEM;
+	}
+
+	stack = memdup(stack, size);
+	if (!stack)
+		return -ENOMEM;
+
+	*id = ++col->nr_stacks;
+	if (hashmap__add(col->stacks, stack, (void *)(uintptr_t)*id)) {
+		free(stack);
+		return -ENOMEM;
+	}
+
+	rec[0] = *id;
+	rec[1] = nr;
+	return 0;
+}
+
+static int columnar__stack(struct columnar *col, struct perf_sample *sample,
+			   struct thread *thread, u32 *id)
+{
+	struct ip_callchain *chain = sample->callchain;
+	struct columnar_stack *key = col->key;
+	bool has_ips = false;
+	u64 i;
+	void *v;
+
+	*id = 0;
+	if (!chain || !chain->nr)
+		return 0;
+
+	if (chain->nr > col->key_max) {
+		key = realloc(key, sizeof(*key) + chain->nr * sizeof(key->ips[0]));
+		if (!key)
+			return -ENOMEM;
+		col->key = key;
+		col->key_max = chain->nr;
+	}
+
+	key->pid = sample->pid;
+	key->gen = 0;
+	if (hashmap__find(col->gens, (void *)(uintptr_t)sample->pid, &v))
+		key->gen = (uintptr_t)v;
+	key->kernel_gen = col->kernel_gen;
+
+	/* keep the context markers, they change how the addresses resolve */
+	key->nr = chain->nr;
+	for (i = 0; i < chain->nr; i++) {
+		key->ips[i] = chain->ips[i];
+		if (chain->ips[i] < PERF_CONTEXT_MAX)
+			has_ips = true;
+	}
+
+	if (!has_ips)
+		return 0;
+
+	if (hashmap__find(col->stacks, key, &v)) {
+		*id = (uintptr_t)v;
+		return 0;
+	}
+
+	return columnar__new_stack(col, thread, id);
+}
+
+/*
+ * The comm or the maps of @pid changed: its stacks seen so far may resolve
+ * differently from now on.  A pid of -1 is for the kernel maps, shared by all.
+ */
+static int columnar__new_gen(struct columnar *col, u32 pid)
+{
+	u32 gen = ++col->nr_gens;
+
+	if (pid == (u32)-1) {
+		col->kernel_gen = gen;
+		return 0;
+	}
+
+	return hashmap__set(col->gens, (void *)(uintptr_t)pid,
+			    (void *)(uintptr_t)gen, NULL, NULL);
+}
+
+static int columnar__event(struct columnar *col, struct evsel *evsel)
+{
+	u32 *rec, name;
+
+	if (hashmap__find(col->events, evsel, NULL))
+		return 0;
+
+	if (columnar__string(col, evsel__name(evsel), &name))
+		return -ENOMEM;
+
+	rec = columnar__record(col, COLUMNAR_CHUNK_EVENT, 2 * sizeof(u32));
+	if (!rec || hashmap__add(col->events, evsel, NULL))
+		return -ENOMEM;
+
+	rec[0] = evsel->core.idx;
+	rec[1] = name;
+	return 0;
+}
+
+static int columnar__add_sample(struct columnar *col, struct perf_sample *sample,
+				struct evsel *evsel, struct addr_location *al)
+{
+	u32 n = col->nr;
+
+	if (columnar__event(col, evsel) ||
+	    columnar__frame(col, al->map, al->sym, &col->frame[n]) ||
+	    columnar__stack(col, sample, al->thread, &col->stack[n])) {
+		pr_err("Not enough memory for the columnar output\n");
+		return -ENOMEM;
+	}
+
+	col->time[n]   = sample->time;
+	col->period[n] = sample->period;
+	col->ip[n]     = sample->ip;
+	col->pid[n]    = sample->pid;
+	col->tid[n]    = sample->tid;
+	col->cpu[n]    = sample->cpu;
+	col->event[n]  = evsel->core.idx;
+	col->nr_samples++;
+
+	if (++col->nr < COLUMNAR_CHUNK_SAMPLES)
+		return 0;
+
+	if (columnar__flush(col)) {
+		char sbuf[STRERR_BUFSIZE];
+
+		pr_err("Failed to write %s: %s\n", col->path,
+		       str_error_r(-col->err, sbuf, sizeof(sbuf)));
+		return col->err;
+	}
+	return 0;
+}
+
+static void columnar__delete(struct columnar *col)
+{
+	struct hashmap_entry *cur;
+	size_t bkt;
+	int i;
+
+	if (!IS_ERR(col->strings)) {
+		hashmap__for_each_entry(col->strings, cur, bkt)
+			free((void *)cur->key);
+		hashmap__free(col->strings);
+	}
+	if (!IS_ERR(col->stacks)) {
+		hashmap__for_each_entry(col->stacks, cur, bkt)
+			free((void *)cur->key);
+		hashmap__free(col->stacks);
+	}
+	hashmap__free(col->frames);
+	hashmap__free(col->events);
+	hashmap__free(col->gens);
+
+	for (i = 0; i < COLUMNAR_CHUNK_MAX; i++)
+		free(col->tables[i].buf);
+
+	free(col->key);
+	free(col->time);
+	free(col->period);
+	free(col->ip);
+	free(col->pid);
+	free(col->tid);
+	free(col->cpu);
+	free(col->event);
+	free(col->frame);
+	free(col->stack);
+	if (col->fp)
+		fclose(col->fp);
+	free(col);
+}
+
+static struct columnar *columnar__new(const char *path)
+{
+	struct columnar *col = zalloc(sizeof(*col));
+	u32 header[2] = { COLUMNAR_VERSION, 0x01020304 };
+	size_t n = COLUMNAR_CHUNK_SAMPLES;
+	char sbuf[STRERR_BUFSIZE];
+
+	if (!col)
+		return NULL;
+
+	col->path    = path;
+	col->strings = hashmap__new(columnar__str_hash, columnar__str_equal, NULL);
+	col->frames  = hashmap__new(columnar__ptr_hash, columnar__ptr_equal, NULL);
+	col->stacks  = hashmap__new(columnar__stack_hash, columnar__stack_equal, NULL);
+	col->events  = hashmap__new(columnar__ptr_hash, columnar__ptr_equal, NULL);
+	col->gens    = hashmap__new(columnar__ptr_hash, columnar__ptr_equal, NULL);
+	col->key     = zalloc(sizeof(*col->key));
+	col->time    = calloc(n, sizeof(u64));
+	col->period  = calloc(n, sizeof(u64));
+	col->ip      = calloc(n, sizeof(u64));
+	col->pid     = calloc(n, sizeof(u32));
+	col->tid     = calloc(n, sizeof(u32));
+	col->cpu     = calloc(n, sizeof(u32));
+	col->event   = calloc(n, sizeof(u32));
+	col->frame   = calloc(n, sizeof(u32));
+	col->stack   = calloc(n, sizeof(u32));
+
+	if (IS_ERR(col->strings) || IS_ERR(col->frames) ||
+	    IS_ERR(col->stacks) || IS_ERR(col->events) ||
+	    IS_ERR(col->gens) || !col->key ||
+	    !col->time || !col->period || !col->ip || !col->pid || !col->tid ||
+	    !col->cpu || !col->event || !col->frame || !col->stack) {
+		pr_err("Not enough memory for the columnar output\n");
+		goto out_delete;
+	}
+
+	col->fp = fopen(path, "w");
+	if (!col->fp) {
+		pr_err("Failed to open %s: %s\n", path, str_error_r(errno, sbuf, sizeof(sbuf)));
+		goto out_delete;
+	}
+
+	columnar__write(col, COLUMNAR_MAGIC, 8);
+	columnar__write(col, header, sizeof(header));
+	if (col->err) {
+		pr_err("Failed to write %s: %s\n", path,
+		       str_error_r(-col->err, sbuf, sizeof(sbuf)));
+		goto out_delete;
+	}
+
+	return col;
+
+out_delete:
+	columnar__delete(col);
+	return NULL;
+}
+
+static int columnar__close(struct columnar *col)
+{
+	int err = columnar__flush(col);
+	char sbuf[STRERR_BUFSIZE];
+
+	if (!err && fflush(col->fp))
+		err = -errno;
+
+	if (err)
+		pr_err("Failed to write %s: %s\n", col->path,
+		       str_error_r(-err, sbuf, sizeof(sbuf)));
+	else
+		fprintf(stderr, "[ perf script: wrote %" PRIu64 " samples, %u stacks, %u frames to %s ]\n",
+			col->nr_samples, col->nr_stacks, col->nr_frames, col->path);
+
+	columnar__delete(col);
+	return err;
+}
+
 static int process_sample_event(struct perf_tool *tool,
 				union perf_event *event,
 				struct perf_sample *sample,
@@ -2370,7 +2981,9 @@ static int process_sample_event(struct perf_tool *tool,
 		goto out_put;
 	}
 
-	if (scripting_ops) {
+	if (columnar) {
+		ret = columnar__add_sample(columnar, sample, evsel, &al);
+	} else if (scripting_ops) {
 		struct addr_location *addr_al_ptr = NULL;
 
 		if ((evsel->core.attr.sample_type & PERF_SAMPLE_ADDR) &&
@@ -2586,6 +3199,45 @@ static int process_mmap2_event(struct perf_tool *tool,
 			   event->mmap2.tid);
 }
 
+/*
+ * With --columnar, comm and mmap events start a new generation of the stacks
+ * of the process before going to the handlers picked for them.
+ */
+static event_op columnar_comm, columnar_mmap, columnar_mmap2;
+
+static int process_columnar_comm_event(struct perf_tool *tool,
+				       union perf_event *event,
+				       struct perf_sample *sample,
+				       struct machine *machine)
+{
+	if (columnar__new_gen(columnar, event->comm.pid))
+		return -ENOMEM;
+
+	return columnar_comm(tool, event, sample, machine);
+}
+
+static int process_columnar_mmap_event(struct perf_tool *tool,
+				       union perf_event *event,
+				       struct perf_sample *sample,
+				       struct machine *machine)
+{
+	if (columnar__new_gen(columnar, event->mmap.pid))
+		return -ENOMEM;
+
+	return columnar_mmap(tool, event, sample, machine);
+}
+
+static int process_columnar_mmap2_event(struct perf_tool *tool,
+					union perf_event *event,
+					struct perf_sample *sample,
+					struct machine *machine)
+{
+	if (columnar__new_gen(columnar, event->mmap2.pid))
+		return -ENOMEM;
+
+	return columnar_mmap2(tool, event, sample, machine);
+}
+
 static int process_switch_event(struct perf_tool *tool,
 				union perf_event *event,
 				struct perf_sample *sample,
@@ -2799,8 +3451,29 @@ static int __cmd_script(struct perf_script *script)
 		return -1;
 	}
 
+	if (columnar_file) {
+		columnar = columnar__new(columnar_file);
+		if (!columnar)
+			return -1;
+
+		columnar_comm = script->tool.comm;
+		columnar_mmap = script->tool.mmap;
+		columnar_mmap2 = script->tool.mmap2;
+		script->tool.comm = process_columnar_comm_event;
+		script->tool.mmap = process_columnar_mmap_event;
+		script->tool.mmap2 = process_columnar_mmap2_event;
+	}
+
 	ret = perf_session__process_events(script->session);
 
+	if (columnar) {
+		int err = columnar__close(columnar);
+
+		if (!ret)
+			ret = err;
+		columnar = NULL;
+	}
+
 	if (script->per_event_dump)
 		perf_script__exit_per_event_dump_stats(script);
 
@@ -3908,6 +4581,8 @@ int cmd_script(int argc, const char **argv)
 		    "Show text poke related events (if recorded)"),
 	OPT_BOOLEAN('\0', "per-event-dump", &script.per_event_dump,
 		    "Dump trace output to files named by the monitored events"),
+	OPT_STRING(0, "columnar", &columnar_file, "file",
+		   "Write samples to file in a columnar binary format for bulk export"),
 	OPT_BOOLEAN('f', "force", &symbol_conf.force, "don't complain, do it"),
 	OPT_INTEGER(0, "max-blocks", &max_blocks,
 		    "Maximum number of code blocks to dump with brstackinsn"),
@@ -3997,6 +4672,12 @@ int cmd_script(int argc, const char **argv)
 		}
 	}
 
+	if (columnar_file && (script_name || script.per_event_dump)) {
+		fprintf(stderr,
+			"--columnar can't be used together with scripts or --per-event-dump.\n");
+		return -1;
+	}
+
 	if (reltime && deltatime) {
 		fprintf(stderr,
 			"reltime and deltatime - the two don't get along well. "
@@ -19,6 +19,7 @@
 #include <api/fs/tracing_path.h>
 #include <bpf/bpf.h>
 #include "util/bpf_map.h"
+#include "util/bpf-aggr.h"
 #include "util/rlimit.h"
 #include "builtin.h"
 #include "util/cgroup.h"
@@ -48,6 +49,7 @@
 #include "util/thread_map.h"
 #include "util/stat.h"
 #include "util/tool.h"
+#include "util/trace-summary.h"
 #include "util/util.h"
 #include "trace/beauty/beauty.h"
 #include "trace-event.h"
@@ -75,6 +77,7 @@
 #include <linux/time64.h>
 #include <linux/zalloc.h>
 #include <fcntl.h>
+#include <time.h>
 #include <sys/sysmacros.h>
 
 #include <linux/ctype.h>
@@ -135,6 +138,9 @@ struct trace {
 	struct {
 		struct bpf_map *map;
 	} dump;
+	/* syscall stats aggregated in BPF, see --bpf-summary */
+	struct trace_summary	bpf_summary;
+	int			bpf_summary_interval;
 	struct record_opts	opts;
 	struct evlist	*evlist;
 	struct machine		*host;
@@ -177,6 +183,7 @@ struct trace {
 	bool			summary;
 	bool			summary_only;
 	bool			errno_summary;
+	bool			bpf_summary_only;
 	bool			failure_only;
 	bool			show_comm;
 	bool			print_sample;
@@ -4455,6 +4462,207 @@ static size_t trace__fprintf_thread_summary(struct trace *trace, FILE *fp)
 	return printed;
 }
 
+/*
+ * --bpf-summary: the per syscall stats are aggregated in per-cpu BPF maps
+ * and only merged here, instead of going thru the perf ring buffer for
+ * every syscall, which is what makes it cheap enough for busy hosts.  A
+ * sample of the syscalls can still be shown, thru a BPF ring buffer.
+ */
+static int trace__bpf_summary_sample(struct trace_summary *ts,
+				     struct syscall_summary_sample *sample)
+{
+	struct trace *trace = container_of(ts, struct trace, bpf_summary);
+	struct syscall *sc = trace__syscall_info(trace, NULL, sample->nr);
+	struct tep_format_field *field;
+	FILE *fp = trace->output;
+	int i;
+
+	if (!trace->base_time)
+		trace->base_time = sample->timestamp;
+
+	__trace__fprintf_tstamp(trace, sample->timestamp, fp);
+	fprintf(fp, "(%6.3f ms): %d ", (double)sample->duration / NSEC_PER_MSEC,
+		sample->tid);
+
+	if (sc == NULL) {
+		fprintf(fp, "%u(", sample->nr);
+		field = NULL;
+	} else {
+		fprintf(fp, "%s(", sc->name);
+		field = sc->args;
+	}
+
+	for (i = 0; i < 6; i++) {
+		if (sc && i >= sc->nr_args)
+			break;
+		if (sc == NULL && !sample->args[i])
+			break;
+
+		fprintf(fp, "%s", i ? ", " : "");
+		if (field) {
+			fprintf(fp, "%s: ", field->name);
+			field = field->next;
+		}
+		fprintf(fp, "%#" PRIx64, (u64)sample->args[i]);
+	}
+
+	if (sample->ret < 0) {
+		const char *arch_name = perf_env__arch(NULL);
+
+		fprintf(fp, ") = -1 %s\n",
+			arch_syscalls__strerrno(arch_name, -sample->ret));
+	} else {
+		fprintf(fp, ") = %" PRId64 "\n", (s64)sample->ret);
+	}
+	return 0;
+}
+
+static int trace_summary_stat__cmp(const void *a, const void *b)
+{
+	const struct trace_summary_stat *l = a, *r = b;
+
+	if (l->total == r->total)
+		return 0;
+	return l->total < r->total ? 1 : -1;
+}
+
+static size_t trace__fprintf_bpf_summary(struct trace *trace, FILE *fp)
+{
+	struct trace_summary *ts = &trace->bpf_summary;
+	const char *arch_name = perf_env__arch(NULL);
+	size_t printed;
+	int i, j;
+
+	qsort(ts->stats, ts->nr_stats, sizeof(*ts->stats), trace_summary_stat__cmp);
+
+	printed  = fprintf(fp, "\n Summary of syscalls:\n\n");
+	printed += fprintf(fp, "   syscall            calls  errors  total       min       avg       max       p99\n");
+	printed += fprintf(fp, "                                     (msec)    (msec)    (msec)    (msec)    (msec)\n");
+	printed += fprintf(fp, "   --------------- --------  ------ -------- --------- --------- --------- ---------\n");
+
+	for (i = 0; i < ts->nr_stats; i++) {
+		struct trace_summary_stat *st = &ts->stats[i];
+		const char *name = syscalltbl__name(trace->sctbl, st->nr);
+
+		if (!st->count)
+			continue;
+
+		if (name)
+			printed += fprintf(fp, "   %-15s", name);
+		else
+			printed += fprintf(fp, "   %-15u", st->nr);
+		printed += fprintf(fp, " %8" PRIu64 " %6" PRIu64 " %9.3f %9.3f %9.3f",
+				   st->count, st->errors,
+				   (double)st->total / NSEC_PER_MSEC,
+				   (double)st->min / NSEC_PER_MSEC,
+				   (double)st->total / st->count / NSEC_PER_MSEC);
+		printed += fprintf(fp, " %9.3f %9.3f\n", (double)st->max / NSEC_PER_MSEC,
+				   (double)bpf_aggr__hist_percentile(st->hist,
+						SYSCALL_SUMMARY_NR_SLOTS, 99,
+						NSEC_PER_USEC, st->max) / NSEC_PER_MSEC);
+
+		for (j = 0; j < ts->nr_errnos; j++) {
+			struct trace_summary_errno *e = &ts->errnos[j];
+
+			if (e->nr == st->nr)
+				printed += fprintf(fp, "\t\t\t\t%s: %" PRIu64 "\n",
+						   arch_syscalls__strerrno(arch_name, e->err),
+						   e->count);
+		}
+	}
+
+	if (ts->lost)
+		printed += fprintf(fp, "\n   %d syscalls lost (BPF map or ring buffer full)\n",
+				   ts->lost);
+
+	printed += fprintf(fp, "\n\n");
+	return printed;
+}
+
+static u64 trace__monotonic_ms(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * MSEC_PER_SEC + now.tv_nsec / NSEC_PER_MSEC;
+}
+
+static int trace__run_bpf_summary(struct trace *trace, int argc, const char **argv)
+{
+	struct trace_summary *ts = &trace->bpf_summary;
+	struct evlist *evlist = trace->evlist;
+	u64 last_print;
+	int err;
+
+	err = evlist__create_maps(evlist, &trace->opts.target);
+	if (err < 0) {
+		fprintf(trace->output, "Problems parsing the target to trace, check your options!\n");
+		return err;
+	}
+
+	if (argc) {
+		err = evlist__prepare_workload(evlist, &trace->opts.target, argv, false, NULL);
+		if (err < 0) {
+			fprintf(trace->output, "Couldn't run the workload!\n");
+			return err;
+		}
+		workload_pid = evlist->workload.pid;
+	}
+
+	ts->evlist = evlist;
+	ts->target = &trace->opts.target;
+	ts->syscalls = trace->ev_qualifier_ids.entries;
+	ts->nr_syscalls = trace->ev_qualifier_ids.nr;
+	ts->not_syscalls = trace->not_ev_qualifier;
+	ts->errno_summary = trace->errno_summary;
+	ts->map_nr_entries = max(512, trace->sctbl->syscalls.max_id + 1);
+	/* the BPF ring buffer size also has to be a power of 2 pages */
+	if (trace->opts.mmap_pages && trace->opts.mmap_pages != UINT_MAX)
+		ts->ringbuf_size = trace->opts.mmap_pages * page_size;
+	else
+		ts->ringbuf_size = 1024 * 1024;
+	ts->handle_sample = trace__bpf_summary_sample;
+
+	err = trace_summary_prepare(ts);
+	if (err < 0) {
+		fprintf(trace->output, "Failed to set up the syscall summary BPF program\n");
+		goto out;
+	}
+
+	trace_summary_start();
+	if (argc)
+		evlist__start_workload(evlist);
+
+	last_print = trace__monotonic_ms();
+	while (!done) {
+		err = trace_summary_poll(ts, 100);
+		if (err < 0)
+			break;
+
+		if (trace->bpf_summary_interval &&
+		    trace__monotonic_ms() - last_print >= (u64)trace->bpf_summary_interval) {
+			last_print = trace__monotonic_ms();
+			err = trace_summary_read(ts);
+			if (err < 0)
+				break;
+			trace__fprintf_bpf_summary(trace, trace->output);
+		}
+	}
+
+	trace_summary_stop();
+
+	if (err >= 0) {
+		/* print the samples still in the ring buffer, then the rest */
+		trace_summary_poll(ts, 0);
+		err = trace_summary_read(ts);
+		if (err >= 0)
+			trace__fprintf_bpf_summary(trace, trace->output);
+	}
+out:
+	trace_summary_finish(ts);
+	return err;
+}
+
 static int trace__set_duration(const struct option *opt, const char *str,
 			       int unset __maybe_unused)
 {
@@ -4800,7 +5008,7 @@ int cmd_trace(int argc, const char **argv)
 	};
 	const char *map_dump_str = NULL;
 	const char *output_name = NULL;
-	const struct option trace_options[] = {
+	struct option trace_options[] = {
 	OPT_CALLBACK('e', "event", &trace, "event",
 		     "event/syscall selector. use 'perf list' to list available events",
 		     trace__parse_events_option),
@@ -4845,6 +5053,12 @@ int cmd_trace(int argc, const char **argv)
 		    "Show only syscall summary with statistics"),
 	OPT_BOOLEAN('S', "with-summary", &trace.summary,
 		    "Show all syscalls and summary with statistics"),
+	OPT_BOOLEAN(0, "bpf-summary", &trace.bpf_summary_only,
+		    "Show only the syscall summary, aggregated in BPF"),
+	OPT_UINTEGER(0, "bpf-summary-sample", &trace.bpf_summary.sample_rate,
+		     "With --bpf-summary, also show one of every N syscalls"),
+	OPT_INTEGER(0, "bpf-summary-interval", &trace.bpf_summary_interval,
+		    "With --bpf-summary, show and reset the summary every N msecs"),
 	OPT_BOOLEAN(0, "errno-summary", &trace.errno_summary,
 		    "Show errno stats per syscall, use with -s or -S"),
 	OPT_CALLBACK_DEFAULT('F', "pf", &trace.trace_pgfaults, "all|maj|min",
@@ -4916,6 +5130,12 @@ int cmd_trace(int argc, const char **argv)
 	 */
 	rlimit__bump_memlock();
 
+#ifndef HAVE_BPF_SKEL
+	set_option_nobuild(trace_options, 0, "bpf-summary", "no BUILD_BPF_SKEL=1", false);
+	set_option_nobuild(trace_options, 0, "bpf-summary-sample", "no BUILD_BPF_SKEL=1", false);
+	set_option_nobuild(trace_options, 0, "bpf-summary-interval", "no BUILD_BPF_SKEL=1", false);
+#endif
+
 	err = perf_config(trace__config, &trace);
 	if (err)
 		goto out;
@@ -4961,6 +5181,11 @@ int cmd_trace(int argc, const char **argv)
 				       "cgroup monitoring only available in system-wide mode");
 	}
 
+	if (trace.bpf_summary_only && (input_name || nr_cgroups || trace.cgroup)) {
+		usage_with_options_msg(trace_usage, trace_options,
+				       "--bpf-summary can't be used with --input or --cgroup");
+	}
+
 	evsel = bpf__setup_output_event(trace.evlist, "__augmented_syscalls__");
 	if (IS_ERR(evsel)) {
 		bpf__strerror_setup_output_event(trace.evlist, PTR_ERR(evsel), bf, sizeof(bf));
@@ -5200,6 +5425,8 @@ int cmd_trace(int argc, const char **argv)
 
 	if (input_name)
 		err = trace__replay(&trace);
+	else if (trace.bpf_summary_only)
+		err = trace__run_bpf_summary(&trace, argc, argv);
 	else
 		err = trace__run(&trace, argc, argv);
 
@@ -0,0 +1,209 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/bitops.h>
+#include <linux/kernel.h>
+#include <linux/zalloc.h>
+
+#include "util/arm-spe-decoder/arm-spe-batch.h"
+
+#include "util/debug.h"
+#include "tests/tests.h"
+
+/*
+ * Decoding Arm SPE needs no hardware.  Synthesize a trace of loads, stores
+ * and branches, with a few bad bytes in it, decode it in one go and in two
+ * halves, and check the latency aggregated per instruction and per cache
+ * line against what was put in the trace.
+ */
+
+#define NR_RECORDS	4096
+#define NR_INSNS	16
+#define NR_LINES	64
+#define LINE_SIZE	64
+#define TEST_IP		0x401000ULL
+#define TEST_DATA	0xffff00001000ULL
+#define BAD_EVERY	512
+
+struct test_record {
+	u64 ip;
+	u64 addr;
+	u32 latency;
+	/* 0: load, 1: store, 2: branch */
+	int kind;
+};
+
+static size_t put_le(unsigned char *p, u64 val, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+		p[i] = val >> (i * 8);
+	return len;
+}
+
+static size_t put_record(unsigned char *p, const struct test_record *r,
+			 u64 timestamp)
+{
+	unsigned char *start = p;
+
+	/* instruction address, non-secure EL0 */
+	*p++ = 0xb0;
+	p += put_le(p, r->ip | BIT_ULL(63), 8);
+	if (r->kind == 2) {
+		*p++ = 0x4a;
+		*p++ = 0;
+	} else {
+		*p++ = 0x49;
+		*p++ = r->kind;
+		*p++ = 0xb2;
+		p += put_le(p, r->addr, 8);
+		*p++ = 0x43;
+		*p++ = 0x8;
+	}
+	*p++ = 0x98;
+	p += put_le(p, r->latency, 2);
+	*p++ = 0x42;
+	*p++ = BIT(EV_RETIRED) | BIT(EV_L1D_ACCESS);
+	*p++ = 0x71;
+	p += put_le(p, timestamp, 8);
+
+	return p - start;
+}
+
+static void make_record(struct test_record *r, int i)
+{
+	int insn = i % NR_INSNS;
+
+	r->ip = TEST_IP + insn * 4;
+	r->addr = TEST_DATA + (i / NR_INSNS % NR_LINES) * LINE_SIZE + (i & 7) * 8;
+	r->latency = (insn + 1) * 8 + (i / NR_INSNS) % 100;
+	r->kind = insn % 3;
+}
+
+static int check_entries(const struct test_record *recs,
+			 struct arm_spe_lat_entry *entries, int nr,
+			 enum arm_spe_lat_key by)
+{
+	int i, j;
+
+	for (i = 0; i < nr; i++) {
+		struct arm_spe_lat_entry *e = &entries[i];
+		u64 count = 0, total = 0;
+		u32 max = 0;
+
+		TEST_ASSERT_VAL("Entries not sorted",
+				!i || entries[i - 1].key < e->key);
+
+		for (j = 0; j < NR_RECORDS; j++) {
+			const struct test_record *r = &recs[j];
+			u64 key = by == ARM_SPE_LAT_BY_DATA ?
+				  r->addr & ~(u64)(LINE_SIZE - 1) : r->ip;
+
+			if (r->kind == 2 || key != e->key)
+				continue;
+			count++;
+			total += r->latency;
+			max = max(max, r->latency);
+		}
+
+		TEST_ASSERT_VAL("Invalid count", count && e->count == count);
+		TEST_ASSERT_VAL("Invalid total", e->total == total);
+		TEST_ASSERT_VAL("Invalid max", e->max == max);
+		TEST_ASSERT_VAL("Invalid percentile",
+				arm_spe_lat_entry__percentile(e, 100) == max &&
+				arm_spe_lat_entry__percentile(e, 50) <= max &&
+				arm_spe_lat_entry__percentile(e, 50) >= e->min);
+	}
+
+	return TEST_OK;
+}
+
+static int test__arm_spe_batch(struct test_suite *test __maybe_unused,
+			       int subtest __maybe_unused)
+{
+	struct test_record *recs;
+	struct arm_spe_batch batch, halves;
+	struct arm_spe_lat_entry *entries = NULL;
+	unsigned char *buf, *p, *half = NULL;
+	int i, nr, nr_stored = 0, err = TEST_FAIL;
+
+	recs = calloc(NR_RECORDS, sizeof(*recs));
+	buf = malloc(NR_RECORDS * ARM_SPE_PKT_MAX_SZ * 8);
+	if (!recs || !buf)
+		goto out_free;
+
+	arm_spe_batch__init(&batch);
+	arm_spe_batch__init(&halves);
+
+	for (i = 0, p = buf; i < NR_RECORDS; i++) {
+		make_record(&recs[i], i);
+		if (i == NR_RECORDS / 2)
+			half = p;
+		/* the decoder skips these a byte at a time */
+		if (i && !(i % BAD_EVERY))
+			*p++ = 0x02;
+		p += put_record(p, &recs[i], 1000 + i);
+	}
+
+	if (arm_spe_batch__decode(&batch, buf, p - buf) < 0 ||
+	    arm_spe_batch__decode(&halves, buf, half - buf) < 0 ||
+	    arm_spe_batch__decode(&halves, half, p - half) < 0)
+		goto out;
+
+	pr_debug("decoded %zu records, %zu errors\n",
+		 batch.nr_records, batch.nr_errors);
+
+	TEST_ASSERT_VAL("Invalid nr records", batch.nr_records == NR_RECORDS);
+	TEST_ASSERT_VAL("Invalid nr errors",
+			batch.nr_errors == NR_RECORDS / BAD_EVERY - 1);
+	TEST_ASSERT_VAL("Invalid nr records", halves.nr_records == NR_RECORDS);
+
+	for (i = 0; i < NR_RECORDS; i++) {
+		struct arm_spe_batch_record *r = &batch.records[i];
+
+		TEST_ASSERT_VAL("Invalid record",
+				r->timestamp == 1000ULL + i &&
+				r->from_ip == recs[i].ip &&
+				r->latency == recs[i].latency &&
+				!memcmp(r, &halves.records[i], sizeof(*r)));
+		if (recs[i].kind != 2) {
+			TEST_ASSERT_VAL("Invalid data record",
+					r->virt_addr == recs[i].addr &&
+					r->op == (recs[i].kind ? ARM_SPE_ST : ARM_SPE_LD));
+			nr_stored++;
+		}
+	}
+
+	nr = arm_spe_batch__aggr_latency(&batch, ARM_SPE_LAT_BY_INSN, 0,
+					 &entries);
+	/* the instructions with kind 2 are branches */
+	TEST_ASSERT_VAL("Invalid nr insns",
+			nr == NR_INSNS - (NR_INSNS + 1) / 3);
+	if (check_entries(recs, entries, nr, ARM_SPE_LAT_BY_INSN))
+		goto out;
+	zfree(&entries);
+
+	nr = arm_spe_batch__aggr_latency(&batch, ARM_SPE_LAT_BY_DATA,
+					 LINE_SIZE, &entries);
+	TEST_ASSERT_VAL("Invalid nr lines", nr == NR_LINES);
+	if (check_entries(recs, entries, nr, ARM_SPE_LAT_BY_DATA))
+		goto out;
+
+	TEST_ASSERT_VAL("Invalid granule",
+			arm_spe_batch__aggr_latency(&batch, ARM_SPE_LAT_BY_DATA,
+						    48, &entries) == -EINVAL);
+	pr_debug("%d loads and stores in %d cache lines\n", nr_stored, nr);
+	err = TEST_OK;
+out:
+	free(entries);
+	arm_spe_batch__exit(&batch);
+	arm_spe_batch__exit(&halves);
+out_free:
+	free(buf);
+	free(recs);
+	return err;
+}
+
+DEFINE_SUITE("Arm SPE batch decoding", arm_spe_batch);
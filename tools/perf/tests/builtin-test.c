@@ -71,6 +71,7 @@ static struct test_suite *generic_tests[] = {
 	&suite__thread_maps_share,
 	&suite__hists_output,
 	&suite__hists_cumulate,
+	&suite__hists_parallel,
 	&suite__switch_tracking,
 	&suite__fdarray__filter,
 	&suite__fdarray__add,
@@ -110,6 +111,10 @@ static struct test_suite *generic_tests[] = {
 	&suite__perf_time_to_tsc,
 	&suite__dlfilter,
 	&suite__sigtrap,
+#ifdef HAVE_AUXTRACE_SUPPORT
+	&suite__intel_pt_par,
+	&suite__arm_spe_batch,
+#endif
 	NULL,
 };
 
@@ -0,0 +1,264 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "util/debug.h"
+#include "util/event.h"
+#include "util/map.h"
+#include "util/symbol.h"
+#include "util/sort.h"
+#include "util/evsel.h"
+#include "util/evlist.h"
+#include "util/machine.h"
+#include "util/thread.h"
+#include "util/parse-events.h"
+#include "util/hist-parallel.h"
+#include "tests/tests.h"
+#include "tests/hists_common.h"
+#include <errno.h>
+#include <inttypes.h>
+#include <time.h>
+#include <linux/kernel.h>
+#include <linux/time64.h>
+
+/*
+ * perf report --num-threads collapses and sorts the hists of different
+ * events concurrently, and splits the sort of a single event between the
+ * threads.  Check that both give the same result as a single thread, and
+ * report the time it takes with a growing number of threads (visible
+ * with -v).
+ */
+
+#define NR_CPUS_SAMPLED		256
+#define NR_ROUNDS		4
+
+static const char *events[] = {
+	"cpu-clock",
+	"task-clock",
+	"page-faults",
+	"context-switches",
+	"cpu-migrations",
+	"minor-faults",
+	"major-faults",
+	"alignment-faults",
+};
+
+static u32 fake_pids[] = {
+	FAKE_PID_PERF1, FAKE_PID_PERF2, FAKE_PID_BASH,
+};
+
+static u64 fake_ips[] = {
+	FAKE_IP_PERF_MAIN, FAKE_IP_PERF_RUN_COMMAND, FAKE_IP_PERF_CMD_RECORD,
+	FAKE_IP_BASH_MAIN, FAKE_IP_BASH_XMALLOC, FAKE_IP_BASH_XFREE,
+	FAKE_IP_LIBC_MALLOC, FAKE_IP_LIBC_FREE, FAKE_IP_LIBC_REALLOC,
+	FAKE_IP_KERNEL_SCHEDULE, FAKE_IP_KERNEL_PAGE_FAULT,
+	FAKE_IP_KERNEL_SYS_PERF_EVENT_OPEN,
+};
+
+static int add_hist_entries(struct evlist *evlist, struct machine *machine)
+{
+	struct evsel *evsel;
+	struct addr_location al;
+	struct perf_sample sample = { .weight = 1, };
+	size_t nr_ips = ARRAY_SIZE(fake_ips), nr_pids = ARRAY_SIZE(fake_pids);
+	size_t nr_samples = NR_ROUNDS * NR_CPUS_SAMPLED * nr_pids * nr_ips;
+	size_t n;
+
+	evlist__for_each_entry(evlist, evsel) {
+		for (n = 0; n < nr_samples; n++) {
+			struct hist_entry_iter iter = {
+				.evsel = evsel,
+				.sample = &sample,
+				.ops = &hist_iter_normal,
+				.hide_unresolved = false,
+			};
+			size_t i = n % nr_ips;
+			size_t p = (n / nr_ips) % nr_pids;
+			size_t cpu = (n / nr_ips / nr_pids) % NR_CPUS_SAMPLED;
+
+			sample.cpumode = PERF_RECORD_MISC_USER;
+			sample.cpu = cpu;
+			sample.pid = fake_pids[p];
+			sample.tid = fake_pids[p];
+			sample.ip = fake_ips[i];
+			sample.period = 1 + (n & 7);
+
+			if (machine__resolve(machine, &al, &sample) < 0)
+				return TEST_FAIL;
+
+			if (hist_entry_iter__add(&iter, &al,
+						 sysctl_perf_event_max_stack,
+						 NULL) < 0) {
+				addr_location__put(&al);
+				return TEST_FAIL;
+			}
+			addr_location__put(&al);
+		}
+	}
+
+	return TEST_OK;
+}
+
+/* collapse and sort all hists like perf report does, return the time in us */
+static int resort_hists(struct evlist *evlist, int nr_threads, u64 *usecs)
+{
+	struct timespec start, end;
+	int err;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	err = evlist__collapse_resort_parallel(evlist, nr_threads, NULL);
+	if (!err)
+		err = evlist__output_resort_parallel(evlist, nr_threads, NULL,
+						     NULL, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	*usecs = (end.tv_sec - start.tv_sec) * USEC_PER_SEC +
+		 (end.tv_nsec - start.tv_nsec) / NSEC_PER_USEC;
+	return err;
+}
+
+/* compare the sorted output of every event against the first run */
+static int validate_output(struct evlist *evlist, struct evlist *ref)
+{
+	struct evsel *evsel, *ref_evsel = evlist__first(ref);
+
+	evlist__for_each_entry(evlist, evsel) {
+		struct hists *hists = evsel__hists(evsel);
+		struct hists *ref_hists = evsel__hists(ref_evsel);
+		struct rb_node *nd, *ref_nd;
+		u64 nr_in = 0;
+
+		TEST_ASSERT_VAL("Invalid nr entries",
+				hists->nr_entries == ref_hists->nr_entries);
+		TEST_ASSERT_VAL("Invalid nr non filtered entries",
+				hists->nr_non_filtered_entries ==
+				ref_hists->nr_non_filtered_entries);
+		TEST_ASSERT_VAL("Invalid total period",
+				hists->stats.total_period ==
+				ref_hists->stats.total_period);
+
+		for (nd = rb_first_cached(&hists->entries),
+		     ref_nd = rb_first_cached(&ref_hists->entries);
+		     nd && ref_nd; nd = rb_next(nd), ref_nd = rb_next(ref_nd)) {
+			struct hist_entry *he, *ref_he;
+
+			he = rb_entry(nd, struct hist_entry, rb_node);
+			ref_he = rb_entry(ref_nd, struct hist_entry, rb_node);
+
+			TEST_ASSERT_VAL("Invalid hist entry",
+					he->stat.period == ref_he->stat.period &&
+					he->cpu == ref_he->cpu &&
+					he->thread->tid == ref_he->thread->tid &&
+					he->ms.sym == ref_he->ms.sym);
+		}
+		TEST_ASSERT_VAL("Invalid nr entries", !nd && !ref_nd);
+
+		/* a split sort borrows the collapsed entries, they must be back */
+		for (nd = rb_first_cached(&hists->entries_collapsed); nd; nd = rb_next(nd))
+			nr_in++;
+		TEST_ASSERT_VAL("Invalid nr collapsed entries",
+				nr_in == hists->nr_entries);
+
+		ref_evsel = evsel__next(ref_evsel);
+	}
+
+	return TEST_OK;
+}
+
+static struct evlist *setup_evlist(size_t nr_events)
+{
+	struct evlist *evlist = evlist__new();
+	size_t i;
+
+	if (!evlist)
+		return NULL;
+
+	for (i = 0; i < nr_events; i++) {
+		if (parse_event(evlist, events[i])) {
+			evlist__delete(evlist);
+			return NULL;
+		}
+	}
+	return evlist;
+}
+
+/*
+ * With as many events as threads, the events are spread over the threads.
+ * With a single one, its sort is split between them.
+ */
+static int test_resort(struct machine *machine, size_t nr_events)
+{
+	struct evlist *ref = NULL, *evlist = NULL;
+	int nr_threads, err = TEST_FAIL;
+	u64 usecs;
+
+	for (nr_threads = 1; nr_threads <= (int)ARRAY_SIZE(events);
+	     nr_threads *= 2) {
+		evlist = setup_evlist(nr_events);
+		if (!evlist) {
+			err = TEST_FAIL;
+			goto out;
+		}
+
+		err = add_hist_entries(evlist, machine);
+		if (err < 0)
+			goto out;
+
+		err = resort_hists(evlist, nr_threads, &usecs);
+		if (err < 0)
+			goto out;
+
+		pr_debug("%d thread(s): collapsed and sorted %d events in %" PRIu64 " usecs\n",
+			 nr_threads, evlist->core.nr_entries, usecs);
+
+		if (!ref) {
+			ref = evlist;
+			evlist = NULL;
+			continue;
+		}
+
+		err = validate_output(evlist, ref);
+		evlist__delete(evlist);
+		evlist = NULL;
+		if (err < 0)
+			goto out;
+	}
+	err = TEST_OK;
+
+out:
+	evlist__delete(evlist);
+	evlist__delete(ref);
+	return err;
+}
+
+static int test__hists_parallel(struct test_suite *test __maybe_unused,
+				int subtest __maybe_unused)
+{
+	int err = TEST_FAIL;
+	struct machines machines;
+	struct machine *machine;
+
+	machines__init(&machines);
+
+	/* setup threads/dso/map/symbols also */
+	machine = setup_fake_machine(&machines);
+	if (!machine)
+		goto out;
+
+	field_order = NULL;
+	sort_order = "comm,dso,sym,cpu";
+	if (setup_sorting(NULL) < 0)
+		goto out;
+
+	err = test_resort(machine, ARRAY_SIZE(events));
+	if (err < 0)
+		goto out;
+
+	err = test_resort(machine, 1);
+
+out:
+	/* tear down everything */
+	reset_output_field();
+	machines__exit(&machines);
+
+	return err;
+}
+
+DEFINE_SUITE("Parallel resort of hist entries", hists_parallel);
@@ -0,0 +1,258 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/kernel.h>
+#include <linux/zalloc.h>
+
+#include "util/intel-pt-decoder/intel-pt-pkt-decoder.h"
+#include "util/intel-pt-decoder/intel-pt-decoder.h"
+#include "util/intel-pt-decoder/intel-pt-par.h"
+
+#include "util/debug.h"
+#include "tests/tests.h"
+
+/*
+ * Decoding Intel PT needs no hardware.  Synthesize the trace of a few cpus,
+ * each PSB+ with a TSC followed by a TIP.PGE / TIP.PGD pair, and use a fake
+ * instruction walker which goes straight to an indirect branch.  Then check
+ * that decoding it in parallel gives the same outputs as decoding it on one
+ * thread, in timestamp order.
+ */
+
+#define NR_STREAMS	4
+#define NR_PSBS		64
+#define NR_PADS		40
+#define TEST_IP		0x401000
+
+struct test_output {
+	uint64_t timestamp;
+	int stream;
+	int type;
+};
+
+struct test_result {
+	struct test_output *outputs;
+	int nr_outputs;
+	int nr_alloc;
+	/* to check that the outputs are delivered in timestamp order */
+	uint64_t last_timestamp;
+	bool out_of_order;
+};
+
+struct test_stream {
+	unsigned char *buf;
+	size_t len;
+	int idx;
+	struct test_result *result;
+};
+
+static size_t put_tsc(unsigned char *p, uint64_t tsc)
+{
+	int i;
+
+	*p++ = 0x19;
+	for (i = 0; i < 7; i++)
+		*p++ = tsc >> (i * 8);
+	return 8;
+}
+
+/* TIP.PGE with a 6-byte sign-extended IP */
+static size_t put_tip_pge(unsigned char *p, uint64_t ip)
+{
+	int i;
+
+	*p++ = 0x71;
+	for (i = 0; i < 6; i++)
+		*p++ = ip >> (i * 8);
+	return 7;
+}
+
+static int make_stream(struct test_stream *s, int idx)
+{
+	size_t max = NR_PSBS * (INTEL_PT_PSB_LEN + 8 + 2 + 7 + 1 + NR_PADS);
+	unsigned char *p;
+	int i;
+
+	s->buf = p = malloc(max);
+	if (!s->buf)
+		return -ENOMEM;
+
+	for (i = 0; i < NR_PSBS; i++) {
+		/* interleave the cpus in time */
+		uint64_t tsc = 1000 + i * 100 + idx * 7;
+
+		memcpy(p, INTEL_PT_PSB_STR, INTEL_PT_PSB_LEN);
+		p += INTEL_PT_PSB_LEN;
+		p += put_tsc(p, tsc);
+		*p++ = 0x02;	/* PSBEND */
+		*p++ = 0x23;
+		p += put_tip_pge(p, TEST_IP);
+		*p++ = 0x01;	/* TIP.PGD, IP suppressed */
+		memset(p, 0, NR_PADS);	/* PAD */
+		p += NR_PADS;
+	}
+
+	s->len = p - s->buf;
+	s->idx = idx;
+	return 0;
+}
+
+static int test_walk_insn(struct intel_pt_insn *intel_pt_insn,
+			  uint64_t *insn_cnt_ptr, uint64_t *ip __maybe_unused,
+			  uint64_t to_ip __maybe_unused,
+			  uint64_t max_insn_cnt __maybe_unused,
+			  void *data __maybe_unused)
+{
+	memset(intel_pt_insn, 0, sizeof(*intel_pt_insn));
+	intel_pt_insn->op = INTEL_PT_OP_JMP;
+	intel_pt_insn->branch = INTEL_PT_BR_INDIRECT;
+	intel_pt_insn->length = 2;
+	*insn_cnt_ptr = 1;
+	return 0;
+}
+
+static int test_get_trace(struct intel_pt_buffer *buffer __maybe_unused,
+			  void *data __maybe_unused)
+{
+	return -EINVAL;
+}
+
+static int test_state(struct intel_pt_par_seg *seg, void *seg_data,
+		      const struct intel_pt_state *state)
+{
+	struct test_stream *s = seg_data;
+	struct test_output *o;
+
+	o = malloc(sizeof(*o));
+	if (!o)
+		return -ENOMEM;
+
+	o->timestamp = state->timestamp;
+	o->stream = s->idx;
+	o->type = state->err ? -state->err : (int)state->type;
+
+	if (intel_pt_par_output(seg, state->timestamp, o)) {
+		free(o);
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+static int test_deliver(void *stream_data, void *output)
+{
+	struct test_stream *s = stream_data;
+	struct test_result *r = s->result;
+	struct test_output *o = output;
+
+	if (o->timestamp < r->last_timestamp)
+		r->out_of_order = true;
+	r->last_timestamp = o->timestamp;
+
+	if (r->nr_outputs == r->nr_alloc) {
+		struct test_output *tmp;
+
+		r->nr_alloc = r->nr_alloc ? r->nr_alloc * 2 : 256;
+		tmp = realloc(r->outputs, r->nr_alloc * sizeof(*tmp));
+		if (!tmp) {
+			free(o);
+			return -ENOMEM;
+		}
+		r->outputs = tmp;
+	}
+	r->outputs[r->nr_outputs++] = *o;
+	free(o);
+	return 0;
+}
+
+static const struct intel_pt_par_ops test_ops = {
+	.state		= test_state,
+	.deliver	= test_deliver,
+	.free_output	= free,
+};
+
+static int decode(struct test_stream *streams, struct test_result *r,
+		  size_t seg_size, int nr_threads)
+{
+	struct intel_pt_par_stream par_streams[NR_STREAMS];
+	struct intel_pt_params params = {
+		.get_trace	= test_get_trace,
+		.walk_insn	= test_walk_insn,
+		.branch_enable	= true,
+	};
+	int i;
+
+	memset(r, 0, sizeof(*r));
+	for (i = 0; i < NR_STREAMS; i++) {
+		streams[i].result = r;
+		par_streams[i].buf = streams[i].buf;
+		par_streams[i].len = streams[i].len;
+		par_streams[i].ref_timestamp = 0;
+		par_streams[i].data = &streams[i];
+	}
+
+	return intel_pt_par_decode(par_streams, NR_STREAMS, &params, &test_ops,
+				   seg_size, nr_threads);
+}
+
+static int test__intel_pt_par(struct test_suite *test __maybe_unused,
+			      int subtest __maybe_unused)
+{
+	struct test_stream streams[NR_STREAMS] = {};
+	struct test_result ref = {}, r = {};
+	struct intel_pt_segment *segs = NULL;
+	int i, n, nr_threads, err = TEST_FAIL;
+
+	for (i = 0; i < NR_STREAMS; i++) {
+		if (make_stream(&streams[i], i))
+			goto out;
+	}
+
+	/* Every segment but the first starts at a PSB and has its TSC */
+	n = intel_pt_split_psb(streams[1].buf, streams[1].len, 1, 0, &segs);
+	if (n != NR_PSBS) {
+		pr_debug("Split into %d segments instead of %d\n", n, NR_PSBS);
+		goto out;
+	}
+	for (i = 0; i < n; i++) {
+		if (memcmp(segs[i].buf, INTEL_PT_PSB_STR, INTEL_PT_PSB_LEN) ||
+		    segs[i].timestamp != (uint64_t)(1000 + i * 100 + 7)) {
+			pr_debug("Bad segment %d\n", i);
+			goto out;
+		}
+	}
+
+	/* The reference: a single segment per cpu on a single thread */
+	if (decode(streams, &ref, SIZE_MAX, 1) || !ref.nr_outputs ||
+	    ref.out_of_order) {
+		pr_debug("Reference decoding failed\n");
+		goto out;
+	}
+	pr_debug("%d outputs\n", ref.nr_outputs);
+
+	for (nr_threads = 1; nr_threads <= 8; nr_threads *= 2) {
+		if (decode(streams, &r, 1, nr_threads)) {
+			pr_debug("Decoding on %d threads failed\n", nr_threads);
+			goto out;
+		}
+
+		if (r.out_of_order || r.nr_outputs != ref.nr_outputs ||
+		    memcmp(r.outputs, ref.outputs,
+			   r.nr_outputs * sizeof(*r.outputs))) {
+			pr_debug("Different outputs on %d threads\n", nr_threads);
+			goto out;
+		}
+		zfree(&r.outputs);
+	}
+
+	err = TEST_OK;
+out:
+	free(r.outputs);
+	free(ref.outputs);
+	free(segs);
+	for (i = 0; i < NR_STREAMS; i++)
+		free(streams[i].buf);
+	return err;
+}
+
+DEFINE_SUITE("Intel PT parallel decoding", intel_pt_par);
@@ -0,0 +1,52 @@
+#!/bin/sh
+# perf c2c report --num-threads output
+# SPDX-License-Identifier: GPL-2.0
+
+set -e
+
+err=0
+perfdata=$(mktemp /tmp/__perf_test.perf.data.XXXXX)
+single=$(mktemp /tmp/__perf_test.c2c.XXXXX)
+multi=$(mktemp /tmp/__perf_test.c2c.XXXXX)
+
+cleanup() {
+  rm -f "${perfdata}" "${single}" "${multi}"
+  trap - EXIT TERM INT
+}
+
+trap_cleanup() {
+  cleanup
+  exit 1
+}
+trap trap_cleanup EXIT TERM INT
+
+# needs load latency / memory sampling support from the cpu
+if ! perf c2c record -o "${perfdata}" -- \
+     perf bench sched messaging -g 4 -l 200 > /dev/null 2>&1
+then
+  echo "Skip: perf c2c record failed, no memory events?"
+  cleanup
+  exit 2
+fi
+
+# the cachelines are sorted by a pool of threads, the result must not depend
+# on how many there are
+perf c2c report -i "${perfdata}" --stdio --num-threads=1 > "${single}" 2> /dev/null
+perf c2c report -i "${perfdata}" --stdio --num-threads=4 > "${multi}" 2> /dev/null
+
+if ! cmp -s "${single}" "${multi}"
+then
+  echo "perf c2c report differs with 1 and 4 threads:"
+  diff -u "${single}" "${multi}" | head -40
+  err=1
+fi
+
+if [ ${err} -ne 0 ]
+then
+  echo "c2c --num-threads check [Failed]"
+else
+  echo "c2c --num-threads check [Success]"
+fi
+
+cleanup
+exit ${err}
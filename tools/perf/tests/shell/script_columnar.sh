@@ -0,0 +1,102 @@
+#!/bin/sh
+# perf script --columnar export
+# SPDX-License-Identifier: GPL-2.0
+
+set -e
+
+err=0
+perfdata=$(mktemp /tmp/__perf_test.perf.data.XXXXX)
+colfile=$(mktemp /tmp/__perf_test.columnar.XXXXX)
+
+cleanup() {
+  rm -f "${perfdata}" "${colfile}"
+  trap - EXIT TERM INT
+}
+
+trap_cleanup() {
+  cleanup
+  exit 1
+}
+trap trap_cleanup EXIT TERM INT
+
+if ! command -v python3 > /dev/null
+then
+  echo "Skip: no python3 to read the columnar file"
+  cleanup
+  exit 2
+fi
+
+# the shell execs dd, so that the same pid gets new maps and a new comm
+perf record -g -o "${perfdata}" -- \
+  sh -c 'dd if=/dev/zero of=/dev/null bs=1 count=200000 2>/dev/null; exec dd if=/dev/zero of=/dev/null bs=1 count=200000 2>/dev/null' \
+  2> /dev/null
+
+nr_samples=$(perf script -i "${perfdata}" -F tid 2> /dev/null | wc -l)
+perf script -i "${perfdata}" --columnar="${colfile}" 2> /dev/null
+
+# read the file back: every id a sample refers to has to be defined before
+python3 - "${colfile}" "${nr_samples}" << 'EOF' || err=1
+import struct, sys
+
+path, expected = sys.argv[1], int(sys.argv[2])
+data = open(path, 'rb').read()
+
+assert data[:8] == b'PERFCOL1', 'bad magic'
+version, byte_order = struct.unpack_from('=II', data, 8)
+assert version == 1 and byte_order == 0x01020304, 'bad header'
+
+strings, frames, stacks, events = {0}, {0}, {0}, set()
+nr_samples, off = 0, 16
+while off < len(data):
+    ctype, nr, size = struct.unpack_from('=IIQ', data, off)
+    off += 16
+    payload, end = off, off + size
+    assert size % 8 == 0 and end <= len(data), 'bad chunk size'
+    for _ in range(nr if ctype != 5 else 0):
+        if ctype == 1:
+            sid, slen = struct.unpack_from('=II', data, payload)
+            strings.add(sid)
+            payload += (8 + slen + 7) & ~7
+        elif ctype == 2:
+            fid, dso, sym, _ = struct.unpack_from('=IIII', data, payload)
+            assert dso in strings and sym in strings, 'frame before its names'
+            frames.add(fid)
+            payload += 16
+        elif ctype == 3:
+            sid, n = struct.unpack_from('=II', data, payload)
+            ids = struct.unpack_from('=%dI' % n, data, payload + 8 + 8 * n)
+            assert n and all(f in frames for f in ids), 'stack before its frames'
+            stacks.add(sid)
+            payload += (8 + 12 * n + 7) & ~7
+        elif ctype == 4:
+            idx, name = struct.unpack_from('=II', data, payload)
+            assert name in strings, 'event before its name'
+            events.add(idx)
+            payload += 8
+        else:
+            raise AssertionError('unknown chunk type %d' % ctype)
+    if ctype == 5:
+        cols = 48 * nr
+        event = struct.unpack_from('=%dI' % nr, data, payload + 24 * nr + 12 * nr)
+        frame = struct.unpack_from('=%dI' % nr, data, payload + 24 * nr + 16 * nr)
+        stack = struct.unpack_from('=%dI' % nr, data, payload + 24 * nr + 20 * nr)
+        assert all(e in events for e in event), 'sample of an unknown event'
+        assert all(f in frames for f in frame), 'sample of an unknown frame'
+        assert all(s in stacks for s in stack), 'sample of an unknown stack'
+        assert any(stack), 'no callchains'
+        assert payload + cols <= end, 'sample chunk too small'
+        nr_samples += nr
+    off = end
+
+assert nr_samples == expected, '%d samples instead of %d' % (nr_samples, expected)
+EOF
+
+if [ ${err} -ne 0 ]
+then
+  echo "Columnar file check [Failed]"
+else
+  echo "Columnar file check [Success]"
+fi
+
+cleanup
+exit ${err}
@@ -0,0 +1,59 @@
+#!/bin/sh
+# perf trace --bpf-summary min latency on several cpus
+# SPDX-License-Identifier: GPL-2.0
+
+set -e
+
+err=0
+output=$(mktemp /tmp/__perf_test.trace.XXXXX)
+
+cleanup() {
+  rm -f "${output}"
+  trap - EXIT TERM INT
+}
+
+trap_cleanup() {
+  cleanup
+  exit 1
+}
+trap trap_cleanup EXIT TERM INT
+
+nr_cpus=$(getconf _NPROCESSORS_ONLN)
+if [ "${nr_cpus}" -lt 2 ] || ! command -v taskset > /dev/null
+then
+  echo "Skip: needs taskset and at least two cpus"
+  cleanup
+  exit 2
+fi
+
+# sleep on every cpu, so the per-cpu stats of nanosleep are spread over
+# several cpus: the slots of the cpus which didn't create the entry start
+# zeroed and must not report a 0 min latency
+cpus=$(seq 0 $((nr_cpus > 4 ? 3 : nr_cpus - 1)))
+if ! perf trace --bpf-summary -o "${output}" -- \
+     sh -c "for cpu in ${cpus}; do taskset -c \${cpu} sleep 0.01; done" \
+     > /dev/null 2>&1
+then
+  echo "Skip: perf trace --bpf-summary failed, no BPF support?"
+  cleanup
+  exit 2
+fi
+
+# syscall calls errors total min ...: sleeping 10 msec takes at least that
+if ! awk '$1 ~ /nanosleep$/ { found = 1; if ($5 < 9) bad = 1 }
+          END { exit !found || bad }' "${output}"
+then
+  echo "Wrong or missing nanosleep min latency:"
+  cat "${output}"
+  err=1
+fi
+
+if [ ${err} -ne 0 ]
+then
+  echo "trace --bpf-summary min latency check [Failed]"
+else
+  echo "trace --bpf-summary min latency check [Success]"
+fi
+
+cleanup
+exit ${err}
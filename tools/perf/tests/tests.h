@@ -108,6 +108,7 @@ DECLARE_SUITE(mmap_thread_lookup);
 DECLARE_SUITE(thread_maps_share);
 DECLARE_SUITE(hists_output);
 DECLARE_SUITE(hists_cumulate);
+DECLARE_SUITE(hists_parallel);
 DECLARE_SUITE(switch_tracking);
 DECLARE_SUITE(fdarray__filter);
 DECLARE_SUITE(fdarray__add);
@@ -147,6 +148,8 @@ DECLARE_SUITE(expand_cgroup_events);
 DECLARE_SUITE(perf_time_to_tsc);
 DECLARE_SUITE(dlfilter);
 DECLARE_SUITE(sigtrap);
+DECLARE_SUITE(intel_pt_par);
+DECLARE_SUITE(arm_spe_batch);
 
 /*
  * PowerPC and S390 do not support creation of instruction breakpoints using the
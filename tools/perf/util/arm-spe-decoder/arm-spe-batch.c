@@ -0,0 +1,230 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * arm-spe-batch.c: Arm SPE batch decoding and memory latency aggregation
+ *
+ * Instead of synthesizing a perf sample for each SPE record, decode whole
+ * aux buffers into an array of compact records, and aggregate the latency
+ * of the loads and stores in it per instruction or per data address range.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/kernel.h>
+#include <linux/log2.h>
+#include <linux/zalloc.h>
+
+#include "arm-spe-batch.h"
+
+struct arm_spe_batch_input {
+	const unsigned char *buf;
+	size_t len;
+};
+
+void arm_spe_batch__init(struct arm_spe_batch *batch)
+{
+	memset(batch, 0, sizeof(*batch));
+}
+
+void arm_spe_batch__exit(struct arm_spe_batch *batch)
+{
+	zfree(&batch->records);
+	batch->nr_records = batch->nr_alloc = 0;
+}
+
+/* Hand out the whole buffer on the first call, and nothing after that */
+static int arm_spe_batch_get_trace(struct arm_spe_buffer *buffer, void *data)
+{
+	struct arm_spe_batch_input *input = data;
+
+	buffer->buf = input->buf;
+	buffer->len = input->len;
+	input->len = 0;
+	return 0;
+}
+
+static int arm_spe_batch__grow(struct arm_spe_batch *batch, size_t len)
+{
+	struct arm_spe_batch_record *records;
+	/* A record with a load or store address is at least ~40 bytes */
+	size_t nr = batch->nr_alloc + len / 32 + 16;
+
+	records = realloc(batch->records, nr * sizeof(*records));
+	if (!records)
+		return -ENOMEM;
+
+	batch->records = records;
+	batch->nr_alloc = nr;
+	return 0;
+}
+
+/*
+ * Decode all the records in @buf and append them to @batch.  A record cut
+ * at the end of the buffer is dropped, like arm_spe_decode() does.
+ */
+int arm_spe_batch__decode(struct arm_spe_batch *batch,
+			  const unsigned char *buf, size_t len)
+{
+	struct arm_spe_batch_input input = { .buf = buf, .len = len, };
+	struct arm_spe_params params = {
+		.get_trace = arm_spe_batch_get_trace,
+		.data = &input,
+	};
+	struct arm_spe_decoder *decoder;
+	int err = 0;
+
+	decoder = arm_spe_decoder_new(&params);
+	if (!decoder)
+		return -ENOMEM;
+
+	while (1) {
+		const struct arm_spe_record *record = &decoder->record;
+		struct arm_spe_batch_record *r;
+
+		err = arm_spe_decode(decoder);
+		if (err == -EBADMSG) {
+			batch->nr_errors++;
+			continue;
+		}
+		if (err <= 0)
+			break;
+
+		if (batch->nr_records == batch->nr_alloc) {
+			err = arm_spe_batch__grow(batch, decoder->len);
+			if (err)
+				break;
+		}
+
+		r = &batch->records[batch->nr_records++];
+		r->timestamp  = record->timestamp;
+		r->from_ip    = record->from_ip;
+		r->virt_addr  = record->virt_addr;
+		r->context_id = record->context_id;
+		r->latency    = record->latency;
+		r->source     = record->source;
+		r->type	      = record->type;
+		r->op	      = record->op;
+	}
+
+	arm_spe_decoder_free(decoder);
+	return err;
+}
+
+struct arm_spe_lat_sample {
+	u64 key;
+	u32 latency;
+};
+
+static int arm_spe_lat_sample__cmp(const void *a, const void *b)
+{
+	const struct arm_spe_lat_sample *sa = a, *sb = b;
+
+	if (sa->key != sb->key)
+		return sa->key < sb->key ? -1 : 1;
+	return 0;
+}
+
+static int arm_spe_lat_slot(u32 latency)
+{
+	int slot;
+
+	if (!latency)
+		return 0;
+
+	slot = ilog2(latency) + 1;
+	return min(slot, ARM_SPE_LAT_NR_SLOTS - 1);
+}
+
+/*
+ * Aggregate the latency of the loads and stores in @batch per instruction or
+ * per data address, with the addresses rounded down to @granule (a power of
+ * 2, or 0 for exact addresses).  Returns the number of entries put in
+ * @entries, sorted by address, or a negative error code.
+ */
+int arm_spe_batch__aggr_latency(const struct arm_spe_batch *batch,
+				enum arm_spe_lat_key by, u64 granule,
+				struct arm_spe_lat_entry **entries)
+{
+	struct arm_spe_lat_sample *samples;
+	struct arm_spe_lat_entry *entry = NULL;
+	u64 mask = granule ? ~(granule - 1) : ~0ULL;
+	size_t i, nr_samples = 0;
+	int nr = 0;
+
+	if (granule && !is_power_of_2(granule))
+		return -EINVAL;
+
+	*entries = NULL;
+
+	samples = malloc(batch->nr_records * sizeof(*samples) + 1);
+	if (!samples)
+		return -ENOMEM;
+
+	for (i = 0; i < batch->nr_records; i++) {
+		const struct arm_spe_batch_record *r = &batch->records[i];
+
+		if (!(r->op & (ARM_SPE_LD | ARM_SPE_ST)))
+			continue;
+
+		samples[nr_samples].key = by == ARM_SPE_LAT_BY_DATA ?
+					  r->virt_addr : r->from_ip;
+		samples[nr_samples].key &= mask;
+		samples[nr_samples].latency = r->latency;
+		nr_samples++;
+	}
+
+	qsort(samples, nr_samples, sizeof(*samples), arm_spe_lat_sample__cmp);
+
+	for (i = 0; i < nr_samples; i++) {
+		if (!i || samples[i].key != samples[i - 1].key)
+			nr++;
+	}
+
+	if (nr) {
+		*entries = calloc(nr, sizeof(**entries));
+		if (!*entries) {
+			free(samples);
+			return -ENOMEM;
+		}
+	}
+
+	for (i = 0; i < nr_samples; i++) {
+		const struct arm_spe_lat_sample *s = &samples[i];
+
+		if (!i || s->key != samples[i - 1].key) {
+			entry = entry ? entry + 1 : *entries;
+			entry->key = s->key;
+			entry->min = s->latency;
+		}
+
+		entry->count++;
+		entry->total += s->latency;
+		entry->min = min(entry->min, s->latency);
+		entry->max = max(entry->max, s->latency);
+		entry->hist[arm_spe_lat_slot(s->latency)]++;
+	}
+
+	free(samples);
+	return nr;
+}
+
+/* The latency under which @pct percent of the accesses completed */
+u32 arm_spe_lat_entry__percentile(const struct arm_spe_lat_entry *entry,
+				  int pct)
+{
+	u64 target = (entry->count * pct + 99) / 100;
+	u64 sum = 0;
+	int slot;
+
+	for (slot = 0; slot < ARM_SPE_LAT_NR_SLOTS; slot++) {
+		sum += entry->hist[slot];
+		if (sum >= target)
+			break;
+	}
+
+	if (!slot)
+		return entry->min;
+	if (slot >= ARM_SPE_LAT_NR_SLOTS - 1)
+		return entry->max;
+	return min((u32)((1ULL << slot) - 1), entry->max);
+}
@@ -0,0 +1,67 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * arm-spe-batch.h: Arm SPE batch decoding and memory latency aggregation
+ */
+
+#ifndef INCLUDE__ARM_SPE_BATCH_H__
+#define INCLUDE__ARM_SPE_BATCH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/types.h>
+
+#include "arm-spe-decoder.h"
+
+/* The subset of struct arm_spe_record needed for memory profiling */
+struct arm_spe_batch_record {
+	u64 timestamp;
+	u64 from_ip;
+	u64 virt_addr;
+	u64 context_id;
+	u32 latency;
+	u16 source;
+	u8 type;
+	u8 op;
+};
+
+/* Records of one or more aux buffers, in the order they were decoded */
+struct arm_spe_batch {
+	struct arm_spe_batch_record *records;
+	size_t nr_records;
+	size_t nr_alloc;
+	/* Bytes skipped to resync after a bad packet */
+	size_t nr_errors;
+};
+
+void arm_spe_batch__init(struct arm_spe_batch *batch);
+void arm_spe_batch__exit(struct arm_spe_batch *batch);
+
+int arm_spe_batch__decode(struct arm_spe_batch *batch,
+			  const unsigned char *buf, size_t len);
+
+/* log2 buckets of the total latency in cycles */
+#define ARM_SPE_LAT_NR_SLOTS	24
+
+enum arm_spe_lat_key {
+	ARM_SPE_LAT_BY_INSN,
+	ARM_SPE_LAT_BY_DATA,
+};
+
+struct arm_spe_lat_entry {
+	/* Instruction address, or the start of the data address range */
+	u64 key;
+	u64 count;
+	u64 total;
+	u32 min;
+	u32 max;
+	u32 hist[ARM_SPE_LAT_NR_SLOTS];
+};
+
+int arm_spe_batch__aggr_latency(const struct arm_spe_batch *batch,
+				enum arm_spe_lat_key by, u64 granule,
+				struct arm_spe_lat_entry **entries);
+
+u32 arm_spe_lat_entry__percentile(const struct arm_spe_lat_entry *entry,
+				  int pct);
+
+#endif
@@ -0,0 +1,32 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef PERF_BPF_AGGR_H
+#define PERF_BPF_AGGR_H
+
+#include <linux/types.h>
+#include <stdio.h>
+
+/*
+ * Helpers shared by the commands which aggregate events in BPF maps and
+ * read them back from time to time.
+ */
+
+/*
+ * The histograms are log2 ones: slot i counts the values in
+ * [2^i, 2^(i+1)) units, slot 0 the ones in [0, 2).
+ */
+u64 bpf_aggr__hist_count(const __u64 *hist, int nr_slots);
+u64 bpf_aggr__hist_percentile(const __u64 *hist, int nr_slots, int pct,
+			      u64 unit, u64 max_val);
+int bpf_aggr__fprintf_hist(FILE *fp, const __u64 *hist, int nr_slots,
+			   int indent, u64 unit);
+
+#ifdef HAVE_BPF_SKEL
+
+typedef int (*bpf_aggr_entry_fn)(void *key, void *value, void *arg);
+
+int bpf_aggr__drain_map(int fd, size_t key_size, size_t value_size,
+			u32 max_entries, bpf_aggr_entry_fn fn, void *arg);
+
+#endif  /* HAVE_BPF_SKEL */
+
+#endif /* PERF_BPF_AGGR_H */
@@ -0,0 +1,205 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "util/bpf-aggr.h"
+#include "util/debug.h"
+#include <linux/kernel.h>
+#include <linux/time64.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HIST_WIDTH	40
+
+u64 bpf_aggr__hist_count(const __u64 *hist, int nr_slots)
+{
+	u64 count = 0;
+	int i;
+
+	for (i = 0; i < nr_slots; i++)
+		count += hist[i];
+	return count;
+}
+
+/*
+ * Upper bound of the histogram slot which holds the given percentile, in
+ * nsec if a slot @unit is @unit nsec.  It is never above @max_val, the
+ * actual maximum.
+ */
+u64 bpf_aggr__hist_percentile(const __u64 *hist, int nr_slots, int pct,
+			      u64 unit, u64 max_val)
+{
+	u64 target = (bpf_aggr__hist_count(hist, nr_slots) * pct + 99) / 100;
+	u64 sum = 0;
+	int i;
+
+	for (i = 0; i < nr_slots - 1; i++) {
+		sum += hist[i];
+		if (sum >= target)
+			break;
+	}
+	return min((2ULL << i) * unit, (unsigned long long)max_val);
+}
+
+static int fprintf_time(FILE *fp, u64 nsec)
+{
+	if (nsec >= NSEC_PER_SEC)
+		return fprintf(fp, "%4" PRIu64 "s", nsec / NSEC_PER_SEC);
+	if (nsec >= NSEC_PER_MSEC)
+		return fprintf(fp, "%4" PRIu64 "ms", nsec / NSEC_PER_MSEC);
+	if (nsec >= NSEC_PER_USEC)
+		return fprintf(fp, "%4" PRIu64 "us", nsec / NSEC_PER_USEC);
+	return fprintf(fp, "%4" PRIu64 "ns", nsec);
+}
+
+/*
+ * Print the non-empty range of slots of @hist, one line per slot:
+ *
+ *   [ 512ns,    1us) |@@@@@@@@@@@@@@@@@@@@@                   | 123
+ *
+ * Each line is indented by @indent spaces, the slots are @unit nsec.
+ */
+int bpf_aggr__fprintf_hist(FILE *fp, const __u64 *hist, int nr_slots,
+			   int indent, u64 unit)
+{
+	int first = -1, last = 0, i, j;
+	int printed = 0;
+	u64 peak = 0;
+
+	for (i = 0; i < nr_slots; i++) {
+		if (!hist[i])
+			continue;
+		if (first < 0)
+			first = i;
+		last = i;
+		peak = max(peak, (u64)hist[i]);
+	}
+
+	for (i = first; first >= 0 && i <= last; i++) {
+		int width = hist[i] * HIST_WIDTH / peak;
+
+		printed += fprintf(fp, "%*s[", indent, "");
+		printed += fprintf_time(fp, i ? (1ULL << i) * unit : 0);
+		printed += fprintf(fp, ", ");
+		printed += fprintf_time(fp, (2ULL << i) * unit);
+		printed += fprintf(fp, ") |");
+		for (j = 0; j < HIST_WIDTH; j++)
+			printed += fprintf(fp, "%c", j < width ? '@' : ' ');
+		printed += fprintf(fp, "| %" PRIu64 "\n", (u64)hist[i]);
+	}
+	return printed;
+}
+
+#ifdef HAVE_BPF_SKEL
+#include <bpf/bpf.h>
+
+/*
+ * Read and delete the entries of a hash map with lookup and delete batches,
+ * which hash maps support since v5.6.  Returns the number of entries read,
+ * or a negative error if the first batch already failed.
+ */
+static int drain_map_batch(int fd, size_t key_size, size_t value_size,
+			   void *keys, void *values, u32 max_entries)
+{
+	LIBBPF_OPTS(bpf_map_batch_opts, opts);
+	u64 in_batch, out_batch;
+	u32 total = 0, count;
+	int err;
+
+	while (total < max_entries) {
+		count = max_entries - total;
+		err = bpf_map_lookup_and_delete_batch(fd, total ? &in_batch : NULL,
+						      &out_batch,
+						      keys + total * key_size,
+						      values + total * value_size,
+						      &count, &opts);
+		/* count is set to what was read even with an error */
+		total += count;
+		if (err == -ENOENT)
+			break;
+		if (err) {
+			if (!total)
+				return err;
+			pr_debug("BPF map lookup and delete batch failed: %d\n", err);
+			break;
+		}
+		in_batch = out_batch;
+	}
+
+	return total;
+}
+
+/*
+ * Without batches, first read all the entries and then delete them:
+ * deleting the entries while walking their keys can make the walk restart
+ * from the first key.  What gets added to an entry between its read and its
+ * deletion is lost.
+ */
+static int drain_map_walk(int fd, size_t key_size, size_t value_size,
+			  void *keys, void *values, u32 max_entries)
+{
+	void *prev, *key = NULL;
+	u32 n = 0, i;
+
+	prev = malloc(key_size);
+	if (prev == NULL)
+		return -ENOMEM;
+
+	while (n < max_entries) {
+		if (bpf_map_get_next_key(fd, key ? prev : NULL, keys + n * key_size))
+			break;
+
+		key = keys + n * key_size;
+		memcpy(prev, key, key_size);
+
+		/* it can be gone already, go on with the next one */
+		if (bpf_map_lookup_elem(fd, key, values + n * value_size) == 0)
+			n++;
+	}
+
+	for (i = 0; i < n; i++)
+		bpf_map_delete_elem(fd, keys + i * key_size);
+
+	free(prev);
+	return n;
+}
+
+/*
+ * Move the entries of the hash map @fd to userspace, deleting them so that
+ * the next call only sees what got aggregated in the meantime, and call @fn
+ * on each of them.  @value_size is the size of the whole value of an entry,
+ * i.e. for a per-cpu map the size of its per-cpu values times the number of
+ * possible cpus.  At most @max_entries are read, as new entries can keep
+ * showing up while reading.
+ *
+ * Each entry is passed to @fn exactly once.  Returns the number of entries,
+ * or a negative error.
+ */
+int bpf_aggr__drain_map(int fd, size_t key_size, size_t value_size,
+			u32 max_entries, bpf_aggr_entry_fn fn, void *arg)
+{
+	void *keys, *values;
+	int nr, i, err = 0;
+
+	keys = calloc(max_entries, key_size);
+	values = calloc(max_entries, value_size);
+	if (!keys || !values) {
+		nr = -ENOMEM;
+		goto out;
+	}
+
+	nr = drain_map_batch(fd, key_size, value_size, keys, values, max_entries);
+	if (nr < 0)
+		nr = drain_map_walk(fd, key_size, value_size, keys, values,
+				    max_entries);
+
+	for (i = 0; i < nr && !err; i++)
+		err = fn(keys + i * key_size, values + i * value_size, arg);
+	if (err)
+		nr = err;
+out:
+	free(keys);
+	free(values);
+	return nr;
+}
+
+#endif  /* HAVE_BPF_SKEL */
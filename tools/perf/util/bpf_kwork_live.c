@@ -0,0 +1,157 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "util/bpf-aggr.h"
+#include "util/debug.h"
+#include "util/kwork-live.h"
+#include <perf/cpumap.h>
+#include <linux/zalloc.h>
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+#include <errno.h>
+#include <stdlib.h>
+
+#include "bpf_skel/kwork_live.skel.h"
+
+static struct kwork_live_bpf *skel;
+
+int kwork_live_prepare(struct kwork_live *live)
+{
+	struct perf_cpu_map *cpus = NULL;
+	int i, ncpus = 1;
+
+	if (live->cpu_list) {
+		cpus = perf_cpu_map__new(live->cpu_list);
+		if (cpus == NULL) {
+			pr_err("Invalid cpu list: %s\n", live->cpu_list);
+			return -1;
+		}
+		ncpus = perf_cpu_map__nr(cpus);
+	}
+
+	skel = kwork_live_bpf__open();
+	if (!skel) {
+		pr_err("Failed to open kwork live BPF skeleton\n");
+		goto out_err;
+	}
+
+	bpf_map__set_max_entries(skel->maps.kwork_stats, live->map_nr_entries);
+	bpf_map__set_max_entries(skel->maps.pending, live->map_nr_entries);
+	bpf_map__set_max_entries(skel->maps.cpu_filter, ncpus);
+
+	/* don't attach to the events of the classes we don't care about */
+	if (!(live->class_mask & (1 << KWORK_LIVE_IRQ))) {
+		bpf_program__set_autoload(skel->progs.on_irq_handler_entry, false);
+		bpf_program__set_autoload(skel->progs.on_irq_handler_exit, false);
+	}
+	if (!(live->class_mask & (1 << KWORK_LIVE_SOFTIRQ))) {
+		bpf_program__set_autoload(skel->progs.on_softirq_raise, false);
+		bpf_program__set_autoload(skel->progs.on_softirq_entry, false);
+		bpf_program__set_autoload(skel->progs.on_softirq_exit, false);
+	}
+	if (!(live->class_mask & (1 << KWORK_LIVE_WORKQUEUE))) {
+		bpf_program__set_autoload(skel->progs.on_workqueue_activate_work, false);
+		bpf_program__set_autoload(skel->progs.on_workqueue_execute_start, false);
+		bpf_program__set_autoload(skel->progs.on_workqueue_execute_end, false);
+	}
+	if (!(live->class_mask & (1 << KWORK_LIVE_TIMER))) {
+		bpf_program__set_autoload(skel->progs.on_hrtimer_expire_entry, false);
+		bpf_program__set_autoload(skel->progs.on_hrtimer_expire_exit, false);
+	}
+
+	if (kwork_live_bpf__load(skel) < 0) {
+		pr_err("Failed to load kwork live BPF skeleton\n");
+		goto out_err;
+	}
+
+	if (cpus) {
+		int fd = bpf_map__fd(skel->maps.cpu_filter);
+		u8 val = 1;
+		u32 cpu;
+
+		skel->bss->has_cpu = 1;
+		for (i = 0; i < ncpus; i++) {
+			cpu = perf_cpu_map__cpu(cpus, i).cpu;
+			bpf_map_update_elem(fd, &cpu, &val, BPF_ANY);
+		}
+	}
+	skel->bss->class_mask = live->class_mask;
+
+	if (kwork_live_bpf__attach(skel) < 0) {
+		pr_err("Failed to attach kwork live BPF skeleton\n");
+		goto out_err;
+	}
+
+	perf_cpu_map__put(cpus);
+	return 0;
+
+out_err:
+	perf_cpu_map__put(cpus);
+	return -1;
+}
+
+int kwork_live_start(void)
+{
+	skel->bss->enabled = 1;
+	return 0;
+}
+
+int kwork_live_stop(void)
+{
+	skel->bss->enabled = 0;
+	return 0;
+}
+
+static int kwork_live__add_stat(void *key, void *value, void *arg)
+{
+	struct kwork_live *live = arg;
+	struct kwork_live_key *k = key;
+	struct kwork_live_stat *st = &live->stats[live->nr_stats++];
+
+	st->class = k->class;
+	st->cpu = k->cpu;
+	st->id = k->id;
+	st->data = *(struct kwork_live_data *)value;
+	return 0;
+}
+
+/*
+ * Move the entries aggregated since the last read from the BPF map into
+ * live->stats, deleting them when they are read so that each read gives
+ * the stats of the last interval only.
+ */
+int kwork_live_read(struct kwork_live *live)
+{
+	int err;
+
+	zfree(&live->stats);
+	live->nr_stats = 0;
+
+	live->stats = calloc(live->map_nr_entries, sizeof(*live->stats));
+	if (live->stats == NULL)
+		return -ENOMEM;
+
+	err = bpf_aggr__drain_map(bpf_map__fd(skel->maps.kwork_stats),
+				  sizeof(struct kwork_live_key),
+				  sizeof(struct kwork_live_data),
+				  live->map_nr_entries, kwork_live__add_stat, live);
+	if (err < 0)
+		return err;
+
+	live->lost = skel->bss->lost;
+	skel->bss->lost = 0;
+	live->collisions = skel->bss->collisions;
+	skel->bss->collisions = 0;
+	return 0;
+}
+
+int kwork_live_finish(struct kwork_live *live)
+{
+	if (skel) {
+		skel->bss->enabled = 0;
+		kwork_live_bpf__destroy(skel);
+		skel = NULL;
+	}
+
+	zfree(&live->stats);
+	live->nr_stats = 0;
+	return 0;
+}
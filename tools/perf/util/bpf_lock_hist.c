@@ -0,0 +1,271 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "util/bpf-aggr.h"
+#include "util/debug.h"
+#include "util/evlist.h"
+#include "util/target.h"
+#include "util/lock-hist.h"
+#include <api/fs/fs.h>
+#include <perf/cpumap.h>
+#include <perf/threadmap.h>
+#include <linux/kernel.h>
+#include <linux/zalloc.h>
+#include <linux/string.h>
+#include <bpf/bpf.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bpf_skel/lock_contention.skel.h"
+
+/* the histograms are collected by the lock contention BPF program */
+static struct lock_contention_bpf *skel;
+
+/* cgroup v2 ids are the inode numbers of the cgroup directories */
+static int lock_hist__add_cgroups(const char *cgroups, int fd)
+{
+	char mnt[PATH_MAX], path[PATH_MAX];
+	char *list, *name, *p;
+	u8 val = 1;
+	int err = 0;
+
+	if (cgroupfs_find_mountpoint(mnt, sizeof(mnt), "perf_event")) {
+		pr_err("Failed to find cgroup mount point\n");
+		return -ENOENT;
+	}
+
+	list = strdup(cgroups);
+	if (list == NULL)
+		return -ENOMEM;
+
+	for (name = strtok_r(list, ",", &p); name; name = strtok_r(NULL, ",", &p)) {
+		struct stat st;
+		u64 id;
+
+		scnprintf(path, sizeof(path), "%s/%s", mnt,
+			  name[0] == '/' ? name + 1 : name);
+		if (stat(path, &st) < 0) {
+			pr_err("Failed to find cgroup: %s\n", name);
+			err = -errno;
+			break;
+		}
+
+		id = st.st_ino;
+		bpf_map_update_elem(fd, &id, &val, BPF_ANY);
+	}
+
+	free(list);
+	return err;
+}
+
+static int lock_hist__count_cgroups(const char *cgroups)
+{
+	int nr = 1;
+
+	while ((cgroups = strchr(cgroups, ',')) != NULL) {
+		cgroups++;
+		nr++;
+	}
+	return nr;
+}
+
+int lock_hist_prepare(struct lock_hist *hist)
+{
+	int i, fd;
+	int ncpus = 1, ntasks = 1, ncgrps = 1;
+	struct evlist *evlist = hist->evlist;
+	struct target *target = hist->target;
+
+	skel = lock_contention_bpf__open();
+	if (!skel) {
+		pr_err("Failed to open lock-contention BPF skeleton\n");
+		return -1;
+	}
+
+	bpf_map__set_value_size(skel->maps.stacks, hist->max_stack * sizeof(u64));
+	bpf_map__set_max_entries(skel->maps.stacks, hist->map_nr_entries);
+	bpf_map__set_max_entries(skel->maps.lock_hist, hist->map_nr_entries);
+	/* lock_stat is not used with aggr_hist */
+	bpf_map__set_max_entries(skel->maps.lock_stat, 1);
+
+	if (target__has_cpu(target))
+		ncpus = perf_cpu_map__nr(evlist->core.user_requested_cpus);
+	if (target__has_task(target))
+		ntasks = perf_thread_map__nr(evlist->core.threads);
+	if (hist->cgroups)
+		ncgrps = lock_hist__count_cgroups(hist->cgroups);
+
+	bpf_map__set_max_entries(skel->maps.cpu_filter, ncpus);
+	bpf_map__set_max_entries(skel->maps.task_filter, ntasks);
+	bpf_map__set_max_entries(skel->maps.cgroup_filter, ncgrps);
+
+	if (lock_contention_bpf__load(skel) < 0) {
+		pr_err("Failed to load lock-contention BPF skeleton\n");
+		return -1;
+	}
+
+	if (target__has_cpu(target)) {
+		u32 cpu;
+		u8 val = 1;
+
+		skel->bss->has_cpu = 1;
+		fd = bpf_map__fd(skel->maps.cpu_filter);
+
+		for (i = 0; i < ncpus; i++) {
+			cpu = perf_cpu_map__cpu(evlist->core.user_requested_cpus, i).cpu;
+			bpf_map_update_elem(fd, &cpu, &val, BPF_ANY);
+		}
+	}
+
+	if (target__has_task(target)) {
+		u32 pid;
+		u8 val = 1;
+
+		skel->bss->has_task = 1;
+		fd = bpf_map__fd(skel->maps.task_filter);
+
+		for (i = 0; i < ntasks; i++) {
+			pid = perf_thread_map__pid(evlist->core.threads, i);
+			bpf_map_update_elem(fd, &pid, &val, BPF_ANY);
+		}
+	}
+
+	if (target__none(target) && evlist->workload.pid > 0) {
+		u32 pid = evlist->workload.pid;
+		u8 val = 1;
+
+		skel->bss->has_task = 1;
+		fd = bpf_map__fd(skel->maps.task_filter);
+		bpf_map_update_elem(fd, &pid, &val, BPF_ANY);
+	}
+
+	if (hist->cgroups) {
+		skel->bss->has_cgroup = 1;
+		fd = bpf_map__fd(skel->maps.cgroup_filter);
+
+		if (lock_hist__add_cgroups(hist->cgroups, fd) < 0)
+			return -1;
+	}
+
+	skel->bss->aggr_hist = 1;
+	skel->bss->aggr_addr = hist->aggr_addr;
+
+	if (lock_contention_bpf__attach(skel) < 0) {
+		pr_err("Failed to attach lock-contention BPF skeleton\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+int lock_hist_start(void)
+{
+	skel->bss->enabled = 1;
+	return 0;
+}
+
+int lock_hist_stop(void)
+{
+	skel->bss->enabled = 0;
+	return 0;
+}
+
+static void lock_hist__free_entries(struct lock_hist *hist)
+{
+	int i;
+
+	for (i = 0; i < hist->nr_entries; i++)
+		free(hist->entries[i].callstack);
+	zfree(&hist->entries);
+	hist->nr_entries = 0;
+}
+
+struct lock_hist__read_arg {
+	struct lock_hist	*hist;
+	int			stack_fd;
+};
+
+static int lock_hist__add_entry(void *key, void *value, void *arg)
+{
+	struct lock_hist__read_arg *ra = arg;
+	struct lock_hist *hist = ra->hist;
+	struct lock_hist_entry *entry = &hist->entries[hist->nr_entries++];
+
+	entry->key = *(struct lock_hist_key *)key;
+	entry->data = *(struct lock_hist_data *)value;
+	if (entry->key.stack_id >= 0) {
+		entry->callstack = zalloc(hist->max_stack * sizeof(u64));
+		if (entry->callstack &&
+		    bpf_map_lookup_elem(ra->stack_fd, &entry->key.stack_id,
+					entry->callstack) < 0)
+			zfree(&entry->callstack);
+	}
+	return 0;
+}
+
+/*
+ * The entries have their own copy of the stack traces, drop those of the
+ * map or it fills up after a while and new callers are counted as lost.
+ * A contention ending during the read may lose its stack trace and be
+ * shown with an unknown caller.
+ */
+static void lock_hist__clear_stacks(int fd)
+{
+	u32 id, next;
+	int err;
+
+	err = bpf_map_get_next_key(fd, NULL, &next);
+	while (!err) {
+		id = next;
+		err = bpf_map_get_next_key(fd, &id, &next);
+		bpf_map_delete_elem(fd, &id);
+	}
+}
+
+/*
+ * Move the stats aggregated since the last read from the BPF map into
+ * hist->entries.  The entries and the stack traces are deleted when they
+ * are read so that every read returns the contention of the last interval
+ * only.
+ */
+int lock_hist_read(struct lock_hist *hist)
+{
+	struct lock_hist__read_arg arg = {
+		.hist = hist,
+		.stack_fd = bpf_map__fd(skel->maps.stacks),
+	};
+	int err;
+
+	lock_hist__free_entries(hist);
+
+	hist->entries = calloc(hist->map_nr_entries, sizeof(*hist->entries));
+	if (hist->entries == NULL)
+		return -ENOMEM;
+
+	err = bpf_aggr__drain_map(bpf_map__fd(skel->maps.lock_hist),
+				  sizeof(struct lock_hist_key),
+				  sizeof(struct lock_hist_data),
+				  hist->map_nr_entries, lock_hist__add_entry, &arg);
+	if (err < 0)
+		return err;
+
+	lock_hist__clear_stacks(arg.stack_fd);
+
+	hist->lost = skel->bss->lost;
+	skel->bss->lost = 0;
+	return 0;
+}
+
+int lock_hist_finish(struct lock_hist *hist)
+{
+	if (skel) {
+		skel->bss->enabled = 0;
+		lock_contention_bpf__destroy(skel);
+		skel = NULL;
+	}
+
+	lock_hist__free_entries(hist);
+	return 0;
+}
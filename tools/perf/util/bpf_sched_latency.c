@@ -0,0 +1,115 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "util/bpf-aggr.h"
+#include "util/debug.h"
+#include "util/sched-latency.h"
+#include <linux/zalloc.h>
+#include <linux/string.h>
+#include <bpf/bpf.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bpf_skel/sched_latency.skel.h"
+
+static struct sched_latency_bpf *skel;
+
+int sched_latency_prepare(struct sched_latency *lat)
+{
+	skel = sched_latency_bpf__open();
+	if (!skel) {
+		pr_err("Failed to open sched-latency BPF skeleton\n");
+		return -1;
+	}
+
+	bpf_map__set_max_entries(skel->maps.latency, lat->map_nr_entries);
+	skel->bss->aggr_cgroup = lat->aggr_mode == SCHED_LAT_AGGR_CGROUP;
+
+	if (sched_latency_bpf__load(skel) < 0) {
+		pr_err("Failed to load sched-latency BPF skeleton\n");
+		return -1;
+	}
+
+	if (sched_latency_bpf__attach(skel) < 0) {
+		pr_err("Failed to attach sched-latency BPF skeleton\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+int sched_latency_start(void)
+{
+	skel->bss->enabled = 1;
+	return 0;
+}
+
+int sched_latency_stop(void)
+{
+	skel->bss->enabled = 0;
+	return 0;
+}
+
+static void sched_latency__free_stats(struct sched_latency *lat)
+{
+	int i;
+
+	for (i = 0; i < lat->nr_stats; i++)
+		free(lat->stats[i].name);
+	zfree(&lat->stats);
+	lat->nr_stats = 0;
+}
+
+static int sched_latency__add_stat(void *key, void *value, void *arg)
+{
+	struct sched_latency *lat = arg;
+	struct sched_lat_data *data = value;
+	struct sched_latency_stat *st = &lat->stats[lat->nr_stats++];
+
+	st->id = *(u64 *)key;
+	st->count = data->count;
+	st->total = data->total;
+	st->max = data->max;
+	memcpy(st->hist, data->hist, sizeof(st->hist));
+	if (lat->aggr_mode == SCHED_LAT_AGGR_TASK)
+		st->name = strndup(data->comm, sizeof(data->comm));
+	return 0;
+}
+
+/*
+ * Move the entries aggregated since the last read from the BPF map into
+ * lat->stats.  The entries are deleted when they are read, so the map only
+ * holds the tasks (or cgroups) which actually waited for a cpu in the
+ * current interval and never fills up with dead tasks.
+ */
+int sched_latency_read(struct sched_latency *lat)
+{
+	int fd = bpf_map__fd(skel->maps.latency);
+	int err;
+
+	sched_latency__free_stats(lat);
+
+	lat->stats = calloc(lat->map_nr_entries, sizeof(*lat->stats));
+	if (lat->stats == NULL)
+		return -ENOMEM;
+
+	err = bpf_aggr__drain_map(fd, sizeof(u64), sizeof(struct sched_lat_data),
+				  lat->map_nr_entries, sched_latency__add_stat, lat);
+	if (err < 0)
+		return err;
+
+	lat->lost = skel->bss->lost;
+	skel->bss->lost = 0;
+	return 0;
+}
+
+int sched_latency_finish(struct sched_latency *lat)
+{
+	if (skel) {
+		skel->bss->enabled = 0;
+		sched_latency_bpf__destroy(skel);
+		skel = NULL;
+	}
+
+	sched_latency__free_stats(lat);
+	return 0;
+}
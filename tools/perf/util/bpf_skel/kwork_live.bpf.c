@@ -0,0 +1,380 @@
+// SPDX-License-Identifier: (GPL-2.0-only OR BSD-2-Clause)
+#include "vmlinux.h"
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+#include <bpf/bpf_core_read.h>
+
+#include "kwork_live_data.h"
+
+/* default buffer size */
+#define MAX_ENTRIES	10240
+
+/*
+ * What is running on a cpu right now.  Hard irqs don't nest, and neither
+ * do softirqs, so a single slot per context is enough.
+ */
+struct cpu_ctx {
+	__u64 irq_start;
+	__u64 softirq_start;
+	__u64 softirq_delay;
+	/* time of the first raise of a still pending softirq vector */
+	__u64 softirq_raise[NR_SOFTIRQS];
+};
+
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+	__uint(key_size, sizeof(__u32));
+	__uint(value_size, sizeof(struct cpu_ctx));
+	__uint(max_entries, 1);
+} cpu_ctx SEC(".maps");
+
+/* a queued work or a running hrtimer, keyed by its address */
+struct pending {
+	__u64 queued;
+	__u64 start;
+	__u64 delay;
+	__u64 func;
+	/* queued again by itself while running, for the next run */
+	__u64 requeued;
+};
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(key_size, sizeof(__u64));
+	__uint(value_size, sizeof(struct pending));
+	__uint(max_entries, MAX_ENTRIES);
+} pending SEC(".maps");
+
+/*
+ * The cpu is part of the key, so an entry is only ever updated by its own
+ * cpu and the counters don't need atomics.
+ */
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(key_size, sizeof(struct kwork_live_key));
+	__uint(value_size, sizeof(struct kwork_live_data));
+	__uint(max_entries, MAX_ENTRIES);
+} kwork_stats SEC(".maps");
+
+/* never written, to initialize new kwork_stats entries */
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+	__uint(key_size, sizeof(__u32));
+	__uint(value_size, sizeof(struct kwork_live_data));
+	__uint(max_entries, 1);
+} empty_data SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(key_size, sizeof(__u32));
+	__uint(value_size, sizeof(__u8));
+	__uint(max_entries, 1);
+} cpu_filter SEC(".maps");
+
+int enabled;
+int has_cpu;
+/* bitmask of enum kwork_live_class */
+int class_mask;
+int lost;
+/* works activated while already in the pending map */
+int collisions;
+
+static inline int can_record(int class)
+{
+	if (!enabled || !(class_mask & (1 << class)))
+		return 0;
+
+	if (has_cpu) {
+		__u32 cpu = bpf_get_smp_processor_id();
+
+		if (!bpf_map_lookup_elem(&cpu_filter, &cpu))
+			return 0;
+	}
+	return 1;
+}
+
+static inline __u32 time_slot(__u64 delta)
+{
+	__u32 slot = 0;
+
+	while (delta > 1 && slot < KWORK_LIVE_NR_SLOTS - 1) {
+		delta >>= 1;
+		slot++;
+	}
+	return slot;
+}
+
+static inline struct cpu_ctx *get_cpu_ctx(void)
+{
+	__u32 zero = 0;
+
+	return bpf_map_lookup_elem(&cpu_ctx, &zero);
+}
+
+static struct kwork_live_data *get_stats(int class, __u64 id)
+{
+	struct kwork_live_key key = {
+		.class	= class,
+		.cpu	= bpf_get_smp_processor_id(),
+		.id	= id,
+	};
+	struct kwork_live_data *data;
+	__u32 zero = 0;
+
+	data = bpf_map_lookup_elem(&kwork_stats, &key);
+	if (data)
+		return data;
+
+	/* the value doesn't fit in the BPF stack, copy it from empty_data */
+	data = bpf_map_lookup_elem(&empty_data, &zero);
+	if (!data)
+		return NULL;
+
+	bpf_map_update_elem(&kwork_stats, &key, data, BPF_NOEXIST);
+
+	data = bpf_map_lookup_elem(&kwork_stats, &key);
+	if (!data)
+		__sync_fetch_and_add(&lost, 1);
+	return data;
+}
+
+static inline void account(struct kwork_live_data *data, __u64 delay,
+			   __u64 runtime, int has_delay)
+{
+	data->count++;
+	data->run_total += runtime;
+	data->run_hist[time_slot(runtime)]++;
+	if (data->run_max < runtime)
+		data->run_max = runtime;
+
+	if (!has_delay)
+		return;
+
+	data->delay_total += delay;
+	data->delay_hist[time_slot(delay)]++;
+	if (data->delay_max < delay)
+		data->delay_max = delay;
+}
+
+SEC("tp_btf/irq_handler_entry")
+int on_irq_handler_entry(u64 *ctx)
+{
+	struct cpu_ctx *c = get_cpu_ctx();
+
+	if (c)
+		c->irq_start = can_record(KWORK_LIVE_IRQ) ? bpf_ktime_get_ns() : 0;
+	return 0;
+}
+
+SEC("tp_btf/irq_handler_exit")
+int on_irq_handler_exit(u64 *ctx)
+{
+	int irq = ctx[0];
+	struct irqaction *action = (void *)ctx[1];
+	struct cpu_ctx *c = get_cpu_ctx();
+	struct kwork_live_data *data;
+	__u64 now = bpf_ktime_get_ns();
+
+	if (!c || !c->irq_start)
+		return 0;
+
+	data = get_stats(KWORK_LIVE_IRQ, irq);
+	if (data) {
+		if (!data->name[0])
+			bpf_probe_read_kernel_str(data->name, sizeof(data->name),
+						  BPF_CORE_READ(action, name));
+		account(data, 0, now - c->irq_start, 0);
+	}
+	c->irq_start = 0;
+	return 0;
+}
+
+SEC("tp_btf/softirq_raise")
+int on_softirq_raise(u64 *ctx)
+{
+	unsigned int vec = ctx[0];
+	struct cpu_ctx *c;
+
+	if (vec >= NR_SOFTIRQS || !can_record(KWORK_LIVE_SOFTIRQ))
+		return 0;
+
+	/* raising a pending softirq again doesn't make it run any sooner */
+	c = get_cpu_ctx();
+	if (c && !c->softirq_raise[vec])
+		c->softirq_raise[vec] = bpf_ktime_get_ns();
+	return 0;
+}
+
+SEC("tp_btf/softirq_entry")
+int on_softirq_entry(u64 *ctx)
+{
+	unsigned int vec = ctx[0];
+	struct cpu_ctx *c = get_cpu_ctx();
+	__u64 now = bpf_ktime_get_ns();
+
+	if (!c || vec >= NR_SOFTIRQS)
+		return 0;
+
+	if (!can_record(KWORK_LIVE_SOFTIRQ)) {
+		c->softirq_raise[vec] = 0;
+		c->softirq_start = 0;
+		return 0;
+	}
+
+	/* raised before we were enabled: count the run, not the delay */
+	c->softirq_delay = c->softirq_raise[vec] ?
+			   now - c->softirq_raise[vec] : ~0ULL;
+	c->softirq_raise[vec] = 0;
+	c->softirq_start = now;
+	return 0;
+}
+
+SEC("tp_btf/softirq_exit")
+int on_softirq_exit(u64 *ctx)
+{
+	unsigned int vec = ctx[0];
+	struct cpu_ctx *c = get_cpu_ctx();
+	struct kwork_live_data *data;
+	__u64 now = bpf_ktime_get_ns();
+
+	if (!c || !c->softirq_start)
+		return 0;
+
+	data = get_stats(KWORK_LIVE_SOFTIRQ, vec);
+	if (data)
+		account(data, c->softirq_delay, now - c->softirq_start,
+			c->softirq_delay != ~0ULL);
+	c->softirq_start = 0;
+	return 0;
+}
+
+SEC("tp_btf/workqueue_activate_work")
+int on_workqueue_activate_work(u64 *ctx)
+{
+	__u64 work = ctx[0];
+	struct pending p = {}, *old;
+
+	if (!can_record(KWORK_LIVE_WORKQUEUE))
+		return 0;
+
+	p.queued = bpf_ktime_get_ns();
+	if (!bpf_map_update_elem(&pending, &work, &p, BPF_NOEXIST))
+		return 0;
+
+	old = bpf_map_lookup_elem(&pending, &work);
+	if (!old) {
+		__sync_fetch_and_add(&lost, 1);
+		return 0;
+	}
+
+	__sync_fetch_and_add(&collisions, 1);
+	/*
+	 * Don't overwrite the run in progress of a work which requeues
+	 * itself, remember when the next one was queued instead.  If it
+	 * isn't running, the entry is left over from an activation which
+	 * was cancelled before it ran: start over from this one.
+	 */
+	if (!old->start)
+		old->queued = p.queued;
+	else if (!old->requeued)
+		old->requeued = p.queued;
+	return 0;
+}
+
+SEC("tp_btf/workqueue_execute_start")
+int on_workqueue_execute_start(u64 *ctx)
+{
+	struct work_struct *work = (void *)ctx[0];
+	__u64 key = (__u64)work;
+	struct pending *p;
+	__u64 now;
+
+	p = bpf_map_lookup_elem(&pending, &key);
+	if (!p)
+		return 0;
+
+	if (!can_record(KWORK_LIVE_WORKQUEUE)) {
+		bpf_map_delete_elem(&pending, &key);
+		return 0;
+	}
+
+	now = bpf_ktime_get_ns();
+	p->delay = now - p->queued;
+	p->start = now;
+	/* the work item can be freed or reused by its function */
+	p->func = (__u64)BPF_CORE_READ(work, func);
+	return 0;
+}
+
+SEC("tp_btf/workqueue_execute_end")
+int on_workqueue_execute_end(u64 *ctx)
+{
+	__u64 key = ctx[0];
+	struct kwork_live_data *data;
+	struct pending *p;
+
+	p = bpf_map_lookup_elem(&pending, &key);
+	if (!p || !p->start)
+		return 0;
+
+	data = get_stats(KWORK_LIVE_WORKQUEUE, p->func);
+	if (data)
+		account(data, p->delay, bpf_ktime_get_ns() - p->start, 1);
+
+	if (p->requeued) {
+		p->queued = p->requeued;
+		p->requeued = 0;
+		p->start = 0;
+		return 0;
+	}
+	bpf_map_delete_elem(&pending, &key);
+	return 0;
+}
+
+SEC("tp_btf/hrtimer_expire_entry")
+int on_hrtimer_expire_entry(u64 *ctx)
+{
+	struct hrtimer *timer = (void *)ctx[0];
+	ktime_t *nowp = (void *)ctx[1];
+	__u64 key = (__u64)timer;
+	struct pending p = {};
+	s64 now = 0, expires;
+
+	if (!can_record(KWORK_LIVE_TIMER))
+		return 0;
+
+	/*
+	 * The expiry time and @now are in the clock of the timer base, which
+	 * is not necessarily the one of bpf_ktime_get_ns().
+	 */
+	bpf_probe_read_kernel(&now, sizeof(now), nowp);
+	expires = BPF_CORE_READ(timer, node.expires);
+
+	p.delay = now > expires ? now - expires : 0;
+	p.start = bpf_ktime_get_ns();
+	p.func = (__u64)BPF_CORE_READ(timer, function);
+	if (bpf_map_update_elem(&pending, &key, &p, BPF_ANY) < 0)
+		__sync_fetch_and_add(&lost, 1);
+	return 0;
+}
+
+SEC("tp_btf/hrtimer_expire_exit")
+int on_hrtimer_expire_exit(u64 *ctx)
+{
+	__u64 key = ctx[0];
+	struct kwork_live_data *data;
+	struct pending *p;
+
+	p = bpf_map_lookup_elem(&pending, &key);
+	if (!p)
+		return 0;
+
+	data = get_stats(KWORK_LIVE_TIMER, p->func);
+	if (data)
+		account(data, p->delay, bpf_ktime_get_ns() - p->start, 1);
+
+	bpf_map_delete_elem(&pending, &key);
+	return 0;
+}
+
+char LICENSE[] SEC("license") = "Dual BSD/GPL";
@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: (GPL-2.0-only OR BSD-2-Clause) */
+/* Data structures shared between BPF and tools. */
+#ifndef UTIL_BPF_SKEL_KWORK_LIVE_DATA_H
+#define UTIL_BPF_SKEL_KWORK_LIVE_DATA_H
+
+/* log2 buckets of the delay and of the runtime in nsec */
+#define KWORK_LIVE_NR_SLOTS	32
+#define KWORK_LIVE_NAME_LEN	16
+
+enum kwork_live_class {
+	KWORK_LIVE_IRQ,
+	KWORK_LIVE_SOFTIRQ,
+	KWORK_LIVE_WORKQUEUE,
+	KWORK_LIVE_TIMER,
+	KWORK_LIVE_CLASS_MAX,
+};
+
+/*
+ * The id is the irq number, the softirq vector, or the address of the
+ * work or hrtimer function.
+ */
+struct kwork_live_key {
+	__u32 class;
+	__u32 cpu;
+	__u64 id;
+};
+
+/*
+ * The delay is from the raise (softirq), the queueing (workqueue) or the
+ * expiry time (hrtimer) to the start of the handler; irqs have no delay.
+ */
+struct kwork_live_data {
+	__u64 count;
+	__u64 delay_total;
+	__u64 delay_max;
+	__u64 run_total;
+	__u64 run_max;
+	__u64 delay_hist[KWORK_LIVE_NR_SLOTS];
+	__u64 run_hist[KWORK_LIVE_NR_SLOTS];
+	/* irq handler name */
+	char name[KWORK_LIVE_NAME_LEN];
+};
+
+#endif /* UTIL_BPF_SKEL_KWORK_LIVE_DATA_H */
@@ -0,0 +1,24 @@
+/* SPDX-License-Identifier: (GPL-2.0-only OR BSD-2-Clause) */
+/* Data structures shared between BPF and tools. */
+#ifndef UTIL_BPF_SKEL_LOCK_HIST_DATA_H
+#define UTIL_BPF_SKEL_LOCK_HIST_DATA_H
+
+/* log2 buckets of the lock wait time in nsec */
+#define LOCK_HIST_NR_SLOTS	40
+
+/* lock_addr is 0 unless the stats are aggregated per lock instance */
+struct lock_hist_key {
+	__u64 lock_addr;
+	__s32 stack_id;
+	__u32 flags;
+};
+
+struct lock_hist_data {
+	__u64 count;
+	__u64 total;
+	__u64 max;
+	__u64 min;
+	__u64 hist[LOCK_HIST_NR_SLOTS];
+};
+
+#endif /* UTIL_BPF_SKEL_LOCK_HIST_DATA_H */
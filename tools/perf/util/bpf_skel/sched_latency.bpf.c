@@ -0,0 +1,150 @@
+// SPDX-License-Identifier: (GPL-2.0-only OR BSD-2-Clause)
+#include "vmlinux.h"
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+#include <bpf/bpf_core_read.h>
+
+#include "sched_latency_data.h"
+
+/* default buffer size */
+#define MAX_ENTRIES	10240
+
+#define TASK_RUNNING	0
+
+/* time the task became runnable, 0 if it's not waiting for a cpu */
+struct {
+	__uint(type, BPF_MAP_TYPE_TASK_STORAGE);
+	__uint(map_flags, BPF_F_NO_PREALLOC);
+	__type(key, int);
+	__type(value, __u64);
+} runnable_ts SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(key_size, sizeof(__u64));
+	__uint(value_size, sizeof(struct sched_lat_data));
+	__uint(max_entries, MAX_ENTRIES);
+} latency SEC(".maps");
+
+/* old kernel task_struct definition */
+struct task_struct___old {
+	long state;
+} __attribute__((preserve_access_index));
+
+int enabled;
+int aggr_cgroup;
+int lost;
+
+/* from kernel/sched/sched.h */
+static inline int get_task_state(struct task_struct *t)
+{
+	if (bpf_core_field_exists(t->__state))
+		return BPF_CORE_READ(t, __state);
+
+	/* recast pointer to capture task_struct___old type for compiler */
+	struct task_struct___old *t_old = (void *)t;
+
+	/* now use old "state" name of the field */
+	return BPF_CORE_READ(t_old, state);
+}
+
+static inline __u32 latency_slot(__u64 delta)
+{
+	__u64 usecs = delta / 1000;
+	__u32 slot = 0;
+
+	while (usecs > 1 && slot < SCHED_LAT_NR_SLOTS - 1) {
+		usecs >>= 1;
+		slot++;
+	}
+	return slot;
+}
+
+static inline void mark_runnable(struct task_struct *t)
+{
+	__u64 *ts;
+
+	/* the idle task is always runnable */
+	if (!enabled || t->pid == 0)
+		return;
+
+	ts = bpf_task_storage_get(&runnable_ts, t, NULL,
+				  BPF_LOCAL_STORAGE_GET_F_CREATE);
+	if (ts)
+		*ts = bpf_ktime_get_ns();
+}
+
+static inline void account_latency(struct task_struct *t)
+{
+	struct sched_lat_data *data;
+	__u64 *ts, delta, key;
+	__u32 slot;
+
+	ts = bpf_task_storage_get(&runnable_ts, t, NULL, 0);
+	if (!ts || !*ts)
+		return;
+
+	delta = bpf_ktime_get_ns() - *ts;
+	*ts = 0;
+
+	if (!enabled)
+		return;
+
+	if (aggr_cgroup)
+		key = BPF_CORE_READ(t, cgroups, dfl_cgrp, kn, id);
+	else
+		key = t->pid;
+
+	data = bpf_map_lookup_elem(&latency, &key);
+	if (!data) {
+		struct sched_lat_data first = {};
+
+		bpf_probe_read_kernel_str(first.comm, sizeof(first.comm), t->comm);
+		bpf_map_update_elem(&latency, &key, &first, BPF_NOEXIST);
+
+		data = bpf_map_lookup_elem(&latency, &key);
+		if (!data) {
+			__sync_fetch_and_add(&lost, 1);
+			return;
+		}
+	}
+
+	slot = latency_slot(delta);
+
+	__sync_fetch_and_add(&data->count, 1);
+	__sync_fetch_and_add(&data->total, delta);
+	__sync_fetch_and_add(&data->hist[slot], 1);
+	/* racy, but a lost update of the max is not worth a lock */
+	if (data->max < delta)
+		data->max = delta;
+}
+
+SEC("tp_btf/sched_wakeup")
+int on_sched_wakeup(u64 *ctx)
+{
+	mark_runnable((void *)ctx[0]);
+	return 0;
+}
+
+SEC("tp_btf/sched_wakeup_new")
+int on_sched_wakeup_new(u64 *ctx)
+{
+	mark_runnable((void *)ctx[0]);
+	return 0;
+}
+
+SEC("tp_btf/sched_switch")
+int on_sched_switch(u64 *ctx)
+{
+	struct task_struct *prev = (void *)ctx[1];
+	struct task_struct *next = (void *)ctx[2];
+
+	/* preempted tasks stay runnable and wait for the cpu again */
+	if (get_task_state(prev) == TASK_RUNNING)
+		mark_runnable(prev);
+
+	account_latency(next);
+	return 0;
+}
+
+char LICENSE[] SEC("license") = "Dual BSD/GPL";
@@ -0,0 +1,19 @@
+/* SPDX-License-Identifier: (GPL-2.0-only OR BSD-2-Clause) */
+/* Data structures shared between BPF and tools. */
+#ifndef UTIL_BPF_SKEL_SCHED_LATENCY_DATA_H
+#define UTIL_BPF_SKEL_SCHED_LATENCY_DATA_H
+
+/* log2 buckets of the wakeup-to-run latency in usec */
+#define SCHED_LAT_NR_SLOTS	32
+#define SCHED_LAT_COMM_LEN	16
+
+/* value of the latency map, the key is a tid or a cgroup id */
+struct sched_lat_data {
+	__u64 count;
+	__u64 total;
+	__u64 max;
+	__u64 hist[SCHED_LAT_NR_SLOTS];
+	char comm[SCHED_LAT_COMM_LEN];
+};
+
+#endif /* UTIL_BPF_SKEL_SCHED_LATENCY_DATA_H */
@@ -0,0 +1,266 @@
+// SPDX-License-Identifier: (GPL-2.0-only OR BSD-2-Clause)
+#include "vmlinux.h"
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+#include <bpf/bpf_core_read.h>
+
+#include "syscall_summary_data.h"
+
+/* default buffer size */
+#define MAX_ENTRIES	512
+
+/* libbpf only has accessors for the first five syscall arguments */
+#ifndef PT_REGS_PARM6_CORE_SYSCALL
+#if defined(bpf_target_x86)
+#define __SYSCALL_PARM6_REG r9
+#elif defined(bpf_target_arm64)
+#define __SYSCALL_PARM6_REG regs[5]
+#elif defined(bpf_target_s390)
+#define __SYSCALL_PARM6_REG gprs[7]
+#elif defined(bpf_target_powerpc)
+#define __SYSCALL_PARM6_REG gpr[8]
+#elif defined(bpf_target_riscv)
+#define __SYSCALL_PARM6_REG a5
+#endif
+
+#ifdef __SYSCALL_PARM6_REG
+#define PT_REGS_PARM6_CORE_SYSCALL(x) BPF_CORE_READ(__PT_REGS_CAST(x), __SYSCALL_PARM6_REG)
+#else
+#define PT_REGS_PARM6_CORE_SYSCALL(x) 0
+#endif
+#endif
+
+/* the syscall currently in progress for each task */
+struct syscall_enter {
+	__u64 timestamp;
+	__u32 nr;
+	__u32 sampled;
+	__u64 args[6];
+};
+
+struct {
+	__uint(type, BPF_MAP_TYPE_TASK_STORAGE);
+	__uint(map_flags, BPF_F_NO_PREALLOC);
+	__type(key, int);
+	__type(value, struct syscall_enter);
+} enter_data SEC(".maps");
+
+/* per-cpu so that the hot path doesn't need atomics */
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_HASH);
+	__uint(key_size, sizeof(__u32));
+	__uint(value_size, sizeof(struct syscall_summary_data));
+	__uint(max_entries, MAX_ENTRIES);
+} syscall_stats SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_HASH);
+	__uint(key_size, sizeof(struct syscall_errno_key));
+	__uint(value_size, sizeof(__u64));
+	__uint(max_entries, MAX_ENTRIES);
+} syscall_errnos SEC(".maps");
+
+/* actual size is set by the user space */
+struct {
+	__uint(type, BPF_MAP_TYPE_RINGBUF);
+	__uint(max_entries, 256 * 1024);
+} samples SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(key_size, sizeof(__u32));
+	__uint(value_size, sizeof(__u8));
+	__uint(max_entries, 1);
+} cpu_filter SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(key_size, sizeof(__u32));
+	__uint(value_size, sizeof(__u8));
+	__uint(max_entries, 1);
+} task_filter SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(key_size, sizeof(__u32));
+	__uint(value_size, sizeof(__u8));
+	__uint(max_entries, 1);
+} syscall_filter SEC(".maps");
+
+/* control flags */
+int enabled;
+int has_cpu;
+int has_task;
+int has_syscall;
+int not_syscall;
+int errno_summary;
+int self_pid;
+/* send one out of this many syscalls to the ring buffer, 0 means none */
+__u32 sample_rate;
+
+/* error stat */
+int lost;
+
+static inline int can_record(__u32 nr)
+{
+	__u64 pid_tgid = bpf_get_current_pid_tgid();
+
+	/* don't count our own syscalls reading the maps */
+	if ((__u32)(pid_tgid >> 32) == self_pid)
+		return 0;
+
+	if (has_cpu) {
+		__u32 cpu = bpf_get_smp_processor_id();
+
+		if (!bpf_map_lookup_elem(&cpu_filter, &cpu))
+			return 0;
+	}
+
+	if (has_task) {
+		__u32 pid = pid_tgid;
+
+		if (!bpf_map_lookup_elem(&task_filter, &pid))
+			return 0;
+	}
+
+	if (has_syscall) {
+		int found = bpf_map_lookup_elem(&syscall_filter, &nr) != NULL;
+
+		if (found == not_syscall)
+			return 0;
+	}
+
+	return 1;
+}
+
+static inline __u32 duration_slot(__u64 delta)
+{
+	__u64 usecs = delta / 1000;
+	__u32 slot = 0;
+
+	while (usecs > 1 && slot < SYSCALL_SUMMARY_NR_SLOTS - 1) {
+		usecs >>= 1;
+		slot++;
+	}
+	return slot;
+}
+
+SEC("tp_btf/sys_enter")
+int sys_enter(u64 *ctx)
+{
+	struct pt_regs *regs = (void *)ctx[0];
+	__u32 nr = ctx[1];
+	struct syscall_enter *e;
+
+	/* see the comment about invalid syscall ids in builtin-trace.c */
+	if ((long)ctx[1] < 0)
+		return 0;
+
+	if (!enabled || !can_record(nr))
+		return 0;
+
+	e = bpf_task_storage_get(&enter_data, bpf_get_current_task_btf(), NULL,
+				 BPF_LOCAL_STORAGE_GET_F_CREATE);
+	if (!e)
+		return 0;
+
+	e->timestamp = bpf_ktime_get_ns();
+	e->nr = nr;
+	e->sampled = sample_rate && (bpf_get_prandom_u32() % sample_rate) == 0;
+
+	/* reading the arguments is only worth it for sampled syscalls */
+	if (e->sampled) {
+		e->args[0] = PT_REGS_PARM1_CORE_SYSCALL(regs);
+		e->args[1] = PT_REGS_PARM2_CORE_SYSCALL(regs);
+		e->args[2] = PT_REGS_PARM3_CORE_SYSCALL(regs);
+		e->args[3] = PT_REGS_PARM4_CORE_SYSCALL(regs);
+		e->args[4] = PT_REGS_PARM5_CORE_SYSCALL(regs);
+		e->args[5] = PT_REGS_PARM6_CORE_SYSCALL(regs);
+	}
+	return 0;
+}
+
+SEC("tp_btf/sys_exit")
+int sys_exit(u64 *ctx)
+{
+	long ret = ctx[1];
+	struct syscall_enter *e;
+	struct syscall_summary_data *data;
+	__u64 start, duration;
+	__u32 slot;
+
+	e = bpf_task_storage_get(&enter_data, bpf_get_current_task_btf(), NULL, 0);
+	if (!e || !e->timestamp)
+		return 0;
+
+	start = e->timestamp;
+	duration = bpf_ktime_get_ns() - start;
+	e->timestamp = 0;
+
+	data = bpf_map_lookup_elem(&syscall_stats, &e->nr);
+	if (!data) {
+		struct syscall_summary_data first = {
+			.min = duration,
+		};
+
+		bpf_map_update_elem(&syscall_stats, &e->nr, &first, BPF_NOEXIST);
+
+		data = bpf_map_lookup_elem(&syscall_stats, &e->nr);
+		if (!data) {
+			__sync_fetch_and_add(&lost, 1);
+			return 0;
+		}
+	}
+
+	slot = duration_slot(duration);
+
+	/*
+	 * The entry was created with the first value on one cpu only, it is
+	 * zeroed on all the others.
+	 */
+	if (data->count++ == 0 || data->min > duration)
+		data->min = duration;
+	data->total += duration;
+	data->hist[slot]++;
+	if (data->max < duration)
+		data->max = duration;
+
+	if (ret < 0) {
+		data->errors++;
+
+		if (errno_summary) {
+			struct syscall_errno_key key = {
+				.nr = e->nr,
+				.err = -ret,
+			};
+			__u64 *count, one = 1;
+
+			count = bpf_map_lookup_elem(&syscall_errnos, &key);
+			if (count)
+				(*count)++;
+			else
+				bpf_map_update_elem(&syscall_errnos, &key, &one, BPF_NOEXIST);
+		}
+	}
+
+	if (e->sampled) {
+		struct syscall_summary_sample *s;
+
+		s = bpf_ringbuf_reserve(&samples, sizeof(*s), 0);
+		if (!s) {
+			__sync_fetch_and_add(&lost, 1);
+			return 0;
+		}
+
+		s->timestamp = start;
+		s->duration = duration;
+		s->ret = ret;
+		__builtin_memcpy(s->args, e->args, sizeof(s->args));
+		s->tid = bpf_get_current_pid_tgid();
+		s->nr = e->nr;
+		bpf_ringbuf_submit(s, 0);
+	}
+	return 0;
+}
+
+char LICENSE[] SEC("license") = "Dual BSD/GPL";
@@ -0,0 +1,35 @@
+/* SPDX-License-Identifier: (GPL-2.0-only OR BSD-2-Clause) */
+/* Data structures shared between BPF and tools. */
+#ifndef UTIL_BPF_SKEL_SYSCALL_SUMMARY_DATA_H
+#define UTIL_BPF_SKEL_SYSCALL_SUMMARY_DATA_H
+
+/* log2 buckets of the syscall duration in usec */
+#define SYSCALL_SUMMARY_NR_SLOTS	24
+
+/* per-cpu value of the syscall_stats map, the key is the syscall id */
+struct syscall_summary_data {
+	__u64 count;
+	__u64 errors;
+	__u64 total;
+	__u64 min;
+	__u64 max;
+	__u64 hist[SYSCALL_SUMMARY_NR_SLOTS];
+};
+
+/* key of the syscall_errnos map, the value is a per-cpu count */
+struct syscall_errno_key {
+	__u32 nr;
+	__u32 err;
+};
+
+/* sampled syscall sent to the ring buffer */
+struct syscall_summary_sample {
+	__u64 timestamp;	/* at sys_enter */
+	__u64 duration;
+	__s64 ret;
+	__u64 args[6];
+	__u32 tid;
+	__u32 nr;
+};
+
+#endif /* UTIL_BPF_SKEL_SYSCALL_SUMMARY_DATA_H */
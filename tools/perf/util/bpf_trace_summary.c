@@ -0,0 +1,287 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "util/bpf-aggr.h"
+#include "util/debug.h"
+#include "util/evlist.h"
+#include "util/target.h"
+#include "util/trace-summary.h"
+#include <perf/cpumap.h>
+#include <perf/threadmap.h>
+#include <linux/kernel.h>
+#include <linux/zalloc.h>
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bpf_skel/syscall_summary.skel.h"
+
+static struct syscall_summary_bpf *skel;
+static struct ring_buffer *ringbuf;
+
+static int trace_summary__sample(void *ctx, void *data, size_t size)
+{
+	struct trace_summary *ts = ctx;
+
+	if (size < sizeof(struct syscall_summary_sample))
+		return 0;
+
+	return ts->handle_sample(ts, data);
+}
+
+int trace_summary_prepare(struct trace_summary *ts)
+{
+	int i, fd;
+	int ncpus = 1, ntasks = 1;
+	struct evlist *evlist = ts->evlist;
+	struct target *target = ts->target;
+
+	skel = syscall_summary_bpf__open();
+	if (!skel) {
+		pr_err("Failed to open syscall summary BPF skeleton\n");
+		return -1;
+	}
+
+	bpf_map__set_max_entries(skel->maps.syscall_stats, ts->map_nr_entries);
+	bpf_map__set_max_entries(skel->maps.syscall_errnos, ts->map_nr_entries);
+	bpf_map__set_max_entries(skel->maps.samples, ts->ringbuf_size);
+
+	if (target__has_cpu(target))
+		ncpus = perf_cpu_map__nr(evlist->core.user_requested_cpus);
+	if (target__has_task(target))
+		ntasks = perf_thread_map__nr(evlist->core.threads);
+
+	bpf_map__set_max_entries(skel->maps.cpu_filter, ncpus);
+	bpf_map__set_max_entries(skel->maps.task_filter, ntasks);
+	bpf_map__set_max_entries(skel->maps.syscall_filter,
+				 ts->nr_syscalls ?: 1);
+
+	if (syscall_summary_bpf__load(skel) < 0) {
+		pr_err("Failed to load syscall summary BPF skeleton\n");
+		return -1;
+	}
+
+	if (target__has_cpu(target)) {
+		u32 cpu;
+		u8 val = 1;
+
+		skel->bss->has_cpu = 1;
+		fd = bpf_map__fd(skel->maps.cpu_filter);
+
+		for (i = 0; i < ncpus; i++) {
+			cpu = perf_cpu_map__cpu(evlist->core.user_requested_cpus, i).cpu;
+			bpf_map_update_elem(fd, &cpu, &val, BPF_ANY);
+		}
+	}
+
+	if (target__has_task(target)) {
+		u32 pid;
+		u8 val = 1;
+
+		skel->bss->has_task = 1;
+		fd = bpf_map__fd(skel->maps.task_filter);
+
+		for (i = 0; i < ntasks; i++) {
+			pid = perf_thread_map__pid(evlist->core.threads, i);
+			bpf_map_update_elem(fd, &pid, &val, BPF_ANY);
+		}
+	}
+
+	if (target__none(target) && evlist->workload.pid > 0) {
+		u32 pid = evlist->workload.pid;
+		u8 val = 1;
+
+		skel->bss->has_task = 1;
+		fd = bpf_map__fd(skel->maps.task_filter);
+		bpf_map_update_elem(fd, &pid, &val, BPF_ANY);
+	}
+
+	if (ts->nr_syscalls) {
+		u32 nr;
+		u8 val = 1;
+
+		skel->bss->has_syscall = 1;
+		skel->bss->not_syscall = ts->not_syscalls;
+		fd = bpf_map__fd(skel->maps.syscall_filter);
+
+		for (i = 0; i < ts->nr_syscalls; i++) {
+			nr = ts->syscalls[i];
+			bpf_map_update_elem(fd, &nr, &val, BPF_ANY);
+		}
+	}
+
+	skel->bss->errno_summary = ts->errno_summary;
+	skel->bss->sample_rate = ts->sample_rate;
+	skel->bss->self_pid = getpid();
+
+	if (ts->sample_rate) {
+		ringbuf = ring_buffer__new(bpf_map__fd(skel->maps.samples),
+					   trace_summary__sample, ts, NULL);
+		if (!ringbuf) {
+			pr_err("Failed to create the syscall sample ring buffer\n");
+			return -1;
+		}
+	}
+
+	if (syscall_summary_bpf__attach(skel) < 0) {
+		pr_err("Failed to attach syscall summary BPF skeleton\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+int trace_summary_start(void)
+{
+	skel->bss->enabled = 1;
+	return 0;
+}
+
+int trace_summary_stop(void)
+{
+	skel->bss->enabled = 0;
+	return 0;
+}
+
+/* wait for sampled syscalls and pass them to ts->handle_sample() */
+int trace_summary_poll(struct trace_summary *ts __maybe_unused, int timeout_ms)
+{
+	int err;
+
+	if (ringbuf == NULL) {
+		usleep(timeout_ms * 1000);
+		return 0;
+	}
+
+	err = ring_buffer__poll(ringbuf, timeout_ms);
+	/* a signal (e.g. ^C) is how the session normally ends */
+	if (err == -EINTR)
+		return 0;
+	return err < 0 ? err : 0;
+}
+
+static void trace_summary__free_stats(struct trace_summary *ts)
+{
+	zfree(&ts->stats);
+	ts->nr_stats = 0;
+	zfree(&ts->errnos);
+	ts->nr_errnos = 0;
+}
+
+struct trace_summary__read_arg {
+	struct trace_summary	*ts;
+	int			nr_cpus;
+};
+
+/* the value has one struct syscall_summary_data per possible cpu */
+static int trace_summary__add_stat(void *key, void *value, void *arg)
+{
+	struct trace_summary__read_arg *ra = arg;
+	struct trace_summary *ts = ra->ts;
+	struct trace_summary_stat *st = &ts->stats[ts->nr_stats++];
+	struct syscall_summary_data *data = value;
+	int cpu, i;
+
+	st->nr = *(u32 *)key;
+	st->min = ULLONG_MAX;
+
+	for (cpu = 0; cpu < ra->nr_cpus; cpu++) {
+		struct syscall_summary_data *d = &data[cpu];
+
+		if (!d->count)
+			continue;
+
+		st->count += d->count;
+		st->errors += d->errors;
+		st->total += d->total;
+		st->min = min(st->min, (u64)d->min);
+		st->max = max(st->max, (u64)d->max);
+		for (i = 0; i < SYSCALL_SUMMARY_NR_SLOTS; i++)
+			st->hist[i] += d->hist[i];
+	}
+
+	if (!st->count)
+		st->min = 0;
+	return 0;
+}
+
+static int trace_summary__add_errno(void *key, void *value, void *arg)
+{
+	struct trace_summary__read_arg *ra = arg;
+	struct trace_summary *ts = ra->ts;
+	struct trace_summary_errno *e = &ts->errnos[ts->nr_errnos++];
+	struct syscall_errno_key *ekey = key;
+	__u64 *counts = value;
+	int cpu;
+
+	e->nr = ekey->nr;
+	e->err = ekey->err;
+	for (cpu = 0; cpu < ra->nr_cpus; cpu++)
+		e->count += counts[cpu];
+	return 0;
+}
+
+/*
+ * Move the per-cpu stats aggregated since the last read from the BPF maps
+ * into ts->stats and ts->errnos, merging the values of all cpus.  The
+ * entries are deleted when they are read, so every read returns the last
+ * interval.
+ */
+int trace_summary_read(struct trace_summary *ts)
+{
+	struct trace_summary__read_arg arg = {
+		.ts = ts,
+		.nr_cpus = libbpf_num_possible_cpus(),
+	};
+	int err;
+
+	trace_summary__free_stats(ts);
+
+	if (arg.nr_cpus < 0)
+		return arg.nr_cpus;
+
+	ts->stats = calloc(ts->map_nr_entries, sizeof(*ts->stats));
+	ts->errnos = calloc(ts->map_nr_entries, sizeof(*ts->errnos));
+	if (!ts->stats || !ts->errnos) {
+		trace_summary__free_stats(ts);
+		return -ENOMEM;
+	}
+
+	err = bpf_aggr__drain_map(bpf_map__fd(skel->maps.syscall_stats),
+				  sizeof(u32),
+				  sizeof(struct syscall_summary_data) * arg.nr_cpus,
+				  ts->map_nr_entries, trace_summary__add_stat, &arg);
+	if (err < 0)
+		return err;
+
+	if (ts->errno_summary) {
+		err = bpf_aggr__drain_map(bpf_map__fd(skel->maps.syscall_errnos),
+					  sizeof(struct syscall_errno_key),
+					  sizeof(__u64) * arg.nr_cpus,
+					  ts->map_nr_entries,
+					  trace_summary__add_errno, &arg);
+		if (err < 0)
+			return err;
+	}
+
+	ts->lost = skel->bss->lost;
+	skel->bss->lost = 0;
+	return 0;
+}
+
+int trace_summary_finish(struct trace_summary *ts)
+{
+	ring_buffer__free(ringbuf);
+	ringbuf = NULL;
+
+	if (skel) {
+		skel->bss->enabled = 0;
+		syscall_summary_bpf__destroy(skel);
+		skel = NULL;
+	}
+
+	trace_summary__free_stats(ts);
+	return 0;
+}
@@ -0,0 +1,323 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Collapse and sort the hists of an evlist with a pool of threads.
+ *
+ * The hists of different events don't share any state while being collapsed
+ * and sorted for output, so they are handed out to the threads one event at
+ * a time.  With fewer events than threads, the output sort of each hists is
+ * split instead: its entries are cut into consecutive chunks, each chunk is
+ * sorted in a private hists by one thread and the sorted chunks are merged.
+ * The merge prefers the earlier chunk on ties, so the output is the same as
+ * the one of a single thread.
+ */
+#include "util/hist-parallel.h"
+#include "util/evlist.h"
+#include "util/evsel.h"
+#include "util/parallel.h"
+#include "util/sort.h"
+#include "util/symbol_conf.h"
+#include "ui/progress.h"
+#include <linux/kernel.h>
+#include <linux/rbtree.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+/* smaller hists are not worth splitting */
+#define HISTS_SPLIT_MIN_ENTRIES	256
+
+struct evlist_resort {
+	struct evsel		**evsels;
+	struct ui_progress	*prog;
+	hists__resort_cb_t	cb;
+	void			*cb_arg;
+	bool			collapse;
+	pthread_mutex_t		lock;
+};
+
+static int evlist_resort__worker(int idx, void *arg)
+{
+	struct evlist_resort *work = arg;
+	struct evsel *evsel = work->evsels[idx];
+	struct hists *hists = evsel__hists(evsel);
+	u64 nr_entries = hists->nr_entries;
+	int ret = 0;
+
+	if (work->collapse)
+		ret = hists__collapse_resort(hists, NULL);
+	else
+		evsel__output_resort_cb(evsel, NULL, work->cb, work->cb_arg);
+
+	/* the progress bar is not thread safe */
+	if (work->prog) {
+		pthread_mutex_lock(&work->lock);
+		ui_progress__update(work->prog, nr_entries);
+		pthread_mutex_unlock(&work->lock);
+	}
+
+	return ret < 0 ? ret : 0;
+}
+
+static int evlist__resort_hists(struct evlist *evlist, unsigned int nr_threads,
+				struct evlist_resort *work)
+{
+	struct evsel *pos;
+	int nr = 0, ret;
+
+	work->evsels = calloc(evlist->core.nr_entries, sizeof(*work->evsels));
+	if (!work->evsels)
+		return -ENOMEM;
+
+	evlist__for_each_entry(evlist, pos)
+		work->evsels[nr++] = pos;
+
+	pthread_mutex_init(&work->lock, NULL);
+	ret = parallel_for(nr, nr_threads, evlist_resort__worker, work);
+	pthread_mutex_destroy(&work->lock);
+
+	free(work->evsels);
+	return ret;
+}
+
+int evlist__collapse_resort_parallel(struct evlist *evlist, unsigned int nr_threads,
+				     struct ui_progress *prog)
+{
+	struct evlist_resort work = {
+		.prog		= prog,
+		.collapse	= true,
+	};
+
+	return evlist__resort_hists(evlist, nr_threads, &work);
+}
+
+int evlist__output_resort_parallel(struct evlist *evlist, unsigned int nr_threads,
+				   struct ui_progress *prog,
+				   hists__resort_cb_t cb, void *cb_arg)
+{
+	struct evlist_resort work = {
+		.prog		= prog,
+		.cb		= cb,
+		.cb_arg		= cb_arg,
+	};
+	struct evsel *pos;
+
+	if ((unsigned int)evlist->core.nr_entries >= nr_threads)
+		return evlist__resort_hists(evlist, nr_threads, &work);
+
+	evlist__for_each_entry(evlist, pos)
+		evsel__output_resort_split(pos, nr_threads, prog, cb, cb_arg);
+
+	return 0;
+}
+
+struct hists_split {
+	struct hists		*sub;
+	struct hist_entry	**entries;
+	/* chunk i is entries[start[i]] up to entries[start[i + 1]] */
+	int			*start;
+};
+
+/* link @node after @last, the rightmost node of @root, NULL when empty */
+static struct rb_node *rb_append(struct rb_root_cached *root, struct rb_node *last,
+				 struct rb_node *node)
+{
+	rb_link_node(node, last, last ? &last->rb_right : &root->rb_root.rb_node);
+	rb_insert_color_cached(node, root, last == NULL);
+	return node;
+}
+
+static struct rb_root_cached *hists__resort_input(struct hists *hists)
+{
+	if (hists__has(hists, need_collapse))
+		return &hists->entries_collapsed;
+
+	return hists->entries_in;
+}
+
+/* the order hists__output_resort() sorts the entries in */
+static int64_t hist_entry__output_cmp(struct hist_entry *a, struct hist_entry *b)
+{
+	struct perf_hpp_fmt *fmt;
+	int64_t cmp = 0;
+
+	hists__for_each_sort_list(a->hists, fmt) {
+		if (perf_hpp__should_skip(fmt, a->hists))
+			continue;
+
+		cmp = fmt->sort(fmt, a, b);
+		if (cmp)
+			break;
+	}
+
+	return cmp;
+}
+
+static int hists_split__worker(int idx, void *arg)
+{
+	struct hists_split *split = arg;
+	struct hists *sub = &split->sub[idx];
+	struct rb_root_cached *root = hists__resort_input(sub);
+	struct rb_node *nd, *last = NULL;
+	int i;
+
+	for (i = split->start[idx]; i < split->start[idx + 1]; i++)
+		last = rb_append(root, last, &split->entries[i]->rb_node_in);
+
+	hists__output_resort_cb(sub, NULL, NULL);
+
+	/* store the chunk back in output order */
+	i = split->start[idx];
+	for (nd = rb_first_cached(&sub->entries); nd; nd = rb_next(nd))
+		split->entries[i++] = rb_entry(nd, struct hist_entry, rb_node);
+
+	return 0;
+}
+
+static bool evsel__can_split_resort(struct evsel *evsel)
+{
+	struct hists *hists = evsel__hists(evsel);
+	struct perf_hpp_fmt *fmt;
+	bool use_callchain;
+
+	if (symbol_conf.report_hierarchy)
+		return false;
+
+	/* dynamic entries update their column width while being sorted */
+	hists__for_each_sort_list(hists, fmt) {
+		if (perf_hpp__is_dynamic_entry(fmt))
+			return false;
+	}
+
+	/*
+	 * The chunks are sorted by hists__output_resort_cb(), which doesn't
+	 * look at the callchains of the evsel like evsel__output_resort_cb().
+	 */
+	if (symbol_conf.use_callchain && !symbol_conf.show_ref_callgraph)
+		use_callchain = evsel__has_callchain(evsel);
+	else
+		use_callchain = symbol_conf.use_callchain;
+
+	use_callchain |= symbol_conf.show_branchflag_count;
+
+	return use_callchain == symbol_conf.use_callchain;
+}
+
+/*
+ * Sort the hists of @evsel for output on up to @nr_threads threads, or on
+ * the calling thread alone when it is small or can't be split.  @cb is
+ * called by the calling thread for every entry, in the order of the input.
+ */
+void evsel__output_resort_split(struct evsel *evsel, unsigned int nr_threads,
+				struct ui_progress *prog,
+				hists__resort_cb_t cb, void *cb_arg)
+{
+	struct hists *hists = evsel__hists(evsel);
+	struct hists_split split = { .sub = NULL, };
+	struct rb_root_cached *root = hists__resort_input(hists);
+	struct hist_entry **all = NULL, *he;
+	struct rb_node *nd, *last;
+	int nr_all = 0, nr = 0, nr_chunks, i, k;
+	int *pos = NULL;
+
+	if (nr_threads <= 1 || !evsel__can_split_resort(evsel))
+		goto out_serial;
+
+	for (nd = rb_first_cached(root); nd; nd = rb_next(nd))
+		nr_all++;
+
+	nr_chunks = min(nr_threads, (unsigned int)nr_all / HISTS_SPLIT_MIN_ENTRIES);
+	if (nr_chunks <= 1)
+		goto out_serial;
+
+	all = calloc(nr_all, sizeof(*all));
+	split.entries = calloc(nr_all, sizeof(*split.entries));
+	split.start = calloc(nr_chunks + 1, sizeof(*split.start));
+	split.sub = calloc(nr_chunks, sizeof(*split.sub));
+	pos = calloc(nr_chunks, sizeof(*pos));
+	if (!all || !split.entries || !split.start || !split.sub || !pos)
+		goto out_serial;
+
+	i = 0;
+	for (nd = rb_first_cached(root); nd; nd = rb_next(nd)) {
+		he = rb_entry(nd, struct hist_entry, rb_node_in);
+		all[i++] = he;
+
+		if (cb && cb(he, cb_arg))
+			continue;
+
+		split.entries[nr++] = he;
+	}
+
+	for (k = 0; k <= nr_chunks; k++)
+		split.start[k] = (u64)nr * k / nr_chunks;
+
+	/* the input tree is rebuilt below, the chunks borrow its nodes */
+	*root = RB_ROOT_CACHED;
+
+	for (k = 0; k < nr_chunks; k++) {
+		__hists__init(&split.sub[k], hists->hpp_list);
+		/* for the callchain minimum percentage */
+		split.sub[k].callchain_period = hists->callchain_period;
+		split.sub[k].callchain_non_filtered_period =
+			hists->callchain_non_filtered_period;
+	}
+
+	parallel_for(nr_chunks, nr_threads, hists_split__worker, &split);
+
+	last = NULL;
+	for (i = 0; i < nr_all; i++)
+		last = rb_append(root, last, &all[i]->rb_node_in);
+
+	hists->entries = RB_ROOT_CACHED;
+	hists->nr_entries = 0;
+	hists->nr_non_filtered_entries = 0;
+	hists->stats.total_period = 0;
+	hists->stats.total_non_filtered_period = 0;
+	hists__reset_col_len(hists);
+
+	for (k = 0; k < nr_chunks; k++)
+		pos[k] = split.start[k];
+
+	last = NULL;
+	for (i = 0; i < nr; i++) {
+		int best = -1;
+
+		for (k = 0; k < nr_chunks; k++) {
+			if (pos[k] == split.start[k + 1])
+				continue;
+
+			if (best < 0 ||
+			    hist_entry__output_cmp(split.entries[pos[k]],
+						   split.entries[pos[best]]) > 0)
+				best = k;
+		}
+
+		he = split.entries[pos[best]++];
+		last = rb_append(&hists->entries, last, &he->rb_node);
+
+		hists__inc_stats(hists, he);
+		if (!he->filtered)
+			hists__calc_col_len(hists, he);
+	}
+
+	if (prog)
+		ui_progress__update(prog, nr);
+
+	for (k = 0; k < nr_chunks; k++)
+		pthread_mutex_destroy(&split.sub[k].lock);
+
+	free(pos);
+	free(split.sub);
+	free(split.start);
+	free(split.entries);
+	free(all);
+	return;
+
+out_serial:
+	free(pos);
+	free(split.sub);
+	free(split.start);
+	free(split.entries);
+	free(all);
+	evsel__output_resort_cb(evsel, prog, cb, cb_arg);
+}
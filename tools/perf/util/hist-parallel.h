@@ -0,0 +1,20 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef PERF_HIST_PARALLEL_H
+#define PERF_HIST_PARALLEL_H
+
+#include "hist.h"
+
+struct evlist;
+struct evsel;
+struct ui_progress;
+
+int evlist__collapse_resort_parallel(struct evlist *evlist, unsigned int nr_threads,
+				     struct ui_progress *prog);
+int evlist__output_resort_parallel(struct evlist *evlist, unsigned int nr_threads,
+				   struct ui_progress *prog,
+				   hists__resort_cb_t cb, void *cb_arg);
+void evsel__output_resort_split(struct evsel *evsel, unsigned int nr_threads,
+				struct ui_progress *prog,
+				hists__resort_cb_t cb, void *cb_arg);
+
+#endif /* PERF_HIST_PARALLEL_H */
@@ -4509,3 +4509,75 @@ int intel_pt_fast_forward(struct intel_pt_decoder *decoder, uint64_t timestamp)
 
 	return 0;
 }
+
+/**
+ * intel_pt_split_psb - split trace data into independently decodable segments.
+ * @buf: trace data
+ * @len: size of trace data
+ * @min_len: minimum size of a segment
+ * @ref_timestamp: reference timestamp to expand the 7-byte TSC values
+ * @segs: returns the array of segments, to be freed by the caller
+ *
+ * Divide @buf into segments of at least @min_len bytes, each of which apart
+ * from the first starts at a PSB packet.  The decoder synchronizes at a PSB, so
+ * the segments can be decoded independently of each other, for example on
+ * different threads.  The timestamp of a segment is the TSC from its first
+ * PSB+, or the timestamp of the previous segment if there is none.
+ *
+ * Return: the number of segments, or a negative error code on failure.
+ */
+int intel_pt_split_psb(const unsigned char *buf, size_t len, size_t min_len,
+		       uint64_t ref_timestamp, struct intel_pt_segment **segs)
+{
+	struct intel_pt_segment *s = NULL;
+	unsigned char *pos = (unsigned char *)buf;
+	uint64_t timestamp = 0;
+	int nr = 0, alloc = 0;
+
+	/* A segment must not be empty */
+	if (!min_len)
+		min_len = 1;
+
+	while (len) {
+		size_t seg_len = len;
+		unsigned char *p;
+		uint64_t tsc;
+		size_t l, rem;
+
+		/* The next segment starts at the first PSB after min_len bytes */
+		if (len > min_len) {
+			p = pos + min_len;
+			l = len - min_len;
+			if (intel_pt_next_psb(&p, &l))
+				seg_len = p - pos;
+		}
+
+		p = pos;
+		l = seg_len;
+		if (intel_pt_next_psb(&p, &l) && intel_pt_next_tsc(p, l, &tsc, &rem))
+			timestamp = intel_pt_8b_tsc(tsc, ref_timestamp);
+
+		if (nr == alloc) {
+			struct intel_pt_segment *tmp;
+
+			alloc = alloc ? alloc * 2 : 16;
+			tmp = realloc(s, alloc * sizeof(*s));
+			if (!tmp) {
+				free(s);
+				return -ENOMEM;
+			}
+			s = tmp;
+		}
+
+		s[nr].buf = pos;
+		s[nr].len = seg_len;
+		s[nr].timestamp = timestamp;
+		nr += 1;
+
+		pos += seg_len;
+		len -= seg_len;
+	}
+
+	*segs = s;
+	return nr;
+}
@@ -298,6 +298,13 @@ struct intel_pt_params {
 
 struct intel_pt_decoder;
 
+/* Part of the trace which starts at a PSB, see intel_pt_split_psb() */
+struct intel_pt_segment {
+	const unsigned char *buf;
+	size_t len;
+	uint64_t timestamp;
+};
+
 struct intel_pt_decoder *intel_pt_decoder_new(struct intel_pt_params *params);
 void intel_pt_decoder_free(struct intel_pt_decoder *decoder);
 
@@ -310,6 +317,9 @@ unsigned char *intel_pt_find_overlap(unsigned char *buf_a, size_t len_a,
 				     bool have_tsc, bool *consecutive,
 				     bool ooo_tsc);
 
+int intel_pt_split_psb(const unsigned char *buf, size_t len, size_t min_len,
+		       uint64_t ref_timestamp, struct intel_pt_segment **segs);
+
 int intel_pt__strerror(int code, char *buf, size_t buflen);
 
 void intel_pt_set_first_timestamp(struct intel_pt_decoder *decoder,
@@ -0,0 +1,391 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * intel-pt-par.c: Intel Processor Trace parallel decoding
+ *
+ * Decoding is dominated by walking instructions and one decoder has to do it
+ * sequentially.  However the decoder synchronizes at every PSB packet, so the
+ * trace of a cpu can be split at PSBs into segments, each decoded by its own
+ * decoder on a pool of threads.  The outputs of the segments are then merged
+ * in timestamp order.
+ *
+ * To bound the memory held by queued outputs, segments are decoded in windows
+ * of a few segments per thread, taken in order of their PSB timestamp.  After
+ * a window, the outputs earlier than the first segment not yet decoded can be
+ * delivered: no segment starts before its PSB timestamp.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <linux/zalloc.h>
+
+#include "../parallel.h"
+#include "intel-pt-decoder.h"
+#include "intel-pt-log.h"
+#include "intel-pt-par.h"
+
+/* Segments per thread in a window */
+#define INTEL_PT_PAR_WINDOW	4
+
+struct intel_pt_par_output {
+	uint64_t timestamp;
+	void *output;
+};
+
+struct intel_pt_par;
+
+struct intel_pt_par_seg {
+	struct intel_pt_segment seg;
+	struct intel_pt_par *par;
+	struct intel_pt_par_stream *stream;
+	void *data;
+	struct intel_pt_par_output *outputs;
+	size_t nr_outputs;
+	size_t alloc_outputs;
+	size_t next_output;
+	uint64_t last_timestamp;
+	bool got_trace;
+	bool decoded;
+	int err;
+};
+
+struct intel_pt_par {
+	struct intel_pt_par_stream *streams;
+	int nr_streams;
+	const struct intel_pt_params *params;
+	const struct intel_pt_par_ops *ops;
+	struct intel_pt_par_seg *segs;
+	int nr_segs;
+	/* Segments of stream i are segs[first[i]] to segs[first[i + 1] - 1] */
+	int *first;
+	/* Next segment to deliver from, for each stream */
+	int *cur;
+	/* Indexes of segs in timestamp order */
+	int *order;
+	/* Window being decoded: order[pos] to order[end - 1] */
+	int pos;
+	int end;
+};
+
+int intel_pt_par_output(struct intel_pt_par_seg *seg, uint64_t timestamp,
+			void *output)
+{
+	struct intel_pt_par_output *o;
+
+	if (seg->nr_outputs == seg->alloc_outputs) {
+		size_t alloc = seg->alloc_outputs ? seg->alloc_outputs * 2 : 256;
+
+		o = realloc(seg->outputs, alloc * sizeof(*o));
+		if (!o)
+			return -ENOMEM;
+		seg->outputs = o;
+		seg->alloc_outputs = alloc;
+	}
+
+	/* Outputs before the first timestamp get the PSB timestamp */
+	if (timestamp < seg->last_timestamp)
+		timestamp = seg->last_timestamp;
+	seg->last_timestamp = timestamp;
+
+	o = &seg->outputs[seg->nr_outputs++];
+	o->timestamp = timestamp;
+	o->output = output;
+	return 0;
+}
+
+static int intel_pt_par_get_trace(struct intel_pt_buffer *buffer, void *data)
+{
+	struct intel_pt_par_seg *seg = data;
+
+	/* Every segment is a separate trace buffer */
+	if (seg->got_trace) {
+		buffer->len = 0;
+		return 0;
+	}
+	seg->got_trace = true;
+
+	buffer->buf = seg->seg.buf;
+	buffer->len = seg->seg.len;
+	buffer->consecutive = false;
+	/* The PSB timestamp is the best reference for the segment */
+	buffer->ref_timestamp = seg->seg.timestamp ?: seg->stream->ref_timestamp;
+	buffer->trace_nr = 0;
+	return 0;
+}
+
+static int intel_pt_par_walk_insn(struct intel_pt_insn *intel_pt_insn,
+				  uint64_t *insn_cnt_ptr, uint64_t *ip,
+				  uint64_t to_ip, uint64_t max_insn_cnt,
+				  void *data)
+{
+	struct intel_pt_par_seg *seg = data;
+
+	return seg->par->params->walk_insn(intel_pt_insn, insn_cnt_ptr, ip,
+					   to_ip, max_insn_cnt, seg->data);
+}
+
+static bool intel_pt_par_pgd_ip(uint64_t ip, void *data)
+{
+	struct intel_pt_par_seg *seg = data;
+
+	return seg->par->params->pgd_ip(ip, seg->data);
+}
+
+static struct intel_pt_vmcs_info *
+intel_pt_par_findnew_vmcs_info(void *data, uint64_t vmcs)
+{
+	struct intel_pt_par_seg *seg = data;
+
+	return seg->par->params->findnew_vmcs_info(seg->data, vmcs);
+}
+
+static void intel_pt_par_decode_seg(struct intel_pt_par_seg *seg)
+{
+	struct intel_pt_par *par = seg->par;
+	const struct intel_pt_par_ops *ops = par->ops;
+	struct intel_pt_params params = *par->params;
+	struct intel_pt_decoder *decoder;
+	const struct intel_pt_state *state;
+
+	params.get_trace = intel_pt_par_get_trace;
+	params.walk_insn = intel_pt_par_walk_insn;
+	if (params.pgd_ip)
+		params.pgd_ip = intel_pt_par_pgd_ip;
+	if (params.findnew_vmcs_info)
+		params.findnew_vmcs_info = intel_pt_par_findnew_vmcs_info;
+	/* Fast forward is not supported */
+	params.lookahead = NULL;
+	params.data = seg;
+
+	seg->last_timestamp = seg->seg.timestamp;
+	seg->data = ops->seg_new ? ops->seg_new(seg->stream->data) : seg->stream->data;
+
+	decoder = intel_pt_decoder_new(&params);
+	if (!decoder) {
+		seg->err = -ENOMEM;
+		goto out;
+	}
+
+	while (1) {
+		state = intel_pt_decode(decoder);
+		/* The decoder resynchronizes by itself after other errors */
+		if (state->err == INTEL_PT_ERR_NODATA)
+			break;
+		seg->err = ops->state(seg, seg->data, state);
+		if (seg->err)
+			break;
+	}
+
+	intel_pt_decoder_free(decoder);
+out:
+	if (ops->seg_free)
+		ops->seg_free(seg->data);
+	seg->decoded = true;
+}
+
+static int intel_pt_par_worker(int idx, void *arg)
+{
+	struct intel_pt_par *par = arg;
+
+	intel_pt_par_decode_seg(&par->segs[par->order[par->pos + idx]]);
+	return 0;
+}
+
+/* Return the segment of stream @i to deliver from next, if it is decoded */
+static struct intel_pt_par_seg *intel_pt_par_head(struct intel_pt_par *par, int i)
+{
+	while (par->cur[i] < par->first[i + 1]) {
+		struct intel_pt_par_seg *seg = &par->segs[par->cur[i]];
+
+		if (!seg->decoded)
+			return NULL;
+		if (seg->next_output < seg->nr_outputs)
+			return seg;
+		zfree(&seg->outputs);
+		par->cur[i] += 1;
+	}
+	return NULL;
+}
+
+/* Deliver the outputs earlier than @limit, all of them if @all */
+static int intel_pt_par_deliver(struct intel_pt_par *par, uint64_t limit, bool all)
+{
+	while (1) {
+		struct intel_pt_par_seg *best = NULL;
+		struct intel_pt_par_output *o;
+		uint64_t best_timestamp = 0;
+		int i, err;
+
+		for (i = 0; i < par->nr_streams; i++) {
+			struct intel_pt_par_seg *seg = intel_pt_par_head(par, i);
+			uint64_t timestamp;
+
+			if (!seg)
+				continue;
+			timestamp = seg->outputs[seg->next_output].timestamp;
+			if (!all && timestamp >= limit)
+				continue;
+			if (!best || timestamp < best_timestamp) {
+				best = seg;
+				best_timestamp = timestamp;
+			}
+		}
+
+		if (!best)
+			return 0;
+
+		o = &best->outputs[best->next_output++];
+		err = par->ops->deliver(best->stream->data, o->output);
+		if (err)
+			return err;
+	}
+}
+
+static int intel_pt_par_cmp(const void *a, const void *b, void *arg)
+{
+	struct intel_pt_par_seg *segs = arg;
+	int ia = *(const int *)a, ib = *(const int *)b;
+
+	if (segs[ia].seg.timestamp != segs[ib].seg.timestamp)
+		return segs[ia].seg.timestamp < segs[ib].seg.timestamp ? -1 : 1;
+	return ia - ib;
+}
+
+static int intel_pt_par_split(struct intel_pt_par *par, size_t seg_size)
+{
+	int i, j, n, nr_segs = 0;
+
+	par->first = calloc(par->nr_streams + 1, sizeof(int));
+	par->cur = calloc(par->nr_streams, sizeof(int));
+	if (!par->first || !par->cur)
+		return -ENOMEM;
+
+	for (i = 0; i < par->nr_streams; i++) {
+		struct intel_pt_par_stream *stream = &par->streams[i];
+		struct intel_pt_segment *segs;
+		struct intel_pt_par_seg *tmp;
+		uint64_t timestamp = 0;
+
+		n = intel_pt_split_psb(stream->buf, stream->len, seg_size,
+				       stream->ref_timestamp, &segs);
+		if (n < 0)
+			return n;
+
+		par->first[i] = nr_segs;
+		par->cur[i] = nr_segs;
+		if (!n)
+			continue;
+
+		tmp = realloc(par->segs, (nr_segs + n) * sizeof(*tmp));
+		if (!tmp) {
+			free(segs);
+			return -ENOMEM;
+		}
+		par->segs = tmp;
+
+		for (j = 0; j < n; j++) {
+			struct intel_pt_par_seg *seg = &par->segs[nr_segs++];
+
+			memset(seg, 0, sizeof(*seg));
+			seg->seg = segs[j];
+			seg->par = par;
+			seg->stream = stream;
+			/* Keep the segments of a stream in order */
+			if (seg->seg.timestamp < timestamp)
+				seg->seg.timestamp = timestamp;
+			timestamp = seg->seg.timestamp;
+		}
+		free(segs);
+	}
+	par->first[par->nr_streams] = nr_segs;
+	par->nr_segs = nr_segs;
+
+	par->order = calloc(nr_segs ?: 1, sizeof(int));
+	if (!par->order)
+		return -ENOMEM;
+	for (i = 0; i < nr_segs; i++)
+		par->order[i] = i;
+	qsort_r(par->order, nr_segs, sizeof(int), intel_pt_par_cmp, par->segs);
+
+	return 0;
+}
+
+/**
+ * intel_pt_par_decode - decode trace streams on a pool of threads.
+ * @streams: trace data, e.g. one stream per cpu
+ * @nr_streams: number of streams
+ * @params: decoder parameters, used for the decoder of every segment
+ * @ops: callbacks to handle the decoded states and to deliver the outputs
+ * @seg_size: minimum size of a segment
+ * @nr_threads: number of threads decoding, including the calling thread
+ *
+ * Split @streams into segments at PSB packets and decode the segments
+ * concurrently.  @ops->state() is called for each state decoded from a segment
+ * and can queue outputs with intel_pt_par_output(), which @ops->deliver() is
+ * called for in timestamp order.  @params->get_trace and @params->lookahead
+ * are not used.  State needed across PSBs, like the return stack for return
+ * compression, is reset at the start of every segment.
+ *
+ * Return: 0 on success, or the first error returned by a callback or a
+ * negative error code.
+ */
+int intel_pt_par_decode(struct intel_pt_par_stream *streams, int nr_streams,
+			const struct intel_pt_params *params,
+			const struct intel_pt_par_ops *ops,
+			size_t seg_size, int nr_threads)
+{
+	struct intel_pt_par par = {
+		.streams = streams,
+		.nr_streams = nr_streams,
+		.params = params,
+		.ops = ops,
+	};
+	int i, err;
+
+	/* The decoder log is not thread-safe */
+	if (nr_threads < 1 || intel_pt_enable_logging)
+		nr_threads = 1;
+
+	err = intel_pt_par_split(&par, seg_size);
+
+	while (!err && par.pos < par.nr_segs) {
+		int window = nr_threads * INTEL_PT_PAR_WINDOW;
+
+		par.end = par.pos + window;
+		if (par.end > par.nr_segs)
+			par.end = par.nr_segs;
+
+		parallel_for(par.end - par.pos, nr_threads, intel_pt_par_worker, &par);
+		for (i = par.pos; !err && i < par.end; i++)
+			err = par.segs[par.order[i]].err;
+		if (err)
+			break;
+
+		par.pos = par.end;
+
+		if (par.end < par.nr_segs)
+			err = intel_pt_par_deliver(&par,
+				par.segs[par.order[par.end]].seg.timestamp, false);
+	}
+
+	if (!err)
+		err = intel_pt_par_deliver(&par, 0, true);
+
+	for (i = 0; i < par.nr_segs; i++) {
+		struct intel_pt_par_seg *seg = &par.segs[i];
+
+		/* Only left after an error */
+		while (ops->free_output && seg->next_output < seg->nr_outputs)
+			ops->free_output(seg->outputs[seg->next_output++].output);
+		free(seg->outputs);
+	}
+	free(par.segs);
+	free(par.order);
+	free(par.first);
+	free(par.cur);
+	return err;
+}
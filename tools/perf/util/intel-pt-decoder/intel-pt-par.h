@@ -0,0 +1,51 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * intel-pt-par.h: Intel Processor Trace parallel decoding
+ */
+
+#ifndef INCLUDE__INTEL_PT_PAR_H__
+#define INCLUDE__INTEL_PT_PAR_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "intel-pt-decoder.h"
+
+/* The trace of one cpu (or thread), decoded in order with itself */
+struct intel_pt_par_stream {
+	const unsigned char *buf;
+	size_t len;
+	uint64_t ref_timestamp;
+	void *data;
+};
+
+struct intel_pt_par_seg;
+
+/*
+ * The callbacks in struct intel_pt_params and seg_new(), seg_free() and
+ * state() are called on worker threads, for different segments at the same
+ * time.  deliver() is only called on the thread which called
+ * intel_pt_par_decode(), in timestamp order.
+ */
+struct intel_pt_par_ops {
+	/* Returns the data passed to the params callbacks for a segment */
+	void *(*seg_new)(void *stream_data);
+	void (*seg_free)(void *seg_data);
+	/* Called for each decoded state, may queue outputs */
+	int (*state)(struct intel_pt_par_seg *seg, void *seg_data,
+		     const struct intel_pt_state *state);
+	/* Called for each queued output */
+	int (*deliver)(void *stream_data, void *output);
+	/* Called for the outputs not delivered because of an error */
+	void (*free_output)(void *output);
+};
+
+int intel_pt_par_output(struct intel_pt_par_seg *seg, uint64_t timestamp,
+			void *output);
+
+int intel_pt_par_decode(struct intel_pt_par_stream *streams, int nr_streams,
+			const struct intel_pt_params *params,
+			const struct intel_pt_par_ops *ops,
+			size_t seg_size, int nr_threads);
+
+#endif
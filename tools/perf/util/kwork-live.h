@@ -0,0 +1,59 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef PERF_UTIL_KWORK_LIVE_H
+#define PERF_UTIL_KWORK_LIVE_H
+
+#include <linux/compiler.h>
+#include <linux/types.h>
+
+#include "bpf_skel/kwork_live_data.h"
+
+/* one entry per kwork class, cpu and irq/vector/function */
+struct kwork_live_stat {
+	enum kwork_live_class	class;
+	u32			cpu;
+	u64			id;
+	struct kwork_live_data	data;
+};
+
+struct kwork_live {
+	/* bitmask of enum kwork_live_class */
+	unsigned int			class_mask;
+	const char			*cpu_list;
+	unsigned long			map_nr_entries;
+	/* results of the last read, reset on every read */
+	struct kwork_live_stat		*stats;
+	int				nr_stats;
+	int				lost;
+	/* works queued again before their previous activation ran */
+	int				collisions;
+};
+
+#ifdef HAVE_BPF_SKEL
+
+int kwork_live_prepare(struct kwork_live *live);
+int kwork_live_start(void);
+int kwork_live_stop(void);
+int kwork_live_read(struct kwork_live *live);
+int kwork_live_finish(struct kwork_live *live);
+
+#else  /* !HAVE_BPF_SKEL */
+
+static inline int kwork_live_prepare(struct kwork_live *live __maybe_unused)
+{
+	return -1;
+}
+
+static inline int kwork_live_start(void) { return 0; }
+static inline int kwork_live_stop(void) { return 0; }
+static inline int kwork_live_read(struct kwork_live *live __maybe_unused)
+{
+	return 0;
+}
+static inline int kwork_live_finish(struct kwork_live *live __maybe_unused)
+{
+	return 0;
+}
+
+#endif  /* HAVE_BPF_SKEL */
+
+#endif  /* PERF_UTIL_KWORK_LIVE_H */
@@ -0,0 +1,62 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef PERF_LOCK_HIST_H
+#define PERF_LOCK_HIST_H
+
+#include <linux/compiler.h>
+#include <linux/types.h>
+
+#include "bpf_skel/lock_hist_data.h"
+
+struct evlist;
+struct target;
+
+struct lock_hist_entry {
+	struct lock_hist_key	key;
+	struct lock_hist_data	data;
+	/* max_stack entries, 0-terminated if shorter; NULL if it was lost */
+	u64			*callstack;
+};
+
+struct lock_hist {
+	struct evlist		*evlist;
+	struct target		*target;
+	/* comma separated list of cgroup names to filter on */
+	const char		*cgroups;
+	unsigned long		map_nr_entries;
+	int			max_stack;
+	bool			aggr_addr;
+	/* results of the last read, reset on every read */
+	struct lock_hist_entry	*entries;
+	int			nr_entries;
+	int			lost;
+};
+
+#ifdef HAVE_BPF_SKEL
+
+int lock_hist_prepare(struct lock_hist *hist);
+int lock_hist_start(void);
+int lock_hist_stop(void);
+int lock_hist_read(struct lock_hist *hist);
+int lock_hist_finish(struct lock_hist *hist);
+
+#else  /* !HAVE_BPF_SKEL */
+
+static inline int lock_hist_prepare(struct lock_hist *hist __maybe_unused)
+{
+	return -1;
+}
+
+static inline int lock_hist_start(void) { return 0; }
+static inline int lock_hist_stop(void) { return 0; }
+static inline int lock_hist_read(struct lock_hist *hist __maybe_unused)
+{
+	return 0;
+}
+static inline int lock_hist_finish(struct lock_hist *hist __maybe_unused)
+{
+	return 0;
+}
+
+#endif  /* HAVE_BPF_SKEL */
+
+#endif  /* PERF_LOCK_HIST_H */
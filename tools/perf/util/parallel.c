@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "util/parallel.h"
+#include "util/debug.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct parallel_work {
+	parallel_fn	 fn;
+	void		*arg;
+	int		 nr;
+	int		 next;
+	int		 err;
+	pthread_mutex_t	 lock;
+};
+
+static void *parallel_worker(void *arg)
+{
+	struct parallel_work *work = arg;
+
+	while (true) {
+		int idx = -1, err;
+
+		pthread_mutex_lock(&work->lock);
+		if (!work->err && work->next < work->nr)
+			idx = work->next++;
+		pthread_mutex_unlock(&work->lock);
+
+		if (idx < 0)
+			break;
+
+		err = work->fn(idx, work->arg);
+		if (err) {
+			pthread_mutex_lock(&work->lock);
+			if (!work->err)
+				work->err = err;
+			pthread_mutex_unlock(&work->lock);
+		}
+	}
+
+	return NULL;
+}
+
+int parallel_for(int nr, unsigned int nr_threads, parallel_fn fn, void *arg)
+{
+	struct parallel_work work = {
+		.fn	= fn,
+		.arg	= arg,
+		.nr	= nr,
+	};
+	pthread_t *threads = NULL;
+	unsigned int i = 0;
+	int err;
+
+	if (nr_threads > (unsigned int)nr)
+		nr_threads = nr;
+
+	if (nr_threads > 1)
+		threads = calloc(nr_threads - 1, sizeof(*threads));
+
+	pthread_mutex_init(&work.lock, NULL);
+
+	/* the calling thread is one of the workers */
+	for (i = 0; threads && i < nr_threads - 1; i++) {
+		err = pthread_create(&threads[i], NULL, parallel_worker, &work);
+		if (err) {
+			pr_debug("failed to create worker thread: %s\n", strerror(err));
+			break;
+		}
+	}
+
+	parallel_worker(&work);
+
+	while (i--)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&work.lock);
+	free(threads);
+	return work.err;
+}
@@ -0,0 +1,20 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef PERF_PARALLEL_H
+#define PERF_PARALLEL_H
+
+/*
+ * Run fn() once for each index in [0, nr) on a pool of up to nr_threads
+ * threads, the calling thread being one of them.  The indexes are handed
+ * out in order, one at a time, so items of very different costs still
+ * spread evenly over the threads.
+ *
+ * fn() returns 0 or a negative error code.  After an error no new index
+ * is handed out, and the first error is returned once all the threads are
+ * done.  Failing to create a thread is not an error: the items are then
+ * run on the threads which could be created.
+ */
+typedef int (*parallel_fn)(int idx, void *arg);
+
+int parallel_for(int nr, unsigned int nr_threads, parallel_fn fn, void *arg);
+
+#endif /* PERF_PARALLEL_H */
@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef PERF_SCHED_LATENCY_H
+#define PERF_SCHED_LATENCY_H
+
+#include <linux/compiler.h>
+#include <linux/types.h>
+
+#include "bpf_skel/sched_latency_data.h"
+
+enum sched_latency_aggr_mode {
+	SCHED_LAT_AGGR_TASK,
+	SCHED_LAT_AGGR_CGROUP,
+};
+
+struct sched_latency_stat {
+	u64	id;		/* tid or cgroup id */
+	char	*name;		/* comm or cgroup path */
+	u64	count;
+	u64	total;
+	u64	max;
+	__u64	hist[SCHED_LAT_NR_SLOTS];
+};
+
+struct sched_latency {
+	enum sched_latency_aggr_mode	aggr_mode;
+	unsigned long			map_nr_entries;
+	/* results of the last read, reset on every read */
+	struct sched_latency_stat	*stats;
+	int				nr_stats;
+	int				lost;
+};
+
+#ifdef HAVE_BPF_SKEL
+
+int sched_latency_prepare(struct sched_latency *lat);
+int sched_latency_start(void);
+int sched_latency_stop(void);
+int sched_latency_read(struct sched_latency *lat);
+int sched_latency_finish(struct sched_latency *lat);
+
+#else  /* !HAVE_BPF_SKEL */
+
+static inline int sched_latency_prepare(struct sched_latency *lat __maybe_unused)
+{
+	return -1;
+}
+
+static inline int sched_latency_start(void) { return 0; }
+static inline int sched_latency_stop(void) { return 0; }
+static inline int sched_latency_read(struct sched_latency *lat __maybe_unused)
+{
+	return 0;
+}
+static inline int sched_latency_finish(struct sched_latency *lat __maybe_unused)
+{
+	return 0;
+}
+
+#endif  /* HAVE_BPF_SKEL */
+
+#endif  /* PERF_SCHED_LATENCY_H */
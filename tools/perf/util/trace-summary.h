@@ -0,0 +1,85 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef PERF_TRACE_SUMMARY_H
+#define PERF_TRACE_SUMMARY_H
+
+#include <linux/compiler.h>
+#include <linux/types.h>
+
+#include "bpf_skel/syscall_summary_data.h"
+
+struct evlist;
+struct target;
+
+struct trace_summary_stat {
+	u32	nr;		/* syscall id */
+	u64	count;
+	u64	errors;
+	u64	total;
+	u64	min;
+	u64	max;
+	__u64	hist[SYSCALL_SUMMARY_NR_SLOTS];
+};
+
+struct trace_summary_errno {
+	u32	nr;
+	u32	err;
+	u64	count;
+};
+
+struct trace_summary {
+	struct evlist		*evlist;
+	struct target		*target;
+	/* syscall ids to trace (or not to, if not_syscalls is set) */
+	int			*syscalls;
+	int			nr_syscalls;
+	bool			not_syscalls;
+	bool			errno_summary;
+	/* send one of every sample_rate syscalls to handle_sample(), 0: none */
+	unsigned int		sample_rate;
+	unsigned long		ringbuf_size;
+	unsigned long		map_nr_entries;
+	int			(*handle_sample)(struct trace_summary *ts,
+						 struct syscall_summary_sample *sample);
+	/* results of the last read, reset on every read */
+	struct trace_summary_stat	*stats;
+	int				nr_stats;
+	struct trace_summary_errno	*errnos;
+	int				nr_errnos;
+	int				lost;
+};
+
+#ifdef HAVE_BPF_SKEL
+
+int trace_summary_prepare(struct trace_summary *ts);
+int trace_summary_start(void);
+int trace_summary_stop(void);
+int trace_summary_poll(struct trace_summary *ts, int timeout_ms);
+int trace_summary_read(struct trace_summary *ts);
+int trace_summary_finish(struct trace_summary *ts);
+
+#else  /* !HAVE_BPF_SKEL */
+
+static inline int trace_summary_prepare(struct trace_summary *ts __maybe_unused)
+{
+	return -1;
+}
+
+static inline int trace_summary_start(void) { return 0; }
+static inline int trace_summary_stop(void) { return 0; }
+static inline int trace_summary_poll(struct trace_summary *ts __maybe_unused,
+				     int timeout_ms __maybe_unused)
+{
+	return 0;
+}
+static inline int trace_summary_read(struct trace_summary *ts __maybe_unused)
+{
+	return 0;
+}
+static inline int trace_summary_finish(struct trace_summary *ts __maybe_unused)
+{
+	return 0;
+}
+
+#endif  /* HAVE_BPF_SKEL */
+
+#endif  /* PERF_TRACE_SUMMARY_H */
@@ -0,0 +1,201 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#define _GNU_SOURCE
+#include <linux/limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sysinfo.h>
+#include <time.h>
+
+#include "../kselftest.h"
+#include "cgroup_util.h"
+
+#define NR_ITERATIONS	200
+
+struct reconfig_lat {
+	const char *name;
+	long nr;
+	long total_usec;
+	long max_usec;
+};
+
+static long now_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
+/* time a write, which has to succeed */
+static int timed_write(struct reconfig_lat *lat, const char *cgroup,
+		       const char *control, char *buf)
+{
+	long start = now_usec(), usec;
+
+	if (cg_write(cgroup, control, buf))
+		return -1;
+
+	usec = now_usec() - start;
+	lat->nr++;
+	lat->total_usec += usec;
+	if (usec > lat->max_usec)
+		lat->max_usec = usec;
+	return 0;
+}
+
+static void cpulist(char *buf, size_t len, int first, int last)
+{
+	if (first == last)
+		snprintf(buf, len, "%d", first);
+	else
+		snprintf(buf, len, "%d-%d", first, last);
+}
+
+static int write_cpus(struct reconfig_lat *lat, const char *cgroup,
+		      int first, int last)
+{
+	char buf[32];
+
+	cpulist(buf, sizeof(buf), first, last);
+	return timed_write(lat, cgroup, "cpuset.cpus", buf);
+}
+
+/*
+ * This test creates a partition root with the cpus 1 to N-1, split between
+ * two child partition roots, and keeps moving a cpu from one child to the
+ * other and switching a child between "root" and "isolated", the way an
+ * orchestrator repartitions cpus for its latency sensitive workloads.
+ * Each of these changes rebuilds the sched domains; the test reports how
+ * long the writes take and checks that both partitions stay valid.
+ */
+static int test_cpuset_reconfig(const char *root)
+{
+	struct reconfig_lat cpus_lat = { .name = "cpuset.cpus" };
+	struct reconfig_lat prs_lat = { .name = "cpuset.cpus.partition" };
+	char *parent = NULL, *a = NULL, *b = NULL;
+	int nr_cpus = get_nprocs();
+	int ret = KSFT_FAIL;
+	int mid, last, i;
+	char buf[32];
+
+	/* cpu 0 stays in the root partition, the children need 2 and 1 */
+	if (nr_cpus < 4)
+		return KSFT_SKIP;
+	last = nr_cpus - 1;
+	mid = nr_cpus / 2;
+
+	if (cg_read_strstr(root, "cgroup.controllers", "cpuset") ||
+	    cg_write(root, "cgroup.subtree_control", "+cpuset"))
+		return KSFT_SKIP;
+
+	parent = cg_name(root, "cpuset_reconfig_test");
+	if (!parent || cg_create(parent))
+		goto cleanup;
+
+	cpulist(buf, sizeof(buf), 1, last);
+	if (cg_write(parent, "cpuset.cpus", buf))
+		goto cleanup;
+
+	/* the cpus may be taken by other partitions already */
+	if (cg_write(parent, "cpuset.cpus.partition", "root") ||
+	    cg_read_strcmp(parent, "cpuset.cpus.partition", "root\n")) {
+		ret = KSFT_SKIP;
+		goto cleanup;
+	}
+
+	if (cg_write(parent, "cgroup.subtree_control", "+cpuset"))
+		goto cleanup;
+
+	a = cg_name(parent, "a");
+	b = cg_name(parent, "b");
+	if (!a || !b || cg_create(a) || cg_create(b))
+		goto cleanup;
+
+	if (write_cpus(&cpus_lat, a, 1, mid) ||
+	    write_cpus(&cpus_lat, b, mid + 1, last) ||
+	    timed_write(&prs_lat, a, "cpuset.cpus.partition", "root") ||
+	    timed_write(&prs_lat, b, "cpuset.cpus.partition", "root"))
+		goto cleanup;
+
+	for (i = 0; i < NR_ITERATIONS; i++) {
+		/* move cpu mid from a to b, and back */
+		if (write_cpus(&cpus_lat, a, 1, mid - 1) ||
+		    write_cpus(&cpus_lat, b, mid, last) ||
+		    write_cpus(&cpus_lat, b, mid + 1, last) ||
+		    write_cpus(&cpus_lat, a, 1, mid))
+			goto cleanup;
+
+		if (timed_write(&prs_lat, a, "cpuset.cpus.partition",
+				"isolated") ||
+		    timed_write(&prs_lat, a, "cpuset.cpus.partition", "root"))
+			goto cleanup;
+	}
+
+	if (cg_read_strcmp(a, "cpuset.cpus.partition", "root\n") ||
+	    cg_read_strcmp(b, "cpuset.cpus.partition", "root\n")) {
+		ksft_print_msg("partitions invalidated\n");
+		goto cleanup;
+	}
+
+	for (i = 0; i < 2; i++) {
+		struct reconfig_lat *lat = i ? &prs_lat : &cpus_lat;
+
+		ksft_print_msg("%s: %ld writes, avg %ld usec, max %ld usec\n",
+			       lat->name, lat->nr, lat->total_usec / lat->nr,
+			       lat->max_usec);
+	}
+
+	ret = KSFT_PASS;
+
+cleanup:
+	if (b) {
+		cg_destroy(b);
+		free(b);
+	}
+	if (a) {
+		cg_destroy(a);
+		free(a);
+	}
+	if (parent) {
+		cg_destroy(parent);
+		free(parent);
+	}
+	return ret;
+}
+
+#define T(x) { x, #x }
+struct cpuset_test {
+	int (*fn)(const char *root);
+	const char *name;
+} tests[] = {
+	T(test_cpuset_reconfig),
+};
+#undef T
+
+int main(int argc, char *argv[])
+{
+	char root[PATH_MAX];
+	int i, ret = EXIT_SUCCESS;
+
+	if (cg_find_unified_root(root, sizeof(root)))
+		ksft_exit_skip("cgroup v2 isn't mounted\n");
+
+	for (i = 0; i < ARRAY_SIZE(tests); i++) {
+		switch (tests[i].fn(root)) {
+		case KSFT_PASS:
+			ksft_test_result_pass("%s\n", tests[i].name);
+			break;
+		case KSFT_SKIP:
+			ksft_test_result_skip("%s\n", tests[i].name);
+			break;
+		default:
+			ret = EXIT_FAILURE;
+			ksft_test_result_fail("%s\n", tests[i].name);
+			break;
+		}
+	}
+
+	return ret;
+}
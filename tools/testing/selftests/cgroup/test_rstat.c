@@ -0,0 +1,417 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#define _GNU_SOURCE
+#include <linux/limits.h>
+#include <linux/cgroup_bulk_stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../kselftest.h"
+#include "cgroup_util.h"
+
+#define NR_SUBTREES	4
+#define NR_CHILDREN	8
+#define NR_READERS	16
+#define READ_SECS	3
+#define NR_CGROUPS	(1 + NR_SUBTREES + NR_SUBTREES * NR_CHILDREN)
+
+/*
+ * Two levels of cgroups with a cpu hog in each leaf, so that cpu.stat
+ * always has something to flush:
+ *
+ *	parent/sub<i>/child<j>
+ */
+struct rstat_tree {
+	char *parent;
+	char *subtrees[NR_SUBTREES];
+	char *children[NR_SUBTREES][NR_CHILDREN];
+	pid_t hogs[NR_SUBTREES][NR_CHILDREN];
+};
+
+struct rstat_reader {
+	pthread_t thread;
+	struct rstat_tree *tree;
+	int id;
+	long nr_reads;
+	int err;
+};
+
+static volatile int readers_stop;
+
+static int hog(const char *cgroup, void *arg)
+{
+	volatile unsigned long n = 0;
+
+	for (;;)
+		n++;
+	return 0;
+}
+
+static void rstat_tree_destroy(struct rstat_tree *tree)
+{
+	int i, j;
+
+	for (i = 0; i < NR_SUBTREES; i++) {
+		for (j = 0; j < NR_CHILDREN; j++) {
+			if (tree->hogs[i][j] > 0) {
+				kill(tree->hogs[i][j], SIGKILL);
+				waitpid(tree->hogs[i][j], NULL, 0);
+			}
+			if (tree->children[i][j]) {
+				cg_destroy(tree->children[i][j]);
+				free(tree->children[i][j]);
+			}
+		}
+		if (tree->subtrees[i]) {
+			cg_destroy(tree->subtrees[i]);
+			free(tree->subtrees[i]);
+		}
+	}
+
+	if (tree->parent) {
+		cg_destroy(tree->parent);
+		free(tree->parent);
+	}
+}
+
+static int rstat_tree_create(struct rstat_tree *tree, const char *root)
+{
+	int i, j;
+
+	memset(tree, 0, sizeof(*tree));
+
+	tree->parent = cg_name(root, "rstat_test");
+	if (!tree->parent || cg_create(tree->parent))
+		return -1;
+
+	for (i = 0; i < NR_SUBTREES; i++) {
+		tree->subtrees[i] = cg_name_indexed(tree->parent, "sub", i);
+		if (!tree->subtrees[i] || cg_create(tree->subtrees[i]))
+			return -1;
+
+		for (j = 0; j < NR_CHILDREN; j++) {
+			tree->children[i][j] = cg_name_indexed(tree->subtrees[i],
+							       "child", j);
+			if (!tree->children[i][j] ||
+			    cg_create(tree->children[i][j]))
+				return -1;
+
+			tree->hogs[i][j] = cg_run_nowait(tree->children[i][j],
+							 hog, NULL);
+			if (tree->hogs[i][j] < 0)
+				return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Each reader keeps reading the cpu usage of its own leaves, of the whole
+ * subtree they are in, and of the parent, which every other reader reads
+ * too.  A flush must never make the usage of a cgroup go backwards.
+ */
+static void *rstat_reader_fn(void *arg)
+{
+	struct rstat_reader *reader = arg;
+	struct rstat_tree *tree = reader->tree;
+	int sub = reader->id % NR_SUBTREES;
+	long last_child[NR_CHILDREN] = {};
+	long last_sub = 0, last_parent = 0;
+	long usage;
+	int j;
+
+	while (!readers_stop) {
+		for (j = 0; j < NR_CHILDREN; j++) {
+			usage = cg_read_key_long(tree->children[sub][j],
+						 "cpu.stat", "usage_usec");
+			if (usage < last_child[j])
+				goto fail;
+			last_child[j] = usage;
+			reader->nr_reads++;
+		}
+
+		usage = cg_read_key_long(tree->subtrees[sub], "cpu.stat",
+					 "usage_usec");
+		if (usage < last_sub)
+			goto fail;
+		last_sub = usage;
+
+		usage = cg_read_key_long(tree->parent, "cpu.stat", "usage_usec");
+		if (usage < last_parent)
+			goto fail;
+		last_parent = usage;
+
+		reader->nr_reads += 2;
+	}
+
+	return NULL;
+fail:
+	reader->err = -1;
+	return NULL;
+}
+
+/*
+ * This test creates 4 subtrees of 8 cgroups running a cpu hog each, and
+ * has 16 threads concurrently reading cpu.stat of cgroups in disjoint
+ * subtrees, of the same subtree and of their common parent.  All the
+ * reads have to succeed and the usage of a cgroup must never decrease.
+ */
+static int test_rstat_concurrent_reads(const char *root)
+{
+	struct rstat_reader readers[NR_READERS] = {};
+	struct rstat_tree tree;
+	long nr_reads = 0;
+	int ret = KSFT_FAIL;
+	int i, nr_threads = 0;
+
+	if (rstat_tree_create(&tree, root))
+		goto cleanup;
+
+	readers_stop = 0;
+	for (i = 0; i < NR_READERS; i++) {
+		readers[i].tree = &tree;
+		readers[i].id = i;
+		if (pthread_create(&readers[i].thread, NULL, rstat_reader_fn,
+				   &readers[i]))
+			break;
+		nr_threads++;
+	}
+
+	if (nr_threads == NR_READERS)
+		sleep(READ_SECS);
+	readers_stop = 1;
+
+	for (i = 0; i < nr_threads; i++) {
+		pthread_join(readers[i].thread, NULL);
+		nr_reads += readers[i].nr_reads;
+		if (readers[i].err) {
+			ksft_print_msg("cpu.stat usage went backwards\n");
+			goto cleanup;
+		}
+	}
+
+	if (nr_threads != NR_READERS)
+		goto cleanup;
+
+	ksft_print_msg("%ld cpu.stat reads in %d secs\n", nr_reads, READ_SECS);
+	ret = KSFT_PASS;
+
+cleanup:
+	rstat_tree_destroy(&tree);
+	return ret;
+}
+
+/*
+ * Once the hogs are gone and nothing updates the stats anymore, the usage
+ * of each cgroup must be the sum of the usage of its children, whatever
+ * the order the flushes of the different subtrees happened in.  Each
+ * cgroup rounds its usage down to a usec, hence the tolerance.
+ */
+static int test_rstat_hierarchy(const char *root)
+{
+	struct rstat_reader readers[NR_SUBTREES] = {};
+	long parent_usage, sub_usage, total = 0;
+	struct rstat_tree tree;
+	int ret = KSFT_FAIL;
+	int i, j, nr_threads = 0;
+
+	if (rstat_tree_create(&tree, root))
+		goto cleanup;
+
+	/* let the hogs run while each subtree gets flushed by its reader */
+	readers_stop = 0;
+	for (i = 0; i < NR_SUBTREES; i++) {
+		readers[i].tree = &tree;
+		readers[i].id = i;
+		if (pthread_create(&readers[i].thread, NULL, rstat_reader_fn,
+				   &readers[i]))
+			break;
+		nr_threads++;
+	}
+
+	sleep(1);
+	readers_stop = 1;
+
+	for (i = 0; i < nr_threads; i++) {
+		pthread_join(readers[i].thread, NULL);
+		if (readers[i].err)
+			goto cleanup;
+	}
+
+	if (nr_threads != NR_SUBTREES)
+		goto cleanup;
+
+	for (i = 0; i < NR_SUBTREES; i++) {
+		for (j = 0; j < NR_CHILDREN; j++) {
+			kill(tree.hogs[i][j], SIGKILL);
+			waitpid(tree.hogs[i][j], NULL, 0);
+			tree.hogs[i][j] = 0;
+		}
+	}
+
+	/* a reaped task can still account its last bit of runtime */
+	usleep(USEC_PER_SEC / 10);
+
+	/* flush the leaves first, then the subtrees and the parent */
+	for (i = 0; i < NR_SUBTREES; i++) {
+		long children_usage = 0;
+
+		for (j = 0; j < NR_CHILDREN; j++)
+			children_usage += cg_read_key_long(tree.children[i][j],
+							   "cpu.stat",
+							   "usage_usec");
+
+		sub_usage = cg_read_key_long(tree.subtrees[i], "cpu.stat",
+					     "usage_usec");
+		if (sub_usage < children_usage ||
+		    sub_usage > children_usage + NR_CHILDREN) {
+			ksft_print_msg("sub%d usage %ld, children usage %ld\n",
+				       i, sub_usage, children_usage);
+			goto cleanup;
+		}
+		total += sub_usage;
+	}
+
+	parent_usage = cg_read_key_long(tree.parent, "cpu.stat", "usage_usec");
+	if (parent_usage < total || parent_usage > total + NR_SUBTREES) {
+		ksft_print_msg("parent usage %ld, subtrees usage %ld\n",
+			       parent_usage, total);
+		goto cleanup;
+	}
+
+	ret = KSFT_PASS;
+
+cleanup:
+	rstat_tree_destroy(&tree);
+	return ret;
+}
+
+/*
+ * cgroup.bulk_stat of the parent has to return one record per cgroup of the
+ * tree, in pre-order, and their cpu usage can't be ahead of what cpu.stat
+ * reports afterwards.
+ */
+static int test_rstat_bulk_stat(const char *root)
+{
+	char buf[NR_CGROUPS * sizeof(struct cgroup_bulk_stat) * 2];
+	__u64 parent_id = 0, sub_id = 0;
+	struct cgroup_bulk_stat *bs;
+	int ret = KSFT_FAIL;
+	struct rstat_tree tree;
+	char path[PATH_MAX];
+	long usage = 0;
+	size_t off, len = 0;
+	ssize_t n;
+	int fd, nr = 0;
+
+	if (rstat_tree_create(&tree, root))
+		goto cleanup;
+
+	sleep(1);
+
+	snprintf(path, sizeof(path), "%s/cgroup.bulk_stat", tree.parent);
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		if (errno == ENOENT)
+			ret = KSFT_SKIP;
+		goto cleanup;
+	}
+
+	/* small reads, to resume the walk in the middle of the tree */
+	while ((n = read(fd, buf + len, sizeof(*bs) * 3 + 1)) > 0) {
+		len += n;
+		if (len + sizeof(*bs) * 3 + 1 > sizeof(buf))
+			break;
+	}
+	close(fd);
+	if (n < 0)
+		goto cleanup;
+
+	for (off = 0; off + sizeof(*bs) <= len; off += bs->size, nr++) {
+		bs = (struct cgroup_bulk_stat *)(buf + off);
+
+		if (bs->size < sizeof(*bs) || !(bs->flags & CGROUP_BULK_STAT_CPU))
+			goto cleanup;
+
+		switch (bs->depth) {
+		case 0:
+			if (nr || bs->parent_id)
+				goto cleanup;
+			parent_id = bs->id;
+			usage = bs->cpu_usage_usec;
+			break;
+		case 1:
+			if (bs->parent_id != parent_id)
+				goto cleanup;
+			sub_id = bs->id;
+			break;
+		case 2:
+			if (bs->parent_id != sub_id)
+				goto cleanup;
+			break;
+		default:
+			goto cleanup;
+		}
+	}
+
+	if (off != len || nr != NR_CGROUPS) {
+		ksft_print_msg("%d records in %zu bytes\n", nr, len);
+		goto cleanup;
+	}
+
+	if (!usage ||
+	    usage > cg_read_key_long(tree.parent, "cpu.stat", "usage_usec"))
+		goto cleanup;
+
+	ret = KSFT_PASS;
+
+cleanup:
+	rstat_tree_destroy(&tree);
+	return ret;
+}
+
+#define T(x) { x, #x }
+struct rstat_test {
+	int (*fn)(const char *root);
+	const char *name;
+} tests[] = {
+	T(test_rstat_concurrent_reads),
+	T(test_rstat_hierarchy),
+	T(test_rstat_bulk_stat),
+};
+#undef T
+
+int main(int argc, char *argv[])
+{
+	char root[PATH_MAX];
+	int i, ret = EXIT_SUCCESS;
+
+	if (cg_find_unified_root(root, sizeof(root)))
+		ksft_exit_skip("cgroup v2 isn't mounted\n");
+
+	for (i = 0; i < ARRAY_SIZE(tests); i++) {
+		switch (tests[i].fn(root)) {
+		case KSFT_PASS:
+			ksft_test_result_pass("%s\n", tests[i].name);
+			break;
+		case KSFT_SKIP:
+			ksft_test_result_skip("%s\n", tests[i].name);
+			break;
+		default:
+			ret = EXIT_FAILURE;
+			ksft_test_result_fail("%s\n", tests[i].name);
+			break;
+		}
+	}
+
+	return ret;
+}